@@ -40,9 +40,12 @@ options {\n\
 	geoip-directory \".\";\n"
 #endif /* if defined(HAVE_GEOIP2) */
 					    "\
+	hitters-sample-rate 0;\n\
+	hugepages none;\n\
 	interface-interval 60m;\n\
 	listen-on {any;};\n\
 	listen-on-v6 {any;};\n\
+	loop-stall-threshold 0;\n\
 	match-mapped-addresses no;\n\
 	max-ixfr-ratio 100%;\n\
 	max-rsa-exponent-size 0; /* no limit */\n\
@@ -52,6 +55,7 @@ options {\n\
 	notify-rate 20;\n\
 	nta-lifetime 3600;\n\
 	nta-recheck 300;\n\
+	offload-work-stealing no;\n\
 #	pid-file \"" NAMED_LOCALSTATEDIR "/run/named/named.pid\"; \n\
 	port 53;\n"
 #if HAVE_SO_REUSEPORT_LB
@@ -62,6 +66,7 @@ options {\n\
 	reuseport no;\n"
 #endif
 					    "\
+	reuseport-cpu-affinity no;\n\
 	tls-port 853;\n"
 #if HAVE_LIBNGHTTP2
 					    "\
@@ -75,8 +80,15 @@ options {\n\
 #	querylog <boolean>;\n\
 	recursing-file \"named.recursing\";\n\
 	recursive-clients 1000;\n\
+	recursive-clients-fair-share no;\n\
+	recursive-clients-ipv4-prefix-length 24;\n\
+	recursive-clients-ipv6-prefix-length 56;\n\
+	recursive-clients-min-share 10;\n\
 	request-nsid false;\n\
 	request-zoneversion false;\n\
+	resolver-forwarder-spread 100%;\n\
+	resolver-hedge-budget 5%;\n\
+	resolver-hedge-percentile 0;\n\
 	resolver-query-timeout 10;\n\
 #	responselog <boolean>;\n\
 #	rrset-order { order cyclic; };\n\
@@ -87,6 +99,7 @@ options {\n\
 	session-keyalg hmac-sha256;\n\
 #	session-keyfile \"" NAMED_LOCALSTATEDIR "/run/named/session.key\";\n\
 	session-keyname local-ddns;\n\
+	share-fetches no;\n\
 	startup-notify-rate 20;\n\
 	sig0checks-quota 1;\n\
 	sig0key-checks-limit 16;\n\
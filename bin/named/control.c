@@ -211,10 +211,14 @@ named_control_docommand(isccc_sexpr_t *message, bool readonly,
 		result = named_server_freeze(named_g_server, true, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_SKR)) {
 		result = named_server_skr(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_HITTERS)) {
+		result = named_server_hitters(named_g_server, lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_LOADKEYS) ||
 		   command_compare(command, NAMED_COMMAND_SIGN))
 	{
 		result = named_server_rekey(named_g_server, lex, text);
+	} else if (command_compare(command, NAMED_COMMAND_LOCKPROF)) {
+		result = named_server_lockprof(lex, text);
 	} else if (command_compare(command, NAMED_COMMAND_MEMPROF)) {
 		result = named_server_togglememprof(lex);
 	} else if (command_compare(command, NAMED_COMMAND_MKEYS)) {
@@ -42,7 +42,9 @@
 #define NAMED_COMMAND_FLUSHTREE	   "flushtree"
 #define NAMED_COMMAND_FREEZE	   "freeze"
 #define NAMED_COMMAND_HALT	   "halt"
+#define NAMED_COMMAND_HITTERS	   "hitters"
 #define NAMED_COMMAND_LOADKEYS	   "loadkeys"
+#define NAMED_COMMAND_LOCKPROF	   "lockprof"
 #define NAMED_COMMAND_MEMPROF	   "memprof"
 #define NAMED_COMMAND_MKEYS	   "managed-keys"
 #define NAMED_COMMAND_MODZONE	   "modzone"
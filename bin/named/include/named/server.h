@@ -406,6 +406,20 @@ named_server_skr(named_server_t *server, isc_lex_t *lex, isc_buffer_t *text);
 isc_result_t
 named_server_togglememprof(isc_lex_t *lex);
 
+/*%
+ * Report the most contended lock sites, or enable, disable or reset
+ * lock profiling if supported.
+ */
+isc_result_t
+named_server_lockprof(isc_lex_t *lex, isc_buffer_t *text);
+
+/*%
+ * Report the most frequent query names, clients and resolver fetch names.
+ */
+isc_result_t
+named_server_hitters(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t *text);
+
 /*%
  * Get status of memory profiling.
  */
@@ -38,10 +38,12 @@
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
+#include <isc/hugepage.h>
 #include <isc/hmac.h>
 #include <isc/httpd.h>
 #include <isc/job.h>
 #include <isc/lex.h>
+#include <isc/lockprof.h>
 #include <isc/loop.h>
 #include <isc/meminfo.h>
 #include <isc/netmgr.h>
@@ -58,6 +60,7 @@
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/acl.h>
 #include <dns/adb.h>
@@ -235,6 +238,7 @@ struct named_dispatch {
 struct named_cache {
 	dns_cache_t *cache;
 	dns_view_t *primaryview;
+	dns_fetchgroup_t *fetchgroup;
 	bool needflush;
 	bool adbsizeadjusted;
 	dns_rdataclass_t rdclass;
@@ -3789,11 +3793,14 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	isc_statsmulti_t *resquerystats = NULL;
 	isc_histomulti_t *resqueryinrttstats = NULL;
 	isc_histomulti_t *resqueryoutrttstats = NULL;
+	isc_topkmulti_t *restopfetches = NULL;
+	uint32_t hittersrate;
 	bool auto_root = false;
 	named_cache_t *nsc = NULL;
 	bool zero_no_soattl;
 	dns_acl_t *clients = NULL, *mapped = NULL, *excluded = NULL;
 	unsigned int query_timeout;
+	unsigned int hedge_percentile;
 	bool old_rpz_ok = false;
 	dns_dyndbctx_t *dctx = NULL;
 	dns_ntatable_t *ntatable = NULL;
@@ -4311,6 +4318,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			dns_resolver_getqueryrttstats(pview->resolver,
 						      &resqueryinrttstats,
 						      &resqueryoutrttstats);
+			dns_resolver_gettopfetches(pview->resolver,
+						   &restopfetches);
 		}
 	}
 
@@ -4397,6 +4406,23 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	dns_resolver_setqueryrttstats(view->resolver, resqueryinrttstats,
 				      resqueryoutrttstats);
 
+	obj = NULL;
+	result = named_config_get(maps, "hitters-sample-rate", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	hittersrate = cfg_obj_asuint32(obj);
+	if (restopfetches != NULL &&
+	    isc_topkmulti_getrate(restopfetches) != hittersrate)
+	{
+		isc_topkmulti_detach(&restopfetches);
+	}
+	if (restopfetches == NULL && hittersrate > 0) {
+		isc_topkmulti_create(mctx, NS_HITTERS_HALFLIFE, hittersrate,
+				     &restopfetches);
+	}
+	if (restopfetches != NULL) {
+		dns_resolver_settopfetches(view->resolver, restopfetches);
+	}
+
 	/*
 	 * Set the ADB cache size to 1/8th of the max-cache-size or
 	 * MAX_ADB_SIZE_FOR_CACHESHARE when the cache is shared.
@@ -4499,6 +4525,39 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	query_timeout = cfg_obj_asuint32(obj);
 	dns_resolver_settimeout(view->resolver, query_timeout);
 
+	/*
+	 * Set up hedged queries.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "resolver-hedge-percentile", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	hedge_percentile = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "resolver-hedge-budget", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_resolver_sethedging(view->resolver, hedge_percentile,
+				cfg_obj_aspercentage(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "resolver-forwarder-spread", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_resolver_setforwarderspread(view->resolver,
+					cfg_obj_aspercentage(obj));
+
+	/*
+	 * Let the views sharing this cache join each other's fetches.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "share-fetches", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asboolean(obj)) {
+		if (nsc->fetchgroup == NULL) {
+			dns_fetchgroup_create(mctx, &nsc->fetchgroup);
+		}
+		dns_resolver_setfetchgroup(view->resolver, nsc->fetchgroup);
+	}
+
 	/* Specify whether to use 0-TTL for negative response for SOA query */
 	dns_resolver_setzeronosoattl(view->resolver, zero_no_soattl);
 
@@ -5548,6 +5607,9 @@ cleanup:
 	if (resqueryoutrttstats != NULL) {
 		isc_histomulti_detach(&resqueryoutrttstats);
 	}
+	if (restopfetches != NULL) {
+		isc_topkmulti_detach(&restopfetches);
+	}
 	if (order != NULL) {
 		dns_order_detach(&order);
 	}
@@ -7756,6 +7818,7 @@ apply_configuration(cfg_obj_t *effectiveconfig, cfg_obj_t *bindkeys,
 	uint32_t max;
 	uint64_t initial, idle, keepalive, advertised, primaries, reuse;
 	bool loadbalancesockets;
+	bool cpuaffinity;
 	bool exclusive = false;
 	dns_aclenv_t *env =
 		ns_interfacemgr_getaclenv(named_g_server->interfacemgr);
@@ -7914,6 +7977,43 @@ apply_configuration(cfg_obj_t *effectiveconfig, cfg_obj_t *bindkeys,
 	}
 	isc_quota_soft(&server->sctx->recursionquota, softquota);
 
+	{
+		bool fairshare;
+		uint32_t prefixlen4, prefixlen6, minshare;
+
+		obj = NULL;
+		result = named_config_get(maps, "recursive-clients-fair-share",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		fairshare = cfg_obj_asboolean(obj);
+
+		obj = NULL;
+		result = named_config_get(
+			maps, "recursive-clients-ipv4-prefix-length", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		prefixlen4 = cfg_obj_asuint32(obj);
+
+		obj = NULL;
+		result = named_config_get(
+			maps, "recursive-clients-ipv6-prefix-length", &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		prefixlen6 = cfg_obj_asuint32(obj);
+
+		obj = NULL;
+		result = named_config_get(maps, "recursive-clients-min-share",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS);
+		minshare = cfg_obj_asuint32(obj);
+
+		ns_server_setrecursionshare(server->sctx, fairshare,
+					    prefixlen4, prefixlen6, minshare);
+	}
+
+	obj = NULL;
+	result = named_config_get(maps, "hitters-sample-rate", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_server_sethitters(server->sctx, cfg_obj_asuint32(obj));
+
 	obj = NULL;
 	result = named_config_get(maps, "sig0checks-quota-exempt", &obj);
 	if (result == ISC_R_SUCCESS) {
@@ -8182,6 +8282,27 @@ apply_configuration(cfg_obj_t *effectiveconfig, cfg_obj_t *bindkeys,
 		}
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "loop-stall-threshold", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_loopmgr_setstallthreshold(cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "offload-work-stealing", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_work_setstealing(cfg_obj_asboolean(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "hugepages", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (strcasecmp(cfg_obj_asstring(obj), "explicit") == 0) {
+		isc_hugepage_setmode(isc_hugepage_explicit);
+	} else if (strcasecmp(cfg_obj_asstring(obj), "transparent") == 0) {
+		isc_hugepage_setmode(isc_hugepage_transparent);
+	} else {
+		isc_hugepage_setmode(isc_hugepage_none);
+	}
+
 	/*
 	 * Find the listen queue depth.
 	 */
@@ -8212,6 +8333,28 @@ apply_configuration(cfg_obj_t *effectiveconfig, cfg_obj_t *bindkeys,
 	}
 #endif
 
+	obj = NULL;
+	result = named_config_get(maps, "reuseport-cpu-affinity", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cpuaffinity = cfg_obj_asboolean(obj);
+	if (first_time) {
+		result = isc_nm_setcpuaffinity(cpuaffinity);
+		if (result == ISC_R_RANGE) {
+			cfg_obj_log(obj, ISC_LOG_WARNING,
+				    "reuseport-cpu-affinity has no effect with "
+				    "more threads than CPUs");
+		} else if (result != ISC_R_SUCCESS) {
+			cfg_obj_log(obj, ISC_LOG_WARNING,
+				    "reuseport-cpu-affinity has no effect %s",
+				    loadbalancesockets ? "on this system"
+						       : "without reuseport");
+		}
+	} else if (cpuaffinity != isc_nm_getcpuaffinity()) {
+		cfg_obj_log(obj, ISC_LOG_WARNING,
+			    "changing reuseport-cpu-affinity value requires "
+			    "server restart");
+	}
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -8839,6 +8982,9 @@ cleanup_cachelist:
 	ISC_LIST_FOREACH(cachelist, nsc, link) {
 		ISC_LIST_UNLINK(cachelist, nsc, link);
 		dns_cache_detach(&nsc->cache);
+		if (nsc->fetchgroup != NULL) {
+			dns_fetchgroup_detach(&nsc->fetchgroup);
+		}
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
 
@@ -9239,6 +9385,9 @@ shutdown_server(void *arg) {
 	ISC_LIST_FOREACH(server->cachelist, nsc, link) {
 		ISC_LIST_UNLINK(server->cachelist, nsc, link);
 		dns_cache_detach(&nsc->cache);
+		if (nsc->fetchgroup != NULL) {
+			dns_fetchgroup_detach(&nsc->fetchgroup);
+		}
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
 
@@ -15059,6 +15208,223 @@ done:
 	return result;
 }
 
+/*
+ * Number of lock sites listed by 'rndc lockprof'.
+ */
+#define LOCKPROF_TOP 20
+
+typedef struct lockprof_top {
+	size_t count;
+	isc_lockprof_stats_t sites[LOCKPROF_TOP];
+} lockprof_top_t;
+
+/*
+ * Keep the sites with the most time spent waiting, sorted.
+ */
+static isc_result_t
+lockprof_collect(const isc_lockprof_stats_t *stats, void *arg) {
+	lockprof_top_t *top = arg;
+	size_t i;
+
+	if (stats->contended == 0) {
+		return ISC_R_SUCCESS;
+	}
+
+	if (top->count == LOCKPROF_TOP) {
+		if (stats->waitns <= top->sites[LOCKPROF_TOP - 1].waitns) {
+			return ISC_R_SUCCESS;
+		}
+		top->count--;
+	}
+
+	for (i = top->count; i > 0; i--) {
+		if (top->sites[i - 1].waitns >= stats->waitns) {
+			break;
+		}
+		top->sites[i] = top->sites[i - 1];
+	}
+	top->sites[i] = *stats;
+	top->count++;
+
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+named_server_lockprof(isc_lex_t *lex, isc_buffer_t *text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	lockprof_top_t top = { .count = 0 };
+	char msg[512];
+	char *ptr;
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	if (!isc_lockprof_supported()) {
+		(void)putstr(text, "named was built without lock profiling");
+		(void)putnull(text);
+		return ISC_R_NOTIMPLEMENTED;
+	}
+
+	ptr = next_token(lex, text);
+	if (ptr == NULL || !strcasecmp(ptr, "show")) {
+		/* fall through to the report */
+	} else if (!strcasecmp(ptr, "reset")) {
+		isc_lockprof_reset();
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "lock profile reset");
+		return ISC_R_SUCCESS;
+	} else if (!strcasecmp(ptr, "on") || !strcasecmp(ptr, "yes") ||
+		   !strcasecmp(ptr, "enable") || !strcasecmp(ptr, "true"))
+	{
+		isc_lockprof_setactive(true);
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "lock profiling enabled");
+		return ISC_R_SUCCESS;
+	} else if (!strcasecmp(ptr, "off") || !strcasecmp(ptr, "no") ||
+		   !strcasecmp(ptr, "disable") || !strcasecmp(ptr, "false"))
+	{
+		isc_lockprof_setactive(false);
+		isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+			      ISC_LOG_INFO, "lock profiling disabled");
+		return ISC_R_SUCCESS;
+	} else {
+		return DNS_R_SYNTAX;
+	}
+
+	RUNTIME_CHECK(isc_lockprof_walk(lockprof_collect, &top) ==
+		      ISC_R_SUCCESS);
+
+	snprintf(msg, sizeof(msg), "lock profiling is %s",
+		 isc_lockprof_active() ? "on" : "off");
+	CHECK(putstr(text, msg));
+
+	for (size_t i = 0; i < top.count; i++) {
+		isc_lockprof_stats_t *site = &top.sites[i];
+
+		snprintf(msg, sizeof(msg),
+			 "\n%s:%u (%s): acquired %" PRIu64 ", contended %" PRIu64
+			 ", wait %" PRIu64 " us, max %" PRIu64 " us",
+			 site->file, site->line,
+			 isc_lockprof_kindtext(site->kind), site->acquired,
+			 site->contended, site->waitns / NS_PER_US,
+			 site->maxwaitns / NS_PER_US);
+		CHECK(putstr(text, msg));
+	}
+
+cleanup:
+	if (isc_buffer_usedlength(text) > 0) {
+		(void)putnull(text);
+	}
+
+	return result;
+}
+
+static isc_result_t
+hitters_show(isc_buffer_t *text, const char *title, isc_topkmulti_t *tm,
+	     bool address) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_topk_entry_t entries[ISC_TOPK_ENTRIES];
+	char name[DNS_NAME_FORMATSIZE];
+	char msg[DNS_NAME_FORMATSIZE + 32];
+	size_t count;
+
+	if (isc_buffer_usedlength(text) > 0) {
+		CHECK(putstr(text, "\n"));
+	}
+	CHECK(putstr(text, title));
+	if (tm == NULL) {
+		CHECK(putstr(text, " not counted"));
+		goto cleanup;
+	}
+
+	count = ns_server_gethitters(tm, entries, ARRAY_SIZE(entries));
+	for (size_t i = 0; i < count; i++) {
+		ns_server_formathitter(&entries[i], address, name,
+				       sizeof(name));
+		snprintf(msg, sizeof(msg), "\n%10" PRIu32 " %s",
+			 entries[i].count, name);
+		CHECK(putstr(text, msg));
+	}
+
+cleanup:
+	return result;
+}
+
+isc_result_t
+named_server_hitters(named_server_t *server, isc_lex_t *lex,
+		     isc_buffer_t *text) {
+	isc_result_t result = ISC_R_SUCCESS;
+	bool qnames = true, clients = true, fetches = true;
+	const char *viewname = NULL;
+	char title[DNS_NAME_FORMATSIZE + 64];
+	char *ptr;
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name. */
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		return ISC_R_UNEXPECTEDEND;
+	}
+
+	ptr = next_token(lex, text);
+	if (ptr == NULL) {
+		/* show everything */
+	} else if (!strcasecmp(ptr, "qnames")) {
+		clients = fetches = false;
+	} else if (!strcasecmp(ptr, "clients")) {
+		qnames = fetches = false;
+	} else if (!strcasecmp(ptr, "fetches")) {
+		qnames = clients = false;
+		viewname = next_token(lex, text);
+	} else {
+		return DNS_R_SYNTAX;
+	}
+
+	if (qnames) {
+		CHECK(hitters_show(text, "most frequent query names:",
+				   server->sctx->topqnames, false));
+	}
+	if (clients) {
+		CHECK(hitters_show(text, "most frequent clients:",
+				   server->sctx->topclients, true));
+	}
+	if (fetches) {
+		ISC_LIST_FOREACH(server->viewlist, view, link) {
+			isc_topkmulti_t *tm = NULL;
+
+			if (viewname != NULL &&
+			    strcmp(view->name, viewname) != 0)
+			{
+				continue;
+			}
+			if (view->resolver == NULL) {
+				continue;
+			}
+			dns_resolver_gettopfetches(view->resolver, &tm);
+			if (tm == NULL) {
+				continue;
+			}
+			snprintf(title, sizeof(title),
+				 "most frequent fetches in view '%s':",
+				 view->name);
+			result = hitters_show(text, title, tm, false);
+			isc_topkmulti_detach(&tm);
+			CHECK(result);
+		}
+	}
+
+cleanup:
+	if (isc_buffer_usedlength(text) > 0) {
+		(void)putnull(text);
+	}
+
+	return result;
+}
+
 #ifdef JEMALLOC_API_SUPPORTED
 const char *
 named_server_getmemprof(void) {
@@ -18,7 +18,10 @@
 
 #include <isc/buffer.h>
 #include <isc/httpd.h>
+#include <isc/lockprof.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
+#include <isc/netmgr.h>
 #include <isc/once.h>
 #include <isc/stats.h>
 #include <isc/string.h>
@@ -134,6 +137,66 @@ user_zonetype(dns_zone_t *zone) {
 	}
 	return tp->string;
 }
+
+/*%
+ * Per-loop counters, collected from the network manager and the loop
+ * lag monitor.  The lag and callback times are in microseconds.
+ */
+enum {
+	loopstat_tcpaccepted,
+	loopstat_tcpactive,
+	loopstat_udpreceived,
+	loopstat_requestsactive,
+	loopstat_stalls,
+	loopstat_iterations,
+	loopstat_lagmedian,
+	loopstat_lag99,
+	loopstat_lagmax,
+	loopstat_callbacks,
+	loopstat_runmedian,
+	loopstat_run99,
+	loopstat_runmax,
+	loopstat_max
+};
+
+static const char *loopstats_desc[loopstat_max] = {
+	[loopstat_tcpaccepted] = "TCPAccepted",
+	[loopstat_tcpactive] = "TCPActive",
+	[loopstat_udpreceived] = "UDPReceived",
+	[loopstat_requestsactive] = "RequestsActive",
+	[loopstat_stalls] = "Stalls",
+	[loopstat_iterations] = "Iterations",
+	[loopstat_lagmedian] = "LagMedian",
+	[loopstat_lag99] = "Lag99",
+	[loopstat_lagmax] = "LagMax",
+	[loopstat_callbacks] = "Callbacks",
+	[loopstat_runmedian] = "CallbackMedian",
+	[loopstat_run99] = "Callback99",
+	[loopstat_runmax] = "CallbackMax",
+};
+
+static void
+loopstats_get(isc_tid_t tid, uint64_t *values) {
+	isc_nm_loopload_t load;
+	isc_loopstats_t stats;
+
+	isc_nm_getloopload(tid, &load);
+	isc_loop_getstats(isc_loop_get(tid), &stats);
+
+	values[loopstat_tcpaccepted] = load.tcp_accepted;
+	values[loopstat_tcpactive] = load.tcp_active;
+	values[loopstat_udpreceived] = load.udp_received;
+	values[loopstat_requestsactive] = load.requests_active;
+	values[loopstat_stalls] = stats.stalls;
+	values[loopstat_iterations] = stats.iterations;
+	values[loopstat_lagmedian] = stats.lag[0];
+	values[loopstat_lag99] = stats.lag[1];
+	values[loopstat_lagmax] = stats.lag[2];
+	values[loopstat_callbacks] = stats.callbacks;
+	values[loopstat_runmedian] = stats.runtime[0];
+	values[loopstat_run99] = stats.runtime[1];
+	values[loopstat_runmax] = stats.runtime[2];
+}
 #endif /* ifdef EXTENDED_STATS */
 
 /*%
@@ -437,6 +500,9 @@ init_desc(void) {
 	SET_NSSTATDESC(reclimitdropped,
 		       "queries dropped due to recursive client limit",
 		       "RecLimitDropped");
+	SET_NSSTATDESC(reclimitfairshare,
+		       "queries dropped due to recursive client fair share",
+		       "RecLimitFairShare");
 	SET_NSSTATDESC(updatequota, "Update quota exceeded", "UpdateQuota");
 
 	INSIST(i == ns_statscounter_max);
@@ -543,6 +609,19 @@ init_desc(void) {
 			"queries retried over TCP after a response with "
 			"mismatched query id",
 			"MismatchTCP");
+	SET_RESSTATDESC(tcpconnnew, "TCP/TLS query connections established",
+			"QueryConnNew");
+	SET_RESSTATDESC(tcpconnreused,
+			"queries sent over an existing TCP/TLS connection",
+			"QueryConnReused");
+	SET_RESSTATDESC(tcpconnidle, "idle TCP/TLS query connections closed",
+			"QueryConnIdleClosed");
+	SET_RESSTATDESC(hedged, "queries hedged to another server",
+			"QueryHedged");
+	SET_RESSTATDESC(hedgebudget, "hedges skipped over the hedging budget",
+			"QueryHedgeBudget");
+	SET_RESSTATDESC(groupjoined, "fetches joined from another view",
+			"FetchGroupJoined");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -567,6 +646,8 @@ init_desc(void) {
 	SET_ADBSTATDESC(entriescnt, "Addresses in hash table", "entriescnt");
 	SET_ADBSTATDESC(nnames, "Name hash table size", "nnames");
 	SET_ADBSTATDESC(namescnt, "Names in hash table", "namescnt");
+	SET_ADBSTATDESC(refreshes, "Names refreshed before expiry",
+			"refreshes");
 
 	INSIST(i == dns_adbstats_max);
 
@@ -1389,6 +1470,8 @@ cleanup:
 #define STATS_XML_NET	  0x08
 #define STATS_XML_MEM	  0x10
 #define STATS_XML_TRAFFIC 0x20
+#define STATS_XML_LOCKS	  0x40
+#define STATS_XML_HITTERS 0x80
 #define STATS_XML_ALL	  0xff
 
 static isc_result_t
@@ -1851,6 +1934,82 @@ cleanup:
 	return ISC_R_FAILURE;
 }
 
+static isc_result_t
+hitters_xmldump(xmlTextWriterPtr writer, const char *type, const char *view,
+		isc_topkmulti_t *tm, bool address) {
+	isc_topk_entry_t entries[ISC_TOPK_ENTRIES];
+	char buf[DNS_NAME_FORMATSIZE];
+	size_t count;
+	int xmlrc;
+
+	count = ns_server_gethitters(tm, entries, ARRAY_SIZE(entries));
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+					 ISC_XMLCHAR type));
+	if (view != NULL) {
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "view",
+						 ISC_XMLCHAR view));
+	}
+	for (size_t i = 0; i < count; i++) {
+		ns_server_formathitter(&entries[i], address, buf, sizeof(buf));
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counter"));
+		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "name",
+						 ISC_XMLCHAR buf));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu32,
+						    entries[i].count));
+		TRY0(xmlTextWriterEndElement(writer)); /* counter */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* counters */
+
+	return ISC_R_SUCCESS;
+
+cleanup:
+	isc_log_write(NAMED_LOGCATEGORY_GENERAL, NAMED_LOGMODULE_SERVER,
+		      ISC_LOG_ERROR, "Failed at hitters_xmldump()");
+	return ISC_R_FAILURE;
+}
+
+/*
+ * The most frequent query names and clients, and the most frequent fetch
+ * names of each view's resolver.
+ */
+static isc_result_t
+hitters_xmlrender(named_server_t *server, xmlTextWriterPtr writer) {
+	isc_result_t result;
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "hitters"));
+
+	CHECK(hitters_xmldump(writer, "qnames", NULL, server->sctx->topqnames,
+			      false));
+	CHECK(hitters_xmldump(writer, "clients", NULL,
+			      server->sctx->topclients, true));
+
+	ISC_LIST_FOREACH(server->viewlist, view, link) {
+		isc_topkmulti_t *tm = NULL;
+
+		if (view->resolver == NULL) {
+			continue;
+		}
+		dns_resolver_gettopfetches(view->resolver, &tm);
+		if (tm == NULL) {
+			continue;
+		}
+		result = hitters_xmldump(writer, "fetches", view->name, tm,
+					 false);
+		isc_topkmulti_detach(&tm);
+		CHECK(result);
+	}
+
+	TRY0(xmlTextWriterEndElement(writer)); /* hitters */
+
+	return ISC_R_SUCCESS;
+
+cleanup:
+	return ISC_R_FAILURE;
+}
+
 static isc_result_t
 generatexml(named_server_t *server, uint32_t flags, int *buflen,
 	    xmlChar **buf) {
@@ -2027,6 +2186,34 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 				 sockstat_values, ISC_STATSDUMP_VERBOSE));
 
 		TRY0(xmlTextWriterEndElement(writer)); /* /sockstat */
+
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "loops"));
+		for (isc_tid_t tid = 0; tid < (isc_tid_t)isc_loopmgr_nloops();
+		     tid++)
+		{
+			uint64_t values[loopstat_max];
+
+			loopstats_get(tid, values);
+
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "loop"));
+			TRY0(xmlTextWriterWriteFormatAttribute(
+				writer, ISC_XMLCHAR "id", "%" PRItid, tid));
+
+			for (int i = 0; i < loopstat_max; i++) {
+				TRY0(xmlTextWriterStartElement(
+					writer, ISC_XMLCHAR "counter"));
+				TRY0(xmlTextWriterWriteAttribute(
+					writer, ISC_XMLCHAR "name",
+					ISC_XMLCHAR loopstats_desc[i]));
+				TRY0(xmlTextWriterWriteFormatString(
+					writer, "%" PRIu64, values[i]));
+				TRY0(xmlTextWriterEndElement(writer));
+			}
+
+			TRY0(xmlTextWriterEndElement(writer)); /* /loop */
+		}
+		TRY0(xmlTextWriterEndElement(writer)); /* /loops */
 	}
 	TRY0(xmlTextWriterEndElement(writer)); /* /server */
 
@@ -2289,6 +2476,14 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		TRY0(xmlTextWriterEndElement(writer)); /* /memory */
 	}
 
+	if ((flags & STATS_XML_LOCKS) != 0 && isc_lockprof_supported()) {
+		TRY0(isc_lockprof_renderxml(writer));
+	}
+
+	if ((flags & STATS_XML_HITTERS) != 0) {
+		CHECK(hitters_xmlrender(server, writer));
+	}
+
 	TRY0(xmlTextWriterEndElement(writer)); /* /statistics */
 	TRY0(xmlTextWriterEndDocument(writer));
 
@@ -2433,6 +2628,28 @@ render_xml_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 			  freecb, freecb_args);
 }
 
+static isc_result_t
+render_xml_locks(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		 void *arg, unsigned int *retcode, const char **retmsg,
+		 const char **mimetype, isc_buffer_t *b,
+		 isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_xml(STATS_XML_LOCKS, arg, retcode, retmsg, mimetype, b,
+			  freecb, freecb_args);
+}
+
+static isc_result_t
+render_xml_hitters(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		   void *arg, unsigned int *retcode, const char **retmsg,
+		   const char **mimetype, isc_buffer_t *b,
+		   isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_xml(STATS_XML_HITTERS, arg, retcode, retmsg, mimetype, b,
+			  freecb, freecb_args);
+}
+
 #endif /* HAVE_LIBXML2 */
 
 #ifdef HAVE_JSON_C
@@ -2446,6 +2663,8 @@ render_xml_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 #define STATS_JSON_NET	   0x08
 #define STATS_JSON_MEM	   0x10
 #define STATS_JSON_TRAFFIC 0x20
+#define STATS_JSON_LOCKS   0x40
+#define STATS_JSON_HITTERS 0x80
 #define STATS_JSON_ALL	   0xff
 
 #define CHECKMEM(m)                              \
@@ -2953,6 +3172,74 @@ cleanup:
 	return result;
 }
 
+static isc_result_t
+hitters_jsondump(json_object *parent, const char *type, isc_topkmulti_t *tm,
+		 bool address) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_topk_entry_t entries[ISC_TOPK_ENTRIES];
+	char buf[DNS_NAME_FORMATSIZE];
+	json_object *counters = NULL, *obj = NULL;
+	size_t count;
+
+	counters = json_object_new_object();
+	CHECKMEM(counters);
+
+	count = ns_server_gethitters(tm, entries, ARRAY_SIZE(entries));
+	for (size_t i = 0; i < count; i++) {
+		ns_server_formathitter(&entries[i], address, buf, sizeof(buf));
+		obj = json_object_new_int64(entries[i].count);
+		CHECKMEM(obj);
+		json_object_object_add(counters, buf, obj);
+	}
+
+	json_object_object_add(parent, type, counters);
+
+	return ISC_R_SUCCESS;
+
+cleanup:
+	if (counters != NULL) {
+		json_object_put(counters);
+	}
+	return result;
+}
+
+/*
+ * The most frequent query names and clients, and the most frequent fetch
+ * names of each view's resolver.
+ */
+static isc_result_t
+hitters_jsonrender(named_server_t *server, json_object *hitters) {
+	isc_result_t result = ISC_R_SUCCESS;
+	json_object *fetches = NULL;
+
+	CHECK(hitters_jsondump(hitters, "qnames", server->sctx->topqnames,
+			       false));
+	CHECK(hitters_jsondump(hitters, "clients", server->sctx->topclients,
+			       true));
+
+	fetches = json_object_new_object();
+	CHECKMEM(fetches);
+	json_object_object_add(hitters, "fetches", fetches);
+
+	ISC_LIST_FOREACH(server->viewlist, view, link) {
+		isc_topkmulti_t *tm = NULL;
+
+		if (view->resolver == NULL) {
+			continue;
+		}
+		dns_resolver_gettopfetches(view->resolver, &tm);
+		if (tm == NULL) {
+			continue;
+		}
+		result = hitters_jsondump(fetches, view->name, tm, false);
+		isc_topkmulti_detach(&tm);
+		CHECK(result);
+	}
+
+cleanup:
+	return result;
+}
+
 static isc_result_t
 generatejson(named_server_t *server, size_t *msglen, const char **msg,
 	     json_object **rootp, uint32_t flags) {
@@ -3405,6 +3692,30 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 		} else {
 			json_object_put(counters);
 		}
+
+		/* per-loop connection load */
+		json_object *loops = json_object_new_array();
+		CHECKMEM(loops);
+		json_object_object_add(bindstats, "loops", loops);
+
+		for (isc_tid_t tid = 0; tid < (isc_tid_t)isc_loopmgr_nloops();
+		     tid++)
+		{
+			uint64_t values[loopstat_max];
+			json_object *loop = json_object_new_object();
+			CHECKMEM(loop);
+
+			loopstats_get(tid, values);
+
+			json_object_object_add(loop, "id",
+					       json_object_new_int64(tid));
+			for (int i = 0; i < loopstat_max; i++) {
+				json_object_object_add(
+					loop, loopstats_desc[i],
+					json_object_new_int64(values[i]));
+			}
+			json_object_array_add(loops, loop);
+		}
 	}
 
 	if ((flags & STATS_JSON_MEM) != 0) {
@@ -3420,6 +3731,27 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 		json_object_object_add(bindstats, "memory", memory);
 	}
 
+	if ((flags & STATS_JSON_LOCKS) != 0 && isc_lockprof_supported()) {
+		json_object *locks = json_object_new_object();
+		CHECKMEM(locks);
+
+		json_object_object_add(bindstats, "locks", locks);
+
+		result = isc_lockprof_renderjson(locks);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	if ((flags & STATS_JSON_HITTERS) != 0) {
+		json_object *hitters = json_object_new_object();
+		CHECKMEM(hitters);
+
+		json_object_object_add(bindstats, "hitters", hitters);
+
+		CHECK(hitters_jsonrender(server, hitters));
+	}
+
 	if ((flags & STATS_JSON_TRAFFIC) != 0) {
 		traffic = json_object_new_object();
 		CHECKMEM(traffic);
@@ -3691,6 +4023,28 @@ render_json_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 			   b, freecb, freecb_args);
 }
 
+static isc_result_t
+render_json_locks(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		  void *arg, unsigned int *retcode, const char **retmsg,
+		  const char **mimetype, isc_buffer_t *b,
+		  isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_json(STATS_JSON_LOCKS, arg, retcode, retmsg, mimetype, b,
+			   freecb, freecb_args);
+}
+
+static isc_result_t
+render_json_hitters(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+		    void *arg, unsigned int *retcode, const char **retmsg,
+		    const char **mimetype, isc_buffer_t *b,
+		    isc_httpdfree_t **freecb, void **freecb_args) {
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+	return render_json(STATS_JSON_HITTERS, arg, retcode, retmsg, mimetype,
+			   b, freecb, freecb_args);
+}
+
 #endif /* HAVE_JSON_C */
 
 #if HAVE_LIBXML2
@@ -3892,6 +4246,12 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 	isc_httpdmgr_addurl(listener->httpdmgr,
 			    "/xml/v" STATS_XML_VERSION_MAJOR "/traffic", false,
 			    render_xml_traffic, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/xml/v" STATS_XML_VERSION_MAJOR "/locks", false,
+			    render_xml_locks, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/xml/v" STATS_XML_VERSION_MAJOR "/hitters", false,
+			    render_xml_hitters, server);
 	isc_httpdmgr_addurl(listener->httpdmgr, "/bind9.xsl", true, render_xsl,
 			    server);
 #endif /* ifdef HAVE_LIBXML2 */
@@ -3922,6 +4282,12 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 	isc_httpdmgr_addurl(listener->httpdmgr,
 			    "/json/v" STATS_JSON_VERSION_MAJOR "/traffic",
 			    false, render_json_traffic, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/json/v" STATS_JSON_VERSION_MAJOR "/locks", false,
+			    render_json_locks, server);
+	isc_httpdmgr_addurl(listener->httpdmgr,
+			    "/json/v" STATS_JSON_VERSION_MAJOR "/hitters",
+			    false, render_json_hitters, server);
 #endif /* ifdef HAVE_JSON_C */
 
 	*listenerp = listener;
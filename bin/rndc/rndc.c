@@ -135,11 +135,18 @@ command is one of the following:\n\
   halt		Stop the server without saving pending updates.\n\
   halt -p	Stop the server without saving pending updates reporting\n\
 		process id.\n\
+  hitters [ qnames | clients | fetches [view] ]\n\
+		Show the most frequent query names, clients and resolver\n\
+		fetch names.\n\
   skr -import file zone [class [view]]\n\
 		Import a SKR file for the specified zone, for offline KSK\n\
 		signing.\n\
   loadkeys zone [class [view]]\n\
 		Update keys without signing immediately.\n\
+  lockprof [ on | off | reset | show ]\n\
+		Enable / disable / reset lock contention profiling or show\n\
+		the most contended lock sites. Requires named to be built\n\
+		with lock profiling.\n\
   managed-keys refresh [class [view]]\n\
 		Check trust anchor for RFC 5011 key changes\n\
   managed-keys status [class [view]]\n\
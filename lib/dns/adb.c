@@ -20,6 +20,7 @@
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/attributes.h>
+#include <isc/bit.h>
 #include <isc/hash.h>
 #include <isc/hashmap.h>
 #include <isc/list.h>
@@ -35,6 +36,7 @@
 #include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/tid.h>
+#include <isc/time.h>
 #include <isc/urcu.h>
 #include <isc/util.h>
 
@@ -77,6 +79,26 @@
 #define ADB_STALE_MARGIN 1800
 #endif /* ifndef ADB_STALE_MARGIN */
 
+/*%
+ * Measured round trip times are counted per address in power-of-two
+ * millisecond buckets: bucket 0 holds RTTs under 1ms, and bucket 'b'
+ * holds RTTs of [2^(b-1), 2^b) ms.  When a bucket fills up, all of them
+ * are halved, so old samples fade out.
+ */
+#define ADB_RTTBUCKETS	  16
+#define ADB_RTTBUCKET_MAX 256
+#define ADB_RTTMINSAMPLES 8
+
+/*%
+ * A name that has been looked up at least ADB_REFRESH_HITS times since its
+ * addresses were last fetched is refreshed in the background when they are
+ * about to expire in less than ADB_REFRESH_WINDOW seconds, so that the
+ * finds don't have to wait for a new fetch.  The same window also limits
+ * how often a single name can be refreshed.
+ */
+#define ADB_REFRESH_HITS   8
+#define ADB_REFRESH_WINDOW 10
+
 typedef ISC_LIST(dns_adbname_t) dns_adbnamelist_t;
 typedef struct dns_adbnamehook dns_adbnamehook_t;
 typedef ISC_LIST(dns_adbnamehook_t) dns_adbnamehooklist_t;
@@ -151,6 +173,8 @@ struct dns_adbname {
 	dns_adbfetch_t *fetch_aaaa;
 	unsigned int fetch_err;
 	unsigned int fetch6_err;
+	unsigned int hits;
+	isc_stdtime_t last_refresh;
 	dns_adbfindlist_t finds;
 	isc_mutex_t lock;
 
@@ -188,6 +212,7 @@ struct dns_adbfetch {
 	dns_fetch_t *fetch;
 	dns_rdataset_t rdataset;
 	unsigned int depth;
+	bool refresh;
 };
 
 /*%
@@ -227,6 +252,8 @@ struct dns_adbentry {
 
 	atomic_uint flags;
 	atomic_uint srtt;
+	_Atomic(uint16_t) rtthist[ADB_RTTBUCKETS];
+	atomic_uint noresponse; /* queries in a row without a response */
 	unsigned int completed;
 	unsigned int timeouts;
 	unsigned char plain;
@@ -356,7 +383,7 @@ static isc_result_t
 dbfind_name(dns_adbname_t *, isc_stdtime_t, dns_rdatatype_t);
 static isc_result_t
 fetch_name(dns_adbname_t *, bool, bool, unsigned int, isc_counter_t *qc,
-	   isc_counter_t *gqc, fetchctx_t *parent, dns_rdatatype_t);
+	   isc_counter_t *gqc, fetchctx_t *parent, dns_rdatatype_t, bool);
 static void
 shutdown_names(dns_adb_t *);
 static void
@@ -417,6 +444,14 @@ enum {
 #define NAME_FETCH_AAAA(n) ((n)->fetch_aaaa != NULL)
 #define NAME_FETCH(n)	   (NAME_FETCH_A(n) || NAME_FETCH_AAAA(n))
 
+/*
+ * Refresh fetches run while the name still has usable addresses, so the
+ * finds never wait for them.
+ */
+#define NAME_FETCH_A_WAIT(n) (NAME_FETCH_A(n) && !(n)->fetch_a->refresh)
+#define NAME_FETCH_AAAA_WAIT(n) \
+	(NAME_FETCH_AAAA(n) && !(n)->fetch_aaaa->refresh)
+
 /*
  * Find options and tests to see if there are addresses on the list.
  */
@@ -698,8 +733,8 @@ expire_name(dns_adbname_t *adbname, dns_adbstatus_t astat) {
 		if (adbname->loop == isc_loop()) {
 			expire_name_async(adbname);
 		} else {
-			isc_async_run(adbname->loop, expire_name_async,
-				      adbname);
+			isc_async_run_low(adbname->loop, expire_name_async,
+					  adbname);
 		}
 	}
 }
@@ -715,29 +750,97 @@ maybe_expire_namehooks(dns_adbname_t *adbname, isc_stdtime_t now) {
 	dns_adb_t *adb = adbname->adb;
 
 	/*
-	 * Check to see if we need to remove the v4 addresses
+	 * Check to see if we need to remove the v4 addresses.  A refresh
+	 * doesn't keep them alive; once they are gone, the refresh becomes
+	 * the fetch that the finds wait for.
 	 */
-	if (!NAME_FETCH_A(adbname) && EXPIRE_OK(adbname->expire_v4, now)) {
+	if ((!NAME_FETCH_A(adbname) || adbname->fetch_a->refresh) &&
+	    EXPIRE_OK(adbname->expire_v4, now))
+	{
 		if (NAME_HAS_V4(adbname)) {
 			DP(DEF_LEVEL, "expiring v4 for name %p", adbname);
 			clean_namehooks(adb, &adbname->v4);
 			adbname->partial_result &= ~DNS_ADBFIND_INET;
+			adbname->hits = 0;
 		}
 		adbname->expire_v4 = INT_MAX;
-		adbname->fetch_err = FIND_ERR_UNEXPECTED;
+		if (NAME_FETCH_A(adbname)) {
+			adbname->fetch_a->refresh = false;
+			adbname->fetch_err = FIND_ERR_NOTFOUND;
+		} else {
+			adbname->fetch_err = FIND_ERR_UNEXPECTED;
+		}
 	}
 
 	/*
 	 * Check to see if we need to remove the v6 addresses
 	 */
-	if (!NAME_FETCH_AAAA(adbname) && EXPIRE_OK(adbname->expire_v6, now)) {
+	if ((!NAME_FETCH_AAAA(adbname) || adbname->fetch_aaaa->refresh) &&
+	    EXPIRE_OK(adbname->expire_v6, now))
+	{
 		if (NAME_HAS_V6(adbname)) {
 			DP(DEF_LEVEL, "expiring v6 for name %p", adbname);
 			clean_namehooks(adb, &adbname->v6);
 			adbname->partial_result &= ~DNS_ADBFIND_INET6;
+			adbname->hits = 0;
 		}
 		adbname->expire_v6 = INT_MAX;
-		adbname->fetch6_err = FIND_ERR_UNEXPECTED;
+		if (NAME_FETCH_AAAA(adbname)) {
+			adbname->fetch_aaaa->refresh = false;
+			adbname->fetch6_err = FIND_ERR_NOTFOUND;
+		} else {
+			adbname->fetch6_err = FIND_ERR_UNEXPECTED;
+		}
+	}
+}
+
+static bool
+refresh_due(isc_stdtime_t expire, isc_stdtime_t now) {
+	return expire != INT_MAX && expire >= now &&
+	       expire - now < ADB_REFRESH_WINDOW;
+}
+
+/*
+ * Start background fetches for the addresses of a frequently used name
+ * that are about to expire.  Requires the name to be locked.
+ */
+static void
+maybe_refresh_name(dns_adbname_t *adbname, unsigned int options,
+		   isc_stdtime_t now) {
+	bool no_validate = ((options & DNS_ADBFIND_NOVALIDATE) != 0);
+	bool refreshed = false;
+
+	REQUIRE(DNS_ADBNAME_VALID(adbname));
+
+	if (adbname->hits < ADB_REFRESH_HITS || NAME_ALIAS(adbname) ||
+	    (adbname->type & (DNS_ADBFIND_STARTATZONE |
+			      DNS_ADBFIND_STATICSTUB)) != 0 ||
+	    now < adbname->last_refresh + ADB_REFRESH_WINDOW)
+	{
+		return;
+	}
+
+	if (NAME_HAS_V4(adbname) && !NAME_FETCH_A(adbname) &&
+	    refresh_due(adbname->expire_v4, now) &&
+	    fetch_name(adbname, false, no_validate, 0, NULL, NULL, NULL,
+		       dns_rdatatype_a, true) == ISC_R_SUCCESS)
+	{
+		refreshed = true;
+	}
+
+	if (NAME_HAS_V6(adbname) && !NAME_FETCH_AAAA(adbname) &&
+	    refresh_due(adbname->expire_v6, now) &&
+	    fetch_name(adbname, false, no_validate, 0, NULL, NULL, NULL,
+		       dns_rdatatype_aaaa, true) == ISC_R_SUCCESS)
+	{
+		refreshed = true;
+	}
+
+	if (refreshed) {
+		DP(DEF_LEVEL, "refreshing addresses for name %p", adbname);
+		inc_adbstats(adbname->adb, dns_adbstats_refreshes);
+		adbname->hits = 0;
+		adbname->last_refresh = now;
 	}
 }
 
@@ -1490,8 +1593,8 @@ expire_entry(dns_adbentry_t *adbentry) {
 		if (adbentry->loop == isc_loop()) {
 			expire_entry_async(adbentry);
 		} else {
-			isc_async_run(adbentry->loop, expire_entry_async,
-				      adbentry);
+			isc_async_run_low(adbentry->loop, expire_entry_async,
+					  adbentry);
 		}
 	}
 }
@@ -1908,6 +2011,15 @@ dns_adb_createfind(dns_adb_t *adb, isc_loop_t *loop, isc_job_cb cb, void *cbarg,
 	 */
 	maybe_expire_namehooks(adbname, now);
 
+	/*
+	 * If the name is in demand and its addresses are about to expire,
+	 * fetch them again now rather than making a later find wait.
+	 */
+	adbname->hits++;
+	if (!FIND_NOFETCH(find)) {
+		maybe_refresh_name(adbname, options, now);
+	}
+
 	/*
 	 * Do we know that the name is an alias?
 	 */
@@ -2047,7 +2159,8 @@ fetch:
 		 */
 		if (WANT_INET(wanted_fetches) &&
 		    fetch_name(adbname, start_at_zone, no_validate, depth, qc,
-			       gqc, parent, dns_rdatatype_a) == ISC_R_SUCCESS)
+			       gqc, parent, dns_rdatatype_a,
+			       false) == ISC_R_SUCCESS)
 		{
 			DP(DEF_LEVEL,
 			   "dns_adb_createfind: "
@@ -2060,8 +2173,8 @@ fetch:
 		 */
 		if (WANT_INET6(wanted_fetches) &&
 		    fetch_name(adbname, start_at_zone, no_validate, depth, qc,
-			       gqc, parent,
-			       dns_rdatatype_aaaa) == ISC_R_SUCCESS)
+			       gqc, parent, dns_rdatatype_aaaa,
+			       false) == ISC_R_SUCCESS)
 		{
 			DP(DEF_LEVEL,
 			   "dns_adb_createfind: "
@@ -2077,10 +2190,10 @@ fetch:
 	copy_namehook_lists(adb, find, adbname, maxfindlen, findlen);
 
 post_copy:
-	if (NAME_FETCH_A(adbname)) {
+	if (NAME_FETCH_A_WAIT(adbname)) {
 		query_pending |= DNS_ADBFIND_INET;
 	}
-	if (NAME_FETCH_AAAA(adbname)) {
+	if (NAME_FETCH_AAAA_WAIT(adbname)) {
 		query_pending |= DNS_ADBFIND_INET6;
 	}
 
@@ -2758,6 +2871,27 @@ fetch_callback(void *arg) {
 		goto out;
 	}
 
+	/*
+	 * A refresh only replaces the addresses the name still has, so no
+	 * find is waiting for it (see maybe_expire_namehooks()); if it
+	 * fails, the old ones stay until they expire and the next find
+	 * fetches them the usual way.
+	 */
+	if (fetch->refresh) {
+		astat = DNS_ADB_CANCELED;
+		if (resp->result == ISC_R_SUCCESS) {
+			if (address_type == DNS_ADBFIND_INET) {
+				clean_namehooks(adb, &name->v4);
+				name->expire_v4 = INT_MAX;
+			} else {
+				clean_namehooks(adb, &name->v6);
+				name->expire_v6 = INT_MAX;
+			}
+			import_rdataset(name, &fetch->rdataset, now);
+		}
+		goto out;
+	}
+
 	/*
 	 * If we got a negative cache response, remember it.
 	 */
@@ -2865,7 +2999,7 @@ out:
 static isc_result_t
 fetch_name(dns_adbname_t *adbname, bool start_at_zone, bool no_validation,
 	   unsigned int depth, isc_counter_t *qc, isc_counter_t *gqc,
-	   fetchctx_t *parent, dns_rdatatype_t type) {
+	   fetchctx_t *parent, dns_rdatatype_t type, bool refresh) {
 	isc_result_t result;
 	dns_adbfetch_t *fetch = NULL;
 	dns_adb_t *adb = NULL;
@@ -2883,7 +3017,11 @@ fetch_name(dns_adbname_t *adbname, bool start_at_zone, bool no_validation,
 	REQUIRE((type == dns_rdatatype_a && !NAME_FETCH_A(adbname)) ||
 		(type == dns_rdatatype_aaaa && !NAME_FETCH_AAAA(adbname)));
 
-	adbname->fetch_err = FIND_ERR_NOTFOUND;
+	if (refresh) {
+		options |= DNS_FETCHOPT_PREFETCH;
+	} else {
+		adbname->fetch_err = FIND_ERR_NOTFOUND;
+	}
 
 	if (start_at_zone) {
 		DP(ENTER_LEVEL, "fetch_name: starting at zone for name %p",
@@ -2901,6 +3039,7 @@ fetch_name(dns_adbname_t *adbname, bool start_at_zone, bool no_validation,
 
 	fetch = new_adbfetch(adb);
 	fetch->depth = depth;
+	fetch->refresh = refresh;
 
 	/*
 	 * We're not minimizing this query, as nothing user-related should
@@ -2942,6 +3081,32 @@ cleanup:
 	return result;
 }
 
+static void
+rtthist_add(dns_adbentry_t *entry, unsigned int rtt) {
+	uint32_t ms = rtt / US_PER_MS;
+	unsigned int bucket = 0;
+
+	if (ms > 0) {
+		bucket = ISC_MIN(32 - stdc_leading_zeros(ms),
+				 ADB_RTTBUCKETS - 1);
+	}
+
+	if (atomic_fetch_add_relaxed(&entry->rtthist[bucket], 1) + 1 <
+	    ADB_RTTBUCKET_MAX)
+	{
+		return;
+	}
+
+	/*
+	 * Concurrent updates may get lost here, which only makes the
+	 * histogram a little less accurate.
+	 */
+	for (size_t i = 0; i < ADB_RTTBUCKETS; i++) {
+		uint16_t count = atomic_load_relaxed(&entry->rtthist[i]);
+		atomic_store_relaxed(&entry->rtthist[i], count / 2);
+	}
+}
+
 void
 dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
 		   unsigned int factor) {
@@ -2954,9 +3119,68 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
 		now = isc_stdtime_now();
 	}
 
+	if (factor == DNS_ADB_RTTADJDEFAULT) {
+		rtthist_add(addr->entry, rtt);
+		atomic_store_relaxed(&addr->entry->noresponse, 0);
+	}
+
 	adjustsrtt(addr, rtt, factor, now);
 }
 
+unsigned int
+dns_adb_noresponse(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
+
+	return atomic_fetch_add_relaxed(&addr->entry->noresponse, 1) + 1;
+}
+
+bool
+dns_adb_unresponsive(dns_adb_t *adb, dns_adbaddrinfo_t *addr) {
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
+
+	return atomic_load_relaxed(&addr->entry->noresponse) >=
+	       DNS_ADB_UNRESPONSIVE;
+}
+
+unsigned int
+dns_adb_rttquantile(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
+		    unsigned int percent) {
+	uint16_t counts[ADB_RTTBUCKETS];
+	unsigned int total = 0, target, seen = 0;
+
+	REQUIRE(DNS_ADB_VALID(adb));
+	REQUIRE(DNS_ADBADDRINFO_VALID(addr));
+	REQUIRE(percent > 0 && percent <= 100);
+
+	for (size_t i = 0; i < ADB_RTTBUCKETS; i++) {
+		counts[i] = atomic_load_relaxed(&addr->entry->rtthist[i]);
+		total += counts[i];
+	}
+
+	if (total < ADB_RTTMINSAMPLES) {
+		return 0;
+	}
+
+	target = (total * percent + 99) / 100;
+	for (size_t i = 0; i < ADB_RTTBUCKETS; i++) {
+		if (seen + counts[i] < target) {
+			seen += counts[i];
+			continue;
+		}
+
+		/*
+		 * Interpolate within the bucket.
+		 */
+		unsigned int lo = (i == 0) ? 0 : (1U << (i - 1)) * US_PER_MS;
+		unsigned int hi = (1U << i) * US_PER_MS;
+		return lo + (uint64_t)(hi - lo) * (target - seen) / counts[i];
+	}
+
+	UNREACHABLE();
+}
+
 void
 dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
 	REQUIRE(DNS_ADB_VALID(adb));
@@ -126,6 +126,43 @@ prio_type(dns_typepair_t type) {
 	return false;
 }
 
+/*%
+ * A per-node map of the types stored at a node, so that looking up a
+ * type that isn't there doesn't have to walk the node's type list.
+ *
+ * A typepair is filed under the type it is about: the covered type for
+ * signatures and negative entries, so a type and its RRSIG share a bit.
+ * Types are folded into 128 bits, which keeps the common types apart
+ * (in particular SVCB and HTTPS don't collide with NS and A). The map
+ * may therefore claim a type that isn't there, but it never misses one
+ * that is, as long as typemap_add() is called for every type added to
+ * the node; removals are handled by rebuilding the map from scratch.
+ */
+typedef struct dns_typemap {
+	uint64_t bits[2];
+} dns_typemap_t;
+
+static inline unsigned int
+typemap_bit(dns_typepair_t typepair) {
+	dns_rdatatype_t covers = DNS_TYPEPAIR_COVERS(typepair);
+	dns_rdatatype_t type = covers != dns_rdatatype_none
+				       ? covers
+				       : DNS_TYPEPAIR_TYPE(typepair);
+	return type % 128;
+}
+
+static inline void
+typemap_add(dns_typemap_t *map, dns_typepair_t typepair) {
+	unsigned int bit = typemap_bit(typepair);
+	map->bits[bit / 64] |= UINT64_C(1) << (bit % 64);
+}
+
+static inline bool
+typemap_has(const dns_typemap_t *map, dns_typepair_t typepair) {
+	unsigned int bit = typemap_bit(typepair);
+	return (map->bits[bit / 64] & (UINT64_C(1) << (bit % 64))) != 0;
+}
+
 void
 dns__db_logtoomanyrecords(dns_db_t *db, const dns_name_t *name,
 			  dns_rdatatype_t type, const char *op, uint32_t limit);
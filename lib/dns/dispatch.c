@@ -852,6 +852,10 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 			 * An idle keep-alive read timed out with no outstanding
 			 * responses.
 			 */
+			if (disp->disptype != DNS_DISPATCHTYPE_XFRIN) {
+				inc_stats(disp->mgr,
+					  dns_resstatscounter_tcpconnidle);
+			}
 			result = ISC_R_CANCELED;
 		} else if (disp->timedout > 0) {
 			/* There was active query that timed-out before */
@@ -1355,6 +1359,7 @@ dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 		result = dispatch_gettcp(mgr, localaddr, destaddr, transport,
 					 disptype, dispp);
 		if (result == ISC_R_SUCCESS) {
+			inc_stats(mgr, dns_resstatscounter_tcpconnreused);
 			if (isc_log_wouldlog(90)) {
 				char addrbuf[ISC_SOCKADDR_FORMATSIZE];
 
@@ -1378,6 +1383,11 @@ dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 	dispatch_createtcp(mgr, localaddr, destaddr, transport, disptype,
 			   options, dispp);
 
+	/* Zone transfers have connections of their own, see above */
+	if (disptype != DNS_DISPATCHTYPE_XFRIN) {
+		inc_stats(mgr, dns_resstatscounter_tcpconnnew);
+	}
+
 	if (isc_log_wouldlog(90)) {
 		char addrbuf[ISC_SOCKADDR_FORMATSIZE];
 
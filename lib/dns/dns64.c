@@ -11,6 +11,7 @@
  * information regarding copyright ownership.
  */
 
+#include <inttypes.h>
 #include <stdbool.h>
 #include <string.h>
 
@@ -126,11 +127,10 @@ dns_dns64_destroy(dns_dns64list_t *list, dns_dns64_t **dns64p) {
 	isc_mem_putanddetach(&dns64->mctx, dns64, sizeof(*dns64));
 }
 
-isc_result_t
-dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
-		    const dns_name_t *reqsigner, dns_aclenv_t *env,
-		    unsigned int flags, unsigned char *a, unsigned char *aaaa) {
-	unsigned int nbytes, i;
+static isc_result_t
+dns64_clientok(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+	       const dns_name_t *reqsigner, dns_aclenv_t *env,
+	       unsigned int flags) {
 	int match;
 
 	if ((dns64->flags & DNS_DNS64_RECURSIVE_ONLY) != 0 &&
@@ -153,6 +153,15 @@ dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
 		}
 	}
 
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+dns64_map(const dns_dns64_t *dns64, dns_aclenv_t *env, unsigned char *a,
+	  unsigned char *aaaa) {
+	unsigned int nbytes, i;
+	int match;
+
 	if (dns64->mapped != NULL) {
 		struct in_addr ina;
 		isc_netaddr_t netaddr;
@@ -187,6 +196,14 @@ dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
 	return ISC_R_SUCCESS;
 }
 
+isc_result_t
+dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		    const dns_name_t *reqsigner, dns_aclenv_t *env,
+		    unsigned int flags, unsigned char *a, unsigned char *aaaa) {
+	RETERR(dns64_clientok(dns64, reqaddr, reqsigner, env, flags));
+	return dns64_map(dns64, env, a, aaaa);
+}
+
 void
 dns_dns64_append(dns_dns64list_t *list, dns_dns64_t *dns64) {
 	ISC_LIST_APPEND(*list, dns64, link);
@@ -457,21 +474,48 @@ dns_dns64_findprefix(dns_rdataset_t *rdataset, isc_netprefix_t *prefix,
 }
 
 isc_result_t
-dns_dns64_apply(isc_mem_t *mctx, dns_dns64list_t dns64s, unsigned int count,
-		dns_message_t *message, dns_aclenv_t *env, isc_sockaddr_t *peer,
-		dns_name_t *reqsigner, unsigned int flags, dns_rdataset_t *a,
-		dns_rdataset_t **aaaap) {
+dns_dns64_apply(isc_mem_t *mctx, dns_dns64list_t dns64s, dns_message_t *message,
+		dns_aclenv_t *env, isc_sockaddr_t *peer, dns_name_t *reqsigner,
+		unsigned int flags, dns_rdataset_t *a, dns_rdataset_t **aaaap) {
 	isc_result_t result;
 	dns_rdatalist_t *aaaalist = NULL;
 	isc_buffer_t *buffer = NULL;
 	isc_netaddr_t netaddr;
+	uint64_t clientok = 0;
+	unsigned int i, nmatched = 0;
 
 	REQUIRE(aaaap != NULL && *aaaap == NULL);
 	REQUIRE(a->type == dns_rdatatype_a);
 
 	isc_netaddr_fromsockaddr(&netaddr, peer);
 
-	isc_buffer_allocate(mctx, &buffer, count * 16 * dns_rdataset_count(a));
+	/*
+	 * The client ACLs and the recursion/DNSSEC flags do not depend
+	 * on the A records being mapped, so evaluate them once per prefix
+	 * rather than once per prefix for every A record.  Only the first
+	 * 64 prefixes are tracked in the bitmap; any further prefixes
+	 * (which no sane configuration has) are marked as matching here
+	 * and rechecked for each record below.
+	 */
+	i = 0;
+	ISC_LIST_FOREACH(dns64s, dns64, link) {
+		if (i >= 64) {
+			nmatched++;
+		} else if (dns64_clientok(dns64, &netaddr, reqsigner, env,
+					  flags) == ISC_R_SUCCESS)
+		{
+			clientok |= UINT64_C(1) << i;
+			nmatched++;
+		}
+		i++;
+	}
+
+	if (nmatched == 0) {
+		return ISC_R_NOMORE;
+	}
+
+	isc_buffer_allocate(mctx, &buffer,
+			    nmatched * 16 * dns_rdataset_count(a));
 
 	dns_message_gettemprdatalist(message, &aaaalist);
 	aaaalist->rdclass = dns_rdataclass_in;
@@ -481,15 +525,26 @@ dns_dns64_apply(isc_mem_t *mctx, dns_dns64list_t dns64s, unsigned int count,
 		dns_rdata_t rdata = DNS_RDATA_INIT;
 		dns_rdataset_current(a, &rdata);
 
+		i = 0;
 		ISC_LIST_FOREACH(dns64s, dns64, link) {
 			dns_rdata_t *dns64_rdata = NULL;
 			isc_region_t r;
+			bool ok;
+
+			if (i < 64) {
+				ok = (clientok & (UINT64_C(1) << i)) != 0;
+			} else {
+				ok = dns64_clientok(dns64, &netaddr, reqsigner,
+						    env, flags) == ISC_R_SUCCESS;
+			}
+			i++;
+			if (!ok) {
+				continue;
+			}
 
 			isc_buffer_availableregion(buffer, &r);
 			INSIST(r.length >= 16);
-			result = dns_dns64_aaaafroma(dns64, &netaddr, reqsigner,
-						     env, flags, rdata.data,
-						     r.base);
+			result = dns64_map(dns64, env, rdata.data, r.base);
 			if (result != ISC_R_SUCCESS) {
 				continue;
 			}
@@ -462,6 +462,28 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
  *
  *\li	The srtt in addr will be updated to reflect the new global
  *	srtt value.  This may include changes made by others.
+ *
+ *\li	With #DNS_ADB_RTTADJDEFAULT, 'rtt' is taken to be a measured
+ *	round trip time and is also counted for dns_adb_rttquantile().
+ */
+
+unsigned int
+dns_adb_rttquantile(dns_adb_t *adb, dns_adbaddrinfo_t *addr,
+		    unsigned int percent);
+/*%<
+ * Estimate the 'percent'th percentile of the round trip times measured
+ * for the address, in microseconds.  Recent samples weigh more than old
+ * ones.
+ *
+ * Returns 0 if too few round trip times have been measured.
+ *
+ * Requires:
+ *
+ *\li	adb be valid.
+ *
+ *\li	addr be valid.
+ *
+ *\li	0 < percent <= 100
  */
 
 void
@@ -482,6 +504,40 @@ dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now);
  *	srtt value.  This may include changes made by others.
  */
 
+/*%
+ * Number of queries in a row that must go unanswered before
+ * dns_adb_unresponsive() reports an address as unresponsive.
+ */
+#define DNS_ADB_UNRESPONSIVE 3
+
+unsigned int
+dns_adb_noresponse(dns_adb_t *adb, dns_adbaddrinfo_t *addr);
+/*%<
+ * Record that a query sent to the address got no response, and return
+ * the number of queries in a row that got none.  The count is reset by
+ * dns_adb_adjustsrtt() with #DNS_ADB_RTTADJDEFAULT, i.e. when a response
+ * arrives.
+ *
+ * Requires:
+ *
+ *\li	adb be valid.
+ *
+ *\li	addr be valid.
+ */
+
+bool
+dns_adb_unresponsive(dns_adb_t *adb, dns_adbaddrinfo_t *addr);
+/*%<
+ * Return true if the last #DNS_ADB_UNRESPONSIVE or more queries sent to
+ * the address got no response.
+ *
+ * Requires:
+ *
+ *\li	adb be valid.
+ *
+ *\li	addr be valid.
+ */
+
 void
 dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int bits,
 		    unsigned int mask);
@@ -170,13 +170,13 @@ dns_dns64_findprefix(dns_rdataset_t *rdataset, isc_netprefix_t *prefix,
  */
 
 isc_result_t
-dns_dns64_apply(isc_mem_t *mctx, dns_dns64list_t dns64s, unsigned int count,
-		dns_message_t *message, dns_aclenv_t *env, isc_sockaddr_t *peer,
-		dns_name_t *reqsigner, unsigned int flags, dns_rdataset_t *a,
-		dns_rdataset_t **aaaap);
+dns_dns64_apply(isc_mem_t *mctx, dns_dns64list_t dns64s, dns_message_t *message,
+		dns_aclenv_t *env, isc_sockaddr_t *peer, dns_name_t *reqsigner,
+		unsigned int flags, dns_rdataset_t *a, dns_rdataset_t **aaaap);
 /*
- * Apply a list of 'count' dns64 prefixes in the list 'dns64s'
- * to an 'a' rdataset, based 'peer', 'reqsigner', 'env', and 'flags'.
+ * Apply the dns64 prefixes in the list 'dns64s' to an 'a' rdataset,
+ * based 'peer', 'reqsigner', 'env', and 'flags'.  Only the prefixes
+ * whose client checks pass for 'peer' are used.
  * If synthesis is performed then return an AAAA rdataset in '*aaaap'.
  *
  * Returns:
@@ -679,6 +679,30 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   all records requested.
  */
 
+isc_result_t
+dns_message_renderraw(dns_message_t *msg, dns_section_t section,
+		      const isc_region_t *region, unsigned int count);
+/*%<
+ * Append 'count' records that are already in wire format in 'region' to
+ * the given section.  Compression pointers in 'region' must be valid at
+ * the current position in the message, e.g. because it was cut out of a
+ * message that was identical up to this point; the names in 'region'
+ * are not added to the compression context.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section.
+ *
+ *\li	'region' is not NULL.
+ *
+ *\li	dns_message_renderbegin() was called.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the records were written.
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
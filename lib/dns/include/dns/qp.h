@@ -85,6 +85,7 @@
  */
 
 #include <isc/attributes.h>
+#include <isc/histo.h>
 
 #include <dns/db.h>
 #include <dns/name.h>
@@ -422,13 +423,17 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode);
 
 void
 dns_qp_gctime(uint64_t *compact_us, uint64_t *recover_us,
-	      uint64_t *rollback_us);
+	      uint64_t *rollback_us, isc_histo_t **pausesp);
 /*%<
  * Get the total times spent on garbage collection in microseconds.
  *
- * These counters are global, covering every qp-trie in the program.
+ * If `pausesp` is not NULL, the distribution of individual compaction
+ * pauses (in nanoseconds) is merged into `*pausesp`, which is created
+ * if it is NULL. Automatic compaction during a write transaction on a
+ * multi-threaded trie works in small bounded steps, so this shows how
+ * long writers are held up by it.
  *
- * XXXFANF This is a placeholder until we can record times in histograms.
+ * These counters are global, covering every qp-trie in the program.
  */
 
 dns_qp_memusage_t
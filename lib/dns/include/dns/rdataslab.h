@@ -121,6 +121,24 @@ struct dns_slabheader {
 	alignas(sizeof(void *)) unsigned char raw[];
 };
 
+/*%
+ * Room for one small slab embedded in another object, such as a cache
+ * node, so that the most common RRsets (a few addresses, a couple of
+ * name servers) don't need an allocation of their own.  'used' is set by
+ * the thread that claims the slot and cleared when the last reference
+ * to the header in 'buf' goes away; 'buf' itself is only written by the
+ * thread that has claimed it.
+ */
+#ifndef DNS_SLABSLOT_RAW
+#define DNS_SLABSLOT_RAW 64
+#endif
+
+typedef struct dns_slabslot {
+	atomic_bool used;
+	alignas(dns_slabheader_t) unsigned char
+		buf[sizeof(dns_slabheader_t) + DNS_SLABSLOT_RAW];
+} dns_slabslot_t;
+
 #if DNS_SLABHEADER_TRACE
 #define dns_slabheader_ref(ptr) \
 	dns_slabheader__ref(ptr, __func__, __FILE__, __LINE__)
@@ -149,6 +167,7 @@ enum {
 	DNS_SLABHEADERATTR_ZEROTTL = 1 << 10,
 	DNS_SLABHEADERATTR_CASEFULLYLOWER = 1 << 11,
 	DNS_SLABHEADERATTR_STALE_WINDOW = 1 << 12,
+	DNS_SLABHEADERATTR_INSLOT = 1 << 13,
 };
 
 /* clang-format off : RemoveParentheses */
@@ -166,14 +185,17 @@ extern dns_rdatasetmethods_t dns_rdataslab_rdatasetmethods;
  *** Functions
  ***/
 
-#define dns_rdataslab_fromrdataset(rdataset, mctx, region, limit)            \
-	dns_rdataslab__fromrdataset(rdataset, mctx, region, limit, __func__, \
-				    __FILE__, __LINE__)
+#define dns_rdataslab_fromrdataset(rdataset, mctx, region, limit)        \
+	dns_rdataslab__fromrdataset(rdataset, mctx, region, limit, NULL, \
+				    __func__, __FILE__, __LINE__)
+#define dns_rdataslab_fromrdatasetslot(rdataset, mctx, region, limit, slot) \
+	dns_rdataslab__fromrdataset(rdataset, mctx, region, limit, slot,    \
+				    __func__, __FILE__, __LINE__)
 isc_result_t
 dns_rdataslab__fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 			    isc_region_t *region, uint32_t limit,
-			    const char *func, const char *file,
-			    const unsigned int line);
+			    dns_slabslot_t *slot, const char *func,
+			    const char *file, const unsigned int line);
 /*%<
  * Allocate space for a slab to hold the data in rdataset, and copy the
  * data into it.  The resulting slab will be returned in 'region'.
@@ -183,8 +205,16 @@ dns_rdataslab__fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
  * it, setting the type, and trust fields to match rdataset->type,
  * rdataset->covers, and rdataset->trust.
  *
+ * dns_rdataslab_fromrdatasetslot() builds the slab in 'slot' instead if
+ * it fits and the slot is not in use, and marks the header with
+ * #DNS_SLABHEADERATTR_INSLOT.  When the last reference to such a header
+ * goes away, the slot is released rather than freed.  Otherwise the slab
+ * is allocated as usual.
+ *
  * Requires:
  *\li	'rdataset' is valid.
+ *\li	'slot' is NULL, or stays valid until the header built in it has
+ *	been released.
  *
  * Ensures:
  *\li	'region' will have base pointing to the start of allocated memory,
@@ -254,7 +284,8 @@ dns_slabheader__reset(dns_slabheader_t *h, dns_dbnode_t *node, const char *func,
 		      const char *file, const unsigned int line);
 /*%<
  * Reset an rdataslab header 'h' so it can be used to store data in
- * database node 'node'.
+ * database node 'node'.  The #DNS_SLABHEADERATTR_INSLOT attribute is
+ * preserved.
  */
 
 #define dns_slabheader_new(mctx, node) \
@@ -55,6 +55,7 @@
 #include <isc/stats.h>
 #include <isc/statsmulti.h>
 #include <isc/tls.h>
+#include <isc/topk.h>
 #include <isc/types.h>
 
 #include <dns/ede.h>
@@ -538,6 +539,69 @@ dns_resolver_getmaxqueries(dns_resolver_t *resolver);
  * \li	resolver to be valid.
  */
 
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, unsigned int percentile,
+			unsigned int budget);
+/*%
+ * Enable hedged queries: when a UDP query to an authoritative server has
+ * gone unanswered for longer than the 'percentile'th percentile of the
+ * round trip times measured for that server (see dns_adb_rttquantile()),
+ * the same query is also sent to the next server, and the first good
+ * response is used.  A 'percentile' of 0 disables hedging.
+ *
+ * 'budget' is the number of hedged queries allowed per hundred queries
+ * sent by the resolver, so that hedging can't multiply the load when
+ * many servers are slow or unreachable.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ * \li	'percentile' and 'budget' are no larger than 100.
+ */
+
+void
+dns_resolver_setforwarderspread(dns_resolver_t *resolver, unsigned int spread);
+/*%
+ * Set how far apart, as a percentage of their smoothed round trip
+ * times, two forwarders may be and still share the load.  Before each
+ * forwarder is picked, the SRTT of every candidate is stretched by a
+ * random amount of up to 'spread' percent, and the lowest wins.  The
+ * default is 100; 0 always picks the forwarder with the lowest SRTT.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ * \li	'spread' is no larger than 100.
+ */
+
+void
+dns_fetchgroup_create(isc_mem_t *mctx, dns_fetchgroup_t **groupp);
+/*%<
+ * Create a fetch group, which lets the resolvers of several views join
+ * each other's fetches (see dns_resolver_setfetchgroup()).
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'groupp' is not NULL and '*groupp' is NULL.
+ */
+
+ISC_REFCOUNT_DECL(dns_fetchgroup);
+
+void
+dns_resolver_setfetchgroup(dns_resolver_t *resolver, dns_fetchgroup_t *group);
+/*%<
+ * Add 'resolver' to the fetch group 'group'.  A fetch for a client query
+ * (one without a 'domain' hint or a parent fetch) then joins a fetch for
+ * the same name, type and options that is in progress in any resolver of
+ * the group, instead of sending its own queries, as long as the two
+ * views have the same validation setting and the same forwarders for the
+ * name.  The answer is cached by the resolver that did the fetch, so the
+ * views in a group must share their cache.
+ *
+ * Requires:
+ * \li	'resolver' is a valid resolver that is not frozen and not yet in
+ *	a fetch group.
+ * \li	'group' is a valid fetch group.
+ */
+
 void
 dns_resolver_setquotaresponse(dns_resolver_t *resolver, dns_quotatype_t which,
 			      isc_result_t resp);
@@ -659,6 +723,29 @@ dns_resolver_getqueryrttstats(dns_resolver_t *res, isc_histomulti_t **hmpin,
  * \li	'hmpout' == NULL || '*hmpout' == NULL
  */
 
+void
+dns_resolver_settopfetches(dns_resolver_t *res, isc_topkmulti_t *tm);
+/*%<
+ * Set the heavy-hitter sketch 'tm' for 'res'.  Once it is installed, the
+ * resolver counts the names of the fetches it creates in it, sampled at
+ * the rate of 'tm'.
+ *
+ * Requires:
+ * \li	'res' is valid.
+ * \li	'tm' is a valid isc_topkmulti_t object.
+ */
+
+void
+dns_resolver_gettopfetches(dns_resolver_t *res, isc_topkmulti_t **tmp);
+/*%<
+ * Get the heavy-hitter sketch of fetch names for 'res'.  If it is set,
+ * '*tmp' is attached to it; otherwise '*tmp' is untouched.
+ *
+ * Requires:
+ * \li	'res' is valid.
+ * \li	'tmp' != NULL && '*tmp' == NULL
+ */
+
 void
 dns_resolver_freefresp(dns_fetchresponse_t **frespp);
 /*%<
@@ -72,7 +72,13 @@ enum {
 	dns_resstatscounter_priming = 39,
 	dns_resstatscounter_forwardonlyfail = 40,
 	dns_resstatscounter_mismatchtcp = 41,
-	dns_resstatscounter_max = 42,
+	dns_resstatscounter_tcpconnnew = 42,
+	dns_resstatscounter_tcpconnreused = 43,
+	dns_resstatscounter_tcpconnidle = 44,
+	dns_resstatscounter_hedged = 45,
+	dns_resstatscounter_hedgebudget = 46,
+	dns_resstatscounter_groupjoined = 47,
+	dns_resstatscounter_max = 48,
 
 	/*
 	 * DNSSEC stats.
@@ -110,8 +116,9 @@ enum {
 	dns_adbstats_entriescnt = 1,
 	dns_adbstats_nnames = 2,
 	dns_adbstats_namescnt = 3,
+	dns_adbstats_refreshes = 4,
 
-	dns_adbstats_max = 4,
+	dns_adbstats_max = 5,
 
 	/*
 	 * Cache statistics values.
@@ -17,12 +17,12 @@
 
 #include <stdbool.h>
 
-#include <isc/hashmap.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
 #include <isc/sieve.h>
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
+#include <isc/swisstable.h>
 
 #include <dns/fixedname.h>
 #include <dns/name.h>
@@ -63,11 +63,11 @@ extern const dns_name_t *dns_tsig_hmacsha512_name;
 #endif /* ifndef DNS_TSIG_MAXGENERATEDKEYS */
 
 struct dns_tsigkeyring {
-	unsigned int   magic; /*%< Magic number. */
-	isc_hashmap_t *keys;
-	unsigned int   writecount;
-	isc_rwlock_t   lock;
-	isc_mem_t     *mctx;
+	unsigned int	  magic; /*%< Magic number. */
+	isc_swisstable_t *keys;
+	unsigned int	  writecount;
+	isc_rwlock_t	  lock;
+	isc_mem_t	 *mctx;
 
 	unsigned int   generated;
 	isc_refcount_t references;
@@ -89,6 +89,7 @@ typedef struct dns_dumpctx	   dns_dumpctx_t;
 typedef struct dns_ecs		   dns_ecs_t;
 typedef struct dns_ednsopt	   dns_ednsopt_t;
 typedef struct dns_fetch	   dns_fetch_t;
+typedef struct dns_fetchgroup	   dns_fetchgroup_t;
 typedef struct dns_fixedname	   dns_fixedname_t;
 typedef struct dns_forwarders	   dns_forwarders_t;
 typedef struct dns_forwarder	   dns_forwarder_t;
@@ -19,6 +19,7 @@
 
 #include <isc/dir.h>
 #include <isc/file.h>
+#include <isc/fileio.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/overflow.h>
@@ -304,6 +305,7 @@ struct dns_journal {
 				      *   while reading the journal */
 	char *filename;		     /*%< Journal file name */
 	FILE *fp;		     /*%< File handle */
+	isc_fileio_t *fio;	     /*%< Batched writes, when committing */
 	off_t offset;		     /*%< Current file offset */
 	journal_xhdr_t curxhdr;	     /*%< Current transaction header */
 	journal_header_t header;     /*%< In-core journal header */
@@ -385,11 +387,19 @@ journal_header_encode(journal_header_t *cooked, journal_rawheader_t *raw) {
 
 /*
  * Journal file I/O subroutines, with error checking and reporting.
+ *
+ * While a batch is open, writes and syncs are queued in 'j->fio'
+ * instead of going through stdio, and seeks only move 'j->offset'.
  */
 static isc_result_t
 journal_seek(dns_journal_t *j, uint32_t offset) {
 	isc_result_t result;
 
+	if (j->fio != NULL) {
+		j->offset = offset;
+		return ISC_R_SUCCESS;
+	}
+
 	result = isc_stdio_seek(j->fp, (off_t)offset, SEEK_SET);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
@@ -405,6 +415,8 @@ static isc_result_t
 journal_read(dns_journal_t *j, void *mem, size_t nbytes) {
 	isc_result_t result;
 
+	INSIST(j->fio == NULL);
+
 	result = isc_stdio_read(mem, 1, nbytes, j->fp, NULL);
 	if (result != ISC_R_SUCCESS) {
 		if (result == ISC_R_EOF) {
@@ -423,6 +435,12 @@ static isc_result_t
 journal_write(dns_journal_t *j, void *mem, size_t nbytes) {
 	isc_result_t result;
 
+	if (j->fio != NULL) {
+		isc_fileio_write(j->fio, mem, nbytes, j->offset);
+		j->offset += (off_t)nbytes;
+		return ISC_R_SUCCESS;
+	}
+
 	result = isc_stdio_write(mem, 1, nbytes, j->fp, NULL);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
@@ -438,6 +456,11 @@ static isc_result_t
 journal_fsync(dns_journal_t *j) {
 	isc_result_t result;
 
+	if (j->fio != NULL) {
+		isc_fileio_sync(j->fio);
+		return ISC_R_SUCCESS;
+	}
+
 	result = isc_stdio_flush(j->fp);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
@@ -455,6 +478,51 @@ journal_fsync(dns_journal_t *j) {
 	return ISC_R_SUCCESS;
 }
 
+/*
+ * Start queueing writes and syncs, so that a commit reaches the disk as
+ * one batch rather than as a series of stdio calls.
+ */
+static isc_result_t
+journal_batch(dns_journal_t *j) {
+	isc_result_t result;
+
+	INSIST(j->fio == NULL);
+
+	/* The batch bypasses stdio, so nothing may be left in its buffer. */
+	result = isc_stdio_flush(j->fp);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR, "%s: flush: %s", j->filename,
+			      isc_result_totext(result));
+		return ISC_R_UNEXPECTED;
+	}
+
+	isc_fileio_create(j->mctx, fileno(j->fp), &j->fio);
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+journal_submit(dns_journal_t *j) {
+	isc_result_t result;
+
+	INSIST(j->fio != NULL);
+
+	result = isc_fileio_submit(j->fio);
+	isc_fileio_destroy(&j->fio);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_JOURNAL,
+			      ISC_LOG_ERROR, "%s: write: %s", j->filename,
+			      isc_result_totext(result));
+		return ISC_R_UNEXPECTED;
+	}
+
+	/*
+	 * Move the stdio file position to where the batch left off; this
+	 * also discards anything stdio read before the batch.
+	 */
+	return journal_seek(j, j->offset);
+}
+
 /*
  * Read/write a transaction header at the current file position.
  */
@@ -1250,11 +1318,13 @@ dns_journal_commit(dns_journal_t *j) {
 	 * Just write out a updated header.
 	 */
 	if (j->state == JOURNAL_STATE_INLINE) {
+		CHECK(journal_batch(j));
 		CHECK(journal_fsync(j));
 		journal_header_encode(&j->header, &rawheader);
 		CHECK(journal_seek(j, 0));
 		CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 		CHECK(journal_fsync(j));
+		CHECK(journal_submit(j));
 		j->state = JOURNAL_STATE_WRITE;
 		return ISC_R_SUCCESS;
 	}
@@ -1323,6 +1393,13 @@ dns_journal_commit(dns_journal_t *j) {
 	}
 #endif /* ifdef notyet */
 
+	/*
+	 * From here on there is nothing more to read, so the syncs and
+	 * header updates below go out as a single batch, ordered by the
+	 * syncs between them.
+	 */
+	CHECK(journal_batch(j));
+
 	/*
 	 * Commit the transaction data to stable storage.
 	 */
@@ -1368,6 +1445,7 @@ dns_journal_commit(dns_journal_t *j) {
 	 * Commit the header to stable storage.
 	 */
 	CHECK(journal_fsync(j));
+	CHECK(journal_submit(j));
 
 	/*
 	 * We no longer have a transaction open.
@@ -1377,6 +1455,9 @@ dns_journal_commit(dns_journal_t *j) {
 	result = ISC_R_SUCCESS;
 
 cleanup:
+	if (j->fio != NULL) {
+		isc_fileio_destroy(&j->fio);
+	}
 	return result;
 }
 
@@ -21,6 +21,7 @@
 #include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/file.h>
+#include <isc/fileio.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
@@ -89,6 +90,10 @@ typedef struct dns_totext_ctx {
 	bool current_ttl_valid;
 	dns_ttl_t serve_stale_ttl;
 	dns_indent_t indent;
+	/* Raw dumps to a file of our own */
+	isc_fileio_t *fio;
+	off_t offset;
+	size_t pending;
 } dns_totext_ctx_t;
 
 const dns_master_style_t dns_master_style_keyzone = {
@@ -349,6 +354,9 @@ totext_ctx_init(const dns_master_style_t *style, const dns_indent_t *indentctx,
 
 	ctx->style = *style;
 	ctx->class_printed = false;
+	ctx->fio = NULL;
+	ctx->offset = 0;
+	ctx->pending = 0;
 
 	dns_fixedname_init(&ctx->origin_fixname);
 
@@ -1189,12 +1197,40 @@ again:
 	return itresult;
 }
 
+/*
+ * Raw data queued for a file dump is written out once there is this much.
+ */
+#define RAW_BATCH_SIZE (256 * 1024)
+
+/*
+ * Write raw format data to 'f'.  When dumping to a file of our own, the
+ * data is queued for isc_fileio instead, and written out in large
+ * batches rather than through the stdio buffer.
+ */
+static isc_result_t
+raw_write(dns_totext_ctx_t *ctx, FILE *f, const void *base, size_t length) {
+	if (ctx->fio == NULL) {
+		return isc_stdio_write(base, 1, length, f, NULL);
+	}
+
+	isc_fileio_write(ctx->fio, base, length, ctx->offset);
+	ctx->offset += (off_t)length;
+	ctx->pending += length;
+	if (ctx->pending < RAW_BATCH_SIZE) {
+		return ISC_R_SUCCESS;
+	}
+
+	ctx->pending = 0;
+	return isc_fileio_submit(ctx->fio);
+}
+
 /*
  * Dump given RRsets in the "raw" format.
  */
 static isc_result_t
 dump_rdataset_raw(isc_mem_t *mctx, const dns_name_t *name,
-		  dns_rdataset_t *rdataset, isc_buffer_t *buffer, FILE *f) {
+		  dns_rdataset_t *rdataset, dns_totext_ctx_t *ctx,
+		  isc_buffer_t *buffer, FILE *f) {
 	isc_result_t result;
 	uint32_t totallen;
 	uint16_t dlen;
@@ -1278,7 +1314,7 @@ restart:
 	/*
 	 * Write the buffer contents to the raw master file.
 	 */
-	result = isc_stdio_write(r.base, 1, (size_t)r.length, f, NULL);
+	result = raw_write(ctx, f, r.base, r.length);
 
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR("raw master file write failed: %s",
@@ -1309,7 +1345,7 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
 		{
 			/* Omit negative cache entries */
 		} else {
-			result = dump_rdataset_raw(mctx, name, &rdataset,
+			result = dump_rdataset_raw(mctx, name, &rdataset, ctx,
 						   buffer, f);
 		}
 		dns_rdataset_disassociate(&rdataset);
@@ -1345,6 +1381,9 @@ dumpctx_destroy(dns_dumpctx_t *dctx) {
 		dns_db_closeversion(dctx->db, &dctx->version, false);
 	}
 	dns_db_detach(&dctx->db);
+	if (dctx->tctx.fio != NULL) {
+		isc_fileio_destroy(&dctx->tctx.fio);
+	}
 	if (dctx->file != NULL) {
 		isc_mem_free(dctx->mctx, dctx->file);
 	}
@@ -1583,6 +1622,18 @@ cleanup:
 	return result;
 }
 
+/*
+ * A raw dump to a new file of our own is written with isc_fileio, at
+ * offsets counted from the start of the file.
+ */
+static void
+dumpctx_batchraw(dns_dumpctx_t *dctx) {
+	if (dctx->format == dns_masterformat_raw) {
+		isc_fileio_create(dctx->mctx, fileno(dctx->f),
+				  &dctx->tctx.fio);
+	}
+}
+
 static isc_result_t
 writeheader(dns_dumpctx_t *dctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -1638,9 +1689,8 @@ writeheader(dns_dumpctx_t *dctx) {
 		}
 
 		INSIST(isc_buffer_usedlength(&buffer) <= sizeof(rawheader));
-		result = isc_stdio_write(buffer.base, 1,
-					 isc_buffer_usedlength(&buffer),
-					 dctx->f, NULL);
+		result = raw_write(&dctx->tctx, dctx->f, buffer.base,
+				   isc_buffer_usedlength(&buffer));
 		if (result != ISC_R_SUCCESS) {
 			break;
 		}
@@ -1718,6 +1768,12 @@ dumptostream(dns_dumpctx_t *dctx) {
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
 	}
+	/*
+	 * The file is synced when it is closed, in closeandrename().
+	 */
+	if (result == ISC_R_SUCCESS && dctx->tctx.fio != NULL) {
+		result = isc_fileio_submit(dctx->tctx.fio);
+	}
 cleanup:
 	RUNTIME_CHECK(dns_dbiterator_pause(dctx->dbiter) == ISC_R_SUCCESS);
 	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
@@ -1829,6 +1885,7 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup_tempname;
 	}
+	dumpctx_batchraw(dctx);
 
 	dctx->done = done;
 	dctx->done_arg = done_arg;
@@ -1869,6 +1926,7 @@ dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 
 	CHECK(dumpctx_create(mctx, db, version, style, f, &dctx, format,
 			     header));
+	dumpctx_batchraw(dctx);
 
 	result = dumptostream(dctx);
 	INSIST(result != DNS_R_CONTINUE);
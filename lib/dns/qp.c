@@ -29,6 +29,8 @@
 #include <isc/atomic.h>
 #include <isc/bit.h>
 #include <isc/buffer.h>
+#include <isc/histo.h>
+#include <isc/hugepage.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -66,6 +68,21 @@ static atomic_uint_fast64_t compact_time;
 static atomic_uint_fast64_t recycle_time;
 static atomic_uint_fast64_t rollback_time;
 
+/*
+ * Library-wide state below is allocated at initialization time, before
+ * any caller can set up the default memory context, so it has its own.
+ */
+static isc_mem_t *qp_mctx = NULL;
+
+/* distribution of individual compaction pauses, in nanoseconds */
+static isc_histo_t *compact_pauses = NULL;
+
+/*
+ * Full-size chunks are allocated from this arena when huge pages are
+ * enabled (see isc_hugepage_setmode()); it is shared by all tries.
+ */
+static isc_hugepage_arena_t *qp_arena = NULL;
+
 /* for LOG_STATS() format strings */
 #define PRItime " %" PRIu64 " ns "
 
@@ -214,11 +231,23 @@ dns__qp_initialize(void) {
 		}
 	}
 	ENSURE(bit_one < SHIFT_OFFSET);
+
+	isc_mem_create("qp", &qp_mctx);
+	isc_histo_create(qp_mctx, isc_histo_digits_to_bits(2),
+			 &compact_pauses);
+
+#if !FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+	isc_hugepage_arena_create(qp_mctx, QP_CHUNK_BYTES, &qp_arena);
+#endif
 }
 
 void
 dns__qp_shutdown(void) {
-	/* Nothing */
+	isc_histo_destroy(&compact_pauses);
+	if (qp_arena != NULL) {
+		isc_hugepage_arena_destroy(&qp_arena);
+	}
+	isc_mem_detach(&qp_mctx);
 }
 
 /*
@@ -467,6 +496,54 @@ write_protect(dns_qp_t *qp, dns_qpchunk_t chunk) {
 
 #endif
 
+/*
+ * Full-size chunks come from the hugepage arena when it can provide them;
+ * everything else, and everything when huge pages are disabled or not
+ * available, from the memory context.
+ */
+static void *
+chunk_get(dns_qp_t *qp, size_t bytes, bool *hugep) {
+	if (qp_arena != NULL && bytes == QP_CHUNK_BYTES) {
+		void *ptr = isc_hugepage_get(qp_arena, qp->mctx);
+		if (ptr != NULL) {
+			*hugep = true;
+			return ptr;
+		}
+	}
+
+	*hugep = false;
+	return chunk_get_raw(qp, bytes);
+}
+
+static void
+chunk_put(dns_qp_t *qp, dns_qpchunk_t chunk) {
+	if (qp->usage[chunk].huge) {
+		isc_hugepage_put(qp_arena, qp->mctx, qp->base->ptr[chunk]);
+	} else {
+		chunk_free_raw(qp, qp->base->ptr[chunk]);
+	}
+}
+
+/*
+ * A hugepage block can't be shrunk in place, so copy what's used into a
+ * normal allocation and give the block back to the arena for a trie that
+ * will fill it.
+ */
+static void *
+chunk_shrink(dns_qp_t *qp, dns_qpchunk_t chunk, size_t bytes) {
+	void *ptr = qp->base->ptr[chunk];
+
+	if (qp->usage[chunk].huge) {
+		void *newptr = chunk_get_raw(qp, bytes);
+		memmove(newptr, ptr, bytes);
+		isc_hugepage_put(qp_arena, qp->mctx, ptr);
+		qp->usage[chunk].huge = false;
+		return newptr;
+	}
+
+	return chunk_shrink_raw(qp, ptr, bytes);
+}
+
 /***********************************************************************
  *
  *  allocator
@@ -513,11 +590,14 @@ chunk_alloc(dns_qp_t *qp, dns_qpchunk_t chunk, dns_qpweight_t size) {
 	INSIST(qp->usage[chunk].free == 0);
 	INSIST(qp->chunk_capacity <= QP_CHUNK_SIZE);
 
+	bool huge;
+
 	qp->chunk_capacity = next_capacity(qp->chunk_capacity * 2u, size);
-	qp->base->ptr[chunk] =
-		chunk_get_raw(qp, qp->chunk_capacity * sizeof(dns_qpnode_t));
+	qp->base->ptr[chunk] = chunk_get(
+		qp, qp->chunk_capacity * sizeof(dns_qpnode_t), &huge);
 
 	qp->usage[chunk] = (qp_usage_t){ .exists = true,
+					 .huge = huge,
 					 .used = size,
 					 .capacity = qp->chunk_capacity };
 	qp->used_count += size;
@@ -707,7 +787,7 @@ chunk_free(dns_qp_t *qp, dns_qpchunk_t chunk) {
 		}
 	}
 	chunk_discount(qp, chunk);
-	chunk_free_raw(qp, qp->base->ptr[chunk]);
+	chunk_put(qp, chunk);
 	qp->base->ptr[chunk] = NULL;
 	qp->usage[chunk] = (qp_usage_t){};
 }
@@ -956,64 +1036,121 @@ make_twigs_mutable(dns_qp_t *qp, dns_qpnode_t *n) {
  * nothing. So the evacuation check is the only place that the
  * algorithm introduces ref changes, that then bubble up towards the
  * root through the logic inside the loop.
+ *
+ * An incremental step stops when its budget runs out, leaving the rest
+ * of the trie as it was, and records the twig positions on the way back
+ * up in `qp->compact_path`. The next step follows that path down (the
+ * nodes on it are checked again, which is harmless) and carries on from
+ * the twig where the last one stopped. The trie may have changed in
+ * between, so the path can be stale; that only means some nodes are
+ * skipped or visited twice in that pass.
  */
+typedef struct qp_compact {
+	size_t budget;
+	unsigned int resume;
+	bool stopped;
+} qp_compact_t;
+
 static dns_qpref_t
-compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent) {
+compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent, qp_compact_t *gc,
+		  unsigned int depth) {
 	dns_qpweight_t size = branch_twigs_size(parent);
 	dns_qpref_t twigs_ref = branch_twigs_ref(parent);
 	dns_qpchunk_t chunk = ref_chunk(twigs_ref);
+	dns_qpweight_t start = 0;
+
+	if (gc->budget > 0) {
+		gc->budget--;
+	}
 
 	if (qp->compact_all ||
 	    (chunk != qp->bump && chunk_usage(qp, chunk) < QP_MIN_USED))
 	{
 		twigs_ref = evacuate(qp, parent);
 	}
+	if (depth < gc->resume) {
+		start = ISC_MIN(qp->compact_path[depth], size);
+	}
 	bool immutable = cells_immutable(qp, twigs_ref);
-	for (dns_qpweight_t pos = 0; pos < size; pos++) {
+	for (dns_qpweight_t pos = start; pos < size; pos++) {
 		dns_qpnode_t *child = ref_ptr(qp, twigs_ref) + pos;
 		if (!is_branch(child)) {
 			continue;
 		}
+		if (gc->budget == 0 && depth < QP_COMPACT_DEPTH) {
+			qp->compact_path[depth] = pos;
+			qp->compact_depth = depth + 1;
+			gc->stopped = true;
+			break;
+		}
+		if (pos != start || depth + 1 >= gc->resume) {
+			/* off the saved path */
+			gc->resume = 0;
+		}
 		dns_qpref_t old_grandtwigs = branch_twigs_ref(child);
-		dns_qpref_t new_grandtwigs = compact_recursive(qp, child);
-		if (old_grandtwigs == new_grandtwigs) {
-			continue;
+		dns_qpref_t new_grandtwigs = compact_recursive(qp, child, gc,
+							       depth + 1);
+		if (old_grandtwigs != new_grandtwigs) {
+			if (immutable) {
+				twigs_ref = evacuate(qp, parent);
+				/* the twigs have moved */
+				child = ref_ptr(qp, twigs_ref) + pos;
+				immutable = false;
+			}
+			*child = make_node(branch_index(child),
+					   new_grandtwigs);
 		}
-		if (immutable) {
-			twigs_ref = evacuate(qp, parent);
-			/* the twigs have moved */
-			child = ref_ptr(qp, twigs_ref) + pos;
-			immutable = false;
+		if (gc->stopped) {
+			qp->compact_path[depth] = pos;
+			break;
 		}
-		*child = make_node(branch_index(child), new_grandtwigs);
 	}
 	return twigs_ref;
 }
 
-static void
-compact(dns_qp_t *qp) {
+/*
+ * Run a compaction pass, or with `incremental`, one step of a pass.
+ * Returns true when the pass is complete.
+ */
+static bool
+compact(dns_qp_t *qp, bool incremental) {
 	LOG_STATS("qp compact before leaf %u live %u used %u free %u hold %u",
 		  qp->leaf_count, qp->used_count - qp->free_count,
 		  qp->used_count, qp->free_count, qp->hold_count);
 
 	isc_nanosecs_t start = isc_time_monotonic();
 
+	qp_compact_t gc = {
+		.budget = SIZE_MAX,
+	};
+	if (incremental && !qp->compact_all) {
+		gc.budget = QP_COMPACT_BUDGET;
+		gc.resume = qp->compact_depth;
+	}
+
 	if (qp->usage[qp->bump].free > QP_MAX_FREE) {
 		alloc_reset(qp);
 	}
 
 	if (qp->leaf_count > 0) {
-		qp->root_ref = compact_recursive(qp, MOVABLE_ROOT(qp));
+		qp->root_ref = compact_recursive(qp, MOVABLE_ROOT(qp), &gc, 0);
+	}
+	if (!gc.stopped) {
+		qp->compact_depth = 0;
+		qp->compact_all = false;
 	}
-	qp->compact_all = false;
 
 	isc_nanosecs_t time = isc_time_monotonic() - start;
 	atomic_fetch_add_relaxed(&compact_time, time);
+	isc_histo_inc(compact_pauses, time);
 
 	LOG_STATS("qp compact" PRItime
-		  "leaf %u live %u used %u free %u hold %u",
-		  time, qp->leaf_count, qp->used_count - qp->free_count,
-		  qp->used_count, qp->free_count, qp->hold_count);
+		  "%s leaf %u live %u used %u free %u hold %u",
+		  time, gc.stopped ? "step" : "done", qp->leaf_count,
+		  qp->used_count - qp->free_count, qp->used_count,
+		  qp->free_count, qp->hold_count);
+
+	return !gc.stopped;
 }
 
 void
@@ -1026,7 +1163,7 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode) {
 		alloc_reset(qp);
 		qp->compact_all = true;
 	}
-	compact(qp);
+	compact(qp, false);
 	recycle(qp);
 }
 
@@ -1047,14 +1184,14 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode) {
  * when garbage collection might be worthwhile. Hence we can trigger
  * collection when garbage passes a threshold.
  *
- * XXXFANF: If we need to avoid latency outliers caused by compaction in
- * write transactions, we can check qp->transaction_mode here.
+ * To avoid latency outliers in write transactions on a multithreaded
+ * trie, each compaction there is one bounded step of an incremental pass.
  */
 static inline bool
 squash_twigs(dns_qp_t *qp, dns_qpref_t twigs, dns_qpweight_t size) {
 	bool destroyed = free_twigs(qp, twigs, size);
 	if (destroyed && QP_AUTOGC(qp)) {
-		compact(qp);
+		bool done = compact(qp, qp->transaction_mode != QP_NONE);
 		recycle(qp);
 		/*
 		 * This shouldn't happen if the garbage collector is
@@ -1062,7 +1199,7 @@ squash_twigs(dns_qp_t *qp, dns_qpref_t twigs, dns_qpweight_t size) {
 		 * time and space, but recovery should be cheaper than
 		 * letting compact+recycle fail repeatedly.
 		 */
-		if (QP_AUTOGC(qp)) {
+		if (done && QP_AUTOGC(qp)) {
 			isc_log_write(DNS_LOGCATEGORY_DATABASE,
 				      DNS_LOGMODULE_QP, ISC_LOG_NOTICE,
 				      "qp %p uctx \"%s\" compact/recycle "
@@ -1136,10 +1273,13 @@ dns_qpmulti_memusage(dns_qpmulti_t *multi) {
 
 void
 dns_qp_gctime(isc_nanosecs_t *compact_p, isc_nanosecs_t *recycle_p,
-	      isc_nanosecs_t *rollback_p) {
+	      isc_nanosecs_t *rollback_p, isc_histo_t **pausesp) {
 	*compact_p = atomic_load_relaxed(&compact_time);
 	*recycle_p = atomic_load_relaxed(&recycle_time);
 	*rollback_p = atomic_load_relaxed(&rollback_time);
+	if (pausesp != NULL) {
+		isc_histo_merge(pausesp, compact_pauses);
+	}
 }
 
 /***********************************************************************
@@ -1285,11 +1425,11 @@ dns_qpmulti_commit(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 	}
 
 	if (qp->transaction_mode == QP_UPDATE) {
-		/* minimize memory overhead */
-		compact(qp);
+		/* minimize memory overhead, a step at a time */
+		compact(qp, true);
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
-		qp->base->ptr[qp->bump] = chunk_shrink_raw(
-			qp, qp->base->ptr[qp->bump],
+		qp->base->ptr[qp->bump] = chunk_shrink(
+			qp, qp->bump,
 			qp->usage[qp->bump].used * sizeof(dns_qpnode_t));
 	} else {
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
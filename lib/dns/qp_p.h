@@ -195,6 +195,20 @@ STATIC_ASSERT(QP_SAFETY_MARGIN >= QP_CHUNK_BYTES,
 #define QP_NEEDGC(qp) QP_GC_HEURISTIC(qp, (qp)->free_count)
 #define QP_AUTOGC(qp) QP_GC_HEURISTIC(qp, (qp)->free_count - (qp)->hold_count)
 
+/*
+ * Automatic compaction during a multithreaded write transaction is
+ * incremental, so that a commit to a large trie does not have to wait
+ * for a scan of the whole trie. Each step visits at most this many branch
+ * nodes, then records where it stopped as the path of twig positions
+ * from the root; the next step carries on from there.
+ *
+ * The path is at most QP_COMPACT_DEPTH long. A step that has entered a
+ * subtree below that depth finishes it regardless of the budget, which
+ * guarantees progress; subtrees that deep are small.
+ */
+#define QP_COMPACT_BUDGET (QP_CHUNK_SIZE * 4)
+#define QP_COMPACT_DEPTH  32
+
 /*
  * The chunk base and usage arrays are resized geometically and start off
  * with two entries.
@@ -284,6 +298,8 @@ typedef struct qp_usage {
 	dns_qpcell_t free : QP_USAGE_BITS;
 	/*% qp->base->ptr[chunk] != NULL */
 	bool exists : 1;
+	/*% allocated from the hugepage arena */
+	bool huge : 1;
 	/*% is this chunk shared? [MT] */
 	bool immutable : 1;
 	/*% already subtracted from multi->*_count [MT] */
@@ -454,6 +470,10 @@ struct dns_qpsnap {
  *    start of each transaction. It is QP_NONE in a single-threaded qp-trie
  *    to detect if part of a `dns_qpmulti_t` is passed to dns_qp_destroy().
  *
+ *  - The `compact_path` records where incremental compaction should
+ *    resume; it is `compact_depth` long, and empty when the next step
+ *    should start a new pass from the root. See QP_COMPACT_BUDGET.
+ *
  *  - The `compact_all` flag is used when every node in the trie should be
  *    copied. (Usually compation aims to avoid moving nodes out of
  *    unfragmented chunks.) It is used when compaction is explicitly
@@ -494,6 +514,9 @@ struct dns_qp {
 	dns_qpcell_t hold_count;
 	/*% capacity of last allocated chunk, for exponential chunk growth */
 	dns_qpcell_t chunk_capacity;
+	/*% where incremental compaction resumes [MT] */
+	uint8_t compact_depth;
+	uint8_t compact_path[QP_COMPACT_DEPTH];
 	/*% what kind of transaction was most recently started [MT] */
 	enum { QP_NONE, QP_WRITE, QP_UPDATE } transaction_mode : 2;
 	/*% compact the entire trie [MT] */
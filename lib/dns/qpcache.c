@@ -136,6 +136,17 @@ struct qpcnode {
 	isc_refcount_t erefs;
 
 	struct cds_list_head headers;
+	dns_typemap_t typemap; /*%< types in 'headers' */
+
+	/*%
+	 * Storage for the first small RRset added to the node, so that
+	 * it lives in the node's allocation instead of one of its own;
+	 * bigger RRsets, and any added while the slot is in use, are
+	 * allocated separately.  Every reference to a header is held
+	 * together with a node reference, so the slot can't outlive the
+	 * node.
+	 */
+	dns_slabslot_t slot;
 
 	/*%
 	 * Used for dead nodes cleaning.  This linked list is used to mark nodes
@@ -414,6 +425,11 @@ header_delete(qpcnode_t *node, dns_slabheader_t *header);
 
 static size_t
 rdataset_size(dns_slabheader_t *header) {
+	/* it is part of the node, and goes with it */
+	if (DNS_SLABHEADER_GETATTR(header, DNS_SLABHEADERATTR_INSLOT) != 0) {
+		return 0;
+	}
+
 	if (EXISTS(header)) {
 		return dns_rdataslab_size(header);
 	}
@@ -798,6 +814,11 @@ header_delete(qpcnode_t *node, dns_slabheader_t *header) {
 
 	cds_list_del_init(&header->headers_link);
 
+	node->typemap = (dns_typemap_t){ 0 };
+	DNS_SLABHEADER_FOREACH(tmp, &node->headers) {
+		typemap_add(&node->typemap, tmp->typepair);
+	}
+
 	/*
 	 * This place is the only place where we actually need header->typepair.
 	 */
@@ -1201,6 +1222,12 @@ store_headers(dns_slabheader_t *tmp, dns_slabheader_t **headerp,
 static void
 find_headers(qpcnode_t *node, qpc_search_t *search, dns_rdatatype_t type,
 	     dns_slabheader_t **foundp, dns_slabheader_t **foundsigp) {
+	if (!typemap_has(&node->typemap, DNS_TYPEPAIR(type)) &&
+	    !typemap_has(&node->typemap, dns_typepair_any))
+	{
+		return;
+	}
+
 	DNS_SLABHEADER_FOREACH(tmp, &node->headers) {
 		dns_slabheader_t *header = NULL, *sigheader = NULL;
 
@@ -1403,6 +1430,14 @@ qpc_search_init(qpc_search_t *search, qpcache_t *db, unsigned int options,
 
 static void
 qpc_search_deinit(qpc_search_t *search DNS__DB_FLARG) {
+	/* release the headers first, they may be stored in the node */
+	if (search->zonecut_sigheader != NULL) {
+		dns_slabheader_detach(&search->zonecut_sigheader);
+	}
+	if (search->zonecut_header != NULL) {
+		dns_slabheader_detach(&search->zonecut_header);
+	}
+
 	if (search->zonecut != NULL) {
 		qpcnode_t *node = search->zonecut;
 		isc_rwlock_t *nlock =
@@ -1415,13 +1450,6 @@ qpc_search_deinit(qpc_search_t *search DNS__DB_FLARG) {
 				&tlocktype DNS__DB_FLARG_PASS);
 		NODE_UNLOCK(nlock, &nlocktype);
 	}
-
-	if (search->zonecut_sigheader != NULL) {
-		dns_slabheader_detach(&search->zonecut_sigheader);
-	}
-	if (search->zonecut_header != NULL) {
-		dns_slabheader_detach(&search->zonecut_header);
-	}
 }
 
 static isc_result_t
@@ -1776,6 +1804,12 @@ qpcache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	sigpair = (type != dns_rdatatype_rrsig) ? DNS_SIGTYPEPAIR(type)
 						: dns_typepair_none;
 
+	if (!typemap_has(&qpnode->typemap, typepair) &&
+	    !typemap_has(&qpnode->typemap, dns_typepair_any))
+	{
+		goto unlock;
+	}
+
 	DNS_SLABHEADER_FOREACH(tmp, &qpnode->headers) {
 		dns_slabheader_t *header = NULL, *sigheader = NULL;
 
@@ -1798,6 +1832,7 @@ qpcache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			      sigrdataset DNS__DB_FLARG_PASS);
 	}
 
+unlock:
 	NODE_UNLOCK(nlock, &nlocktype);
 
 	if (found == NULL) {
@@ -2597,6 +2632,7 @@ add(qpcache_t *qpdb, qpcnode_t *qpnode, dns_slabheader_t *newheader,
 		/* There were no priority headers */
 		cds_list_add(&newheader->headers_link, &qpnode->headers);
 	}
+	typemap_add(&qpnode->typemap, newheader->typepair);
 
 	if (related != NULL) {
 		INSIST(related->related == NULL);
@@ -2743,8 +2779,9 @@ qpcache_addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	REQUIRE(VALID_QPDB(qpdb));
 	REQUIRE(version == NULL);
 
-	result = dns_rdataslab_fromrdataset(rdataset, qpnode->mctx, &region,
-					    qpdb->maxrrperset);
+	result = dns_rdataslab_fromrdatasetslot(rdataset, qpnode->mctx,
+						&region, qpdb->maxrrperset,
+						&qpnode->slot);
 	if (result != ISC_R_SUCCESS) {
 		if (result == DNS_R_TOOMANYRECORDS) {
 			dns__db_logtoomanyrecords((dns_db_t *)qpdb,
@@ -3387,6 +3424,7 @@ qpcnode_destroy(qpcnode_t *qpnode) {
 	{
 		header_delete(qpnode, header);
 	}
+	INSIST(!atomic_load_acquire(&qpnode->slot.used));
 
 	dns_name_free(&qpnode->name, qpnode->mctx);
 	isc_mem_putanddetach(&qpnode->mctx, qpnode, sizeof(qpcnode_t));
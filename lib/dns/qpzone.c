@@ -208,6 +208,7 @@ struct qpznode {
 	atomic_bool dirty;
 
 	ISC_SLIST(dns_vectop_t) next_type;
+	dns_typemap_t typemap; /*%< types in 'next_type' */
 };
 
 struct qpzonedb {
@@ -1105,6 +1106,11 @@ clean_zone_node(qpz_heap_t *heap, qpznode_t *node, uint32_t least_serial) {
 		}
 	}
 
+	node->typemap = (dns_typemap_t){ 0 };
+	ISC_SLIST_FOREACH(top, node->next_type, next_type) {
+		typemap_add(&node->typemap, top->typepair);
+	}
+
 	if (!still_dirty) {
 		node->dirty = false;
 	}
@@ -1707,7 +1713,11 @@ qpzone_findrdataset(dns_db_t *db, dns_dbnode_t *dbnode,
 		sigpair = dns_typepair_none;
 	}
 
-	ISC_SLIST_FOREACH(top, node->next_type, next_type) {
+	/* skip the walk if the type isn't at the node at all */
+	dns_vectop_t *first = typemap_has(&node->typemap, typepair)
+				      ? ISC_SLIST_HEAD(node->next_type)
+				      : NULL;
+	ISC_SLIST_FOREACH_FROM(top, node->next_type, next_type, first) {
 		dns_vecheader_t *header = first_existing_header(top, serial);
 		if (header != NULL) {
 			/*
@@ -2136,6 +2146,7 @@ add(qpzonedb_t *qpdb, qpznode_t *node, const dns_name_t *nodename,
 				ISC_SLIST_PREPEND(node->next_type, newtop,
 						  next_type);
 			}
+			typemap_add(&node->typemap, newtop->typepair);
 		}
 	}
 
@@ -134,11 +134,23 @@ compare_rdata(const void *p1, const void *p2) {
 
 static unsigned char *
 newslab(dns_rdataset_t *rdataset, isc_mem_t *mctx, isc_region_t *region,
-	uint16_t nitems, size_t size, const char *func, const char *file,
-	const unsigned int line) {
-	dns_slabheader_t *header = isc_mem_get(mctx, size);
+	dns_slabslot_t *slot, uint16_t nitems, size_t size, const char *func,
+	const char *file, const unsigned int line) {
+	dns_slabheader_t *header = NULL;
+	uint16_t attributes = 0;
+	bool unused = false;
+
+	if (slot != NULL && size <= sizeof(slot->buf) &&
+	    atomic_compare_exchange_strong_acq_rel(&slot->used, &unused, true))
+	{
+		header = (dns_slabheader_t *)slot->buf;
+		attributes = DNS_SLABHEADERATTR_INSLOT;
+	} else {
+		header = isc_mem_get(mctx, size);
+	}
 
 	*header = (dns_slabheader_t){
+		.attributes = attributes,
 		.headers_link = CDS_LIST_HEAD_INIT(header->headers_link),
 		.trust = rdataset->trust,
 		.nitems = nitems,
@@ -166,8 +178,8 @@ newslab(dns_rdataset_t *rdataset, isc_mem_t *mctx, isc_region_t *region,
 
 static isc_result_t
 makeslab(dns_rdataset_t *rdataset, isc_mem_t *mctx, isc_region_t *region,
-	 uint32_t maxrrperset, const char *func, const char *file,
-	 const unsigned int line) {
+	 uint32_t maxrrperset, dns_slabslot_t *slot, const char *func,
+	 const char *file, const unsigned int line) {
 	/*
 	 * Use &removed as a sentinel pointer for duplicate
 	 * rdata as rdata.data == NULL is valid.
@@ -193,8 +205,8 @@ makeslab(dns_rdataset_t *rdataset, isc_mem_t *mctx, isc_region_t *region,
 		dns_slabheader_t *header = rdataset_getheader(rdataset);
 		buflen = dns_rdataslab_size(header);
 
-		rawbuf = newslab(rdataset, mctx, region, header->nitems, buflen,
-				 func, file, line);
+		rawbuf = newslab(rdataset, mctx, region, slot, header->nitems,
+				 buflen, func, file, line);
 
 		INSIST(headerlen <= buflen);
 		memmove(rawbuf, (unsigned char *)header + headerlen,
@@ -211,8 +223,8 @@ makeslab(dns_rdataset_t *rdataset, isc_mem_t *mctx, isc_region_t *region,
 		if (rdataset->type != 0) {
 			return ISC_R_FAILURE;
 		}
-		(void)newslab(rdataset, mctx, region, 0, buflen, func, file,
-			      line);
+		(void)newslab(rdataset, mctx, region, slot, 0, buflen, func,
+			      file, line);
 		return ISC_R_SUCCESS;
 	}
 
@@ -324,8 +336,8 @@ makeslab(dns_rdataset_t *rdataset, isc_mem_t *mctx, isc_region_t *region,
 	 * Allocate the memory, set up a buffer, start copying in
 	 * data.
 	 */
-	rawbuf = newslab(rdataset, mctx, region, nitems, buflen, func, file,
-			 line);
+	rawbuf = newslab(rdataset, mctx, region, slot, nitems, buflen, func,
+			 file, line);
 
 	for (i = 0; i < nalloc; i++) {
 		if (rdata[i].data == &removed) {
@@ -363,8 +375,8 @@ free_rdatas:
 isc_result_t
 dns_rdataslab__fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 			    isc_region_t *region, uint32_t maxrrperset,
-			    const char *func, const char *file,
-			    const unsigned int line) {
+			    dns_slabslot_t *slot, const char *func,
+			    const char *file, const unsigned int line) {
 	if (rdataset->type == dns_rdatatype_none &&
 	    rdataset->covers == dns_rdatatype_none)
 	{
@@ -372,7 +384,7 @@ dns_rdataslab__fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	}
 
 	isc_result_t result = makeslab(rdataset, mctx, region, maxrrperset,
-				       func, file, line);
+				       slot, func, file, line);
 	if (result != ISC_R_SUCCESS) {
 		return result;
 	}
@@ -520,7 +532,8 @@ dns_slabheader__reset(dns_slabheader_t *h, dns_dbnode_t *node, const char *func,
 		      const char *file, const unsigned int line) {
 	h->node = node;
 
-	atomic_init(&h->attributes, 0);
+	atomic_init(&h->attributes, atomic_load_relaxed(&h->attributes) &
+					    DNS_SLABHEADERATTR_INSLOT);
 	atomic_init(&h->last_refresh_fail_ts, 0);
 	isc_refcount_init(&h->references, 1);
 
@@ -583,6 +596,16 @@ slabheader_destroy(dns_slabheader_t *header) {
 		dns_slabheader_freeproof(header->mctx, &header->closest);
 	}
 
+	if (DNS_SLABHEADER_GETATTR(header, DNS_SLABHEADERATTR_INSLOT) != 0) {
+		/* the memory belongs to the slot owner; hand it back */
+		dns_slabslot_t *slot =
+			(dns_slabslot_t *)((unsigned char *)header -
+					   offsetof(dns_slabslot_t, buf));
+		isc_mem_detach(&header->mctx);
+		atomic_store_release(&slot->used, false);
+		return;
+	}
+
 	isc_mem_putanddetach(&header->mctx, header, size);
 }
 
@@ -23,7 +23,6 @@
 #include <isc/atomic.h>
 #include <isc/counter.h>
 #include <isc/hash.h>
-#include <isc/hashmap.h>
 #include <isc/hex.h>
 #include <isc/histo.h>
 #include <isc/list.h>
@@ -37,7 +36,9 @@
 #include <isc/siphash.h>
 #include <isc/stats.h>
 #include <isc/string.h>
+#include <isc/swisstable.h>
 #include <isc/tid.h>
+#include <isc/topk.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/urcu.h>
@@ -72,6 +73,7 @@
 #include <dns/rdatasetiter.h>
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
+#include <dns/request.h>
 #include <dns/resolver.h>
 #include <dns/rootns.h>
 #include <dns/stats.h>
@@ -185,6 +187,16 @@
 #define MAX_SINGLE_QUERY_TIMEOUT    9000U
 #define MAX_SINGLE_QUERY_TIMEOUT_US (MAX_SINGLE_QUERY_TIMEOUT * US_PER_MS)
 
+/*
+ * Hedged queries: don't hedge sooner than HEDGE_MIN_DELAY_US after the
+ * query was sent.  Every query sent earns 'hedge_budget' tokens, a hedge
+ * costs HEDGE_COST of them, and at most HEDGE_BURST hedges' worth of
+ * tokens are kept.
+ */
+#define HEDGE_MIN_DELAY_US (10 * US_PER_MS)
+#define HEDGE_COST	   100
+#define HEDGE_BURST	   10
+
 /*
  * The default maximum number of validations and validation failures per-fetch
  */
@@ -272,6 +284,7 @@ typedef struct query {
 	isc_time_t start;
 	dns_messageid_t id;
 	dns_dispentry_t *dispentry;
+	isc_timer_t *hedgetimer;
 	ISC_LINK(struct query) link;
 	isc_buffer_t buffer;
 	isc_buffer_t *tsig;
@@ -305,6 +318,7 @@ struct tried {
 #define VALID_QUERY(query) ISC_MAGIC_VALID(query, QUERY_MAGIC)
 
 #define RESQUERY_ATTR_CANCELED 0x02
+#define RESQUERY_ATTR_HEDGED   0x04 /* one of a pair of parallel queries */
 
 #define RESQUERY_CONNECTING(q) ((q)->connects > 0)
 #define RESQUERY_CANCELED(q)   (((q)->attributes & RESQUERY_ATTR_CANCELED) != 0)
@@ -525,6 +539,13 @@ struct fetchctx {
 
 	struct cds_lfht_node ht_node;
 	struct rcu_head rcu_head;
+
+	/*%
+	 * Set when the fetch context is also in the fetch group of its
+	 * resolver, so that other views can join it.
+	 */
+	struct cds_lfht_node group_node;
+	bool grouped;
 };
 
 #define FCTX_MAGIC	 ISC_MAGIC('F', '!', '!', '!')
@@ -573,6 +594,38 @@ struct dns_fetch {
 #define DNS_FETCH_MAGIC	       ISC_MAGIC('F', 't', 'c', 'h')
 #define DNS_FETCH_VALID(fetch) ISC_MAGIC_VALID(fetch, DNS_FETCH_MAGIC)
 
+/*%
+ * Fetch contexts that the resolvers of views sharing a cache can join;
+ * see dns_resolver_setfetchgroup().
+ */
+struct dns_fetchgroup {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	struct cds_lfht *fctxs_ht;
+};
+
+#define FETCHGROUP_MAGIC	    ISC_MAGIC('F', 'G', 'r', 'p')
+#define VALID_FETCHGROUP(group) ISC_MAGIC_VALID(group, FETCHGROUP_MAGIC)
+
+/*%
+ * A health probe for a forwarder that stopped responding; see
+ * fwdprobe_start().
+ */
+typedef struct fwdprobe fwdprobe_t;
+struct fwdprobe {
+	isc_mem_t *mctx;
+	dns_resolver_t *res;
+	dns_requestmgr_t *requestmgr;
+	isc_loop_t *loop;
+	isc_sockaddr_t addr;
+	isc_timer_t *timer;
+	dns_request_t *request;
+	isc_time_t start;
+	bool canceled;
+	ISC_LINK(fwdprobe_t) link;
+};
+
 typedef struct alternate {
 	bool isaddress;
 	union {
@@ -600,8 +653,9 @@ struct dns_resolver {
 	dns_dispatchset_t *dispatches6;
 
 	struct cds_lfht *fctxs_ht;
+	dns_fetchgroup_t *fetchgroup;
 
-	isc_hashmap_t *counters;
+	isc_swisstable_t *counters;
 	isc_rwlock_t counters_lock;
 
 	uint32_t lame_ttl;
@@ -620,11 +674,20 @@ struct dns_resolver {
 	isc_statsmulti_t *querystats;
 	isc_histomulti_t *queryinrttstats;
 	isc_histomulti_t *queryoutrttstats;
+	isc_topkmulti_t *topfetches;
 
 	/* Additions for serve-stale feature. */
 	unsigned int retryinterval; /* in milliseconds */
 	unsigned int nonbackofftries;
 
+	/* Hedged queries, see dns_resolver_sethedging(). */
+	unsigned int hedge_percentile;
+	unsigned int hedge_budget;
+	atomic_uint_fast32_t hedge_tokens;
+
+	/* See dns_resolver_setforwarderspread(). */
+	unsigned int forwarder_spread;
+
 	/* Atomic */
 	isc_refcount_t references;
 	atomic_uint_fast32_t zspill; /* fetches-per-zone */
@@ -637,6 +700,9 @@ struct dns_resolver {
 	/* Locked by lock. */
 	unsigned int spillat; /* clients-per-query */
 
+	/* Locked by lock. */
+	ISC_LIST(fwdprobe_t) fwdprobes;
+
 	/* Locked by primelock. */
 	dns_fetch_t *primefetch;
 
@@ -694,6 +760,8 @@ resquery_response_continue(void *arg, isc_result_t result);
 static void
 resquery_connected(isc_result_t eresult, isc_region_t *region, void *arg);
 static void
+resquery_hedge(void *arg);
+static void
 fctx_try(fetchctx_t *fctx, bool retrying);
 static void
 fctx_shutdown(void *arg);
@@ -1213,6 +1281,275 @@ update_edns_stats(resquery_t *query) {
 	}
 }
 
+/*
+ * Forwarder health probes.
+ *
+ * When DNS_ADB_UNRESPONSIVE queries in a row sent to a forwarder have
+ * timed out or failed to reach it, nextforwarder() stops preferring it
+ * and a probe is started: every FWDPROBE_INTERVAL seconds, a "./NS" query
+ * is sent to the forwarder until it answers with any well-formed
+ * response, or until a client query does.  The probe's round trip time
+ * is then fed to the ADB, which makes the forwarder responsive again.  This way client
+ * queries go to the healthy forwarders rather than time out on a sick one
+ * until its SRTT has grown large enough.
+ *
+ * Forwarders reached over TLS are not probed; they recover when they
+ * answer a client query sent to them after the others have been tried.
+ */
+#define FWDPROBE_INTERVAL 5 /* seconds */
+#define FWDPROBE_TIMEOUT  2 /* seconds */
+
+static void
+fwdprobe_destroy(fwdprobe_t *probe) {
+	if (probe->timer != NULL) {
+		isc_timer_destroy(&probe->timer);
+	}
+	if (probe->request != NULL) {
+		dns_request_destroy(&probe->request);
+	}
+	dns_requestmgr_detach(&probe->requestmgr);
+	dns_resolver_detach(&probe->res);
+	isc_mem_putanddetach(&probe->mctx, probe, sizeof(*probe));
+}
+
+static void
+fwdprobe_again(fwdprobe_t *probe) {
+	isc_interval_t interval;
+
+	isc_interval_set(&interval, FWDPROBE_INTERVAL, 0);
+	isc_timer_start(probe->timer, isc_timertype_once, &interval);
+}
+
+static void
+fwdprobe_done(void *arg) {
+	dns_request_t *request = arg;
+	fwdprobe_t *probe = dns_request_getarg(request);
+	dns_resolver_t *res = probe->res;
+	dns_message_t *message = NULL;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	dns_adb_t *adb = NULL;
+	isc_time_t now = isc_time_now();
+	isc_result_t result = dns_request_getresult(request);
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+
+	if (probe->canceled) {
+		fwdprobe_destroy(probe);
+		return;
+	}
+
+	/*
+	 * Any well-formed response shows that the forwarder is alive, even
+	 * if it refuses to answer "./NS" or fails to resolve it.
+	 */
+	if (result == ISC_R_SUCCESS) {
+		dns_message_create(probe->mctx, NULL, NULL,
+				   DNS_MESSAGE_INTENTPARSE, &message);
+		result = dns_request_getresponse(request, message, 0);
+		dns_message_detach(&message);
+	}
+	dns_request_destroy(&probe->request);
+
+	if (result != ISC_R_SUCCESS) {
+		if (!atomic_load_acquire(&res->exiting)) {
+			fwdprobe_again(probe);
+		}
+		return;
+	}
+
+	/* When shutting down, fwdprobe_cancel() cleans up */
+	LOCK(&res->lock);
+	if (atomic_load_acquire(&res->exiting)) {
+		UNLOCK(&res->lock);
+		return;
+	}
+	ISC_LIST_UNLINK(res->fwdprobes, probe, link);
+	UNLOCK(&res->lock);
+
+	dns_view_getadb(res->view, &adb);
+	if (adb != NULL) {
+		result = dns_adb_findaddrinfo(adb, &probe->addr, &addrinfo, 0);
+		if (result == ISC_R_SUCCESS) {
+			dns_adb_adjustsrtt(
+				adb, addrinfo,
+				(unsigned int)isc_time_microdiff(&now,
+								 &probe->start),
+				DNS_ADB_RTTADJDEFAULT);
+			dns_adb_freeaddrinfo(adb, &addrinfo);
+		}
+		dns_adb_detach(&adb);
+	}
+
+	isc_sockaddr_format(&probe->addr, addrbuf, sizeof(addrbuf));
+	isc_log_write(DNS_LOGCATEGORY_RESOLVER, DNS_LOGMODULE_RESOLVER,
+		      ISC_LOG_INFO, "forwarder %s is responding again",
+		      addrbuf);
+
+	fwdprobe_destroy(probe);
+}
+
+static void
+fwdprobe_send(void *arg) {
+	fwdprobe_t *probe = arg;
+	dns_resolver_t *res = probe->res;
+	dns_message_t *message = NULL;
+	dns_name_t *qname = NULL;
+	dns_rdataset_t *qrdataset = NULL;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	dns_adb_t *adb = NULL;
+	bool responsive = true;
+	isc_result_t result;
+
+	/* When shutting down, fwdprobe_cancel() cleans up */
+	if (atomic_load_acquire(&res->exiting)) {
+		return;
+	}
+
+	/*
+	 * Stop probing once the forwarder is no longer unresponsive, e.g.
+	 * because a client query sent to it got an answer in the meantime.
+	 */
+	dns_view_getadb(res->view, &adb);
+	if (adb != NULL) {
+		result = dns_adb_findaddrinfo(adb, &probe->addr, &addrinfo, 0);
+		if (result == ISC_R_SUCCESS) {
+			responsive = !dns_adb_unresponsive(adb, addrinfo);
+			dns_adb_freeaddrinfo(adb, &addrinfo);
+		}
+		dns_adb_detach(&adb);
+	}
+	if (responsive) {
+		LOCK(&res->lock);
+		if (atomic_load_acquire(&res->exiting)) {
+			UNLOCK(&res->lock);
+			return;
+		}
+		ISC_LIST_UNLINK(res->fwdprobes, probe, link);
+		UNLOCK(&res->lock);
+
+		fwdprobe_destroy(probe);
+		return;
+	}
+
+	dns_message_create(probe->mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &message);
+	message->opcode = dns_opcode_query;
+	message->rdclass = res->rdclass;
+	message->flags |= DNS_MESSAGEFLAG_RD;
+
+	dns_message_gettempname(message, &qname);
+	dns_message_gettemprdataset(message, &qrdataset);
+	dns_name_clone(dns_rootname, qname);
+	dns_rdataset_makequestion(qrdataset, res->rdclass, dns_rdatatype_ns);
+	ISC_LIST_APPEND(qname->list, qrdataset, link);
+	dns_message_addname(message, qname, DNS_SECTION_QUESTION);
+
+	probe->start = isc_time_now();
+	result = dns_request_create(probe->requestmgr, message, NULL,
+				    &probe->addr, NULL, NULL, 0, NULL,
+				    FWDPROBE_TIMEOUT, FWDPROBE_TIMEOUT, 0, 0,
+				    probe->loop, fwdprobe_done, probe,
+				    &probe->request);
+	dns_message_detach(&message);
+
+	if (result != ISC_R_SUCCESS) {
+		fwdprobe_again(probe);
+	}
+}
+
+static void
+fwdprobe_cancel(void *arg) {
+	fwdprobe_t *probe = arg;
+
+	isc_timer_destroy(&probe->timer);
+	if (probe->request != NULL) {
+		/* fwdprobe_done() cleans up */
+		probe->canceled = true;
+		dns_request_cancel(probe->request);
+	} else {
+		fwdprobe_destroy(probe);
+	}
+}
+
+/*
+ * Start probing a forwarder that stopped responding, unless it is
+ * already being probed.
+ */
+static void
+fwdprobe_start(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	dns_resolver_t *res = fctx->res;
+	dns_requestmgr_t *requestmgr = NULL;
+	fwdprobe_t *probe = NULL;
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+
+	if (addrinfo->transport != NULL) {
+		return;
+	}
+
+	LOCK(&res->view->lock);
+	if (res->view->requestmgr != NULL) {
+		dns_requestmgr_attach(res->view->requestmgr, &requestmgr);
+	}
+	UNLOCK(&res->view->lock);
+	if (requestmgr == NULL) {
+		return;
+	}
+
+	LOCK(&res->lock);
+	if (atomic_load_acquire(&res->exiting)) {
+		goto unlock;
+	}
+	ISC_LIST_FOREACH(res->fwdprobes, p, link) {
+		if (isc_sockaddr_equal(&p->addr, &addrinfo->sockaddr)) {
+			goto unlock;
+		}
+	}
+
+	probe = isc_mem_get(res->mctx, sizeof(*probe));
+	*probe = (fwdprobe_t){
+		.loop = isc_loop(),
+		.addr = addrinfo->sockaddr,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	isc_mem_attach(res->mctx, &probe->mctx);
+	dns_resolver_attach(res, &probe->res);
+	dns_requestmgr_attach(requestmgr, &probe->requestmgr);
+	isc_timer_create(probe->loop, fwdprobe_send, probe, &probe->timer);
+	ISC_LIST_APPEND(res->fwdprobes, probe, link);
+	fwdprobe_again(probe);
+
+unlock:
+	UNLOCK(&res->lock);
+	dns_requestmgr_detach(&requestmgr);
+
+	if (probe != NULL) {
+		isc_sockaddr_format(&addrinfo->sockaddr, addrbuf,
+				    sizeof(addrbuf));
+		isc_log_write(DNS_LOGCATEGORY_RESOLVER, DNS_LOGMODULE_RESOLVER,
+			      ISC_LOG_INFO,
+			      "forwarder %s is not responding, probing it "
+			      "every %u seconds",
+			      addrbuf, FWDPROBE_INTERVAL);
+	}
+}
+
+/*
+ * Record that 'query' timed out or could not reach its server.  This is
+ * not done in fctx_cancelquery(), which also penalizes queries that were
+ * merely canceled because another one was answered first or the fetch
+ * was shutting down: those say nothing about whether the server responds.
+ */
+static void
+query_noresponse(resquery_t *query) {
+	fetchctx_t *fctx = query->fctx;
+
+	if (dns_adb_noresponse(fctx->adb, query->addrinfo) ==
+		    DNS_ADB_UNRESPONSIVE &&
+	    ISFORWARDER(query->addrinfo))
+	{
+		fwdprobe_start(fctx, query->addrinfo);
+	}
+}
+
 static void
 fctx_expired(void *arg);
 
@@ -1265,6 +1602,10 @@ fctx_cancelquery(resquery_t **queryp, isc_time_t *finish, bool no_response,
 
 	query->attributes |= RESQUERY_ATTR_CANCELED;
 
+	if (query->hedgetimer != NULL) {
+		isc_timer_destroy(&query->hedgetimer);
+	}
+
 	/*
 	 * Should we update the RTT?
 	 */
@@ -1546,8 +1887,8 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 	hashval = dns_name_hash(fctx->domain);
 
 	RWLOCK(&res->counters_lock, locktype);
-	result = isc_hashmap_find(res->counters, hashval, fcount_match,
-				  fctx->domain, (void **)&counter);
+	result = isc_swisstable_find(res->counters, hashval, fcount_match,
+				     fctx->domain, (void **)&counter);
 	switch (result) {
 	case ISC_R_SUCCESS:
 		break;
@@ -1564,8 +1905,9 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 		UPGRADELOCK(&res->counters_lock, locktype);
 
 		void *found = NULL;
-		result = isc_hashmap_add(res->counters, hashval, fcount_match,
-					 counter->domain, counter, &found);
+		result = isc_swisstable_add(res->counters, hashval,
+					    fcount_match, counter->domain,
+					    counter, &found);
 		if (result == ISC_R_EXISTS) {
 			isc_mutex_destroy(&counter->lock);
 			isc_mem_putanddetach(&counter->mctx, counter,
@@ -1631,9 +1973,9 @@ fcount_decr(fetchctx_t *fctx) {
 		return;
 	}
 
-	isc_result_t result = isc_hashmap_delete(fctx->res->counters,
-						 dns_name_hash(counter->domain),
-						 match_ptr, counter);
+	isc_result_t result = isc_swisstable_delete(
+		fctx->res->counters, dns_name_hash(counter->domain), match_ptr,
+		counter);
 	INSIST(result == ISC_R_SUCCESS);
 
 	fcount_logspill(fctx, counter, true);
@@ -1841,6 +2183,10 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 
 	/* The fctx will get deleted either here or in get_attached_fctx() */
 	cds_lfht_del(fctx->res->fctxs_ht, &fctx->ht_node);
+	if (fctx->grouped) {
+		cds_lfht_del(fctx->res->fetchgroup->fctxs_ht,
+			     &fctx->group_node);
+	}
 
 	UNLOCK(&fctx->lock);
 
@@ -1954,6 +2300,7 @@ resquery_senddone(isc_result_t eresult, isc_region_t *region, void *arg) {
 			   eresult);
 		add_bad(fctx, query->rmessage, query->addrinfo, eresult,
 			badns_unreachable);
+		query_noresponse(query);
 		fctx_cancelquery(&copy, NULL, true, false);
 		FCTX_ATTR_CLR(fctx, FCTX_ATTR_ADDRWAIT);
 		fctx_try(fctx, true);
@@ -2043,9 +2390,74 @@ fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
 static struct tried *
 triededns(fetchctx_t *fctx, isc_sockaddr_t *address);
 
+static void
+hedge_earn(dns_resolver_t *res) {
+	uint_fast32_t tokens = atomic_load_relaxed(&res->hedge_tokens);
+	uint_fast32_t max = HEDGE_BURST * HEDGE_COST;
+
+	while (tokens < max &&
+	       !atomic_compare_exchange_weak_relaxed(
+		       &res->hedge_tokens, &tokens,
+		       ISC_MIN(tokens + res->hedge_budget, max)))
+	{
+		/* retry */
+	}
+}
+
+static bool
+hedge_spend(dns_resolver_t *res) {
+	uint_fast32_t tokens = atomic_load_relaxed(&res->hedge_tokens);
+
+	do {
+		if (tokens < HEDGE_COST) {
+			return false;
+		}
+	} while (!atomic_compare_exchange_weak_relaxed(
+		&res->hedge_tokens, &tokens, tokens - HEDGE_COST));
+
+	return true;
+}
+
+/*
+ * Arm the hedge timer of a query that was just sent, if the server's
+ * observed RTT percentile is comfortably below the query timeout.
+ */
+static void
+hedge_arm(fetchctx_t *fctx, resquery_t *query, unsigned int timeout_ms) {
+	dns_resolver_t *res = fctx->res;
+	isc_interval_t interval;
+	unsigned int us;
+
+	if (res->hedge_percentile == 0 ||
+	    (query->options & DNS_FETCHOPT_TCP) != 0 ||
+	    ISFORWARDER(query->addrinfo))
+	{
+		return;
+	}
+
+	us = dns_adb_rttquantile(fctx->adb, query->addrinfo,
+				 res->hedge_percentile);
+	if (us == 0) {
+		/* Not enough RTTs measured yet. */
+		return;
+	}
+
+	us = ISC_MAX(us, query->addrinfo->srtt);
+	us = ISC_MAX(us, HEDGE_MIN_DELAY_US);
+	if (us >= (uint64_t)timeout_ms * US_PER_MS) {
+		return;
+	}
+
+	isc_timer_create(fctx->loop, resquery_hedge, query,
+			 &query->hedgetimer);
+	isc_interval_set(&interval, us / US_PER_SEC,
+			 (us % US_PER_SEC) * NS_PER_US);
+	isc_timer_start(query->hedgetimer, isc_timertype_once, &interval);
+}
+
 static isc_result_t
-fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
-	   unsigned int options) {
+fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo, unsigned int options,
+	   bool hedge) {
 	isc_result_t result;
 	dns_resolver_t *res = NULL;
 	dns_dns64_t *dns64 = NULL;
@@ -2190,6 +2602,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	*query = (resquery_t){
 		.options = options,
 		.addrinfo = addrinfo,
+		.attributes = hedge ? RESQUERY_ATTR_HEDGED : 0,
 		.link = ISC_LINK_INITIALIZER,
 	};
 
@@ -2339,6 +2752,13 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	}
 
+	if (res->hedge_percentile != 0) {
+		hedge_earn(res);
+		if (!hedge) {
+			hedge_arm(fctx, query, timeout_ms);
+		}
+	}
+
 	return result;
 
 cleanup_udpfetch:
@@ -3050,6 +3470,7 @@ resquery_connected(isc_result_t eresult, isc_region_t *region, void *arg) {
 			   eresult);
 		add_bad(fctx, query->rmessage, query->addrinfo, eresult,
 			badns_unreachable);
+		query_noresponse(query);
 		fctx_cancelquery(&copy, NULL, true, false);
 
 		FCTX_ATTR_CLR(fctx, FCTX_ATTR_ADDRWAIT);
@@ -4188,6 +4609,49 @@ nextaddress(fetchctx_t *fctx) {
 	return lowestsrttai;
 }
 
+/*
+ * Pick the forwarder to try next.  Each candidate's SRTT is stretched by
+ * a random amount of up to 'forwarder_spread' percent, and the lowest
+ * wins: with the default of 100%, forwarders with similar latency share
+ * the load, while one that is more than twice as slow as another is only
+ * used when the faster one has been tried.  With 0%, the forwarder with
+ * the lowest SRTT is always tried first.  Forwarders that have stopped
+ * responding (see fwdprobe_start()) come last.
+ */
+static dns_adbaddrinfo_t *
+nextforwarder(fetchctx_t *fctx) {
+	dns_adbaddrinfo_t *best = NULL;
+	uint64_t bestkey = UINT64_MAX;
+	unsigned int spread = fctx->res->forwarder_spread;
+
+	ISC_LIST_FOREACH(fctx->forwaddrs, ai, publink) {
+		if (!UNMARKED(ai)) {
+			continue;
+		}
+		possibly_mark(fctx, ai);
+		if (!UNMARKED(ai)) {
+			continue;
+		}
+
+		uint64_t key = ai->srtt;
+		if (spread != 0) {
+			key += isc_random_uniform(
+				(uint32_t)((uint64_t)ai->srtt * spread / 100) +
+				1);
+		}
+		if (dns_adb_unresponsive(fctx->adb, ai)) {
+			key += UINT32_MAX;
+		}
+
+		if (best == NULL || key < bestkey) {
+			best = ai;
+			bestkey = key;
+		}
+	}
+
+	return best;
+}
+
 static dns_adbaddrinfo_t *
 fctx_nextaddress(fetchctx_t *fctx) {
 	dns_adbfind_t *find = NULL, *start = NULL;
@@ -4198,27 +4662,21 @@ fctx_nextaddress(fetchctx_t *fctx) {
 	 */
 
 	/*
-	 * Find the first unmarked forwarder (if any).
+	 * Find the next unmarked forwarder (if any).
 	 */
-	ISC_LIST_FOREACH(fctx->forwaddrs, ai, publink) {
-		if (!UNMARKED(ai)) {
-			continue;
-		}
-		possibly_mark(fctx, ai);
-		if (UNMARKED(ai)) {
-			ai->flags |= FCTX_ADDRINFO_MARK;
-			fctx->forwarding = true;
+	addrinfo = nextforwarder(fctx);
+	if (addrinfo != NULL) {
+		addrinfo->flags |= FCTX_ADDRINFO_MARK;
+		fctx->forwarding = true;
 
-			/*
-			 * QNAME minimization is disabled when
-			 * forwarding, and has to remain disabled if
-			 * we switch back to normal recursion; otherwise
-			 * forwarding could leave us in an inconsistent
-			 * state.
-			 */
-			fctx->minimized = false;
-			return ai;
-		}
+		/*
+		 * QNAME minimization is disabled when forwarding, and has
+		 * to remain disabled if we switch back to normal recursion;
+		 * otherwise forwarding could leave us in an inconsistent
+		 * state.
+		 */
+		fctx->minimized = false;
+		return addrinfo;
 	}
 
 	/*
@@ -4336,6 +4794,90 @@ incr_query_counters(fetchctx_t *fctx) {
 	return result;
 }
 
+/*
+ * A query has gone unanswered for longer than its server usually takes:
+ * send the same question to the next server in parallel, and let the
+ * first good response win.
+ */
+static void
+resquery_hedge(void *arg) {
+	resquery_t *query = arg;
+	fetchctx_t *fctx = query->fctx;
+	dns_resolver_t *res = NULL;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	isc_result_t result;
+	bool waiting;
+
+	REQUIRE(VALID_QUERY(query));
+	REQUIRE(VALID_FCTX(fctx));
+	REQUIRE(fctx->tid == isc_tid());
+
+	res = fctx->res;
+
+	QTRACE("hedge");
+
+	LOCK(&fctx->lock);
+	waiting = !SHUTTINGDOWN(fctx) && !ISC_LIST_EMPTY(fctx->resps);
+	UNLOCK(&fctx->lock);
+
+	if (!waiting || RESQUERY_CANCELED(query) || ADDRWAIT(fctx) ||
+	    !ISC_LIST_EMPTY(fctx->validators))
+	{
+		return;
+	}
+
+	if (!hedge_spend(res)) {
+		inc_stats(res, dns_resstatscounter_hedgebudget);
+		return;
+	}
+
+	addrinfo = fctx_nextaddress(fctx);
+	while (addrinfo != NULL && dns_adb_overquota(fctx->adb, addrinfo)) {
+		addrinfo = fctx_nextaddress(fctx);
+	}
+	if (addrinfo == NULL) {
+		/*
+		 * Nothing left to try in parallel; the query keeps
+		 * waiting for its own timeout.
+		 */
+		atomic_fetch_add_relaxed(&res->hedge_tokens, HEDGE_COST);
+		return;
+	}
+
+	result = incr_query_counters(fctx);
+	if (result == ISC_R_SUCCESS) {
+		result = fctx_query(fctx, addrinfo, fctx->options, true);
+	}
+	if (result == ISC_R_SUCCESS) {
+		query->attributes |= RESQUERY_ATTR_HEDGED;
+		inc_stats(res, dns_resstatscounter_hedged);
+	} else {
+		FCTXTRACE3("hedged query failed", result);
+	}
+}
+
+/*
+ * Is a query that was sent in parallel with another still waiting for
+ * its response?
+ */
+static bool
+fctx_hedgepending(fetchctx_t *fctx) {
+	bool pending = false;
+
+	LOCK(&fctx->lock);
+	ISC_LIST_FOREACH(fctx->queries, query, link) {
+		if (!RESQUERY_CANCELED(query) &&
+		    (query->attributes & RESQUERY_ATTR_HEDGED) != 0)
+		{
+			pending = true;
+			break;
+		}
+	}
+	UNLOCK(&fctx->lock);
+
+	return pending;
+}
+
 static void
 fctx_try(fetchctx_t *fctx, bool retrying) {
 	isc_result_t result;
@@ -4347,6 +4889,16 @@ fctx_try(fetchctx_t *fctx, bool retrying) {
 
 	res = fctx->res;
 
+	if (retrying && fctx_hedgepending(fctx)) {
+		/*
+		 * The other query of a hedged pair is still outstanding.
+		 * Rather than adding a third query, wait for it to answer,
+		 * or to fail and come back here itself.
+		 */
+		FCTXTRACE("waiting for the hedged query");
+		return;
+	}
+
 	/* We've already exceeded maximum query count */
 	if (isc_counter_used(fctx->qc) > isc_counter_getlimit(fctx->qc)) {
 		isc_log_write(
@@ -4485,7 +5037,7 @@ fctx_try(fetchctx_t *fctx, bool retrying) {
 		goto done;
 	}
 
-	result = fctx_query(fctx, addrinfo, fctx->options);
+	result = fctx_query(fctx, addrinfo, fctx->options, false);
 	if (result != ISC_R_SUCCESS) {
 		goto done;
 	}
@@ -8326,6 +8878,8 @@ rctx_dispfail(respctx_t *rctx) {
 	case ISC_R_CONNREFUSED:
 	case ISC_R_CONNECTIONRESET:
 	case ISC_R_INVALIDPROTO:
+		query_noresponse(rctx->query);
+		FALLTHROUGH;
 	case ISC_R_CANCELED:
 	case ISC_R_SHUTTINGDOWN:
 		rctx->broken_server = rctx->result;
@@ -8373,6 +8927,7 @@ rctx_timedout(respctx_t *rctx) {
 		FCTX_ATTR_CLR(fctx, FCTX_ATTR_ADDRWAIT);
 		fctx->timeout = true;
 		fctx->timeouts++;
+		query_noresponse(rctx->query);
 
 		rctx->no_response = true;
 		rctx->finish = NULL;
@@ -9781,7 +10336,7 @@ rctx_resend(respctx_t *rctx, dns_adbaddrinfo_t *addrinfo) {
 
 	CHECK(incr_query_counters(fctx));
 
-	result = fctx_query(fctx, addrinfo, rctx->retryopts);
+	result = fctx_query(fctx, addrinfo, rctx->retryopts, false);
 	if (result == ISC_R_SUCCESS) {
 		inc_stats(fctx->res, dns_resstatscounter_retry);
 	}
@@ -10183,6 +10738,9 @@ dns_resolver__destroy(dns_resolver_t *res) {
 	dns_nametree_detach(&res->algorithms);
 	dns_nametree_detach(&res->digests);
 
+	if (res->topfetches != NULL) {
+		isc_topkmulti_detach(&res->topfetches);
+	}
 	if (res->queryoutrttstats != NULL) {
 		isc_histomulti_detach(&res->queryoutrttstats);
 	}
@@ -10200,9 +10758,12 @@ dns_resolver__destroy(dns_resolver_t *res) {
 	isc_mutex_destroy(&res->lock);
 
 	RUNTIME_CHECK(cds_lfht_destroy(res->fctxs_ht, NULL) == 0);
+	if (res->fetchgroup != NULL) {
+		dns_fetchgroup_detach(&res->fetchgroup);
+	}
 
-	INSIST(isc_hashmap_count(res->counters) == 0);
-	isc_hashmap_destroy(&res->counters);
+	INSIST(isc_swisstable_count(res->counters) == 0);
+	isc_swisstable_destroy(&res->counters);
 	isc_rwlock_destroy(&res->counters_lock);
 
 	isc_tlsctx_cache_detach(&res->tlsctx_cache);
@@ -10291,6 +10852,8 @@ dns_resolver_create(dns_view_t *view, unsigned int options,
 		.maxdepth = DEFAULT_RECURSION_DEPTH,
 		.maxqueries = DEFAULT_MAX_QUERIES,
 		.alternates = ISC_LIST_INITIALIZER,
+		.fwdprobes = ISC_LIST_INITIALIZER,
+		.forwarder_spread = 100,
 		.nloops = isc_loopmgr_nloops(),
 		.maxvalidations = DEFAULT_MAX_VALIDATIONS,
 		.maxvalidationfails = DEFAULT_MAX_VALIDATION_FAILURES,
@@ -10315,7 +10878,7 @@ dns_resolver_create(dns_view_t *view, unsigned int options,
 			     CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
 	RUNTIME_CHECK(res->fctxs_ht != NULL);
 
-	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->counters);
+	isc_swisstable_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->counters);
 	isc_rwlock_init(&res->counters_lock);
 
 	if (dispatchv4 != NULL) {
@@ -10590,6 +11153,10 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 		if (res->spillattimer != NULL) {
 			isc_timer_async_destroy(&res->spillattimer);
 		}
+		ISC_LIST_FOREACH(res->fwdprobes, probe, link) {
+			ISC_LIST_UNLINK(res->fwdprobes, probe, link);
+			isc_async_run(probe->loop, fwdprobe_cancel, probe);
+		}
 		UNLOCK(&res->lock);
 	}
 }
@@ -10621,6 +11188,25 @@ log_fetch(const dns_name_t *name, dns_rdatatype_t type) {
 		      "fetch: %s/%s", namebuf, typebuf);
 }
 
+/*
+ * Count the name in the heavy-hitter sketch, if it is enabled and this
+ * fetch is sampled, lower-cased so that randomized case doesn't split
+ * its count.
+ */
+static void
+count_fetch(dns_resolver_t *res, const dns_name_t *name) {
+	unsigned char key[ISC_TOPK_KEYSIZE];
+
+	if (res->topfetches == NULL || !isc_topkmulti_sample(res->topfetches))
+	{
+		return;
+	}
+
+	isc_ascii_lowercopy(key, name->ndata, name->length);
+	isc_topkmulti_add(res->topfetches, key, name->length,
+			  isc_stdtime_now());
+}
+
 static void
 fctx_minimize_qname(fetchctx_t *fctx) {
 	isc_result_t result;
@@ -10820,6 +11406,150 @@ get_attached_fctx(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 	return ISC_R_SUCCESS;
 }
 
+static int
+group_match(struct cds_lfht_node *ht_node, const void *key) {
+	const fetchctx_t *fctx0 = caa_container_of(ht_node, fetchctx_t,
+						   group_node);
+	const fetchctx_t *fctx1 = key;
+
+	return fctx0->options == fctx1->options && fctx0->type == fctx1->type &&
+	       dns_name_equal(fctx0->name, fctx1->name);
+}
+
+static bool
+same_forwarders(dns_view_t *view1, dns_view_t *view2, const dns_name_t *name,
+		dns_rdatatype_t type) {
+	dns_forwarders_t *forwarders1 = NULL, *forwarders2 = NULL;
+	dns_forwarder_t *fwd1 = NULL, *fwd2 = NULL;
+	dns_name_t suffix;
+	bool same = false;
+
+	if (view1 == view2) {
+		return true;
+	}
+
+	/* See fctx_getaddresses_forwarders() */
+	if (dns_rdatatype_atparent(type) && dns_name_countlabels(name) > 1) {
+		unsigned int labels = dns_name_countlabels(name);
+		dns_name_init(&suffix);
+		dns_name_getlabelsequence(name, 1, labels - 1, &suffix);
+		name = &suffix;
+	}
+
+	(void)dns_fwdtable_find(view1->fwdtable, name, &forwarders1);
+	(void)dns_fwdtable_find(view2->fwdtable, name, &forwarders2);
+
+	if (forwarders1 == NULL || forwarders2 == NULL) {
+		same = (forwarders1 == forwarders2);
+		goto cleanup;
+	}
+
+	if (forwarders1->fwdpolicy != forwarders2->fwdpolicy ||
+	    !dns_name_equal(&forwarders1->name, &forwarders2->name))
+	{
+		goto cleanup;
+	}
+
+	fwd1 = ISC_LIST_HEAD(forwarders1->fwdrs);
+	fwd2 = ISC_LIST_HEAD(forwarders2->fwdrs);
+	while (fwd1 != NULL && fwd2 != NULL) {
+		if (!isc_sockaddr_equal(&fwd1->addr, &fwd2->addr)) {
+			goto cleanup;
+		}
+		if (fwd1->tlsname != NULL || fwd2->tlsname != NULL) {
+			if (fwd1->tlsname == NULL || fwd2->tlsname == NULL ||
+			    !dns_name_equal(fwd1->tlsname, fwd2->tlsname))
+			{
+				goto cleanup;
+			}
+		}
+		fwd1 = ISC_LIST_NEXT(fwd1, link);
+		fwd2 = ISC_LIST_NEXT(fwd2, link);
+	}
+	same = (fwd1 == NULL && fwd2 == NULL);
+
+cleanup:
+	if (forwarders1 != NULL) {
+		dns_forwarders_detach(&forwarders1);
+	}
+	if (forwarders2 != NULL) {
+		dns_forwarders_detach(&forwarders2);
+	}
+	return same;
+}
+
+/*
+ * Look for a fetch context for the same question that was started by any
+ * resolver in the fetch group of 'res'.  A fetch context of another view
+ * is only joined when that view validates and forwards the same way as
+ * ours; the QNAME minimization policy is part of the fetch options.
+ *
+ * Like get_attached_fctx(), this returns a locked and referenced fetch
+ * context.
+ */
+static fetchctx_t *
+get_grouped_fctx(dns_resolver_t *res, const dns_name_t *name,
+		 dns_rdatatype_t type, unsigned int options) {
+	fetchctx_t key = {
+		.name = UNCONST(name),
+		.options = options,
+		.type = type,
+	};
+	fetchctx_t *fctx = NULL;
+	uint32_t hashval = fctx_hash(&key);
+	struct cds_lfht_iter iter;
+
+	rcu_read_lock();
+	cds_lfht_lookup(res->fetchgroup->fctxs_ht, hashval, group_match, &key,
+			&iter);
+	fctx = cds_lfht_entry(cds_lfht_iter_get_node(&iter), fetchctx_t,
+			      group_node);
+	if (fctx != NULL && !fetchctx_ref_unless_zero(fctx)) {
+		fctx = NULL;
+	}
+	rcu_read_unlock();
+
+	if (fctx == NULL) {
+		return NULL;
+	}
+
+	if (fctx->res != res &&
+	    (atomic_load_acquire(&fctx->res->exiting) ||
+	     fctx->res->view->enablevalidation != res->view->enablevalidation ||
+	     !same_forwarders(fctx->res->view, res->view, name, type)))
+	{
+		fetchctx_detach(&fctx);
+		return NULL;
+	}
+
+	LOCK(&fctx->lock);
+	if (SHUTTINGDOWN(fctx)) {
+		UNLOCK(&fctx->lock);
+		fetchctx_detach(&fctx);
+		return NULL;
+	}
+
+	return fctx;
+}
+
+/*
+ * Make a new, locked fetch context available to the other resolvers in
+ * the fetch group.  If a fetch context for the same question is already
+ * there (e.g. one from a view that forwards differently), this one stays
+ * private to its resolver.
+ */
+static void
+fctx_group(fetchctx_t *fctx) {
+	struct cds_lfht_node *ht_node = NULL;
+
+	rcu_read_lock();
+	ht_node = cds_lfht_add_unique(fctx->res->fetchgroup->fctxs_ht,
+				      fctx_hash(fctx), group_match, fctx,
+				      &fctx->group_node);
+	fctx->grouped = (ht_node == &fctx->group_node);
+	rcu_read_unlock();
+}
+
 static bool
 is_samedomain(const dns_name_t *domain1, const dns_name_t *domain2) {
 	if (domain1 == NULL && domain2 == NULL) {
@@ -10862,6 +11592,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	fetchctx_t *fctx = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
 	bool new_fctx = false;
+	bool grouped = false;
 	unsigned int count = 0;
 	unsigned int spillat;
 	unsigned int spillatmin;
@@ -10887,6 +11618,7 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 	}
 
 	log_fetch(name, type);
+	count_fetch(res, name);
 
 	fetch = isc_mem_get(mctx, sizeof(*fetch));
 	*fetch = (dns_fetch_t){ 0 };
@@ -10905,11 +11637,31 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 		spillatmin = res->spillatmin;
 		UNLOCK(&res->lock);
 
-		result = get_attached_fctx(res, loop, name, type, domain,
-					   delegset, client, options, depth, qc,
-					   gqc, parent, &fctx, &new_fctx);
-		if (result != ISC_R_SUCCESS) {
-			goto fail;
+		/*
+		 * Fetches for client queries can be shared with the other
+		 * views in the fetch group.
+		 */
+		grouped = res->fetchgroup != NULL && domain == NULL &&
+			  parent == NULL;
+		if (grouped) {
+			fctx = get_grouped_fctx(res, name, type, options);
+		}
+
+		if (fctx != NULL) {
+			if (fctx->res != res) {
+				inc_stats(res, dns_resstatscounter_groupjoined);
+			}
+		} else {
+			result = get_attached_fctx(res, loop, name, type,
+						   domain, delegset, client,
+						   options, depth, qc, gqc,
+						   parent, &fctx, &new_fctx);
+			if (result != ISC_R_SUCCESS) {
+				goto fail;
+			}
+			if (new_fctx && grouped) {
+				fctx_group(fctx);
+			}
 		}
 
 		/* On success, the fctx is locked in get_attached_fctx() */
@@ -11353,6 +12105,66 @@ dns_resolver_setmaxqueries(dns_resolver_t *resolver, unsigned int queries) {
 	resolver->maxqueries = queries;
 }
 
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, unsigned int percentile,
+			unsigned int budget) {
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(percentile <= 100);
+	REQUIRE(budget <= 100);
+
+	resolver->hedge_percentile = percentile;
+	resolver->hedge_budget = budget;
+}
+
+void
+dns_resolver_setforwarderspread(dns_resolver_t *resolver,
+				unsigned int spread) {
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(spread <= 100);
+
+	resolver->forwarder_spread = spread;
+}
+
+static void
+dns__fetchgroup_destroy(dns_fetchgroup_t *group) {
+	group->magic = 0;
+	RUNTIME_CHECK(cds_lfht_destroy(group->fctxs_ht, NULL) == 0);
+	isc_mem_putanddetach(&group->mctx, group, sizeof(*group));
+}
+
+ISC_REFCOUNT_IMPL(dns_fetchgroup, dns__fetchgroup_destroy);
+
+void
+dns_fetchgroup_create(isc_mem_t *mctx, dns_fetchgroup_t **groupp) {
+	dns_fetchgroup_t *group = NULL;
+
+	REQUIRE(groupp != NULL && *groupp == NULL);
+
+	group = isc_mem_get(mctx, sizeof(*group));
+	*group = (dns_fetchgroup_t){
+		.magic = FETCHGROUP_MAGIC,
+		.references = ISC_REFCOUNT_INITIALIZER(1),
+	};
+	isc_mem_attach(mctx, &group->mctx);
+
+	group->fctxs_ht =
+		cds_lfht_new(RES_DOMAIN_HASH_SIZE, RES_DOMAIN_HASH_SIZE, 0,
+			     CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
+	RUNTIME_CHECK(group->fctxs_ht != NULL);
+
+	*groupp = group;
+}
+
+void
+dns_resolver_setfetchgroup(dns_resolver_t *resolver, dns_fetchgroup_t *group) {
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(VALID_FETCHGROUP(group));
+	REQUIRE(!resolver->frozen);
+	REQUIRE(resolver->fetchgroup == NULL);
+
+	dns_fetchgroup_attach(group, &resolver->fetchgroup);
+}
+
 unsigned int
 dns_resolver_getmaxqueries(dns_resolver_t *resolver) {
 	REQUIRE(VALID_RESOLVER(resolver));
@@ -11424,7 +12236,7 @@ dns_resolver_dumpfetches(dns_resolver_t *res, isc_statsformat_t format,
 isc_result_t
 dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t *buf) {
 	isc_result_t result;
-	isc_hashmap_iter_t *it = NULL;
+	isc_swisstable_iter_t *it = NULL;
 	uint_fast32_t spill;
 
 	REQUIRE(VALID_RESOLVER(res));
@@ -11435,16 +12247,16 @@ dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t *buf) {
 	}
 
 	RWLOCK(&res->counters_lock, isc_rwlocktype_read);
-	isc_hashmap_iter_create(res->counters, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
+	isc_swisstable_iter_create(res->counters, &it);
+	for (result = isc_swisstable_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_swisstable_iter_next(it))
 	{
 		fctxcount_t *counter = NULL;
 		uint_fast32_t count, dropped, allowed;
 		char nb[DNS_NAME_FORMATSIZE];
 		char text[DNS_NAME_FORMATSIZE + BUFSIZ];
 
-		isc_hashmap_iter_current(it, (void **)&counter);
+		isc_swisstable_iter_current(it, (void **)&counter);
 
 		LOCK(&counter->lock);
 		count = counter->count;
@@ -11470,7 +12282,7 @@ dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t *buf) {
 	}
 
 cleanup:
-	isc_hashmap_iter_destroy(&it);
+	isc_swisstable_iter_destroy(&it);
 	RWUNLOCK(&res->counters_lock, isc_rwlocktype_read);
 	return result;
 }
@@ -11565,6 +12377,24 @@ dns_resolver_getqueryrttstats(dns_resolver_t *res, isc_histomulti_t **hmpin,
 	}
 }
 
+void
+dns_resolver_settopfetches(dns_resolver_t *res, isc_topkmulti_t *tm) {
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(res->topfetches == NULL);
+
+	isc_topkmulti_attach(tm, &res->topfetches);
+}
+
+void
+dns_resolver_gettopfetches(dns_resolver_t *res, isc_topkmulti_t **tmp) {
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(tmp != NULL && *tmp == NULL);
+
+	if (res->topfetches != NULL) {
+		isc_topkmulti_attach(res->topfetches, tmp);
+	}
+}
+
 void
 dns_resolver_freefresp(dns_fetchresponse_t **frespp) {
 	REQUIRE(frespp != NULL);
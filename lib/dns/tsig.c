@@ -18,13 +18,13 @@
 #include <stdlib.h>
 
 #include <isc/buffer.h>
-#include <isc/hashmap.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/serial.h>
 #include <isc/string.h>
+#include <isc/swisstable.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -245,21 +245,21 @@ dns__tsigkey_deletelru(dns_tsigkeyring_t *ring, dns_tsigkey_t *tkey) {
 static void
 destroyring(dns_tsigkeyring_t *ring) {
 	isc_result_t result;
-	isc_hashmap_iter_t *it = NULL;
+	isc_swisstable_iter_t *it = NULL;
 
 	RWLOCK(&ring->lock, isc_rwlocktype_write);
-	isc_hashmap_iter_create(ring->keys, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_delcurrent_next(it))
+	isc_swisstable_iter_create(ring->keys, &it);
+	for (result = isc_swisstable_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_swisstable_iter_delcurrent_next(it))
 	{
 		dns_tsigkey_t *tkey = NULL;
-		isc_hashmap_iter_current(it, (void **)&tkey);
+		isc_swisstable_iter_current(it, (void **)&tkey);
 
 		dns__tsigkey_deletelru(ring, tkey);
 		dns_tsigkey_detach(&tkey);
 	}
-	isc_hashmap_iter_destroy(&it);
-	isc_hashmap_destroy(&ring->keys);
+	isc_swisstable_iter_destroy(&it);
+	isc_swisstable_destroy(&ring->keys);
 	RWUNLOCK(&ring->lock, isc_rwlocktype_write);
 
 	ring->magic = 0;
@@ -384,25 +384,25 @@ isc_result_t
 dns_tsigkeyring_dump(dns_tsigkeyring_t *ring, FILE *fp) {
 	isc_result_t result;
 	isc_stdtime_t now = isc_stdtime_now();
-	isc_hashmap_iter_t *it = NULL;
+	isc_swisstable_iter_t *it = NULL;
 	bool found = false;
 
 	REQUIRE(VALID_TSIGKEYRING(ring));
 
 	RWLOCK(&ring->lock, isc_rwlocktype_read);
-	isc_hashmap_iter_create(ring->keys, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
+	isc_swisstable_iter_create(ring->keys, &it);
+	for (result = isc_swisstable_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_swisstable_iter_next(it))
 	{
 		dns_tsigkey_t *tkey = NULL;
-		isc_hashmap_iter_current(it, (void **)&tkey);
+		isc_swisstable_iter_current(it, (void **)&tkey);
 
 		if (tkey->generated && tkey->expire >= now) {
 			dump_key(tkey, fp);
 			found = true;
 		}
 	}
-	isc_hashmap_iter_destroy(&it);
+	isc_swisstable_iter_destroy(&it);
 	RWUNLOCK(&ring->lock, isc_rwlocktype_read);
 
 	return found ? ISC_R_SUCCESS : ISC_R_NOTFOUND;
@@ -479,7 +479,7 @@ ISC_REFCOUNT_IMPL(dns_tsigkey, destroy_tsigkey);
 
 static void
 dns__tsigkey_delete(dns_tsigkeyring_t *ring, dns_tsigkey_t *tkey) {
-	isc_result_t result = isc_hashmap_delete(
+	isc_result_t result = isc_swisstable_delete(
 		ring->keys, dns_name_hash(tkey->name), match_ptr, tkey);
 	if (result == ISC_R_SUCCESS) {
 		dns__tsigkey_deletelru(ring, tkey);
@@ -1448,8 +1448,8 @@ dns_tsigkey_find(dns_tsigkey_t **tsigkey, const dns_name_t *name,
 
 again:
 	RWLOCK(&ring->lock, locktype);
-	result = isc_hashmap_find(ring->keys, dns_name_hash(name), tkey_match,
-				  name, (void **)&key);
+	result = isc_swisstable_find(ring->keys, dns_name_hash(name),
+				     tkey_match, name, (void **)&key);
 	if (result == ISC_R_NOTFOUND) {
 		RWUNLOCK(&ring->lock, locktype);
 		return result;
@@ -1531,7 +1531,7 @@ dns_tsigkeyring_create(isc_mem_t *mctx, dns_tsigkeyring_t **ringp) {
 
 	ISC_SIEVE_INIT(ring->lrulist);
 
-	isc_hashmap_create(mctx, 12, &ring->keys);
+	isc_swisstable_create(mctx, 12, &ring->keys);
 	isc_rwlock_init(&ring->lock);
 
 	*ringp = ring;
@@ -1545,8 +1545,8 @@ dns_tsigkeyring_add(dns_tsigkeyring_t *ring, dns_tsigkey_t *tkey) {
 	REQUIRE(VALID_TSIGKEYRING(ring));
 
 	RWLOCK(&ring->lock, isc_rwlocktype_write);
-	result = isc_hashmap_add(ring->keys, dns_name_hash(tkey->name),
-				 tkey_match, tkey->name, tkey, NULL);
+	result = isc_swisstable_add(ring->keys, dns_name_hash(tkey->name),
+				    tkey_match, tkey->name, tkey, NULL);
 	if (result == ISC_R_SUCCESS) {
 		dns_tsigkey_ref(tkey);
 
@@ -1533,7 +1533,7 @@ dns_zone_asyncload(dns_zone_t *zone, bool newonly, dns_zt_callback_t *done,
 
 	zone_iattach(zone, &asl->zone);
 	DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADPENDING);
-	isc_async_run(zone->loop, zone_asyncload, asl);
+	isc_async_run_low(zone->loop, zone_asyncload, asl);
 	UNLOCK_ZONE(zone);
 
 	return ISC_R_SUCCESS;
@@ -10349,7 +10349,7 @@ dns_zone_refresh(dns_zone_t *zone) {
 	REQUIRE(DNS_ZONE_VALID(zone));
 
 	dns_zone_ref(zone);
-	isc_async_run(zone->loop, zone_refresh_async, zone);
+	isc_async_run_low(zone->loop, zone_refresh_async, zone);
 }
 
 static isc_result_t
@@ -36,11 +36,15 @@
 #include "job_p.h"
 #include "loop_p.h"
 
-void
-isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
-	REQUIRE(VALID_LOOP(loop));
-	REQUIRE(cb != NULL);
+/*
+ * Maximum number of low priority jobs run per loop iteration; the rest is
+ * postponed until the pending I/O has been processed.
+ */
+#define ASYNC_LOW_BUDGET 64
 
+static void
+async_enqueue(isc_loop_t *loop, isc_jobqueue_t *queue, isc_job_cb cb,
+	      void *cbarg) {
 	isc_job_t *job = isc_mem_get(loop->mctx, sizeof(*job));
 	*job = (isc_job_t){
 		.cb = cb,
@@ -56,20 +60,40 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	 * The function returns 'false' in case the queue was empty - in such
 	 * case we need to trigger the async callback.
 	 */
-	if (!cds_wfcq_enqueue(&loop->async_jobs.head, &loop->async_jobs.tail,
-			      &job->wfcq_node))
-	{
+	if (!cds_wfcq_enqueue(&queue->head, &queue->tail, &job->wfcq_node)) {
 		int r = uv_async_send(&loop->async_trigger);
 		UV_RUNTIME_CHECK(uv_async_send, r);
 	}
 }
 
 void
-isc__async_cb(uv_async_t *handle) {
-	isc_loop_t *loop = uv_handle_get_data(handle);
-	isc_jobqueue_t jobs;
+isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(cb != NULL);
+
+	async_enqueue(loop, &loop->async_jobs, cb, cbarg);
+}
 
+void
+isc_async_run_low(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(cb != NULL);
+
+	async_enqueue(loop, &loop->async_lowjobs, cb, cbarg);
+}
+
+static void
+async_run_job(isc_loop_t *loop, struct cds_wfcq_node *node) {
+	isc_job_t *job = caa_container_of(node, isc_job_t, wfcq_node);
+
+	isc__loop_runcb(loop, job->cb, job->cbarg);
+
+	isc_mem_put(loop->mctx, job, sizeof(*job));
+}
+
+static void
+async_run_all(isc_loop_t *loop) {
+	isc_jobqueue_t jobs;
 
 	/* Initialize local wfcqueue */
 	__cds_wfcq_init(&jobs.head, &jobs.tail);
@@ -105,11 +129,65 @@ isc__async_cb(uv_async_t *handle) {
 	 */
 	struct cds_wfcq_node *node, *next;
 	__cds_wfcq_for_each_blocking_safe(&jobs.head, &jobs.tail, node, next) {
-		isc_job_t *job = caa_container_of(node, isc_job_t, wfcq_node);
+		async_run_job(loop, node);
+	}
+}
 
-		job->cb(job->cbarg);
+/*
+ * Run at most 'budget' low priority jobs and return true if there are
+ * more jobs waiting.
+ */
+static bool
+async_run_low(isc_loop_t *loop, size_t budget) {
+	/*
+	 * The loop->async_lowpending queue is only ever touched from the
+	 * loop thread, so it can use the same unlocked operations as the
+	 * local queue in async_run_all().
+	 */
+	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
+		&loop->async_lowpending.head, &loop->async_lowpending.tail,
+		&loop->async_lowjobs.head, &loop->async_lowjobs.tail);
+	INSIST(ret != CDS_WFCQ_RET_WOULDBLOCK);
 
-		isc_mem_put(loop->mctx, job, sizeof(*job));
+	for (size_t i = 0; i < budget; i++) {
+		struct cds_wfcq_node *node = __cds_wfcq_dequeue_blocking(
+			&loop->async_lowpending.head,
+			&loop->async_lowpending.tail);
+		if (node == NULL) {
+			return false;
+		}
+
+		async_run_job(loop, node);
+	}
+
+	return !cds_wfcq_empty(&loop->async_lowpending.head,
+			       &loop->async_lowpending.tail);
+}
+
+void
+isc__async_cb(uv_async_t *handle) {
+	isc_loop_t *loop = uv_handle_get_data(handle);
+
+	REQUIRE(VALID_LOOP(loop));
+
+	async_run_all(loop);
+
+	/*
+	 * The normal jobs scheduled in the meantime have already triggered
+	 * another run, they go first.
+	 */
+	if (!cds_wfcq_empty(&loop->async_jobs.head, &loop->async_jobs.tail)) {
+		return;
+	}
+
+	/*
+	 * Low priority jobs get a fixed budget per loop iteration; if some
+	 * are left over, trigger ourselves again, so the queued network I/O
+	 * gets processed before we come back to them.
+	 */
+	if (async_run_low(loop, ASYNC_LOW_BUDGET)) {
+		int r = uv_async_send(&loop->async_trigger);
+		UV_RUNTIME_CHECK(uv_async_send, r);
 	}
 }
 
@@ -117,5 +195,15 @@ void
 isc__async_close(uv_handle_t *handle) {
 	isc_loop_t *loop = uv_handle_get_data(handle);
 
-	isc__async_cb(&loop->async_trigger);
+	/*
+	 * This is the last chance to run the jobs, so ignore the budget and
+	 * keep going until both queues are empty.
+	 */
+	do {
+		async_run_all(loop);
+		(void)async_run_low(loop, SIZE_MAX);
+	} while (!cds_wfcq_empty(&loop->async_jobs.head,
+				 &loop->async_jobs.tail) ||
+		 !cds_wfcq_empty(&loop->async_lowjobs.head,
+				 &loop->async_lowjobs.tail));
 }
@@ -0,0 +1,597 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif /* HAVE_LINUX_IO_URING_H */
+
+#include <isc/atomic.h>
+#include <isc/fileio.h>
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/util.h>
+
+#include "errno2result.h"
+
+#define FILEIO_MAGIC	ISC_MAGIC('F', 'i', 'l', 'I')
+#define VALID_FILEIO(f) ISC_MAGIC_VALID(f, FILEIO_MAGIC)
+
+#define MINOPS 8
+
+typedef enum { op_write, op_sync } optype_t;
+
+typedef struct op {
+	optype_t type;
+	struct iovec iov;
+	size_t size; /* Allocated for iov.iov_base */
+	off_t offset;
+} op_t;
+
+struct isc_fileio {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	int fd;
+	bool regular;
+	op_t *ops;
+	size_t nops;
+	size_t maxops;
+};
+
+static void
+ops_clear(isc_fileio_t *fio) {
+	for (size_t i = 0; i < fio->nops; i++) {
+		op_t *op = &fio->ops[i];
+		if (op->type == op_write) {
+			isc_mem_put(fio->mctx, op->iov.iov_base, op->size);
+		}
+	}
+	fio->nops = 0;
+}
+
+static op_t *
+op_new(isc_fileio_t *fio, optype_t type) {
+	if (fio->nops == fio->maxops) {
+		size_t maxops = ISC_MAX(MINOPS, fio->maxops * 2);
+		fio->ops = isc_mem_creget(fio->mctx, fio->ops, fio->maxops,
+					  maxops, sizeof(fio->ops[0]));
+		fio->maxops = maxops;
+	}
+
+	op_t *op = &fio->ops[fio->nops++];
+	*op = (op_t){ .type = type };
+
+	return op;
+}
+
+static isc_result_t
+datasync(int fd) {
+	int ret;
+
+#ifdef HAVE_FDATASYNC
+	ret = fdatasync(fd);
+#else
+	ret = fsync(fd);
+#endif /* HAVE_FDATASYNC */
+	if (ret != 0) {
+		return isc__errno2result(errno);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+/*
+ * Perform the batch one operation at a time.  This is also how errors
+ * from the io_uring path are reported: the batch is simply redone, which
+ * is harmless since the writes are positional, and the first failing
+ * call tells us what went wrong.
+ */
+static isc_result_t
+submit_sync(isc_fileio_t *fio) {
+	isc_result_t result;
+
+	for (size_t i = 0; i < fio->nops; i++) {
+		op_t *op = &fio->ops[i];
+		const char *base = op->iov.iov_base;
+		size_t done = 0;
+
+		if (op->type == op_sync) {
+			result = datasync(fio->fd);
+			if (result != ISC_R_SUCCESS) {
+				return result;
+			}
+			continue;
+		}
+
+		while (done < op->iov.iov_len) {
+			ssize_t n = pwrite(fio->fd, base + done,
+					   op->iov.iov_len - done,
+					   op->offset + done);
+			if (n < 0 && errno == EINTR) {
+				continue;
+			}
+			if (n < 0) {
+				return isc__errno2result(errno);
+			}
+			if (n == 0) {
+				return ISC_R_UNEXPECTED;
+			}
+			done += n;
+		}
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#define RING_ENTRIES 64
+
+typedef struct ring ring_t;
+struct ring {
+	int fd;
+	unsigned int entries;
+	void *sqmap;
+	size_t sqmapsize;
+	void *cqmap;
+	size_t cqmapsize;
+	struct io_uring_sqe *sqes;
+	size_t sqessize;
+	uint32_t *sqhead;
+	uint32_t *sqtail;
+	uint32_t *sqmask;
+	uint32_t *sqarray;
+	uint32_t *cqhead;
+	uint32_t *cqtail;
+	uint32_t *cqmask;
+	struct io_uring_cqe *cqes;
+	ISC_LINK(ring_t) link;
+};
+
+/*
+ * Rings are expensive to set up, so idle ones are kept for reuse; there
+ * are never more of them than there have been concurrent submissions.
+ */
+static isc_mutex_t ringlock;
+static ISC_LIST(ring_t) rings = ISC_LIST_INITIALIZER;
+static atomic_bool ring_unavailable = false;
+
+/*
+ * Stop using io_uring if 'err' says the kernel does not support it or
+ * does not let us use it.  Anything else, such as running out of memory
+ * or descriptors, may go away, so the next batch tries again.
+ */
+static void
+ring_failed(int err) {
+	switch (err) {
+	case ENOSYS:
+	case EPERM:
+	case EACCES:
+	case EINVAL:
+	case EOPNOTSUPP:
+		atomic_store_relaxed(&ring_unavailable, true);
+		break;
+	default:
+		break;
+	}
+}
+
+static void
+ring_destroy(ring_t *ring) {
+	if (ring->sqes != NULL) {
+		(void)munmap(ring->sqes, ring->sqessize);
+	}
+	if (ring->cqmap != NULL && ring->cqmap != ring->sqmap) {
+		(void)munmap(ring->cqmap, ring->cqmapsize);
+	}
+	if (ring->sqmap != NULL) {
+		(void)munmap(ring->sqmap, ring->sqmapsize);
+	}
+	(void)close(ring->fd);
+	isc_mem_put(isc_g_mctx, ring, sizeof(*ring));
+}
+
+static void *
+ring_mmap(int fd, size_t size, off_t offset) {
+	void *map = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, fd, offset);
+	return (map == MAP_FAILED) ? NULL : map;
+}
+
+static ring_t *
+ring_new(void) {
+	struct io_uring_params params = { 0 };
+	ring_t *ring = NULL;
+	int fd;
+
+	fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+	if (fd < 0) {
+		/* Not supported, forbidden by seccomp, or out of resources */
+		ring_failed(errno);
+		return NULL;
+	}
+
+	ring = isc_mem_get(isc_g_mctx, sizeof(*ring));
+	*ring = (ring_t){
+		.fd = fd,
+		.entries = params.sq_entries,
+		.link = ISC_LINK_INITIALIZER,
+	};
+
+	ring->sqmapsize = params.sq_off.array +
+			  params.sq_entries * sizeof(uint32_t);
+	ring->cqmapsize = params.cq_off.cqes +
+			  params.cq_entries * sizeof(struct io_uring_cqe);
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+		ring->sqmapsize = ISC_MAX(ring->sqmapsize, ring->cqmapsize);
+		ring->cqmapsize = ring->sqmapsize;
+	}
+
+	ring->sqmap = ring_mmap(fd, ring->sqmapsize, IORING_OFF_SQ_RING);
+	if (ring->sqmap == NULL) {
+		goto fail;
+	}
+	if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+		ring->cqmap = ring->sqmap;
+	} else {
+		ring->cqmap = ring_mmap(fd, ring->cqmapsize,
+					IORING_OFF_CQ_RING);
+		if (ring->cqmap == NULL) {
+			goto fail;
+		}
+	}
+	ring->sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = ring_mmap(fd, ring->sqessize, IORING_OFF_SQES);
+	if (ring->sqes == NULL) {
+		goto fail;
+	}
+
+	ring->sqhead = (uint32_t *)((char *)ring->sqmap + params.sq_off.head);
+	ring->sqtail = (uint32_t *)((char *)ring->sqmap + params.sq_off.tail);
+	ring->sqmask = (uint32_t *)((char *)ring->sqmap +
+				    params.sq_off.ring_mask);
+	ring->sqarray = (uint32_t *)((char *)ring->sqmap +
+				     params.sq_off.array);
+	ring->cqhead = (uint32_t *)((char *)ring->cqmap + params.cq_off.head);
+	ring->cqtail = (uint32_t *)((char *)ring->cqmap + params.cq_off.tail);
+	ring->cqmask = (uint32_t *)((char *)ring->cqmap +
+				    params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)((char *)ring->cqmap +
+					     params.cq_off.cqes);
+
+	return ring;
+
+fail:
+	ring_failed(errno);
+	ring_destroy(ring);
+	return NULL;
+}
+
+static ring_t *
+ring_get(void) {
+	ring_t *ring = NULL;
+
+	if (atomic_load_relaxed(&ring_unavailable)) {
+		return NULL;
+	}
+
+	LOCK(&ringlock);
+	ring = ISC_LIST_HEAD(rings);
+	if (ring != NULL) {
+		ISC_LIST_UNLINK(rings, ring, link);
+	}
+	UNLOCK(&ringlock);
+
+	if (ring == NULL) {
+		ring = ring_new();
+	}
+
+	return ring;
+}
+
+static void
+ring_put(ring_t *ring) {
+	LOCK(&ringlock);
+	ISC_LIST_PREPEND(rings, ring, link);
+	UNLOCK(&ringlock);
+}
+
+static void
+ring_prep(ring_t *ring, uint32_t tail, isc_fileio_t *fio, size_t i,
+	  bool link) {
+	op_t *op = &fio->ops[i];
+	uint32_t index = tail & *ring->sqmask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+
+	*sqe = (struct io_uring_sqe){
+		.fd = fio->fd,
+		.user_data = i,
+		.flags = link ? IOSQE_IO_LINK : 0,
+	};
+
+	switch (op->type) {
+	case op_write:
+		sqe->opcode = IORING_OP_WRITEV;
+		sqe->addr = (uintptr_t)&op->iov;
+		sqe->len = 1;
+		sqe->off = op->offset;
+		break;
+	case op_sync:
+		sqe->opcode = IORING_OP_FSYNC;
+		sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	ring->sqarray[index] = index;
+}
+
+static int
+ring_enter(ring_t *ring, unsigned int submit, unsigned int wait) {
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter, ring->fd, submit, wait,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret;
+}
+
+/*
+ * Wait for 'count' requests submitted to the ring to complete.  Returns
+ * false if any of them did not do all it was asked to.
+ */
+static bool
+ring_reap(ring_t *ring, isc_fileio_t *fio, size_t count) {
+	size_t completed = 0;
+	bool ok = true;
+
+	while (completed < count) {
+		uint32_t head = *ring->cqhead;
+		uint32_t cqtail = __atomic_load_n(ring->cqtail,
+						  __ATOMIC_ACQUIRE);
+
+		if (head == cqtail) {
+			/*
+			 * The requests may still be using the buffers of
+			 * the batch, so there is no giving up here.
+			 */
+			if (ring_enter(ring, 0, count - completed) < 0) {
+				if (errno != EAGAIN && errno != EBUSY) {
+					FATAL_SYSERROR(errno,
+						       "io_uring_enter()");
+				}
+				(void)sched_yield();
+			}
+			continue;
+		}
+
+		for (; head != cqtail; head++) {
+			struct io_uring_cqe *cqe =
+				&ring->cqes[head & *ring->cqmask];
+			op_t *op = &fio->ops[cqe->user_data];
+			int64_t expected = (op->type == op_write)
+						   ? op->iov.iov_len
+						   : 0;
+
+			if (cqe->res != expected) {
+				ok = false;
+			}
+			completed++;
+		}
+		__atomic_store_n(ring->cqhead, head, __ATOMIC_RELEASE);
+	}
+
+	return ok;
+}
+
+/*
+ * Submit the batch in chains of linked requests, as many as fit in the
+ * ring at once.  Each chain is waited for before the next one is queued,
+ * so the order of the batch is preserved across chains too.
+ *
+ * Returns false if anything at all went wrong, including short writes;
+ * the caller then falls back to submit_sync().  Either way, every request
+ * the kernel has taken has completed by then.  If the kernel did not take
+ * the whole chain, the ring is thrown away, as the rest of the chain is
+ * still queued in it.
+ */
+static bool
+ring_submit(ring_t *ring, isc_fileio_t *fio) {
+	bool ok = true;
+
+	for (size_t first = 0; ok && first < fio->nops;) {
+		size_t n = ISC_MIN(fio->nops - first, ring->entries);
+		uint32_t tail = *ring->sqtail;
+		size_t submitted;
+		int err = 0;
+
+		for (size_t i = 0; i < n; i++) {
+			ring_prep(ring, tail++, fio, first + i, i + 1 < n);
+		}
+		__atomic_store_n(ring->sqtail, tail, __ATOMIC_RELEASE);
+
+		if (ring_enter(ring, n, n) < 0) {
+			err = errno;
+		}
+
+		/*
+		 * The requests the kernel has taken off the submission
+		 * queue complete even if io_uring_enter() failed.
+		 */
+		submitted = n - (tail - __atomic_load_n(ring->sqhead,
+							__ATOMIC_ACQUIRE));
+		ok = ring_reap(ring, fio, submitted);
+
+		if (submitted < n) {
+			ring_failed(err);
+			ring_destroy(ring);
+			return false;
+		}
+		first += n;
+	}
+
+	ring_put(ring);
+
+	return ok;
+}
+
+#endif /* HAVE_LINUX_IO_URING_H */
+
+void
+isc_fileio_create(isc_mem_t *mctx, int fd, isc_fileio_t **fiop) {
+	struct stat st;
+
+	REQUIRE(fd >= 0);
+	REQUIRE(fiop != NULL && *fiop == NULL);
+
+	isc_fileio_t *fio = isc_mem_get(mctx, sizeof(*fio));
+	*fio = (isc_fileio_t){
+		.magic = FILEIO_MAGIC,
+		.fd = fd,
+		.regular = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)),
+	};
+	isc_mem_attach(mctx, &fio->mctx);
+
+	*fiop = fio;
+}
+
+void
+isc_fileio_destroy(isc_fileio_t **fiop) {
+	REQUIRE(fiop != NULL && VALID_FILEIO(*fiop));
+
+	isc_fileio_t *fio = *fiop;
+	*fiop = NULL;
+
+	ops_clear(fio);
+	if (fio->ops != NULL) {
+		isc_mem_cput(fio->mctx, fio->ops, fio->maxops,
+			     sizeof(fio->ops[0]));
+	}
+	fio->magic = 0;
+	isc_mem_putanddetach(&fio->mctx, fio, sizeof(*fio));
+}
+
+void
+isc_fileio_write(isc_fileio_t *fio, const void *buf, size_t length,
+		 off_t offset) {
+	REQUIRE(VALID_FILEIO(fio));
+	REQUIRE(buf != NULL || length == 0);
+	REQUIRE(offset >= 0);
+
+	if (length == 0) {
+		return;
+	}
+
+	/*
+	 * Extend the previous write if this one carries on from it, so
+	 * that sequential output becomes one large write.
+	 */
+	if (fio->nops > 0) {
+		op_t *op = &fio->ops[fio->nops - 1];
+		if (op->type == op_write &&
+		    op->offset + (off_t)op->iov.iov_len == offset)
+		{
+			size_t used = op->iov.iov_len;
+			if (op->size - used < length) {
+				size_t size = ISC_MAX(op->size * 2,
+						      used + length);
+				op->iov.iov_base = isc_mem_reget(
+					fio->mctx, op->iov.iov_base, op->size,
+					size);
+				op->size = size;
+			}
+			memmove((char *)op->iov.iov_base + used, buf, length);
+			op->iov.iov_len += length;
+			return;
+		}
+	}
+
+	op_t *op = op_new(fio, op_write);
+	op->iov.iov_base = isc_mem_get(fio->mctx, length);
+	op->iov.iov_len = length;
+	op->size = length;
+	op->offset = offset;
+	memmove(op->iov.iov_base, buf, length);
+}
+
+void
+isc_fileio_sync(isc_fileio_t *fio) {
+	REQUIRE(VALID_FILEIO(fio));
+
+	if (!fio->regular) {
+		return;
+	}
+
+	(void)op_new(fio, op_sync);
+}
+
+isc_result_t
+isc_fileio_submit(isc_fileio_t *fio) {
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_FILEIO(fio));
+
+	if (fio->nops == 0) {
+		return ISC_R_SUCCESS;
+	}
+
+#ifdef HAVE_LINUX_IO_URING_H
+	ring_t *ring = ring_get();
+	if (ring != NULL && ring_submit(ring, fio)) {
+		goto done;
+	}
+#endif /* HAVE_LINUX_IO_URING_H */
+
+	result = submit_sync(fio);
+
+#ifdef HAVE_LINUX_IO_URING_H
+done:
+#endif /* HAVE_LINUX_IO_URING_H */
+	ops_clear(fio);
+	return result;
+}
+
+void
+isc__fileio_initialize(void) {
+#ifdef HAVE_LINUX_IO_URING_H
+	isc_mutex_init(&ringlock);
+#endif /* HAVE_LINUX_IO_URING_H */
+}
+
+void
+isc__fileio_shutdown(void) {
+#ifdef HAVE_LINUX_IO_URING_H
+	ISC_LIST_FOREACH(rings, ring, link) {
+		ISC_LIST_UNLINK(rings, ring, link);
+		ring_destroy(ring);
+	}
+	isc_mutex_destroy(&ringlock);
+#endif /* HAVE_LINUX_IO_URING_H */
+}
@@ -0,0 +1,354 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/mman.h>
+
+#include <isc/atomic.h>
+#include <isc/hash.h>
+#include <isc/hugepage.h>
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/swisstable.h>
+#include <isc/util.h>
+
+#define ARENA_MAGIC    ISC_MAGIC('H', 'g', 'P', 'a')
+#define VALID_ARENA(a) ISC_MAGIC_VALID(a, ARENA_MAGIC)
+
+#define REGION_SIZE ISC_HUGEPAGE_REGION_SIZE
+#define REGION_MASK ((uintptr_t)REGION_SIZE - 1)
+
+/*
+ * The explicit huge pages must be REGION_SIZE, whatever the system's
+ * default huge page size is.
+ */
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif /* ifndef MAP_HUGE_2MB */
+#define MAP_HUGE_REGION (MAP_HUGETLB | MAP_HUGE_2MB)
+STATIC_ASSERT(REGION_SIZE == 1U << 21,
+	      "MAP_HUGE_2MB must match the hugepage region size");
+#endif /* if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT) */
+
+typedef struct region region_t;
+struct region {
+	uint8_t *base;
+	bool explicit;
+	size_t nfree;
+	size_t nfresh; /* blocks at the end that have never been used */
+	void *freelist;
+	ISC_LINK(region_t) link;
+};
+
+struct isc_hugepage_arena {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_mutex_t lock;
+	size_t blocksize;
+	size_t nblocks;
+	size_t blocks;
+	size_t nexplicit;
+	isc_swisstable_t *regions;
+	/* regions with free blocks */
+	ISC_LIST(region_t) partial;
+	/* a completely free region kept for reuse */
+	region_t *spare;
+};
+
+static atomic_int hugepage_mode = isc_hugepage_none;
+
+void
+isc_hugepage_setmode(isc_hugepage_mode_t mode) {
+	atomic_store_relaxed(&hugepage_mode, mode);
+}
+
+isc_hugepage_mode_t
+isc_hugepage_getmode(void) {
+	return atomic_load_relaxed(&hugepage_mode);
+}
+
+static uint32_t
+region_hash(const uint8_t *base) {
+	uintptr_t key = (uintptr_t)base;
+	return isc_hash32(&key, sizeof(key), true);
+}
+
+static bool
+region_match(void *node, const void *key) {
+	const region_t *region = node;
+	return region->base == key;
+}
+
+/*
+ * Map REGION_SIZE bytes aligned to REGION_SIZE, trying explicit huge pages
+ * first if we've been asked to.
+ */
+static uint8_t *
+region_map(isc_hugepage_mode_t mode, bool *explicitp) {
+	uint8_t *raw = NULL, *base = NULL;
+	size_t head, tail;
+
+	*explicitp = false;
+
+#ifdef MAP_HUGE_REGION
+	if (mode == isc_hugepage_explicit) {
+		raw = mmap(NULL, REGION_SIZE, PROT_READ | PROT_WRITE,
+			   MAP_ANON | MAP_PRIVATE | MAP_HUGE_REGION, -1, 0);
+		if (raw != MAP_FAILED) {
+			INSIST(((uintptr_t)raw & REGION_MASK) == 0);
+			*explicitp = true;
+			return raw;
+		}
+	}
+#else
+	UNUSED(mode);
+#endif /* ifdef MAP_HUGE_REGION */
+
+	/*
+	 * Over-allocate so that an aligned region fits, then trim.
+	 */
+	raw = mmap(NULL, 2 * REGION_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_ANON | MAP_PRIVATE, -1, 0);
+	if (raw == MAP_FAILED) {
+		return NULL;
+	}
+
+	base = (uint8_t *)(((uintptr_t)raw + REGION_MASK) & ~REGION_MASK);
+	head = base - raw;
+	tail = REGION_SIZE - head;
+	if (head > 0) {
+		RUNTIME_CHECK(munmap(raw, head) == 0);
+	}
+	if (tail > 0) {
+		RUNTIME_CHECK(munmap(base + REGION_SIZE, tail) == 0);
+	}
+
+#ifdef MADV_HUGEPAGE
+	/* Failure only means we get normal pages. */
+	(void)madvise(base, REGION_SIZE, MADV_HUGEPAGE);
+#endif /* ifdef MADV_HUGEPAGE */
+
+	return base;
+}
+
+static region_t *
+region_new(isc_hugepage_arena_t *arena, isc_hugepage_mode_t mode) {
+	region_t *region = NULL;
+	isc_result_t result;
+	bool explicit;
+	uint8_t *base = region_map(mode, &explicit);
+
+	if (base == NULL) {
+		return NULL;
+	}
+
+	region = isc_mem_get(arena->mctx, sizeof(*region));
+	*region = (region_t){
+		.base = base,
+		.explicit = explicit,
+		.nfree = arena->nblocks,
+		.nfresh = arena->nblocks,
+		.link = ISC_LINK_INITIALIZER,
+	};
+
+	result = isc_swisstable_add(arena->regions, region_hash(base),
+				    region_match, base, region, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+
+	if (explicit) {
+		arena->nexplicit++;
+	}
+
+	return region;
+}
+
+static void
+region_free(isc_hugepage_arena_t *arena, region_t *region) {
+	isc_result_t result;
+
+	INSIST(region->nfree == arena->nblocks);
+
+	result = isc_swisstable_delete(arena->regions,
+				       region_hash(region->base), region_match,
+				       region->base);
+	INSIST(result == ISC_R_SUCCESS);
+
+	if (region->explicit) {
+		arena->nexplicit--;
+	}
+
+	RUNTIME_CHECK(munmap(region->base, REGION_SIZE) == 0);
+	isc_mem_put(arena->mctx, region, sizeof(*region));
+}
+
+void
+isc_hugepage_arena_create(isc_mem_t *mctx, size_t blocksize,
+			  isc_hugepage_arena_t **arenap) {
+	isc_hugepage_arena_t *arena = NULL;
+
+	REQUIRE(arenap != NULL && *arenap == NULL);
+	REQUIRE(blocksize >= sizeof(void *) && blocksize <= REGION_SIZE);
+	REQUIRE(blocksize % sizeof(void *) == 0);
+
+	arena = isc_mem_get(mctx, sizeof(*arena));
+	*arena = (isc_hugepage_arena_t){
+		.magic = ARENA_MAGIC,
+		.blocksize = blocksize,
+		.nblocks = REGION_SIZE / blocksize,
+		.partial = ISC_LIST_INITIALIZER,
+	};
+	isc_mem_attach(mctx, &arena->mctx);
+	isc_mutex_init(&arena->lock);
+	isc_swisstable_create(mctx, 4, &arena->regions);
+
+	*arenap = arena;
+}
+
+void
+isc_hugepage_arena_destroy(isc_hugepage_arena_t **arenap) {
+	isc_hugepage_arena_t *arena = NULL;
+
+	REQUIRE(arenap != NULL && VALID_ARENA(*arenap));
+
+	arena = *arenap;
+	*arenap = NULL;
+
+	INSIST(arena->blocks == 0);
+
+	ISC_LIST_FOREACH(arena->partial, region, link) {
+		ISC_LIST_UNLINK(arena->partial, region, link);
+		region_free(arena, region);
+	}
+	if (arena->spare != NULL) {
+		region_free(arena, arena->spare);
+	}
+	INSIST(isc_swisstable_count(arena->regions) == 0);
+
+	isc_swisstable_destroy(&arena->regions);
+	isc_mutex_destroy(&arena->lock);
+	arena->magic = 0;
+	isc_mem_putanddetach(&arena->mctx, arena, sizeof(*arena));
+}
+
+void *
+isc_hugepage_get(isc_hugepage_arena_t *arena, isc_mem_t *mctx) {
+	isc_hugepage_mode_t mode = isc_hugepage_getmode();
+	region_t *region = NULL;
+	void *ptr = NULL;
+
+	REQUIRE(VALID_ARENA(arena));
+
+	if (mode == isc_hugepage_none) {
+		return NULL;
+	}
+
+	LOCK(&arena->lock);
+
+	region = ISC_LIST_HEAD(arena->partial);
+	if (region == NULL) {
+		region = arena->spare;
+		arena->spare = NULL;
+		if (region == NULL) {
+			region = region_new(arena, mode);
+		}
+		if (region == NULL) {
+			UNLOCK(&arena->lock);
+			return NULL;
+		}
+		ISC_LIST_APPEND(arena->partial, region, link);
+	}
+
+	/*
+	 * Prefer recycled blocks; hand out the untouched tail of the region
+	 * in address order so the kernel only backs what is used.
+	 */
+	if (region->freelist != NULL) {
+		ptr = region->freelist;
+		region->freelist = *(void **)ptr;
+	} else {
+		INSIST(region->nfresh > 0);
+		ptr = region->base +
+		      (arena->nblocks - region->nfresh) * arena->blocksize;
+		region->nfresh--;
+	}
+
+	region->nfree--;
+	if (region->nfree == 0) {
+		ISC_LIST_UNLINK(arena->partial, region, link);
+	}
+	arena->blocks++;
+
+	UNLOCK(&arena->lock);
+
+	isc_mem_charge(mctx, arena->blocksize);
+
+	return ptr;
+}
+
+void
+isc_hugepage_put(isc_hugepage_arena_t *arena, isc_mem_t *mctx, void *ptr) {
+	uint8_t *base = (uint8_t *)((uintptr_t)ptr & ~REGION_MASK);
+	region_t *region = NULL;
+	isc_result_t result;
+
+	REQUIRE(VALID_ARENA(arena));
+	REQUIRE(ptr != NULL);
+
+	isc_mem_uncharge(mctx, arena->blocksize);
+
+	LOCK(&arena->lock);
+
+	result = isc_swisstable_find(arena->regions, region_hash(base),
+				     region_match, base, (void **)&region);
+	INSIST(result == ISC_R_SUCCESS);
+
+	if (region->nfree == 0) {
+		ISC_LIST_PREPEND(arena->partial, region, link);
+	}
+
+	*(void **)ptr = region->freelist;
+	region->freelist = ptr;
+	region->nfree++;
+	arena->blocks--;
+
+	if (region->nfree == arena->nblocks) {
+		ISC_LIST_UNLINK(arena->partial, region, link);
+		if (arena->spare != NULL) {
+			region_free(arena, arena->spare);
+		}
+		arena->spare = region;
+	}
+
+	UNLOCK(&arena->lock);
+}
+
+void
+isc_hugepage_stats(isc_hugepage_arena_t *arena, isc_hugepage_stats_t *stats) {
+	REQUIRE(VALID_ARENA(arena));
+	REQUIRE(stats != NULL);
+
+	LOCK(&arena->lock);
+	*stats = (isc_hugepage_stats_t){
+		.regions = isc_swisstable_count(arena->regions),
+		.explicit = arena->nexplicit,
+		.blocks = arena->blocks,
+	};
+	UNLOCK(&arena->lock);
+}
@@ -42,6 +42,26 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
  *\li	'cbarg' is passed to the 'cb' as the only argument, may be NULL
  */
 
+void
+isc_async_run_low(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
+/*%<
+ * Schedule the job callback 'cb' to be run on the 'loop' event loop with
+ * low priority.  Low priority jobs are run after all the normal jobs, and
+ * only a limited number of them is run in each loop iteration, so the
+ * loop keeps processing network I/O when many of them are queued.  Use
+ * this for maintenance work that doesn't need to run immediately.
+ *
+ * Low priority jobs are run in the order they were scheduled, but there
+ * is no ordering guarantee relative to the jobs scheduled with
+ * isc_async_run().
+ *
+ * Requires:
+ *
+ *\li	'loop' is a valid isc event loop
+ *\li	'cb' is a callback function, must be non-NULL
+ *\li	'cbarg' is passed to the 'cb' as the only argument, may be NULL
+ */
+
 #define isc_async_current(cb, cbarg) isc_async_run(isc_loop(), cb, cbarg)
 /*%<
  * Helper macro to run the job on the current loop
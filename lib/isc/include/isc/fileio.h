@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/fileio.h
+ * \brief Batched positional writes and syncs on a file descriptor.
+ *
+ * An `isc_fileio_t` collects a sequence of writes at given offsets and
+ * data syncs, and performs them in order when isc_fileio_submit() is
+ * called.  Where io_uring is available the whole batch is handed to the
+ * kernel as one chain of linked requests, so a commit that writes a few
+ * regions and syncs them costs a single system call instead of one per
+ * operation; elsewhere, or if the kernel refuses the ring, the batch is
+ * performed with pwrite() and fdatasync().  A write that carries on from
+ * where the previous one ended is merged into it.
+ *
+ * isc_fileio_submit() blocks the calling thread until the whole batch
+ * has completed.  The batching saves system calls; it does not take the
+ * I/O off the calling thread.
+ *
+ * A sync is a barrier: it completes after the writes queued before it and
+ * before the writes queued after it are started.  Syncs on descriptors
+ * that are not regular files are skipped, like isc_stdio_sync() does.
+ */
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <isc/result.h>
+#include <isc/types.h>
+
+typedef struct isc_fileio isc_fileio_t;
+
+void
+isc_fileio_create(isc_mem_t *mctx, int fd, isc_fileio_t **fiop);
+/*%<
+ * Create an empty batch of operations on `fd`.
+ *
+ * Requires:
+ *\li	`mctx` is a valid memory context
+ *\li	`fd` is an open file descriptor
+ *\li	`fiop != NULL && *fiop == NULL`
+ */
+
+void
+isc_fileio_destroy(isc_fileio_t **fiop);
+/*%<
+ * Destroy a batch, discarding any operations that were not submitted.
+ *
+ * Requires:
+ *\li	`*fiop` is a pointer to a valid batch
+ *
+ * Ensures:
+ *\li	`*fiop == NULL`
+ */
+
+void
+isc_fileio_write(isc_fileio_t *fio, const void *buf, size_t length,
+		 off_t offset);
+/*%<
+ * Queue a write of `length` bytes from `buf` at `offset`.  The data is
+ * copied, so `buf` can be reused as soon as this returns.
+ *
+ * Requires:
+ *\li	`fio` is a pointer to a valid batch
+ *\li	`buf != NULL || length == 0`
+ *\li	`offset >= 0`
+ */
+
+void
+isc_fileio_sync(isc_fileio_t *fio);
+/*%<
+ * Queue a sync of the data written so far.
+ *
+ * Requires:
+ *\li	`fio` is a pointer to a valid batch
+ */
+
+isc_result_t
+isc_fileio_submit(isc_fileio_t *fio);
+/*%<
+ * Perform the queued operations in order and wait for them to complete.
+ * The batch is empty afterwards and can be reused.
+ *
+ * Requires:
+ *\li	`fio` is a pointer to a valid batch
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	the result of the first failed write or sync; writes after it may
+ *	or may not have been done
+ */
+
+void
+isc__fileio_initialize(void);
+
+void
+isc__fileio_shutdown(void);
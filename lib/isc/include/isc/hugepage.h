@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/hugepage.h
+ * \brief Hugepage-backed arenas of fixed-size blocks.
+ *
+ * An arena hands out blocks of one size, carved from 2MB regions that are
+ * mapped with explicit 2MB huge pages (MAP_HUGETLB) or aligned to 2MB and
+ * marked for transparent huge pages (MADV_HUGEPAGE), depending on the
+ * process-wide mode set with isc_hugepage_setmode().  Large, long-lived
+ * and hot data structures (such as qp-trie chunks) allocated this way need
+ * far fewer TLB entries than when they are spread over 4KB pages.
+ *
+ * When the mode is isc_hugepage_none, or the kernel can't provide the
+ * memory, isc_hugepage_get() returns NULL and the caller is expected to
+ * fall back to its memory context.  When explicit huge pages are not
+ * available, the arena falls back to transparent huge pages, and those
+ * fall back to normal pages at the kernel's discretion.
+ *
+ * The blocks handed out are charged to the caller's memory context (see
+ * isc_mem_charge()), so they count towards isc_mem_inuse() and the memory
+ * context water marks.  A region is unmapped when all of its blocks have
+ * been returned, except for one spare region kept to avoid churn.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <isc/types.h>
+
+/*%
+ * Size and alignment of the regions blocks are carved from.
+ */
+#define ISC_HUGEPAGE_REGION_SIZE (2U * 1024 * 1024)
+
+typedef enum {
+	isc_hugepage_none = 0,	  /*%< don't use huge pages */
+	isc_hugepage_transparent, /*%< madvise(MADV_HUGEPAGE) */
+	isc_hugepage_explicit,	  /*%< mmap(MAP_HUGETLB), or transparent */
+} isc_hugepage_mode_t;
+
+typedef struct isc_hugepage_arena isc_hugepage_arena_t;
+
+typedef struct isc_hugepage_stats {
+	size_t regions;	 /*%< regions currently mapped */
+	size_t explicit; /*%< ... of which with MAP_HUGETLB */
+	size_t blocks;	 /*%< blocks handed out */
+} isc_hugepage_stats_t;
+
+void
+isc_hugepage_setmode(isc_hugepage_mode_t mode);
+/*%<
+ * Set the process-wide huge page mode.  Only newly mapped regions are
+ * affected; blocks already handed out stay where they are.  The default
+ * is isc_hugepage_none.
+ */
+
+isc_hugepage_mode_t
+isc_hugepage_getmode(void);
+/*%<
+ * Return the process-wide huge page mode.
+ */
+
+void
+isc_hugepage_arena_create(isc_mem_t *mctx, size_t blocksize,
+			  isc_hugepage_arena_t **arenap);
+/*%<
+ * Create an arena of 'blocksize' byte blocks; the arena bookkeeping is
+ * allocated from 'mctx'.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'blocksize' is a multiple of the pointer size and no larger than
+ *	#ISC_HUGEPAGE_REGION_SIZE.
+ *\li	'arenap' is not NULL and '*arenap' is NULL.
+ */
+
+void
+isc_hugepage_arena_destroy(isc_hugepage_arena_t **arenap);
+/*%<
+ * Unmap all regions and free the arena.
+ *
+ * Requires:
+ *\li	'*arenap' is a valid arena with no blocks handed out.
+ */
+
+void *
+isc_hugepage_get(isc_hugepage_arena_t *arena, isc_mem_t *mctx);
+/*%<
+ * Get a block from the arena and charge it to 'mctx'.  The block is not
+ * zeroed.
+ *
+ * Returns NULL if huge pages are disabled or no memory could be mapped.
+ *
+ * Requires:
+ *\li	'arena' is a valid arena.
+ *\li	'mctx' is a valid memory context.
+ */
+
+void
+isc_hugepage_put(isc_hugepage_arena_t *arena, isc_mem_t *mctx, void *ptr);
+/*%<
+ * Return a block to the arena and uncharge it from 'mctx'.
+ *
+ * Requires:
+ *\li	'arena' is a valid arena.
+ *\li	'ptr' was returned by isc_hugepage_get() on 'arena', charged to
+ *	'mctx'.
+ */
+
+void
+isc_hugepage_stats(isc_hugepage_arena_t *arena, isc_hugepage_stats_t *stats);
+/*%<
+ * Fill in '*stats' with a snapshot of the arena usage.
+ *
+ * Requires:
+ *\li	'arena' is a valid arena.
+ *\li	'stats' is not NULL.
+ */
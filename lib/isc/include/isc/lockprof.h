@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/lockprof.h
+ * \brief Lock contention profiler.
+ *
+ * When BIND is built with lock profiling (meson -Dlock-profiling=enabled),
+ * every LOCK(), RWLOCK() and derived macro call site gets its own static
+ * isc_lockprof_site_t.  While profiling is active, an acquisition first
+ * tries to take the lock without blocking; only when that fails is the
+ * wait timed, so an uncontended acquisition costs a trylock and a relaxed
+ * atomic increment.  Sites register themselves on first use.
+ *
+ * Without lock profiling the macros expand to the plain lock calls and
+ * the functions below report that profiling is not supported.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/types.h>
+
+/*%
+ * Wait times are recorded in power-of-two nanosecond buckets; the last
+ * bucket collects everything above ~1 second.
+ */
+#define ISC_LOCKPROF_BUCKETS 32
+
+typedef enum {
+	isc_lockprof_mutex = 0,
+	isc_lockprof_rdlock,
+	isc_lockprof_wrlock,
+} isc_lockprof_kind_t;
+
+typedef struct isc_lockprof_site isc_lockprof_site_t;
+struct isc_lockprof_site {
+	const char	    *file;
+	unsigned int	     line;
+	isc_lockprof_kind_t  kind;
+	atomic_bool	     registered;
+	isc_lockprof_site_t *next;
+	atomic_uint_fast64_t acquired;
+	atomic_uint_fast64_t contended;
+	atomic_uint_fast64_t waitns;
+	atomic_uint_fast64_t maxwaitns;
+	atomic_uint_fast64_t wait[ISC_LOCKPROF_BUCKETS];
+};
+
+typedef struct isc_lockprof_stats {
+	const char	   *file;
+	unsigned int	    line;
+	isc_lockprof_kind_t kind;
+	uint64_t	    acquired;
+	uint64_t	    contended;
+	uint64_t	    waitns;
+	uint64_t	    maxwaitns;
+	uint64_t	    wait[ISC_LOCKPROF_BUCKETS];
+} isc_lockprof_stats_t;
+
+typedef isc_result_t (*isc_lockprof_cb_t)(const isc_lockprof_stats_t *stats,
+					  void			   *arg);
+
+bool
+isc_lockprof_supported(void);
+/*%<
+ * Return true if the library was built with lock profiling.
+ */
+
+void
+isc_lockprof_setactive(bool active);
+/*%<
+ * Start or stop collecting lock statistics.  Collection is active by
+ * default in builds with lock profiling.
+ */
+
+bool
+isc_lockprof_active(void);
+/*%<
+ * Return true if lock statistics are being collected.
+ */
+
+void
+isc_lockprof_reset(void);
+/*%<
+ * Zero the counters of all registered lock sites.
+ */
+
+isc_result_t
+isc_lockprof_walk(isc_lockprof_cb_t cb, void *arg);
+/*%<
+ * Call 'cb' with a snapshot of every registered lock site that has been
+ * acquired at least once, stopping at the first result other than
+ * ISC_R_SUCCESS, which is returned.
+ *
+ * Requires:
+ *\li	'cb' is not NULL.
+ */
+
+const char *
+isc_lockprof_kindtext(isc_lockprof_kind_t kind);
+/*%<
+ * Return "mutex", "read" or "write".
+ */
+
+#ifdef HAVE_LIBXML2
+int
+isc_lockprof_renderxml(void *writer0);
+/*%<
+ * Render the lock statistics in XML for writer.
+ */
+#endif /* HAVE_LIBXML2 */
+
+#ifdef HAVE_JSON_C
+isc_result_t
+isc_lockprof_renderjson(void *lockobj0);
+/*%<
+ * Render the lock statistics in JSON.
+ */
+#endif /* HAVE_JSON_C */
+
+/* private */
+
+#if ISC_LOCK_PROFILE
+
+extern atomic_bool isc__lockprof_active;
+
+#define ISC__LOCKPROF_SITE(name, k)                    \
+	static isc_lockprof_site_t name = { .file = __FILE__, \
+					    .line = __LINE__, \
+					    .kind = (k) }
+
+/*
+ * Take a lock with 'lockfn', trying 'trylockfn' first to find out whether
+ * the acquisition is contended.
+ */
+#define ISC__LOCKPROF_LOCK(site, lockfn, trylockfn)                         \
+	if (!atomic_load_relaxed(&isc__lockprof_active)) {                  \
+		lockfn;                                                     \
+	} else if ((trylockfn) == ISC_R_SUCCESS) {                          \
+		isc__lockprof_acquired(site, false, 0);                     \
+	} else {                                                            \
+		uint64_t _lockprof_start = isc__lockprof_now();             \
+		lockfn;                                                     \
+		isc__lockprof_acquired(site, true,                          \
+				       isc__lockprof_now() - _lockprof_start); \
+	}
+
+uint64_t
+isc__lockprof_now(void);
+
+void
+isc__lockprof_acquired(isc_lockprof_site_t *site, bool contended,
+		       uint64_t waitns);
+
+#endif /* ISC_LOCK_PROFILE */
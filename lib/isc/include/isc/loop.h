@@ -204,3 +204,35 @@ isc_loop_shuttingdown(isc_loop_t *loop);
  *
  * \li 'loop' is a valid loop and the loop tid matches the current tid.
  */
+
+void
+isc_loopmgr_setstallthreshold(uint32_t threshold);
+/*%<
+ * Log a warning whenever a loop iteration, or a single callback run from
+ * the loop's job queues, takes 'threshold' milliseconds or longer.  The
+ * callback is identified by its symbol name where possible.  At most one
+ * warning per loop is logged every minute, the next one reports how many
+ * were suppressed.  A value of 0 disables the stall detection (the
+ * default) and with it the measuring of the callback run times.
+ */
+
+typedef struct isc_loopstats {
+	uint64_t stalls;	/*%< iterations over the stall threshold */
+	uint64_t iterations;	/*%< iterations measured */
+	uint64_t lag[3];	/*%< iteration time: median, 99th pct, max */
+	uint64_t callbacks;	/*%< callbacks measured (stall detection on) */
+	uint64_t runtime[3];	/*%< callback time: median, 99th pct, max */
+} isc_loopstats_t;
+
+void
+isc_loop_getstats(isc_loop_t *loop, isc_loopstats_t *stats);
+/*%<
+ * Fill 'stats' with the lag statistics collected by 'loop' since it
+ * was started.  The times are in microseconds; the time spent waiting
+ * for network events is not included in the iteration time.
+ *
+ * Requires:
+ *
+ * \li 'loop' is a valid loop.
+ * \li 'stats' is not NULL.
+ */
@@ -265,6 +265,18 @@ isc_mem_inuse(isc_mem_t *mctx);
  * allocated from the system but not yet used.
  */
 
+void
+isc_mem_charge(isc_mem_t *mctx, size_t size);
+void
+isc_mem_uncharge(isc_mem_t *mctx, size_t size);
+/*%<
+ * Account for 'size' bytes that belong to 'mctx' but were not allocated
+ * from it (e.g. blocks from a hugepage arena), so that they are included
+ * in isc_mem_inuse() and the water marks.  Each isc_mem_charge() must be
+ * balanced by an isc_mem_uncharge() of the same size before 'mctx' is
+ * destroyed.
+ */
+
 bool
 isc_mem_isovermem(isc_mem_t *mctx);
 /*%<
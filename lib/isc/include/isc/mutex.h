@@ -19,14 +19,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <isc/lockprof.h>
 #include <isc/result.h> /* for ISC_R_ codes */
 #include <isc/util.h>
 
+#if ISC_LOCK_PROFILE
+#define isc__mutex_lock_site(lp)                                         \
+	{                                                                \
+		ISC__LOCKPROF_SITE(_lockprof_site, isc_lockprof_mutex);  \
+		ISC__LOCKPROF_LOCK(&_lockprof_site, isc_mutex_lock(lp), \
+				   isc_mutex_trylock(lp));               \
+	}
+#else /* ISC_LOCK_PROFILE */
+#define isc__mutex_lock_site(lp) isc_mutex_lock(lp)
+#endif /* ISC_LOCK_PROFILE */
+
 #define LOCK(lp)                                                           \
 	{                                                                  \
 		ISC_UTIL_TRACE(fprintf(stderr, "LOCKING %p %s %d\n", (lp), \
 				       __FILE__, __LINE__));               \
-		isc_mutex_lock((lp));                                      \
+		isc__mutex_lock_site((lp));                                \
 		ISC_UTIL_TRACE(fprintf(stderr, "LOCKED %p %s %d\n", (lp),  \
 				       __FILE__, __LINE__));               \
 	}
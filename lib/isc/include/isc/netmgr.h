@@ -583,6 +583,64 @@ isc_nm_setloadbalancesockets(bool enabled);
  * \li	'mgr' is a valid netmgr.
  */
 
+bool
+isc_nm_getcpuaffinity(void);
+isc_result_t
+isc_nm_setcpuaffinity(bool enabled);
+/*%<
+ * Get and enable the CPU affinity of the network loops.  When enabled,
+ * every loop thread is pinned to its own CPU, and listening sockets
+ * created afterwards hand each UDP packet and TCP connection to the
+ * loop pinned to the CPU the kernel received it on, rather than to the
+ * loop chosen by the reuseport hash.  This only helps if the NIC spreads
+ * its receive queues over the same CPUs.  Once enabled, it can't be
+ * disabled.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED if the system doesn't support it, or socket
+ *	load balancing is disabled
+ * \li	#ISC_R_RANGE if there are more loops than CPUs the process may
+ *	run on
+ */
+
+typedef struct isc_nm_loopload {
+	uint64_t tcp_accepted;	  /*%< TCP connections accepted so far */
+	uint32_t tcp_active;	  /*%< TCP connections currently open */
+	uint64_t udp_received;	  /*%< UDP packets received by listeners */
+	uint32_t requests_active; /*%< requests still being processed */
+} isc_nm_loopload_t;
+
+void
+isc_nm_getloopload(isc_tid_t tid, isc_nm_loopload_t *load);
+/*%<
+ * Fill in 'load' with the incoming connection and packet counters of
+ * the network worker running on loop 'tid'.  Connections stay on the
+ * loop that accepted them, so comparing these across loops shows how
+ * evenly the kernel is spreading clients over the listening sockets.
+ *
+ * 'requests_active' is the loop's pending work: the number of handles
+ * that carry per-request state from isc_nmhandle_setdata() and have not
+ * been released yet.  Unlike the connection counters, it counts each
+ * of the queries pipelined on one TCP connection.
+ *
+ * The netmgr does not rebalance connections: a libuv handle can't move
+ * to another loop once it is open, and running single requests on a
+ * less loaded loop would still need the connection's own loop to read
+ * the request and write the response, which is most of the work for a
+ * DNS message.  The only say over where a connection lands is which
+ * listening socket the kernel picks before it is accepted; see
+ * isc_nm_setloadbalancesockets() and isc_nm_setcpuaffinity().
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ * \li	'tid' is a valid loop number.
+ * \li	'load' is not NULL.
+ */
+
 uint32_t
 isc_nm_getinitialtimeout(void);
 /*%<
@@ -46,6 +46,14 @@ isc_os_umask(void);
  * Return umask of the current process as initialized at the program start
  */
 
+int
+isc_os_cpu(unsigned int n);
+/*%<
+ * Return the id of the 'n'-th CPU among the CPUs the process was allowed
+ * to run on when it started, or -1 if there are not that many or this
+ * cannot be determined.
+ */
+
 void
 isc_os_kernel(char **name, int *major, int *minor, int *patch);
 /*%<
@@ -17,6 +17,7 @@
 
 /*! \file isc/rwlock.h */
 
+#include <isc/lockprof.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -26,11 +27,26 @@ typedef enum {
 	isc_rwlocktype_write
 } isc_rwlocktype_t;
 
+#if ISC_LOCK_PROFILE
+#define isc__rwlock_lock_site(lp, t)                                        \
+	{                                                                   \
+		ISC__LOCKPROF_SITE(_lockprof_rdsite, isc_lockprof_rdlock);  \
+		ISC__LOCKPROF_SITE(_lockprof_wrsite, isc_lockprof_wrlock);  \
+		ISC__LOCKPROF_LOCK((t) == isc_rwlocktype_read            \
+					   ? &_lockprof_rdsite              \
+					   : &_lockprof_wrsite,             \
+				   isc_rwlock_lock(lp, t),                  \
+				   isc_rwlock_trylock(lp, t));              \
+	}
+#else /* ISC_LOCK_PROFILE */
+#define isc__rwlock_lock_site(lp, t) isc_rwlock_lock(lp, t)
+#endif /* ISC_LOCK_PROFILE */
+
 #define RWLOCK(lp, t)                                                         \
 	{                                                                     \
 		ISC_UTIL_TRACE(fprintf(stderr, "RWLOCK %p, %d %s %d\n", (lp), \
 				       (t), __FILE__, __LINE__));             \
-		isc_rwlock_lock((lp), (t));                                   \
+		isc__rwlock_lock_site((lp), (t));                             \
 		ISC_UTIL_TRACE(fprintf(stderr, "RWLOCKED %p, %d %s %d\n",     \
 				       (lp), (t), __FILE__, __LINE__));       \
 	}
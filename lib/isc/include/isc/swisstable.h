@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#pragma once
+
+/*
+ * An open-addressing hash table in the style of the "Swiss table": the
+ * slots are split into groups with one control byte per slot holding
+ * seven bits of the hash value, so a whole group is probed with a few
+ * SIMD (or SWAR) instructions and the match callback only runs for slots
+ * whose fingerprint and full 32-bit hash value both match.
+ *
+ * The table grows and shrinks incrementally: a resize allocates the new
+ * table and every following add or delete migrates one group from the old
+ * one, so no single operation has to rehash the whole table.
+ *
+ * The interface is the same as isc_hashmap's, so the callers can switch
+ * between the two.  As with isc_hashmap, the caller is responsible for
+ * locking, and must not add or delete entries while an iterator exists,
+ * except with isc_swisstable_iter_delcurrent_next().
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#include <isc/result.h>
+#include <isc/types.h>
+
+typedef struct isc_swisstable	   isc_swisstable_t;
+typedef struct isc_swisstable_iter isc_swisstable_iter_t;
+
+typedef bool (*isc_swisstable_match_fn)(void *node, const void *key);
+
+void
+isc_swisstable_create(isc_mem_t *mctx, uint8_t bits,
+		      isc_swisstable_t **tablep);
+/*%<
+ * Create a table at *tablep, using memory context and an initial size of
+ * (1<<bits) slots, rounded up to a whole number of groups.
+ *
+ * Requires:
+ * \li	'tablep' is not NULL and '*tablep' is NULL.
+ * \li	'mctx' is a valid memory context.
+ * \li	'bits' >=1 and 'bits' <=28
+ */
+
+void
+isc_swisstable_destroy(isc_swisstable_t **tablep);
+/*%<
+ * Destroy the table, freeing everything.  The values are not freed.
+ *
+ * Requires:
+ * \li	'*tablep' is a valid table
+ */
+
+isc_result_t
+isc_swisstable_add(isc_swisstable_t *table, const uint32_t hashval,
+		   isc_swisstable_match_fn match, const void *key, void *value,
+		   void **foundp);
+/*%<
+ * Add 'value' under 'key' to the table.  If a matching entry already
+ * exists, its value is stored in '*foundp' (if 'foundp' is not NULL).
+ *
+ * Requires:
+ * \li	'table' is a valid table
+ * \li	'hashval' is a precomputed hash value of 'key'
+ * \li	'key' is non-null
+ * \li	'foundp' is NULL or '*foundp' is NULL
+ *
+ * Returns:
+ * \li	#ISC_R_EXISTS		-- node of the same key already exists
+ * \li	#ISC_R_SUCCESS		-- all is well.
+ */
+
+isc_result_t
+isc_swisstable_find(const isc_swisstable_t *table, const uint32_t hashval,
+		    isc_swisstable_match_fn match, const void *key,
+		    void **valuep);
+/*%<
+ * Find an entry matching 'key'; if found, set '*valuep' to its value.
+ * (If 'valuep' is NULL, simply return SUCCESS or NOTFOUND.)
+ *
+ * Requires:
+ * \li	'table' is a valid table
+ * \li	'hashval' is a precomputed hash value of 'key'
+ * \li	'valuep' is NULL or '*valuep' is NULL
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS		-- success
+ * \li	#ISC_R_NOTFOUND		-- key not found
+ */
+
+isc_result_t
+isc_swisstable_delete(isc_swisstable_t *table, const uint32_t hashval,
+		      isc_swisstable_match_fn match, const void *key);
+/*%<
+ * Delete the entry matching 'key' from the table.
+ *
+ * Requires:
+ * \li	'table' is a valid table
+ * \li	'hashval' is a precomputed hash value of 'key'
+ * \li	'key' is non-null
+ *
+ * Returns:
+ * \li	#ISC_R_NOTFOUND		-- key not found
+ * \li	#ISC_R_SUCCESS		-- all is well
+ */
+
+void
+isc_swisstable_iter_create(isc_swisstable_t	 *table,
+			   isc_swisstable_iter_t **itp);
+/*%<
+ * Create an iterator for the table; point '*itp' to it.
+ *
+ * Requires:
+ * \li	'table' is a valid table
+ * \li	'itp' is non NULL and '*itp' is NULL.
+ */
+
+void
+isc_swisstable_iter_destroy(isc_swisstable_iter_t **itp);
+/*%<
+ * Destroy the iterator '*itp', set it to NULL
+ *
+ * Requires:
+ * \li	'itp' is non NULL and '*itp' is non NULL.
+ */
+
+isc_result_t
+isc_swisstable_iter_first(isc_swisstable_iter_t *it);
+/*%<
+ * Set an iterator to the first entry.
+ *
+ * Requires:
+ * \li	'it' is non NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	-- success
+ * \li	#ISC_R_NOMORE	-- no data in the table
+ */
+
+isc_result_t
+isc_swisstable_iter_next(isc_swisstable_iter_t *it);
+/*%<
+ * Set an iterator to the next entry.
+ *
+ * Requires:
+ * \li	'it' is non NULL and points to an entry.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	-- success
+ * \li	#ISC_R_NOMORE	-- end of table reached
+ */
+
+isc_result_t
+isc_swisstable_iter_delcurrent_next(isc_swisstable_iter_t *it);
+/*%<
+ * Delete the current entry and set an iterator to the next entry.
+ *
+ * Requires:
+ * \li	'it' is non NULL and points to an entry.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS	-- success
+ * \li	#ISC_R_NOMORE	-- end of table reached
+ */
+
+void
+isc_swisstable_iter_current(isc_swisstable_iter_t *it, void **valuep);
+/*%<
+ * Set '*valuep' to the current value under the iterator
+ *
+ * Requires:
+ * \li	'it' is non NULL and points to an entry.
+ * \li	'valuep' is non NULL and '*valuep' is NULL.
+ */
+
+void
+isc_swisstable_iter_currentkey(isc_swisstable_iter_t *it,
+			       const unsigned char  **key);
+/*%<
+ * Set '*key' to the current key for the value under the iterator
+ *
+ * Requires:
+ * \li	'it' is non NULL and points to an entry.
+ * \li	'key' is non NULL and '*key' is NULL.
+ */
+
+unsigned int
+isc_swisstable_count(isc_swisstable_t *table);
+/*%<
+ * Returns the number of items in the table.
+ *
+ * Requires:
+ * \li	'table' is a valid table
+ */
@@ -51,6 +51,17 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+isc_result_t
+isc_thread_setaffinity(int cpu);
+/*%<
+ * Restrict the calling thread to run on CPU 'cpu' only.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED if the platform can't do this
+ *\li	any other result if the system refused
+ */
+
 #define isc_thread_self (uintptr_t)pthread_self
 
 size_t
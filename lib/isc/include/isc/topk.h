@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/topk.h
+ * \brief Approximate heavy hitters of a stream of keys.
+ *
+ * An `isc_topk_t` counts the keys it is given in a count-min sketch
+ * (a few rows of counters indexed by different bits of the key's hash
+ * value) and keeps the #ISC_TOPK_ENTRIES keys with the highest estimated
+ * counts in a space-saving table.  The memory used is fixed no matter
+ * how many distinct keys are seen, and the estimates only ever err on
+ * the high side, by a small fraction of the total count.
+ *
+ * Most keys in a long-tailed stream are estimated below the smallest
+ * count in the table, and for those an update costs a hash and a few
+ * counter increments.
+ *
+ * When a half-life is set, all counts are halved every `halflife`
+ * seconds, so the table follows what is frequent now rather than since
+ * startup.  The decay is driven by the `now` argument of the update and
+ * merge functions.
+ *
+ * A sketch is not locked: it may only be updated by one thread at a
+ * time, but it can be merged into another sketch or read by any thread
+ * while it is being updated.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <isc/refcount.h>
+#include <isc/stdtime.h>
+#include <isc/types.h>
+
+/*%
+ * Maximum key size; large enough for a DNS name in wire format.
+ */
+#define ISC_TOPK_KEYSIZE 256
+
+/*%
+ * Number of keys tracked.
+ */
+#define ISC_TOPK_ENTRIES 32
+
+/*%
+ * Highest sampling rate of a multithreaded sketch.
+ */
+#define ISC_TOPK_MAXRATE 65536
+
+typedef struct isc_topk	     isc_topk_t;
+typedef struct isc_topkmulti isc_topkmulti_t;
+
+typedef struct isc_topk_entry {
+	uint32_t      count;
+	unsigned int  length;
+	unsigned char key[ISC_TOPK_KEYSIZE];
+} isc_topk_entry_t;
+
+void
+isc_topk_create(isc_mem_t *mctx, unsigned int halflife, isc_topk_t **tkp);
+/*%<
+ * Create an empty heavy-hitter sketch whose counts are halved every
+ * `halflife` seconds, or never if `halflife` is zero.
+ *
+ * Requires:
+ *\li	`mctx` is a valid memory context
+ *\li	`tkp != NULL && *tkp == NULL`
+ */
+
+void
+isc_topk_destroy(isc_topk_t **tkp);
+/*%<
+ * Destroy a sketch.
+ *
+ * Requires:
+ *\li	`*tkp` is a pointer to a valid sketch
+ *
+ * Ensures:
+ *\li	`*tkp == NULL`
+ */
+
+void
+isc_topk_add(isc_topk_t *tk, const void *key, size_t length, uint32_t inc,
+	     isc_stdtime_t now);
+/*%<
+ * Count `inc` occurrences of `key`.  Keys are compared byte by byte, so
+ * the caller has to canonicalize them (e.g. lower-case DNS names).
+ *
+ * Requires:
+ *\li	`tk` is a pointer to a valid sketch
+ *\li	`key != NULL`
+ *\li	`length <= ISC_TOPK_KEYSIZE`
+ */
+
+uint32_t
+isc_topk_estimate(isc_topk_t *tk, const void *key, size_t length);
+/*%<
+ * Return the estimated count of `key`, which is never lower than the
+ * true count.
+ *
+ * Requires:
+ *\li	`tk` is a pointer to a valid sketch
+ *\li	`key != NULL`
+ *\li	`length <= ISC_TOPK_KEYSIZE`
+ */
+
+void
+isc_topk_merge(isc_topk_t **targetp, isc_topk_t *source, isc_stdtime_t now);
+/*%<
+ * Add the counts recorded in `source` to `*targetp`, after decaying both
+ * up to `now`.
+ *
+ * The target sketch is created with the half-life of `source` if
+ * `*targetp` is NULL.
+ *
+ * Requires:
+ *\li	`targetp != NULL`
+ *\li	`*targetp` is NULL or a pointer to a valid sketch
+ *\li	`source` is a pointer to a valid sketch
+ */
+
+size_t
+isc_topk_get(isc_topk_t *tk, isc_topk_entry_t *entries, size_t size);
+/*%<
+ * Copy up to `size` of the tracked keys with the highest counts to
+ * `entries`, highest first, and return the number copied.
+ *
+ * Requires:
+ *\li	`tk` is a pointer to a valid sketch
+ *\li	`entries != NULL || size == 0`
+ */
+
+/**********************************************************************/
+
+void
+isc_topkmulti_create(isc_mem_t *mctx, unsigned int halflife,
+		     unsigned int rate, isc_topkmulti_t **tmp);
+/*%<
+ * Create a multithreaded sharded heavy-hitter sketch that counts about
+ * one in `rate` of the keys it is offered, each as `rate` occurrences.
+ *
+ * Each thread updates its own `isc_topk_t`, without any locking.
+ *
+ * Requires:
+ *\li	`mctx` is a valid memory context
+ *\li	`0 < rate <= ISC_TOPK_MAXRATE`
+ *\li	`tmp != NULL && *tmp == NULL`
+ */
+
+unsigned int
+isc_topkmulti_getrate(isc_topkmulti_t *tm);
+/*%<
+ * Return the sampling rate of `tm`.
+ *
+ * Requires:
+ *\li	`tm` is a pointer to a valid multithreaded sketch
+ */
+
+bool
+isc_topkmulti_sample(isc_topkmulti_t *tm);
+/*%<
+ * Return true if the current thread should count the next key in `tm`,
+ * which is about one time in the sampling rate.  Callers check this
+ * before they make the key, so that keys which are not counted cost
+ * next to nothing.  Always false in threads that are not loop threads.
+ *
+ * Requires:
+ *\li	`tm` is a pointer to a valid multithreaded sketch
+ */
+
+void
+isc_topkmulti_add(isc_topkmulti_t *tm, const void *key, size_t length,
+		  isc_stdtime_t now);
+/*%<
+ * Count `key` in the current thread's sketch, as many times as the
+ * sampling rate of `tm`.  Calls from threads that are not loop threads
+ * are ignored.
+ *
+ * Requires:
+ *\li	`tm` is a pointer to a valid multithreaded sketch
+ *\li	`key != NULL`
+ *\li	`length <= ISC_TOPK_KEYSIZE`
+ */
+
+void
+isc_topkmulti_merge(isc_topk_t **targetp, isc_topkmulti_t *source,
+		    isc_stdtime_t now);
+/*%<
+ * Add the counts recorded by all threads in `source` to `*targetp`,
+ * which is created if it is NULL.
+ *
+ * Requires:
+ *\li	`targetp != NULL`
+ *\li	`*targetp` is NULL or a pointer to a valid sketch
+ *\li	`source` is a pointer to a valid multithreaded sketch
+ */
+
+ISC_REFCOUNT_DECL(isc_topkmulti);
@@ -80,6 +80,16 @@ isc_work_cancel(isc_work_t *work);
  *\li	'work' is a handle from isc_work_enqueue() whose 'done_cb' has not run.
  */
 
+void
+isc_work_setstealing(bool enabled);
+/*%<
+ * Enable or disable work stealing for the ISC_WORKLANE_FAST lane.  When
+ * enabled, a task queued to a worker that is busy wakes an idle worker of
+ * another loop, and idle workers take queued tasks from busy ones.  The
+ * 'done_cb' still runs on the loop that enqueued the task.  Disabled by
+ * default.
+ */
+
 /* private */
 
 typedef struct isc__workthread isc__workthread_t;
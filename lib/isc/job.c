@@ -69,7 +69,7 @@ isc__job_cb(uv_idle_t *handle) {
 		void *cbarg = job->cbarg;
 		ISC_LIST_UNLINK(jobs, job, link);
 		LIBISC_JOB_CB_BEFORE(job, cb, cbarg);
-		cb(cbarg);
+		isc__loop_runcb(loop, cb, cbarg);
 		LIBISC_JOB_CB_AFTER(job, cb, cbarg);
 	}
 
@@ -14,6 +14,7 @@
 /*! \file */
 
 #include <isc/crypto.h>
+#include <isc/fileio.h>
 #include <isc/hash.h>
 #include <isc/iterated_hash.h>
 #include <isc/md.h>
@@ -58,6 +59,7 @@ isc__lib_initialize(void) {
 	isc__xml_initialize();
 	isc__hash_initialize();
 	isc__iterated_hash_initialize();
+	isc__fileio_initialize();
 	(void)isc_os_ncpus();
 }
 
@@ -70,6 +72,7 @@ isc__lib_shutdown(void) {
 	rcu_barrier();
 	rcu_unregister_thread();
 
+	isc__fileio_shutdown();
 	isc__iterated_hash_shutdown();
 	isc__xml_shutdown();
 	isc__uv_shutdown();
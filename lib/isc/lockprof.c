@@ -0,0 +1,336 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <isc/atomic.h>
+#include <isc/bit.h>
+#include <isc/lockprof.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#ifdef HAVE_LIBXML2
+#include <libxml/xmlwriter.h>
+#define ISC_XMLCHAR (const xmlChar *)
+#endif /* HAVE_LIBXML2 */
+
+#ifdef HAVE_JSON_C
+#include <json_object.h>
+#endif /* HAVE_JSON_C */
+
+/*
+ * The sites form a lock-free, insert-only list; they are static objects
+ * at the LOCK() call sites, so they are never freed.
+ */
+static _Atomic(isc_lockprof_site_t *) sites = NULL;
+
+#if ISC_LOCK_PROFILE
+atomic_bool isc__lockprof_active = true;
+
+static void
+site_register(isc_lockprof_site_t *site) {
+	if (atomic_exchange_acquire(&site->registered, true)) {
+		return;
+	}
+
+	site->next = atomic_load_acquire(&sites);
+	while (!atomic_compare_exchange_weak_acq_rel(&sites, &site->next,
+						     site))
+	{
+		/* retry */
+	}
+}
+
+static unsigned int
+wait_bucket(uint64_t waitns) {
+	unsigned int bucket;
+
+	if (waitns == 0) {
+		return 0;
+	}
+
+	bucket = 64 - stdc_leading_zeros(waitns);
+	return ISC_MIN(bucket, ISC_LOCKPROF_BUCKETS - 1);
+}
+
+uint64_t
+isc__lockprof_now(void) {
+	return isc_time_monotonic();
+}
+
+void
+isc__lockprof_acquired(isc_lockprof_site_t *site, bool contended,
+		       uint64_t waitns) {
+	if (!atomic_load_relaxed(&site->registered)) {
+		site_register(site);
+	}
+
+	atomic_fetch_add_relaxed(&site->acquired, 1);
+
+	if (!contended) {
+		return;
+	}
+
+	atomic_fetch_add_relaxed(&site->contended, 1);
+	atomic_fetch_add_relaxed(&site->waitns, waitns);
+	atomic_fetch_add_relaxed(&site->wait[wait_bucket(waitns)], 1);
+
+	uint_fast64_t max = atomic_load_relaxed(&site->maxwaitns);
+	while (waitns > max &&
+	       !atomic_compare_exchange_weak_relaxed(&site->maxwaitns, &max,
+						     waitns))
+	{
+		/* retry */
+	}
+}
+
+bool
+isc_lockprof_supported(void) {
+	return true;
+}
+
+void
+isc_lockprof_setactive(bool active) {
+	atomic_store_relaxed(&isc__lockprof_active, active);
+}
+
+bool
+isc_lockprof_active(void) {
+	return atomic_load_relaxed(&isc__lockprof_active);
+}
+#else /* ISC_LOCK_PROFILE */
+bool
+isc_lockprof_supported(void) {
+	return false;
+}
+
+void
+isc_lockprof_setactive(bool active) {
+	UNUSED(active);
+}
+
+bool
+isc_lockprof_active(void) {
+	return false;
+}
+#endif /* ISC_LOCK_PROFILE */
+
+void
+isc_lockprof_reset(void) {
+	for (isc_lockprof_site_t *site = atomic_load_acquire(&sites);
+	     site != NULL; site = site->next)
+	{
+		atomic_store_relaxed(&site->acquired, 0);
+		atomic_store_relaxed(&site->contended, 0);
+		atomic_store_relaxed(&site->waitns, 0);
+		atomic_store_relaxed(&site->maxwaitns, 0);
+		for (size_t i = 0; i < ISC_LOCKPROF_BUCKETS; i++) {
+			atomic_store_relaxed(&site->wait[i], 0);
+		}
+	}
+}
+
+isc_result_t
+isc_lockprof_walk(isc_lockprof_cb_t cb, void *arg) {
+	REQUIRE(cb != NULL);
+
+	for (isc_lockprof_site_t *site = atomic_load_acquire(&sites);
+	     site != NULL; site = site->next)
+	{
+		isc_lockprof_stats_t stats = {
+			.file = site->file,
+			.line = site->line,
+			.kind = site->kind,
+			.acquired = atomic_load_relaxed(&site->acquired),
+			.contended = atomic_load_relaxed(&site->contended),
+			.waitns = atomic_load_relaxed(&site->waitns),
+			.maxwaitns = atomic_load_relaxed(&site->maxwaitns),
+		};
+
+		if (stats.acquired == 0) {
+			continue;
+		}
+
+		for (size_t i = 0; i < ISC_LOCKPROF_BUCKETS; i++) {
+			stats.wait[i] = atomic_load_relaxed(&site->wait[i]);
+		}
+
+		isc_result_t result = cb(&stats, arg);
+		if (result != ISC_R_SUCCESS) {
+			return result;
+		}
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+const char *
+isc_lockprof_kindtext(isc_lockprof_kind_t kind) {
+	switch (kind) {
+	case isc_lockprof_mutex:
+		return "mutex";
+	case isc_lockprof_rdlock:
+		return "read";
+	case isc_lockprof_wrlock:
+		return "write";
+	default:
+		UNREACHABLE();
+	}
+}
+
+#ifdef HAVE_LIBXML2
+#define TRY0(a)                     \
+	do {                        \
+		xmlrc = (a);        \
+		if (xmlrc < 0)      \
+			goto error; \
+	} while (0)
+
+static isc_result_t
+xml_rendersite(const isc_lockprof_stats_t *stats, void *arg) {
+	xmlTextWriterPtr writer = arg;
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "lock"));
+	TRY0(xmlTextWriterWriteFormatAttribute(writer, ISC_XMLCHAR "site",
+					       "%s:%u", stats->file,
+					       stats->line));
+	TRY0(xmlTextWriterWriteAttribute(
+		writer, ISC_XMLCHAR "type",
+		ISC_XMLCHAR isc_lockprof_kindtext(stats->kind)));
+
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "acquired",
+					     "%" PRIu64, stats->acquired));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "contended",
+					     "%" PRIu64, stats->contended));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "waitns",
+					     "%" PRIu64, stats->waitns));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "maxwaitns",
+					     "%" PRIu64, stats->maxwaitns));
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "waits"));
+	for (size_t i = 0; i < ISC_LOCKPROF_BUCKETS; i++) {
+		if (stats->wait[i] == 0) {
+			continue;
+		}
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "bucket"));
+		TRY0(xmlTextWriterWriteFormatAttribute(
+			writer, ISC_XMLCHAR "max", "%" PRIu64,
+			i == ISC_LOCKPROF_BUCKETS - 1 ? UINT64_MAX
+						      : (UINT64_C(1) << i)));
+		TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64,
+						    stats->wait[i]));
+		TRY0(xmlTextWriterEndElement(writer)); /* bucket */
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* waits */
+
+	TRY0(xmlTextWriterEndElement(writer)); /* lock */
+
+	return ISC_R_SUCCESS;
+
+error:
+	return ISC_R_FAILURE;
+}
+
+int
+isc_lockprof_renderxml(void *writer0) {
+	xmlTextWriterPtr writer = (xmlTextWriterPtr)writer0;
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "locks"));
+	TRY0(xmlTextWriterWriteAttribute(
+		writer, ISC_XMLCHAR "active",
+		ISC_XMLCHAR(isc_lockprof_active() ? "yes" : "no")));
+	if (isc_lockprof_walk(xml_rendersite, writer) != ISC_R_SUCCESS) {
+		xmlrc = -1;
+		goto error;
+	}
+	TRY0(xmlTextWriterEndElement(writer)); /* locks */
+
+error:
+	return xmlrc;
+}
+#endif /* HAVE_LIBXML2 */
+
+#ifdef HAVE_JSON_C
+#define CHECKMEM(m) RUNTIME_CHECK(m != NULL)
+
+static isc_result_t
+json_rendersite(const isc_lockprof_stats_t *stats, void *arg) {
+	json_object *array = arg;
+	json_object *siteobj, *waits, *obj;
+	char buf[1024];
+
+	siteobj = json_object_new_object();
+	CHECKMEM(siteobj);
+
+	snprintf(buf, sizeof(buf), "%s:%u", stats->file, stats->line);
+	obj = json_object_new_string(buf);
+	CHECKMEM(obj);
+	json_object_object_add(siteobj, "site", obj);
+
+	obj = json_object_new_string(isc_lockprof_kindtext(stats->kind));
+	CHECKMEM(obj);
+	json_object_object_add(siteobj, "type", obj);
+
+	obj = json_object_new_int64(stats->acquired);
+	CHECKMEM(obj);
+	json_object_object_add(siteobj, "acquired", obj);
+
+	obj = json_object_new_int64(stats->contended);
+	CHECKMEM(obj);
+	json_object_object_add(siteobj, "contended", obj);
+
+	obj = json_object_new_int64(stats->waitns);
+	CHECKMEM(obj);
+	json_object_object_add(siteobj, "waitns", obj);
+
+	obj = json_object_new_int64(stats->maxwaitns);
+	CHECKMEM(obj);
+	json_object_object_add(siteobj, "maxwaitns", obj);
+
+	/* waits[i] counts waits shorter than 2^i nanoseconds */
+	waits = json_object_new_array();
+	CHECKMEM(waits);
+	for (size_t i = 0; i < ISC_LOCKPROF_BUCKETS; i++) {
+		obj = json_object_new_int64(stats->wait[i]);
+		CHECKMEM(obj);
+		json_object_array_add(waits, obj);
+	}
+	json_object_object_add(siteobj, "waits", waits);
+
+	json_object_array_add(array, siteobj);
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+isc_lockprof_renderjson(void *lockobj0) {
+	json_object *lockobj = (json_object *)lockobj0;
+	json_object *sitearray, *obj;
+
+	obj = json_object_new_boolean(isc_lockprof_active());
+	CHECKMEM(obj);
+	json_object_object_add(lockobj, "active", obj);
+
+	sitearray = json_object_new_array();
+	CHECKMEM(sitearray);
+	json_object_object_add(lockobj, "sites", sitearray);
+
+	return isc_lockprof_walk(json_rendersite, sitearray);
+}
+#endif /* HAVE_JSON_C */
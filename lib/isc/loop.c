@@ -19,7 +19,9 @@
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/backtrace.h>
 #include <isc/barrier.h>
+#include <isc/histo.h>
 #include <isc/job.h>
 #include <isc/list.h>
 #include <isc/log.h>
@@ -51,6 +53,17 @@
 thread_local isc_loop_t *isc__loop_local = NULL;
 isc_loopmgr_t *isc__loopmgr = NULL;
 
+/*
+ * The loop histograms record values in microseconds with 3 significant
+ * bits, i.e. with less than 12.5% relative error.
+ */
+#define LOOP_HISTO_SIGBITS 3
+
+/*
+ * Log at most one stall warning per loop in this interval.
+ */
+#define LOOP_STALL_LOG_INTERVAL ((isc_nanosecs_t)60 * NS_PER_SEC)
+
 static void
 ignore_signal(int sig, void (*handler)(int)) {
 	struct sigaction sa = { .sa_handler = handler };
@@ -102,6 +115,7 @@ pause_loop(isc_loop_t *loop) {
 	rcu_thread_offline();
 
 	loop->paused = true;
+	loop->lag_skip = true;
 	(void)isc_barrier_wait(&loopmgr->pausing);
 }
 
@@ -209,6 +223,9 @@ loop_init(isc_loop_t *loop, isc_tid_t tid, const char *kind) {
 	};
 
 	__cds_wfcq_init(&loop->async_jobs.head, &loop->async_jobs.tail);
+	__cds_wfcq_init(&loop->async_lowjobs.head, &loop->async_lowjobs.tail);
+	__cds_wfcq_init(&loop->async_lowpending.head,
+			&loop->async_lowpending.tail);
 	__cds_wfcq_init(&loop->setup_jobs.head, &loop->setup_jobs.tail);
 	__cds_wfcq_init(&loop->teardown_jobs.head, &loop->teardown_jobs.tail);
 
@@ -239,16 +256,138 @@ loop_init(isc_loop_t *loop, isc_tid_t tid, const char *kind) {
 	UV_RUNTIME_CHECK(uv_prepare_init, r);
 	uv_handle_set_data(&loop->quiescent, loop);
 
+#if UV_VERSION_HEX >= UV_VERSION(1, 39, 0)
+	r = uv_loop_configure(&loop->loop, UV_METRICS_IDLE_TIME);
+	UV_RUNTIME_CHECK(uv_loop_configure, r);
+#endif /* UV_VERSION_HEX >= UV_VERSION(1, 39, 0) */
+
 	isc_mem_create(kind, &loop->mctx);
 
+	isc_histo_create(loop->mctx, LOOP_HISTO_SIGBITS, &loop->lag);
+	isc_histo_create(loop->mctx, LOOP_HISTO_SIGBITS, &loop->runtime);
+	atomic_init(&loop->stalls, 0);
+
 	isc_refcount_init(&loop->references, 1);
 
 	loop->magic = LOOP_MAGIC;
 }
 
+static void
+loop_stalled(isc_loop_t *loop, isc_job_cb cb, isc_nanosecs_t elapsed) {
+	isc_nanosecs_t threshold =
+		atomic_load_relaxed(&isc__loopmgr->stall_threshold);
+	char suppressed[64] = "";
+
+	if (threshold == 0 || elapsed < threshold) {
+		return;
+	}
+
+	if (cb == NULL) {
+		atomic_fetch_add_relaxed(&loop->stalls, 1);
+		if (loop->lag_reported) {
+			return;
+		}
+	} else {
+		loop->lag_reported = true;
+	}
+
+	/*
+	 * A slow disk or a big zone load can stall the loop over and over
+	 * again, so only log once per interval and count the rest.
+	 */
+	isc_nanosecs_t now = isc_time_monotonic();
+	if (loop->stall_logged != 0 &&
+	    now - loop->stall_logged < LOOP_STALL_LOG_INTERVAL)
+	{
+		loop->stall_suppressed++;
+		return;
+	}
+
+	if (loop->stall_suppressed > 0) {
+		snprintf(suppressed, sizeof(suppressed),
+			 " (%" PRIu64 " similar messages suppressed)",
+			 loop->stall_suppressed);
+	}
+	loop->stall_logged = now;
+	loop->stall_suppressed = 0;
+
+	if (cb == NULL) {
+		isc_log_write(ISC_LOGCATEGORY_GENERAL, ISC_LOGMODULE_OTHER,
+			      ISC_LOG_WARNING,
+			      "loop %" PRItid " stalled: iteration took "
+			      "%" PRIu64 " ms%s",
+			      loop->tid, elapsed / NS_PER_MS, suppressed);
+		return;
+	}
+
+	/*
+	 * The callback has already returned, so the current stack is of no
+	 * use; resolve the callback address itself to name the culprit.
+	 */
+	void *addr = (void *)cb;
+	char **strs = isc_backtrace_symbols(&addr, 1);
+
+	isc_log_write(ISC_LOGCATEGORY_GENERAL, ISC_LOGMODULE_OTHER,
+		      ISC_LOG_WARNING,
+		      "loop %" PRItid " stalled: callback %s ran for %" PRIu64
+		      " ms%s",
+		      loop->tid, strs != NULL ? strs[0] : "<unknown>",
+		      elapsed / NS_PER_MS, suppressed);
+	free(strs);
+}
+
+void
+isc__loop_runcb(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
+	/*
+	 * Don't pay for the clock reads when nobody is looking.
+	 */
+	if (atomic_load_relaxed(&isc__loopmgr->stall_threshold) == 0) {
+		cb(cbarg);
+		return;
+	}
+
+	isc_nanosecs_t start = isc_time_monotonic();
+
+	cb(cbarg);
+
+	isc_nanosecs_t elapsed = isc_time_monotonic() - start;
+
+	isc_histo_inc(loop->runtime, elapsed / NS_PER_US);
+	loop_stalled(loop, cb, elapsed);
+}
+
+/*
+ * Measure how long the loop was busy since the previous iteration, that
+ * is the time between two prepare callbacks minus the time spent waiting
+ * in the poll.
+ */
+static void
+loop_lag(isc_loop_t *loop) {
+#if UV_VERSION_HEX >= UV_VERSION(1, 39, 0)
+	isc_nanosecs_t now = isc_time_monotonic();
+	uint64_t idle = uv_metrics_idle_time(&loop->loop);
+
+	if (loop->lag_start != 0 && !loop->lag_skip) {
+		isc_nanosecs_t busy = now - loop->lag_start;
+		uint64_t waited = idle - loop->lag_idle;
+
+		busy = (busy > waited) ? busy - waited : 0;
+
+		isc_histo_inc(loop->lag, busy / NS_PER_US);
+		loop_stalled(loop, NULL, busy);
+	}
+
+	loop->lag_start = now;
+	loop->lag_idle = idle;
+#endif /* UV_VERSION_HEX >= UV_VERSION(1, 39, 0) */
+
+	loop->lag_skip = false;
+	loop->lag_reported = false;
+}
+
 static void
 quiescent_cb(uv_prepare_t *handle) {
-	UNUSED(handle);
+	loop_lag(uv_handle_get_data(handle));
 
 #if defined(RCU_QSBR)
 	/* safe memory reclamation */
@@ -267,10 +406,17 @@ loop_close(isc_loop_t *loop) {
 	UV_RUNTIME_CHECK(uv_loop_close, r);
 
 	INSIST(cds_wfcq_empty(&loop->async_jobs.head, &loop->async_jobs.tail));
+	INSIST(cds_wfcq_empty(&loop->async_lowjobs.head,
+			      &loop->async_lowjobs.tail));
+	INSIST(cds_wfcq_empty(&loop->async_lowpending.head,
+			      &loop->async_lowpending.tail));
 	INSIST(ISC_LIST_EMPTY(loop->run_jobs));
 
 	loop->magic = 0;
 
+	isc_histo_destroy(&loop->lag);
+	isc_histo_destroy(&loop->runtime);
+
 	isc_mem_detach(&loop->mctx);
 }
 
@@ -626,6 +772,48 @@ isc_loop_now(isc_loop_t *loop) {
 	return t;
 }
 
+void
+isc_loopmgr_setstallthreshold(uint32_t threshold) {
+	REQUIRE(VALID_LOOPMGR(isc__loopmgr));
+
+	atomic_store_relaxed(&isc__loopmgr->stall_threshold,
+			     (isc_nanosecs_t)threshold * NS_PER_MS);
+}
+
+static uint64_t
+loop_histo_stats(const isc_histo_t *source, uint64_t quantiles[3]) {
+	static const double fractions[3] = { 1.0, 0.99, 0.5 };
+	isc_histo_t *hg = NULL;
+	uint64_t values[3] = { 0 };
+	double population = 0.0;
+
+	/* Get a stable copy, the loop keeps updating the source */
+	isc_histo_merge(&hg, source);
+	isc_histo_moments(hg, &population, NULL, NULL);
+	(void)isc_histo_quantiles(hg, ARRAY_SIZE(fractions), fractions,
+				  values);
+	isc_histo_destroy(&hg);
+
+	quantiles[0] = values[2];
+	quantiles[1] = values[1];
+	quantiles[2] = values[0];
+
+	return (uint64_t)population;
+}
+
+void
+isc_loop_getstats(isc_loop_t *loop, isc_loopstats_t *stats) {
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(stats != NULL);
+
+	*stats = (isc_loopstats_t){
+		.stalls = atomic_load_relaxed(&loop->stalls),
+	};
+
+	stats->iterations = loop_histo_stats(loop->lag, stats->lag);
+	stats->callbacks = loop_histo_stats(loop->runtime, stats->runtime);
+}
+
 bool
 isc_loop_shuttingdown(isc_loop_t *loop) {
 	REQUIRE(VALID_LOOP(loop));
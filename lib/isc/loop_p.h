@@ -16,6 +16,7 @@
 #include <inttypes.h>
 
 #include <isc/barrier.h>
+#include <isc/histo.h>
 #include <isc/job.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
@@ -24,6 +25,7 @@
 #include <isc/result.h>
 #include <isc/signal.h>
 #include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/types.h>
 #include <isc/urcu.h>
 #include <isc/uv.h>
@@ -55,6 +57,8 @@ struct isc_loop {
 	/* Async queue */
 	uv_async_t async_trigger;
 	isc_jobqueue_t async_jobs;
+	isc_jobqueue_t async_lowjobs;
+	isc_jobqueue_t async_lowpending; /* loop thread only */
 
 	/* Jobs queue */
 	uv_idle_t run_trigger;
@@ -74,6 +78,17 @@ struct isc_loop {
 	/* safe memory reclamation */
 	uv_prepare_t quiescent;
 
+	/* lag monitoring */
+	isc_histo_t *lag;
+	isc_histo_t *runtime;
+	isc_nanosecs_t lag_start;
+	uint64_t lag_idle;
+	bool lag_skip;
+	bool lag_reported;
+	atomic_uint_fast64_t stalls;
+	isc_nanosecs_t stall_logged;
+	uint64_t stall_suppressed;
+
 	/* thread pools */
 	isc__workthread_t *workthreads[ISC_WORKLANE_COUNT];
 };
@@ -108,6 +123,9 @@ typedef struct isc_loopmgr {
 	/* stopping */
 	isc_barrier_t stopping;
 
+	/* stall detection threshold in nanoseconds, 0 means disabled */
+	atomic_uint_fast64_t stall_threshold;
+
 	/* per-thread objects */
 	isc_loop_t *loops;
 } isc_loopmgr_t;
@@ -145,3 +163,9 @@ void
 isc__loopmgr_starting(void);
 void
 isc__loopmgr_stopping(void);
+
+void
+isc__loop_runcb(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
+/*%<
+ * Run the callback 'cb' on the 'loop' and record how long it took.
+ */
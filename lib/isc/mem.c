@@ -985,6 +985,20 @@ isc_mem_inuse(isc_mem_t *ctx) {
 	return (size_t)inuse;
 }
 
+void
+isc_mem_charge(isc_mem_t *ctx, size_t size) {
+	REQUIRE(VALID_CONTEXT(ctx));
+
+	mem_getstats(ctx, size);
+}
+
+void
+isc_mem_uncharge(isc_mem_t *ctx, size_t size) {
+	REQUIRE(VALID_CONTEXT(ctx));
+
+	mem_putstats(ctx, size);
+}
+
 void
 isc_mem_clearwater(isc_mem_t *mctx) {
 	isc_mem_setwater(mctx, 0, 0);
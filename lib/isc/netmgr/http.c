@@ -35,6 +35,12 @@
 
 #define DNS_MEDIA_TYPE "application/dns-message"
 
+/*
+ * The exact number of octets an unpadded base64url string of 'len'
+ * characters decodes to.
+ */
+#define BASE64URL_DECODED_LEN(len) ((len) / 4 * 3 + (len) % 4 * 3 / 4)
+
 /*
  * See https://developer.mozilla.org/en-US/docs/Web/HTTP/Headers/Cache-Control
  * for additional details. Basically it means "avoid caching by any
@@ -937,13 +943,21 @@ send_client_connection_header(isc_nm_http_session_t *session) {
 	return true;
 }
 
+/*
+ * Header names are always string literals, and MAKE_NV2() is only ever
+ * used with literal values, so there is no need for nghttp2 to make
+ * its own copy of them for every submitted request or response.  Note
+ * that nghttp2 does not lowercase the names that are not copied, so
+ * they must be written in lowercase here.
+ */
 #define MAKE_NV(NAME, VALUE, VALUELEN)                                 \
 	{ (uint8_t *)(uintptr_t)(NAME), (uint8_t *)(uintptr_t)(VALUE), \
-	  sizeof(NAME) - 1, VALUELEN, NGHTTP2_NV_FLAG_NONE }
+	  sizeof(NAME) - 1, VALUELEN, NGHTTP2_NV_FLAG_NO_COPY_NAME }
 
 #define MAKE_NV2(NAME, VALUE)                                          \
 	{ (uint8_t *)(uintptr_t)(NAME), (uint8_t *)(uintptr_t)(VALUE), \
-	  sizeof(NAME) - 1, sizeof(VALUE) - 1, NGHTTP2_NV_FLAG_NONE }
+	  sizeof(NAME) - 1, sizeof(VALUE) - 1,                         \
+	  NGHTTP2_NV_FLAG_NO_COPY_NAME | NGHTTP2_NV_FLAG_NO_COPY_VALUE }
 
 static ssize_t
 client_read_callback(nghttp2_session *ngsession, int32_t stream_id,
@@ -2162,6 +2176,38 @@ server_on_begin_headers_callback(nghttp2_session *ngsession,
 	return 0;
 }
 
+/*
+ * Decode the base64url encoded DNS message from the GET query string
+ * straight into its binary form.  If the value is not valid base64url,
+ * 'query_data' is left unset and the request is rejected later on.
+ */
+static void
+server_decode_query_data(isc_nmsocket_t *socket, const char *value,
+			 const size_t valuelen) {
+	isc_mem_t *mctx = socket->worker->mctx;
+	isc_buffer_t buf;
+	size_t size;
+
+	if (socket->h2->query_data != NULL) {
+		isc_mem_free(mctx, socket->h2->query_data);
+		socket->h2->query_data_len = 0;
+	}
+
+	size = BASE64URL_DECODED_LEN(valuelen);
+	if (size == 0) {
+		return;
+	}
+
+	socket->h2->query_data = isc_mem_allocate(mctx, size);
+	isc_buffer_init(&buf, socket->h2->query_data, size);
+	if (isc__nm_base64url_decode(value, valuelen, &buf) != ISC_R_SUCCESS)
+	{
+		isc_mem_free(mctx, socket->h2->query_data);
+		return;
+	}
+	socket->h2->query_data_len = isc_buffer_usedlength(&buf);
+}
+
 static isc_http_error_responses_t
 server_handle_path_header(isc_nmsocket_t *socket, const uint8_t *value,
 			  const size_t valuelen) {
@@ -2203,17 +2249,12 @@ server_handle_path_header(isc_nmsocket_t *socket, const uint8_t *value,
 		if (isc__nm_parse_httpquery((const char *)qstr, &dns_value,
 					    &dns_value_len))
 		{
-			const size_t decoded_size = dns_value_len / 4 * 3;
-			if (decoded_size <= MAX_DNS_MESSAGE_SIZE) {
-				if (socket->h2->query_data != NULL) {
-					isc_mem_free(socket->worker->mctx,
-						     socket->h2->query_data);
-				}
-				socket->h2->query_data =
-					isc__nm_base64url_to_base64(
-						socket->worker->mctx, dns_value,
-						dns_value_len,
-						&socket->h2->query_data_len);
+			socket->h2->query_present = true;
+			if (BASE64URL_DECODED_LEN(dns_value_len) <=
+			    MAX_DNS_MESSAGE_SIZE)
+			{
+				server_decode_query_data(socket, dns_value,
+							 dns_value_len);
 				socket->h2->session->processed_useful_data +=
 					dns_value_len;
 			} else {
@@ -2371,6 +2412,15 @@ server_on_header_callback(nghttp2_session *session, const nghttp2_frame *frame,
 	return 0;
 }
 
+/*
+ * The response body is copied into the DATA frames here.  Sending it
+ * straight from 'wbuf' would need NGHTTP2_DATA_FLAG_NO_COPY, which only
+ * works with a send_data_callback and nghttp2_session_send(), while the
+ * session is driven by nghttp2_session_mem_send() so that all output is
+ * batched into one buffer per write (see http_send_outgoing()).  A DNS
+ * response is small compared with the per-write costs that batching
+ * saves, so the copy stays.
+ */
 static ssize_t
 server_read_callback(nghttp2_session *ngsession, int32_t stream_id,
 		     uint8_t *buf, size_t length, uint32_t *data_flags,
@@ -2561,7 +2611,6 @@ server_on_request_recv(nghttp2_session *ngsession, isc_nmsocket_t *socket) {
 	isc_result_t result;
 	isc_http_error_responses_t code = ISC_HTTP_ERROR_SUCCESS;
 	isc_region_t data;
-	uint8_t tmp_buf[MAX_DNS_MESSAGE_SIZE];
 
 	code = socket->h2->headers_error_code;
 	if (code != ISC_HTTP_ERROR_SUCCESS) {
@@ -2585,7 +2634,7 @@ server_on_request_recv(nghttp2_session *ngsession, isc_nmsocket_t *socket) {
 	{
 		code = ISC_HTTP_ERROR_BAD_REQUEST;
 	} else if (socket->h2->request_type == ISC_HTTP_REQ_POST &&
-		   socket->h2->query_data != NULL)
+		   socket->h2->query_present)
 	{
 		/* The spec does not mention which value the query string for
 		 * POST should have. For GET we use its value to decode a DNS
@@ -2612,15 +2661,9 @@ server_on_request_recv(nghttp2_session *ngsession, isc_nmsocket_t *socket) {
 	}
 
 	if (socket->h2->request_type == ISC_HTTP_REQ_GET) {
-		isc_buffer_t decoded_buf;
-		isc_buffer_init(&decoded_buf, tmp_buf, sizeof(tmp_buf));
-		if (isc_base64_decodestring(socket->h2->query_data,
-					    &decoded_buf) != ISC_R_SUCCESS)
-		{
-			code = ISC_HTTP_ERROR_BAD_REQUEST;
-			goto error;
-		}
-		isc_buffer_usedregion(&decoded_buf, &data);
+		INSIST(socket->h2->query_data_len > 0);
+		data = (isc_region_t){ .base = socket->h2->query_data,
+				       .length = socket->h2->query_data_len };
 	} else if (socket->h2->request_type == ISC_HTTP_REQ_POST) {
 		INSIST(socket->h2->content_length > 0);
 		isc_buffer_usedregion(&socket->h2->rbuf, &data);
@@ -2724,23 +2767,25 @@ server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 				       sizeof(sock->h2->clenbuf), "%lu",
 				       (unsigned long)req->uvbuf.len);
 	if (sock->h2->min_ttl == 0) {
-		cache_control_buf_len =
-			snprintf(sock->h2->cache_control_buf,
-				 sizeof(sock->h2->cache_control_buf), "%s",
-				 DEFAULT_CACHE_CONTROL);
+		cache_control_buf_len = 0;
 	} else {
 		cache_control_buf_len =
 			snprintf(sock->h2->cache_control_buf,
 				 sizeof(sock->h2->cache_control_buf),
 				 "max-age=%" PRIu32, sock->h2->min_ttl);
 	}
-	const nghttp2_nv hdrs[] = { MAKE_NV2(":status", "200"),
-				    MAKE_NV2("Content-Type", DNS_MEDIA_TYPE),
-				    MAKE_NV("Content-Length", sock->h2->clenbuf,
-					    content_len_buf_len),
-				    MAKE_NV("Cache-Control",
-					    sock->h2->cache_control_buf,
-					    cache_control_buf_len) };
+	const nghttp2_nv hdrs[] = {
+		MAKE_NV2(":status", "200"),
+		MAKE_NV2("content-type", DNS_MEDIA_TYPE),
+		MAKE_NV("content-length", sock->h2->clenbuf,
+			content_len_buf_len),
+		cache_control_buf_len == 0
+			? (nghttp2_nv)MAKE_NV2("cache-control",
+					       DEFAULT_CACHE_CONTROL)
+			: (nghttp2_nv)MAKE_NV("cache-control",
+					      sock->h2->cache_control_buf,
+					      cache_control_buf_len)
+	};
 
 	result = server_send_response(handle->httpsession->ngsession,
 				      sock->h2->stream_id, hdrs,
@@ -3506,52 +3551,79 @@ static const bool base64url_validation_table[256] = {
 	false, false, false, false, false, false
 };
 
-char *
-isc__nm_base64url_to_base64(isc_mem_t *mem, const char *base64url,
-			    const size_t base64url_len, size_t *res_len) {
-	char *res = NULL;
-	size_t i, k, len;
+static int
+base64url_value(const unsigned char c) {
+	if (c >= 'A' && c <= 'Z') {
+		return c - 'A';
+	} else if (c >= 'a' && c <= 'z') {
+		return c - 'a' + 26;
+	} else if (c >= '0' && c <= '9') {
+		return c - '0' + 52;
+	} else if (c == '-') {
+		return 62;
+	} else if (c == '_') {
+		return 63;
+	}
+	return -1;
+}
 
-	if (mem == NULL || base64url == NULL || base64url_len == 0) {
-		return NULL;
+isc_result_t
+isc__nm_base64url_decode(const char *base64url, const size_t base64url_len,
+			 isc_buffer_t *target) {
+	const unsigned char *in = (const unsigned char *)base64url;
+	size_t tail, i;
+	uint32_t acc = 0;
+	unsigned char *out = NULL;
+
+	REQUIRE(base64url != NULL);
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	tail = base64url_len % 4;
+	if (base64url_len == 0 || tail == 1) {
+		return ISC_R_BADBASE64;
 	}
 
-	len = base64url_len % 4 ? base64url_len + (4 - base64url_len % 4)
-				: base64url_len;
-	res = isc_mem_allocate(mem, len + 1); /* '\0' */
+	if (isc_buffer_availablelength(target) <
+	    BASE64URL_DECODED_LEN(base64url_len))
+	{
+		return ISC_R_NOSPACE;
+	}
 
+	out = isc_buffer_used(target);
 	for (i = 0; i < base64url_len; i++) {
-		switch (base64url[i]) {
-		case '-':
-			res[i] = '+';
-			break;
-		case '_':
-			res[i] = '/';
-			break;
-		default:
-			if (base64url_validation_table[(size_t)base64url[i]]) {
-				res[i] = base64url[i];
-			} else {
-				isc_mem_free(mem, res);
-				return NULL;
-			}
-			break;
+		int v = base64url_value(in[i]);
+		if (v < 0) {
+			return ISC_R_BADBASE64;
+		}
+		acc = (acc << 6) | (uint32_t)v;
+		if (i % 4 == 3) {
+			*out++ = (acc >> 16) & 0xff;
+			*out++ = (acc >> 8) & 0xff;
+			*out++ = acc & 0xff;
+			acc = 0;
 		}
 	}
 
-	if (base64url_len % 4 != 0) {
-		for (k = 0; k < (4 - base64url_len % 4); k++, i++) {
-			res[i] = '=';
+	/*
+	 * Unpadded final group: two characters carry one octet and three
+	 * characters carry two.  The leftover bits must be zero.
+	 */
+	if (tail == 2) {
+		if ((acc & 0x0f) != 0) {
+			return ISC_R_BADBASE64;
+		}
+		*out++ = (acc >> 4) & 0xff;
+	} else if (tail == 3) {
+		if ((acc & 0x03) != 0) {
+			return ISC_R_BADBASE64;
 		}
+		*out++ = (acc >> 10) & 0xff;
+		*out++ = (acc >> 2) & 0xff;
 	}
 
-	INSIST(i == len);
-
-	SET_IF_NOT_NULL(res_len, len);
+	isc_buffer_add(target, out - (unsigned char *)isc_buffer_used(target));
 
-	res[len] = '\0';
-
-	return res;
+	return ISC_R_SUCCESS;
 }
 
 char *
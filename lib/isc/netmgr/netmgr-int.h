@@ -112,6 +112,18 @@ STATIC_ASSERT(ISC_NETMGR_TCP_RECVBUF_SIZE <= ISC_NETMGR_RECVBUF_SIZE,
  */
 #define NM_MAXSEG (1280 - 20 - 40)
 
+/*%
+ * Steering packets to the loop pinned to the CPU that received them
+ * needs a reuseport program that can read the CPU number, and a way to
+ * pin threads.
+ */
+#if HAVE_SO_REUSEPORT_LB && HAVE_SO_ATTACH_REUSEPORT_CBPF && \
+	HAVE_LINUX_FILTER_H && HAVE_PTHREAD_SETAFFINITY_NP
+#define NM_CPU_AFFINITY 1
+#else
+#define NM_CPU_AFFINITY 0
+#endif
+
 /*%
  * How many isc_nmhandles and isc_nm_uvreqs will we be
  * caching for reuse in a socket.
@@ -219,6 +231,15 @@ typedef struct isc__networker {
 
 	isc_mempool_t *nmsocket_pool;
 	isc_mempool_t *uvreq_pool;
+
+	/*%
+	 * Per-loop load accounting; only updated from the loop's own
+	 * thread, but read by the statistics channel from elsewhere.
+	 */
+	atomic_uint_fast64_t tcp_accepted;
+	atomic_uint_fast32_t tcp_active;
+	atomic_uint_fast32_t requests_active;
+	atomic_uint_fast64_t udp_received;
 } isc__networker_t;
 
 ISC_REFCOUNT_DECL(isc__networker);
@@ -331,6 +352,7 @@ typedef struct isc__netmgr {
 	atomic_uint_fast32_t maxudp;
 
 	bool load_balance_sockets;
+	bool cpu_affinity;
 
 	/*
 	 * Active connections are being closed and new connections are
@@ -458,8 +480,9 @@ struct isc_nm_http_endpoints {
 typedef struct isc_nmsocket_h2 {
 	isc_nmsocket_t *psock; /* owner of the structure */
 	char *request_path;
-	char *query_data;
+	uint8_t *query_data;
 	size_t query_data_len;
+	bool query_present; /* even if it could not be decoded */
 	bool query_too_large;
 
 	isc_buffer_t rbuf;
@@ -626,6 +649,8 @@ struct isc_nmsocket {
 	/*% Child sockets for multi-socket setups */
 	isc_nmsocket_t *children;
 	uint_fast32_t nchildren;
+	/*% Children that joined the reuseport group, with CPU affinity */
+	uint_fast32_t njoined;
 	isc_sockaddr_t iface;
 	isc_nmhandle_t *statichandle;
 	isc_nmhandle_t *outerhandle;
@@ -675,6 +700,11 @@ struct isc_nmsocket {
 	 */
 	bool client;
 
+	/*%
+	 * Accepted incoming connection, counted in the worker's tcp_active.
+	 */
+	bool accepted;
+
 	/*%
 	 * The socket is processing read callback, this is guard to not read
 	 * data before the readcb is back.
@@ -1115,9 +1145,21 @@ bool
 isc__nm_parse_httpquery(const char *query_string, const char **start,
 			size_t *len);
 
-char *
-isc__nm_base64url_to_base64(isc_mem_t *mem, const char *base64url,
-			    const size_t base64url_len, size_t *res_len);
+isc_result_t
+isc__nm_base64url_decode(const char *base64url, const size_t base64url_len,
+			 isc_buffer_t *target);
+/*%<
+ * Decode the unpadded base64url string 'base64url' of length
+ * 'base64url_len' directly into 'target', without converting it to
+ * regular base64 first.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_BADBASE64 if the input is empty, has an invalid length,
+ *	contains characters outside of the base64url alphabet or has
+ *	non-zero trailing bits
+ *\li	#ISC_R_NOSPACE if the decoded data does not fit into 'target'
+ */
 
 char *
 isc__nm_base64_to_base64url(isc_mem_t *mem, const char *base64,
@@ -1353,6 +1395,22 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd);
  * Set the SO_REUSEPORT_LB (or equivalent) socket option on the fd
  */
 
+isc_result_t
+isc__nm_socket_steer_cpu(uv_os_sock_t fd, uint32_t nchildren);
+/*%<
+ * Attach a program to the reuseport group of the fd that hands each
+ * packet or connection to the n-th socket of the group when it arrives
+ * on the CPU that loop n is pinned to.  The sockets must join the group
+ * in the order of their loops.
+ */
+
+isc_result_t
+isc__nm_socket_unsteer_cpu(uv_os_sock_t fd);
+/*%<
+ * Detach the program attached by isc__nm_socket_steer_cpu() from the
+ * reuseport group of the fd, so that the kernel hashes again.
+ */
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family);
 /*%<
@@ -1413,6 +1471,15 @@ isc__nmsocket_barrier_init(isc_nmsocket_t *listener);
  * number of children.
  */
 
+void
+isc__nmsocket_joined(isc_nmsocket_t *sock);
+/*%>
+ * Note that the listener child 'sock' has joined the reuseport group.
+ * With CPU affinity, if an earlier child failed to join, the children
+ * after it don't sit where isc__nm_socket_steer_cpu() expects them, so
+ * the program is detached and the kernel's hashing takes over.
+ */
+
 void
 isc__nmsocket_stop(isc_nmsocket_t *listener);
 /*%>
@@ -29,6 +29,7 @@
 #include <isc/mem.h>
 #include <isc/netaddr.h>
 #include <isc/netmgr.h>
+#include <isc/os.h>
 #include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
@@ -224,6 +225,10 @@ isc_netmgr_create(isc_mem_t *mctx) {
 			.active_sockets = ISC_LIST_INITIALIZER,
 		};
 
+		atomic_init(&worker->tcp_accepted, 0);
+		atomic_init(&worker->tcp_active, 0);
+		atomic_init(&worker->udp_received, 0);
+
 		isc__netmgr_ref(netmgr);
 
 		isc_mem_attach(loop->mctx, &worker->mctx);
@@ -375,6 +380,23 @@ isc_nm_getloadbalancesockets(void) {
 	return isc__netmgr->load_balance_sockets;
 }
 
+void
+isc_nm_getloopload(isc_tid_t tid, isc_nm_loopload_t *load) {
+	REQUIRE(VALID_NM(isc__netmgr));
+	REQUIRE(tid >= 0 && (uint32_t)tid < isc__netmgr->nloops);
+	REQUIRE(load != NULL);
+
+	isc__networker_t *worker = &isc__netmgr->workers[tid];
+
+	*load = (isc_nm_loopload_t){
+		.tcp_accepted = atomic_load_relaxed(&worker->tcp_accepted),
+		.tcp_active = atomic_load_relaxed(&worker->tcp_active),
+		.requests_active =
+			atomic_load_relaxed(&worker->requests_active),
+		.udp_received = atomic_load_relaxed(&worker->udp_received),
+	};
+}
+
 void
 isc_nm_setloadbalancesockets(ISC_ATTR_UNUSED bool enabled) {
 	REQUIRE(VALID_NM(isc__netmgr));
@@ -384,6 +406,63 @@ isc_nm_setloadbalancesockets(ISC_ATTR_UNUSED bool enabled) {
 #endif
 }
 
+#if NM_CPU_AFFINITY
+static void
+networker_setaffinity(void *arg) {
+	isc__networker_t *worker = arg;
+	isc_tid_t tid = worker->loop->tid;
+	int cpu = isc_os_cpu(tid);
+	isc_result_t result = ISC_R_NOTIMPLEMENTED;
+
+	if (cpu >= 0) {
+		result = isc_thread_setaffinity(cpu);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(ISC_LOGCATEGORY_GENERAL, ISC_LOGMODULE_NETMGR,
+			      ISC_LOG_WARNING,
+			      "unable to pin loop %" PRItid " to CPU %d: %s",
+			      tid, cpu, isc_result_totext(result));
+	}
+}
+#endif /* NM_CPU_AFFINITY */
+
+bool
+isc_nm_getcpuaffinity(void) {
+	REQUIRE(VALID_NM(isc__netmgr));
+
+	return isc__netmgr->cpu_affinity;
+}
+
+isc_result_t
+isc_nm_setcpuaffinity(bool enabled) {
+	REQUIRE(VALID_NM(isc__netmgr));
+
+	if (!enabled || isc__netmgr->cpu_affinity) {
+		return ISC_R_SUCCESS;
+	}
+
+#if NM_CPU_AFFINITY
+	if (!isc__netmgr->load_balance_sockets || isc_os_cpu(0) < 0) {
+		return ISC_R_NOTIMPLEMENTED;
+	}
+
+	/* Every loop needs a CPU of its own */
+	if (isc_os_cpu(isc__netmgr->nloops - 1) < 0) {
+		return ISC_R_RANGE;
+	}
+
+	isc__netmgr->cpu_affinity = true;
+	for (size_t i = 0; i < isc__netmgr->nloops; i++) {
+		isc__networker_t *worker = &isc__netmgr->workers[i];
+		isc_async_run(worker->loop, networker_setaffinity, worker);
+	}
+
+	return ISC_R_SUCCESS;
+#else  /* NM_CPU_AFFINITY */
+	return ISC_R_NOTIMPLEMENTED;
+#endif /* NM_CPU_AFFINITY */
+}
+
 uint32_t
 isc_nm_getinitialtimeout(void) {
 	REQUIRE(VALID_NM(isc__netmgr));
@@ -465,6 +544,12 @@ nmsocket_cleanup(void *arg) {
 
 	isc__nm_decstats(sock, STATID_ACTIVE);
 
+	if (sock->accepted) {
+		uint_fast32_t active =
+			atomic_fetch_sub_relaxed(&worker->tcp_active, 1);
+		INSIST(active > 0);
+	}
+
 	REQUIRE(!sock->destroying);
 	sock->destroying = true;
 
@@ -863,6 +948,11 @@ isc___nmhandle_get(isc_nmsocket_t *sock, isc_sockaddr_t const *peer,
 
 	isc___nmsocket_attach(sock, &handle->sock FLARG_PASS);
 
+	if (handle->doreset != NULL) {
+		/* a recycled handle that still carries request state */
+		atomic_fetch_add_relaxed(&sock->worker->requests_active, 1);
+	}
+
 #if ISC_NETMGR_TRACE
 	handle->backtrace_size = isc_backtrace(handle->backtrace, TRACE_SIZE);
 #endif
@@ -977,6 +1067,7 @@ nmhandle_destroy(isc_nmhandle_t *handle) {
 
 	if (handle->doreset != NULL) {
 		handle->doreset(handle->opaque);
+		atomic_fetch_sub_relaxed(&sock->worker->requests_active, 1);
 	}
 
 #if HAVE_LIBNGHTTP2
@@ -1030,6 +1121,18 @@ isc_nmhandle_setdata(isc_nmhandle_t *handle, void *arg,
 		     isc_nm_opaquecb_t doreset, isc_nm_opaquecb_t dofree) {
 	REQUIRE(VALID_NMHANDLE(handle));
 
+	/*
+	 * A live handle with a reset callback is a request being processed;
+	 * see isc_nm_getloopload().
+	 */
+	if (handle->doreset == NULL && doreset != NULL) {
+		atomic_fetch_add_relaxed(&handle->sock->worker->requests_active,
+					 1);
+	} else if (handle->doreset != NULL && doreset == NULL) {
+		atomic_fetch_sub_relaxed(&handle->sock->worker->requests_active,
+					 1);
+	}
+
 	handle->opaque = arg;
 	handle->doreset = doreset;
 	handle->dofree = dofree;
@@ -1874,6 +1977,43 @@ isc__nmsocket_barrier_init(isc_nmsocket_t *listener) {
 	listener->barriers_initialised = true;
 }
 
+void
+isc__nmsocket_joined(isc_nmsocket_t *sock) {
+	isc_nmsocket_t *listener = NULL;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(VALID_NMSOCK(sock->parent));
+
+	if (!isc__netmgr->cpu_affinity) {
+		return;
+	}
+
+	/*
+	 * The children are started one after another, each from the loop
+	 * of the one before, so 'njoined' is never updated concurrently.
+	 */
+	listener = sock->parent;
+	if (listener->njoined++ == (uint32_t)sock->tid) {
+		return;
+	}
+
+	isc_result_t result = isc__nm_socket_unsteer_cpu(sock->fd);
+	switch (result) {
+	case ISC_R_SUCCESS:
+		isc__nmsocket_log(sock, ISC_LOG_WARNING,
+				  "a listener child failed to start, no "
+				  "longer steering by CPU");
+		break;
+	case ISC_R_NOTFOUND:
+		/* Already detached, or the first child never joined */
+		break;
+	default:
+		isc__nmsocket_log(sock, ISC_LOG_ERROR,
+				  "unable to stop steering by CPU: %s",
+				  isc_result_totext(result));
+	}
+}
+
 static void
 isc___nm_connectcb(void *arg) {
 	isc__nm_uvreq_t *uvreq = arg;
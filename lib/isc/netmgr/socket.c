@@ -13,7 +13,13 @@
 
 #include <netinet/in.h>
 
+#if HAVE_LINUX_FILTER_H
+#include <linux/filter.h>
+#endif /* HAVE_LINUX_FILTER_H */
+
 #include <isc/errno.h>
+#include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/result.h>
 #include <isc/uv.h>
 
@@ -221,6 +227,89 @@ isc__nm_socket_reuse_lb(uv_os_sock_t fd) {
 #endif
 }
 
+isc_result_t
+isc__nm_socket_steer_cpu(uv_os_sock_t fd, uint32_t nchildren) {
+#if NM_CPU_AFFINITY
+	isc_result_t result = ISC_R_SUCCESS;
+	struct sock_filter *code = NULL;
+	struct sock_fprog prog;
+	unsigned short len = 0, size;
+
+	REQUIRE(nchildren > 0);
+
+	if (nchildren > (BPF_MAXINSNS - 2) / 2) {
+		return ISC_R_RANGE;
+	}
+	size = 2 * nchildren + 2;
+
+	code = isc_mem_cget(isc__netmgr->mctx, size, sizeof(code[0]));
+
+	/* A = the CPU that received the packet */
+	code[len++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+						   SKF_AD_OFF + SKF_AD_CPU);
+	for (uint32_t i = 0; i < nchildren; i++) {
+		int cpu = isc_os_cpu(i);
+		if (cpu < 0) {
+			CLEANUP(ISC_R_NOTIMPLEMENTED);
+		}
+
+		/* if (A == cpu) return i */
+		code[len++] = (struct sock_filter)BPF_JUMP(
+			BPF_JMP | BPF_JEQ | BPF_K, cpu, 0, 1);
+		code[len++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, i);
+	}
+	/* An index past the end makes the kernel fall back to hashing. */
+	code[len++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K,
+						   UINT32_MAX);
+	INSIST(len == size);
+
+	prog = (struct sock_fprog){ .len = len, .filter = code };
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) == -1)
+	{
+		CLEANUP(isc_errno_toresult(errno));
+	}
+
+cleanup:
+	isc_mem_cput(isc__netmgr->mctx, code, size, sizeof(code[0]));
+	return result;
+#else  /* NM_CPU_AFFINITY */
+	UNUSED(fd);
+	UNUSED(nchildren);
+	return ISC_R_NOTIMPLEMENTED;
+#endif /* NM_CPU_AFFINITY */
+}
+
+isc_result_t
+isc__nm_socket_unsteer_cpu(uv_os_sock_t fd) {
+#if NM_CPU_AFFINITY
+#if defined(SO_DETACH_REUSEPORT_BPF)
+	if (setsockopt(fd, SOL_SOCKET, SO_DETACH_REUSEPORT_BPF, &(int){ 0 },
+		       sizeof(int)) == -1)
+	{
+		return errno == ENOENT ? ISC_R_NOTFOUND
+				       : isc_errno_toresult(errno);
+	}
+#else  /* defined(SO_DETACH_REUSEPORT_BPF) */
+	/* Older kernels can only replace the program with one that hashes */
+	struct sock_filter code[] = {
+		BPF_STMT(BPF_RET | BPF_K, UINT32_MAX),
+	};
+	struct sock_fprog prog = { .len = ARRAY_SIZE(code), .filter = code };
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) == -1)
+	{
+		return isc_errno_toresult(errno);
+	}
+#endif /* defined(SO_DETACH_REUSEPORT_BPF) */
+	return ISC_R_SUCCESS;
+#else  /* NM_CPU_AFFINITY */
+	UNUSED(fd);
+	return ISC_R_NOTIMPLEMENTED;
+#endif /* NM_CPU_AFFINITY */
+}
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family) {
 	/*
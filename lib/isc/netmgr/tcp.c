@@ -74,6 +74,10 @@ accept_connection(isc_nmsocket_t *ssock);
 static void
 quota_accept_cb(void *arg);
 
+static void
+start_tcp_child(isc_sockaddr_t *iface, isc_nmsocket_t *sock, uv_os_sock_t fd,
+		isc_tid_t tid);
+
 static void
 tcp_dbg_log(const isc_nmsocket_t *sock, const isc_result_t result,
 	    const char *msg) {
@@ -413,6 +417,8 @@ start_tcp_child_job(void *arg) {
 		goto done;
 	}
 
+	isc__nmsocket_joined(sock);
+
 	if (sock->tid == 0) {
 		r = uv_tcp_getsockname(&sock->uv_handle.tcp,
 				       (struct sockaddr *)&ss,
@@ -441,6 +447,16 @@ done_result:
 	REQUIRE(!loop->paused);
 
 	if (sock->tid != 0) {
+		/*
+		 * With CPU affinity, the next child is started only now
+		 * that this one has joined the reuseport group.
+		 */
+		if (isc__netmgr->cpu_affinity &&
+		    (uint32_t)sock->tid + 1 < sock->parent->nchildren)
+		{
+			start_tcp_child(&sock->iface, sock->parent, -1,
+					sock->tid + 1);
+		}
 		isc_barrier_wait(&sock->parent->listen_barrier);
 	}
 }
@@ -470,6 +486,17 @@ start_tcp_child(isc_sockaddr_t *iface, isc_nmsocket_t *sock, uv_os_sock_t fd,
 	}
 	REQUIRE(csock->fd >= 0);
 
+	if (isc__netmgr->cpu_affinity && tid == 0) {
+		isc_result_t result =
+			isc__nm_socket_steer_cpu(csock->fd, sock->nchildren);
+		if (result != ISC_R_SUCCESS) {
+			isc__nmsocket_log(csock, ISC_LOG_WARNING,
+					  "unable to steer connections by CPU: "
+					  "%s",
+					  isc_result_totext(result));
+		}
+	}
+
 	if (tid == 0) {
 		start_tcp_child_job(csock);
 	} else {
@@ -517,8 +544,15 @@ isc_nm_listentcp(uint32_t workers, isc_sockaddr_t *iface,
 	result = sock->children[0].result;
 	INSIST(result != ISC_R_UNSET);
 
-	for (size_t i = 1; i < sock->nchildren; i++) {
-		start_tcp_child(iface, sock, fd, i);
+	if (isc__netmgr->cpu_affinity) {
+		/* The rest are started by their predecessors. */
+		if (sock->nchildren > 1) {
+			start_tcp_child(iface, sock, fd, 1);
+		}
+	} else {
+		for (size_t i = 1; i < sock->nchildren; i++) {
+			start_tcp_child(iface, sock, fd, i);
+		}
 	}
 
 	isc_barrier_wait(&sock->listen_barrier);
@@ -989,6 +1023,10 @@ accept_connection(isc_nmsocket_t *csock) {
 
 	isc__nm_incstats(csock, STATID_ACCEPT);
 
+	csock->accepted = true;
+	atomic_fetch_add_relaxed(&csock->worker->tcp_accepted, 1);
+	atomic_fetch_add_relaxed(&csock->worker->tcp_active, 1);
+
 	/*
 	 * The acceptcb needs to attach to the handle if it wants to keep the
 	 * connection alive
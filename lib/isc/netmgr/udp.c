@@ -63,6 +63,10 @@
 static void
 udp_send_cb(uv_udp_send_t *req, int status);
 
+static void
+start_udp_child(isc_sockaddr_t *iface, isc_nmsocket_t *sock, uv_os_sock_t fd,
+		isc_tid_t tid);
+
 static void
 udp_close_cb(uv_handle_t *handle);
 
@@ -156,6 +160,8 @@ start_udp_child_job(void *arg) {
 		sock->uv_handle.udp.flags = sock->parent->uv_handle.udp.flags;
 	}
 
+	isc__nmsocket_joined(sock);
+
 	isc__nm_set_network_buffers(&sock->uv_handle.handle);
 
 	r = uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
@@ -173,6 +179,17 @@ done:
 	REQUIRE(!loop->paused);
 
 	if (sock->tid != 0) {
+		/*
+		 * With CPU affinity, the children are started one after
+		 * another, so that they join the reuseport group in loop
+		 * order; see isc__nm_socket_steer_cpu().
+		 */
+		if (isc__netmgr->cpu_affinity &&
+		    (uint32_t)sock->tid + 1 < sock->parent->nchildren)
+		{
+			start_udp_child(&sock->iface, sock->parent, -1,
+					sock->tid + 1);
+		}
 		isc_barrier_wait(&sock->parent->listen_barrier);
 	}
 }
@@ -196,6 +213,16 @@ start_udp_child(isc_sockaddr_t *iface, isc_nmsocket_t *sock, uv_os_sock_t fd,
 	}
 	INSIST(csock->fd >= 0);
 
+	if (isc__netmgr->cpu_affinity && tid == 0) {
+		isc_result_t result =
+			isc__nm_socket_steer_cpu(csock->fd, sock->nchildren);
+		if (result != ISC_R_SUCCESS) {
+			isc__nmsocket_log(csock, ISC_LOG_WARNING,
+					  "unable to steer packets by CPU: %s",
+					  isc_result_totext(result));
+		}
+	}
+
 	if (tid == 0) {
 		start_udp_child_job(csock);
 	} else {
@@ -243,8 +270,15 @@ isc_nm_listenudp(uint32_t workers, isc_sockaddr_t *iface, isc_nm_recv_cb_t cb,
 	result = sock->children[0].result;
 	INSIST(result != ISC_R_UNSET);
 
-	for (size_t i = 1; i < sock->nchildren; i++) {
-		start_udp_child(iface, sock, fd, i);
+	if (isc__netmgr->cpu_affinity) {
+		/* The rest are started by their predecessors. */
+		if (sock->nchildren > 1) {
+			start_udp_child(iface, sock, fd, 1);
+		}
+	} else {
+		for (size_t i = 1; i < sock->nchildren; i++) {
+			start_udp_child(iface, sock, fd, i);
+		}
 	}
 
 	isc_barrier_wait(&sock->listen_barrier);
@@ -540,6 +574,10 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	INSIST(addr != NULL);
 
+	if (sock->parent != NULL) {
+		atomic_fetch_add_relaxed(&sock->worker->udp_received, 1);
+	}
+
 	if (!sock->route_sock) {
 		result = isc_sockaddr_fromsockaddr(&sockaddr, addr);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
@@ -31,6 +31,30 @@ static mode_t isc__os_umask = 0;
 static int kernel_major = -1, kernel_minor = -1, kernel_patch = -1;
 static char kernel_name[64];
 
+#if defined(__linux__) && defined(HAVE_SCHED_GETAFFINITY)
+#include <sched.h>
+
+/*
+ * The CPUs we may run on, as set by 'taskset' or similar.  This is read
+ * once at startup, because pinning threads changes what the calling
+ * thread would see later.
+ */
+static cpu_set_t isc__os_cpuset;
+static int isc__os_ncpuset = 0;
+
+static void
+cpuset_initialize(void) {
+	if (sched_getaffinity(0, sizeof(isc__os_cpuset), &isc__os_cpuset) ==
+	    0)
+	{
+		isc__os_ncpuset = CPU_COUNT(&isc__os_cpuset);
+	}
+}
+#else  /* if defined(__linux__) && defined(HAVE_SCHED_GETAFFINITY) */
+static void
+cpuset_initialize(void) {}
+#endif /* if defined(__linux__) && defined(HAVE_SCHED_GETAFFINITY) */
+
 /*
  * The affinity support for non-Linux is in the review in the upstream
  * yet, but will be included in the upcoming version of libuv.
@@ -200,6 +224,25 @@ isc_os_ncpus(void) {
 	return isc__os_ncpus;
 }
 
+int
+isc_os_cpu(unsigned int n) {
+#if defined(__linux__) && defined(HAVE_SCHED_GETAFFINITY)
+	if (n >= (unsigned int)isc__os_ncpuset) {
+		return -1;
+	}
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &isc__os_cpuset) && n-- == 0) {
+			return cpu;
+		}
+	}
+#else  /* if defined(__linux__) && defined(HAVE_SCHED_GETAFFINITY) */
+	UNUSED(n);
+#endif /* if defined(__linux__) && defined(HAVE_SCHED_GETAFFINITY) */
+
+	return -1;
+}
+
 unsigned long
 isc_os_cacheline(void) {
 	return isc__os_cacheline;
@@ -222,6 +265,7 @@ void
 isc__os_initialize(void) {
 	umask_initialize();
 	ncpus_initialize();
+	cpuset_initialize();
 	kernel_initialize();
 #if defined(_SC_LEVEL1_DCACHE_LINESIZE)
 	long s = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
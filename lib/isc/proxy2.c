@@ -553,8 +553,118 @@ isc__proxy2_handler_handle_data(isc_proxy2_handler_t *restrict handler) {
 	return false;
 }
 
+/*
+ * A fast path for the most common case: a complete "PROXY" header
+ * carrying only IPv4 or IPv6 TCP/UDP addresses (no TLVs) that is
+ * available in the buffer in its entirety, as is always the case for
+ * datagrams and almost always the case for the first read on a stream.
+ * Such a header has a fixed layout and can be verified and decoded
+ * with a few loads instead of going through the state machine.
+ *
+ * Returns 'false' without touching the handler state if the header is
+ * anything else, in which case the generic code takes over (and
+ * reports errors, if any).
+ */
+static inline bool
+isc__proxy2_handler_handle_fast(isc_proxy2_handler_t *restrict handler) {
+	isc_region_t remaining = { 0 };
+	isc_sockaddr_t src_addr = { 0 }, dst_addr = { 0 };
+	const uint8_t *p = NULL;
+	isc_proxy2_addrfamily_t addrfamily;
+	isc_proxy2_socktype_t socktype;
+	size_t addrs_size, addr_size;
+	uint16_t len, src_port, dst_port;
+
+	isc_buffer_remainingregion(&handler->hdrbuf, &remaining);
+	if (remaining.length < ISC_PROXY2_MIN_AF_INET_SIZE) {
+		return false;
+	}
+
+	p = remaining.base;
+	if (memcmp(p, ISC_PROXY2_HEADER_SIGNATURE,
+		   ISC_PROXY2_HEADER_SIGNATURE_SIZE) != 0)
+	{
+		return false;
+	}
+	p += ISC_PROXY2_HEADER_SIGNATURE_SIZE;
+
+	/* version 2, "PROXY" command */
+	if (p[0] != ((2 << 4) | ISC_PROXY2_CMD_PROXY)) {
+		return false;
+	}
+
+	addrfamily = (isc_proxy2_addrfamily_t)(p[1] >> 4);
+	socktype = (isc_proxy2_socktype_t)(p[1] & 0xFU);
+	len = ((uint16_t)p[2] << 8) | p[3];
+	p += 4;
+
+	switch (addrfamily) {
+	case ISC_PROXY2_AF_INET:
+		addrs_size = ISC_PROXY2_MIN_AF_INET_SIZE -
+			     ISC_PROXY2_HEADER_SIZE;
+		addr_size = sizeof(src_addr.type.sin.sin_addr.s_addr);
+		break;
+	case ISC_PROXY2_AF_INET6:
+		addrs_size = ISC_PROXY2_MIN_AF_INET6_SIZE -
+			     ISC_PROXY2_HEADER_SIZE;
+		addr_size = sizeof(src_addr.type.sin6.sin6_addr);
+		break;
+	default:
+		return false;
+	}
+
+	if ((socktype != ISC_PROXY2_SOCK_STREAM &&
+	     socktype != ISC_PROXY2_SOCK_DGRAM) ||
+	    len != addrs_size ||
+	    remaining.length < ISC_PROXY2_HEADER_SIZE + addrs_size ||
+	    (handler->max_size > 0 &&
+	     ISC_PROXY2_HEADER_SIZE + addrs_size > handler->max_size))
+	{
+		return false;
+	}
+
+	src_port = ((uint16_t)p[2 * addr_size] << 8) | p[2 * addr_size + 1];
+	dst_port = ((uint16_t)p[2 * addr_size + 2] << 8) |
+		   p[2 * addr_size + 3];
+	if (addrfamily == ISC_PROXY2_AF_INET) {
+		isc_sockaddr_fromin(&src_addr, (const void *)p, src_port);
+		isc_sockaddr_fromin(&dst_addr, (const void *)(p + addr_size),
+				    dst_port);
+	} else {
+		isc_sockaddr_fromin6(&src_addr, (const void *)p, src_port);
+		isc_sockaddr_fromin6(&dst_addr, (const void *)(p + addr_size),
+				     dst_port);
+	}
+
+	handler->cmd = ISC_PROXY2_CMD_PROXY;
+	handler->proxy_addr_family = addrfamily;
+	handler->proxy_socktype = socktype;
+	handler->header_size = ISC_PROXY2_HEADER_SIZE + addrs_size;
+	handler->tlv_data_size = 0;
+	handler->tlv_data = (isc_region_t){ 0 };
+	handler->expect_data = 0;
+
+	isc_buffer_forward(&handler->hdrbuf, handler->header_size);
+	isc_buffer_remainingregion(&handler->hdrbuf, &handler->extra_data);
+
+	handler->state = ISC_PROXY2_STATE_END;
+
+	isc__proxy2_handler_callcb(handler, ISC_R_SUCCESS, handler->cmd,
+				   handler->proxy_socktype, &src_addr,
+				   &dst_addr, &handler->tlv_data,
+				   &handler->extra_data);
+
+	return true;
+}
+
 static inline isc_result_t
 isc__proxy2_handler_process_data(isc_proxy2_handler_t *restrict handler) {
+	if (handler->state == ISC_PROXY2_STATE_WAITING_SIGNATURE &&
+	    isc__proxy2_handler_handle_fast(handler))
+	{
+		return handler->result;
+	}
+
 	while (isc__proxy2_handler_handle_data(handler)) {
 		if (handler->state == ISC_PROXY2_STATE_END) {
 			break;
@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * This is an open-addressing hash table with SIMD group probing, after
+ * the design of Google's "Swiss tables" [a] [b].
+ *
+ * The slots are split into aligned groups of GROUP_SIZE.  Every slot has a
+ * control byte, which is either CTRL_EMPTY, CTRL_DELETED (a tombstone) or,
+ * for a used slot, the low seven bits of its hash value.  A lookup picks a
+ * start group from the high bits of the hash value, compares all control
+ * bytes of the group against the seven-bit fingerprint at once, checks the
+ * full hash value of the candidate slots and only then calls the match
+ * function.  It stops at the first group that has an empty slot; otherwise
+ * it continues with the next group of a triangular probe sequence, which
+ * visits every group of a power-of-two sized table.
+ *
+ * With SSE2, a group is 16 slots wide and is probed with one compare and
+ * a movemask.  Everywhere else (including NEON, where the 8-byte SWAR
+ * variant is as fast as the vector one) a group is 8 slots wide and probed
+ * with 64-bit arithmetic.
+ *
+ * Resizing is incremental, as in isc_hashmap: the new table becomes the
+ * current one and each subsequent add or delete moves one group of the old
+ * table over.  Lookups check both tables while the move is in progress.
+ *
+ * a. https://abseil.io/about/design/swisstables
+ * b. https://www.youtube.com/watch?v=ncHmEUmJZf4
+ */
+
+#include <inttypes.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif /* defined(__SSE2__) */
+
+#include <isc/atomic.h>
+#include <isc/bit.h>
+#include <isc/endian.h>
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/swisstable.h>
+#include <isc/types.h>
+#include <isc/util.h>
+
+#define ISC_SWISSTABLE_MAGIC	   ISC_MAGIC('S', 'w', 'T', 'b')
+#define ISC_SWISSTABLE_VALID(table) ISC_MAGIC_VALID(table, ISC_SWISSTABLE_MAGIC)
+
+/* We have two tables for incremental rehashing */
+#define SWISSTABLE_NUM_TABLES 2
+
+#define HASHSIZE(bits) (UINT64_C(1) << (bits))
+
+#define CTRL_EMPTY   0x80
+#define CTRL_DELETED 0xfe
+#define CTRL_H2(hv)  ((uint8_t)((hv) & 0x7f))
+
+#if defined(__SSE2__)
+typedef __m128i	 group_t;
+typedef uint32_t bitmask_t;
+#define GROUP_BITS    4
+#define BITMASK_SHIFT 0
+#else /* defined(__SSE2__) */
+typedef uint64_t group_t;
+typedef uint64_t bitmask_t;
+#define GROUP_BITS    3
+#define BITMASK_SHIFT 3
+#define GROUP_LSBS    UINT64_C(0x0101010101010101)
+#define GROUP_MSBS    UINT64_C(0x8080808080808080)
+#endif /* defined(__SSE2__) */
+
+#define GROUP_SIZE (1U << GROUP_BITS)
+
+/*
+ * The table always has at least two groups, and the group index is taken
+ * from the hash value with isc_hash_bits32().
+ */
+#define SWISSTABLE_MIN_BITS (GROUP_BITS + 1)
+#define SWISSTABLE_MAX_BITS 28U
+
+/* Used slots (including tombstones) may fill 7/8 of the table */
+#define MAX_LOAD(size) ((size) - (size) / 8)
+
+typedef struct swisstable_slot {
+	const void *key;
+	void *value;
+	uint32_t hashval;
+} swisstable_slot_t;
+
+typedef struct swisstable_table {
+	size_t size;
+	size_t used; /* full slots and tombstones */
+	uint8_t bits;
+	uint8_t *ctrl;
+	swisstable_slot_t *slots;
+} swisstable_table_t;
+
+struct isc_swisstable {
+	unsigned int magic;
+	uint8_t hindex;
+	size_t hiter; /* next group of the old table to move */
+	isc_mem_t *mctx;
+	size_t count;
+	swisstable_table_t tables[SWISSTABLE_NUM_TABLES];
+	atomic_uint_fast32_t iterators;
+};
+
+struct isc_swisstable_iter {
+	isc_swisstable_t *table;
+	size_t i;
+	size_t size;
+	uint8_t hindex;
+	swisstable_slot_t *cur;
+};
+
+/*
+ * Group operations.  The bitmasks have one bit (SSE2) or one byte (SWAR)
+ * per slot; group_next() returns the lowest slot and clears it.
+ */
+#if defined(__SSE2__)
+static group_t
+group_load(const uint8_t *ctrl) {
+	return _mm_loadu_si128((const __m128i *)ctrl);
+}
+
+static bitmask_t
+group_match(group_t group, uint8_t h2) {
+	return (bitmask_t)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+}
+
+static bitmask_t
+group_match_empty(group_t group) {
+	return (bitmask_t)_mm_movemask_epi8(
+		_mm_cmpeq_epi8(group, _mm_set1_epi8((char)CTRL_EMPTY)));
+}
+
+static bitmask_t
+group_match_free(group_t group) {
+	/* Empty and deleted slots are the ones with the high bit set */
+	return (bitmask_t)_mm_movemask_epi8(group);
+}
+
+static bitmask_t
+group_match_full(group_t group) {
+	return group_match_free(group) ^ 0xffff;
+}
+#else /* defined(__SSE2__) */
+static group_t
+group_load(const uint8_t *ctrl) {
+	uint64_t group;
+
+	memcpy(&group, ctrl, sizeof(group));
+
+	return le64toh(group);
+}
+
+static bitmask_t
+group_match(group_t group, uint8_t h2) {
+	/*
+	 * This can report a false positive for a full slot right above a
+	 * real match; that is harmless, because the full hash value is
+	 * compared before the match function is called.
+	 */
+	uint64_t x = group ^ (GROUP_LSBS * h2);
+
+	return (x - GROUP_LSBS) & ~x & GROUP_MSBS;
+}
+
+static bitmask_t
+group_match_empty(group_t group) {
+	/* CTRL_EMPTY is the only control byte with bit 7 set and bit 1 clear */
+	return group & ~(group << 6) & GROUP_MSBS;
+}
+
+static bitmask_t
+group_match_free(group_t group) {
+	return group & GROUP_MSBS;
+}
+
+static bitmask_t
+group_match_full(group_t group) {
+	return ~group & GROUP_MSBS;
+}
+#endif /* defined(__SSE2__) */
+
+static size_t
+group_next(bitmask_t *mask) {
+	size_t slot = stdc_trailing_zeros(*mask) >> BITMASK_SHIFT;
+
+	*mask &= *mask - 1;
+
+	return slot;
+}
+
+static uint8_t
+swisstable_nexttable(uint8_t idx) {
+	return (idx == 0) ? 1 : 0;
+}
+
+static bool
+rehashing_in_progress(const isc_swisstable_t *table) {
+	return table->tables[swisstable_nexttable(table->hindex)].ctrl != NULL;
+}
+
+static void
+swisstable_create_table(isc_swisstable_t *table, const uint8_t idx,
+			const uint8_t bits) {
+	swisstable_table_t *t = &table->tables[idx];
+
+	REQUIRE(t->ctrl == NULL);
+	REQUIRE(bits >= SWISSTABLE_MIN_BITS);
+	REQUIRE(bits <= SWISSTABLE_MAX_BITS);
+
+	*t = (swisstable_table_t){
+		.bits = bits,
+		.size = HASHSIZE(bits),
+	};
+
+	t->ctrl = isc_mem_get(table->mctx, t->size);
+	memset(t->ctrl, CTRL_EMPTY, t->size);
+	t->slots = isc_mem_cget(table->mctx, t->size, sizeof(t->slots[0]));
+}
+
+static void
+swisstable_free_table(isc_swisstable_t *table, const uint8_t idx) {
+	swisstable_table_t *t = &table->tables[idx];
+
+	isc_mem_put(table->mctx, t->ctrl, t->size);
+	isc_mem_cput(table->mctx, t->slots, t->size, sizeof(t->slots[0]));
+
+	*t = (swisstable_table_t){ 0 };
+}
+
+/*
+ * Triangular probing: the start group, then +1, +2, +3... groups further.
+ */
+#define PROBE_FOREACH(t, hashval, g, i)                                     \
+	for (size_t i = 0,                                                  \
+		    g = isc_hash_bits32(hashval, (t)->bits - GROUP_BITS);   \
+	     i < ((t)->size >> GROUP_BITS);                                 \
+	     i++, g = (g + i) & (((t)->size >> GROUP_BITS) - 1))
+
+static swisstable_slot_t *
+table_find(const swisstable_table_t *t, const uint32_t hashval,
+	   isc_swisstable_match_fn match, const void *key) {
+	PROBE_FOREACH(t, hashval, g, i) {
+		size_t base = g << GROUP_BITS;
+		group_t group = group_load(t->ctrl + base);
+		bitmask_t mask = group_match(group, CTRL_H2(hashval));
+
+		while (mask != 0) {
+			swisstable_slot_t *slot =
+				&t->slots[base + group_next(&mask)];
+
+			if (slot->hashval == hashval &&
+			    match(slot->value, key))
+			{
+				return slot;
+			}
+		}
+
+		if (group_match_empty(group) != 0) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Claim the first free slot on the probe sequence; the caller has checked
+ * that the key isn't present.
+ */
+static swisstable_slot_t *
+table_insert(swisstable_table_t *t, const uint32_t hashval) {
+	PROBE_FOREACH(t, hashval, g, i) {
+		size_t base = g << GROUP_BITS;
+		bitmask_t mask = group_match_free(group_load(t->ctrl + base));
+
+		if (mask != 0) {
+			size_t pos = base + group_next(&mask);
+
+			if (t->ctrl[pos] == CTRL_EMPTY) {
+				t->used++;
+			}
+			t->ctrl[pos] = CTRL_H2(hashval);
+
+			return &t->slots[pos];
+		}
+	}
+
+	UNREACHABLE();
+}
+
+static void
+table_erase(swisstable_table_t *t, swisstable_slot_t *slot) {
+	size_t pos = slot - t->slots;
+	size_t base = pos & ~((size_t)GROUP_SIZE - 1);
+
+	/*
+	 * If the group still has an empty slot, no probe sequence has ever
+	 * continued past it, so the slot can become empty again; otherwise
+	 * it has to stay a tombstone.
+	 */
+	if (group_match_empty(group_load(t->ctrl + base)) != 0) {
+		t->ctrl[pos] = CTRL_EMPTY;
+		t->used--;
+	} else {
+		t->ctrl[pos] = CTRL_DELETED;
+	}
+
+	*slot = (swisstable_slot_t){ 0 };
+}
+
+static swisstable_slot_t *
+swisstable_find(const isc_swisstable_t *table, const uint32_t hashval,
+		isc_swisstable_match_fn match, const void *key,
+		uint8_t *idxp) {
+	uint8_t idx = table->hindex;
+	swisstable_slot_t *slot = table_find(&table->tables[idx], hashval,
+					     match, key);
+
+	if (slot == NULL && rehashing_in_progress(table)) {
+		idx = swisstable_nexttable(idx);
+		slot = table_find(&table->tables[idx], hashval, match, key);
+	}
+
+	SET_IF_NOT_NULL(idxp, idx);
+	return slot;
+}
+
+static void
+swisstable_rehash_one(isc_swisstable_t *table) {
+	uint8_t oldidx = swisstable_nexttable(table->hindex);
+	swisstable_table_t *old = &table->tables[oldidx];
+	swisstable_table_t *new = &table->tables[table->hindex];
+	size_t base = table->hiter << GROUP_BITS;
+	bitmask_t mask = group_match_full(group_load(old->ctrl + base));
+
+	/* Don't rehash when iterating */
+	INSIST(atomic_load_acquire(&table->iterators) == 0);
+
+	while (mask != 0) {
+		size_t pos = base + group_next(&mask);
+		swisstable_slot_t *slot = table_insert(new,
+						       old->slots[pos].hashval);
+
+		*slot = old->slots[pos];
+
+		/* Keep the probe sequences of the old table intact */
+		old->ctrl[pos] = CTRL_DELETED;
+	}
+
+	table->hiter++;
+
+	/* Rehashing complete */
+	if (table->hiter == old->size >> GROUP_BITS) {
+		swisstable_free_table(table, oldidx);
+		table->hiter = 0;
+	}
+}
+
+static void
+swisstable_rehash_start(isc_swisstable_t *table, uint8_t bits) {
+	uint8_t newidx = swisstable_nexttable(table->hindex);
+
+	REQUIRE(!rehashing_in_progress(table));
+
+	swisstable_create_table(table, newidx, bits);
+	table->hindex = newidx;
+	table->hiter = 0;
+}
+
+/*
+ * The new table must take the live entries at half the maximum load, so
+ * that the adds made while the old table is being moved over still fit.
+ * When the table is full mostly of tombstones this rehashes to the same
+ * size.
+ */
+static uint8_t
+grow_bits(isc_swisstable_t *table) {
+	uint8_t bits = table->tables[table->hindex].bits;
+
+	while (bits < SWISSTABLE_MAX_BITS &&
+	       table->count >= MAX_LOAD(HASHSIZE(bits)) / 2)
+	{
+		bits++;
+	}
+
+	return bits;
+}
+
+static bool
+over_threshold(isc_swisstable_t *table) {
+	swisstable_table_t *t = &table->tables[table->hindex];
+
+	return t->used >= MAX_LOAD(t->size);
+}
+
+static bool
+under_threshold(isc_swisstable_t *table) {
+	swisstable_table_t *t = &table->tables[table->hindex];
+
+	return t->bits > SWISSTABLE_MIN_BITS && table->count < t->size / 16;
+}
+
+void
+isc_swisstable_create(isc_mem_t *mctx, uint8_t bits,
+		      isc_swisstable_t **tablep) {
+	isc_swisstable_t *table = NULL;
+
+	REQUIRE(tablep != NULL && *tablep == NULL);
+	REQUIRE(mctx != NULL);
+	REQUIRE(bits >= 1 && bits <= SWISSTABLE_MAX_BITS);
+
+	table = isc_mem_get(mctx, sizeof(*table));
+	*table = (isc_swisstable_t){
+		.magic = ISC_SWISSTABLE_MAGIC,
+	};
+	isc_mem_attach(mctx, &table->mctx);
+
+	swisstable_create_table(table, 0, ISC_MAX(bits, SWISSTABLE_MIN_BITS));
+
+	*tablep = table;
+}
+
+void
+isc_swisstable_destroy(isc_swisstable_t **tablep) {
+	isc_swisstable_t *table = NULL;
+
+	REQUIRE(tablep != NULL && ISC_SWISSTABLE_VALID(*tablep));
+
+	table = *tablep;
+	*tablep = NULL;
+
+	table->magic = 0;
+
+	INSIST(atomic_load_acquire(&table->iterators) == 0);
+
+	for (size_t i = 0; i < SWISSTABLE_NUM_TABLES; i++) {
+		if (table->tables[i].ctrl != NULL) {
+			swisstable_free_table(table, i);
+		}
+	}
+
+	isc_mem_putanddetach(&table->mctx, table, sizeof(*table));
+}
+
+isc_result_t
+isc_swisstable_find(const isc_swisstable_t *table, const uint32_t hashval,
+		    isc_swisstable_match_fn match, const void *key,
+		    void **valuep) {
+	REQUIRE(ISC_SWISSTABLE_VALID(table));
+	REQUIRE(valuep == NULL || *valuep == NULL);
+
+	swisstable_slot_t *slot = swisstable_find(table, hashval, match, key,
+						  NULL);
+	if (slot == NULL) {
+		return ISC_R_NOTFOUND;
+	}
+
+	INSIST(slot->key != NULL);
+	SET_IF_NOT_NULL(valuep, slot->value);
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+isc_swisstable_add(isc_swisstable_t *table, const uint32_t hashval,
+		   isc_swisstable_match_fn match, const void *key, void *value,
+		   void **foundp) {
+	REQUIRE(ISC_SWISSTABLE_VALID(table));
+	REQUIRE(key != NULL);
+	REQUIRE(foundp == NULL || *foundp == NULL);
+
+	INSIST(atomic_load_acquire(&table->iterators) == 0);
+
+	if (rehashing_in_progress(table)) {
+		swisstable_rehash_one(table);
+	}
+
+	swisstable_slot_t *slot = swisstable_find(table, hashval, match, key,
+						  NULL);
+	if (slot != NULL) {
+		INSIST(slot->key != NULL);
+		SET_IF_NOT_NULL(foundp, slot->value);
+		return ISC_R_EXISTS;
+	}
+
+	if (!rehashing_in_progress(table) && over_threshold(table)) {
+		swisstable_rehash_start(table, grow_bits(table));
+		swisstable_rehash_one(table);
+	}
+
+	slot = table_insert(&table->tables[table->hindex], hashval);
+	*slot = (swisstable_slot_t){
+		.key = key,
+		.value = value,
+		.hashval = hashval,
+	};
+	table->count++;
+
+	return ISC_R_SUCCESS;
+}
+
+isc_result_t
+isc_swisstable_delete(isc_swisstable_t *table, const uint32_t hashval,
+		      isc_swisstable_match_fn match, const void *key) {
+	REQUIRE(ISC_SWISSTABLE_VALID(table));
+	REQUIRE(key != NULL);
+
+	uint8_t idx;
+
+	if (atomic_load_acquire(&table->iterators) == 0) {
+		if (rehashing_in_progress(table)) {
+			swisstable_rehash_one(table);
+		} else if (under_threshold(table)) {
+			swisstable_rehash_start(
+				table, table->tables[table->hindex].bits - 1);
+			swisstable_rehash_one(table);
+		}
+	}
+
+	swisstable_slot_t *slot = swisstable_find(table, hashval, match, key,
+						  &idx);
+	if (slot == NULL) {
+		return ISC_R_NOTFOUND;
+	}
+
+	INSIST(slot->key != NULL);
+	table_erase(&table->tables[idx], slot);
+	table->count--;
+
+	return ISC_R_SUCCESS;
+}
+
+void
+isc_swisstable_iter_create(isc_swisstable_t *table,
+			   isc_swisstable_iter_t **iterp) {
+	isc_swisstable_iter_t *iter = NULL;
+
+	REQUIRE(ISC_SWISSTABLE_VALID(table));
+	REQUIRE(iterp != NULL && *iterp == NULL);
+
+	iter = isc_mem_get(table->mctx, sizeof(*iter));
+	*iter = (isc_swisstable_iter_t){
+		.table = table,
+		.hindex = table->hindex,
+	};
+
+	(void)atomic_fetch_add_release(&table->iterators, 1);
+
+	*iterp = iter;
+}
+
+void
+isc_swisstable_iter_destroy(isc_swisstable_iter_t **iterp) {
+	isc_swisstable_iter_t *iter = NULL;
+	isc_swisstable_t *table = NULL;
+
+	REQUIRE(iterp != NULL && *iterp != NULL);
+
+	iter = *iterp;
+	*iterp = NULL;
+	table = iter->table;
+	isc_mem_put(table->mctx, iter, sizeof(*iter));
+
+	INSIST(atomic_fetch_sub_release(&table->iterators, 1) > 0);
+}
+
+static isc_result_t
+swisstable_iter_next(isc_swisstable_iter_t *iter) {
+	isc_swisstable_t *table = iter->table;
+	swisstable_table_t *t = &table->tables[iter->hindex];
+
+	while (iter->i < iter->size && t->ctrl[iter->i] >= CTRL_EMPTY) {
+		iter->i++;
+	}
+
+	if (iter->i < iter->size) {
+		iter->cur = &t->slots[iter->i];
+		return ISC_R_SUCCESS;
+	}
+
+	iter->cur = NULL;
+
+	if (iter->hindex == table->hindex && rehashing_in_progress(table)) {
+		/* The groups below 'hiter' have been moved already */
+		iter->hindex = swisstable_nexttable(iter->hindex);
+		iter->i = table->hiter << GROUP_BITS;
+		iter->size = table->tables[iter->hindex].size;
+		return swisstable_iter_next(iter);
+	}
+
+	return ISC_R_NOMORE;
+}
+
+isc_result_t
+isc_swisstable_iter_first(isc_swisstable_iter_t *iter) {
+	REQUIRE(iter != NULL);
+
+	iter->hindex = iter->table->hindex;
+	iter->i = 0;
+	iter->size = iter->table->tables[iter->hindex].size;
+
+	return swisstable_iter_next(iter);
+}
+
+isc_result_t
+isc_swisstable_iter_next(isc_swisstable_iter_t *iter) {
+	REQUIRE(iter != NULL);
+	REQUIRE(iter->cur != NULL);
+
+	iter->i++;
+
+	return swisstable_iter_next(iter);
+}
+
+isc_result_t
+isc_swisstable_iter_delcurrent_next(isc_swisstable_iter_t *iter) {
+	REQUIRE(iter != NULL);
+	REQUIRE(iter->cur != NULL);
+
+	/* Erasing never moves other entries, so iteration is unaffected */
+	table_erase(&iter->table->tables[iter->hindex], iter->cur);
+	iter->table->count--;
+
+	iter->i++;
+
+	return swisstable_iter_next(iter);
+}
+
+void
+isc_swisstable_iter_current(isc_swisstable_iter_t *it, void **valuep) {
+	REQUIRE(it != NULL);
+	REQUIRE(it->cur != NULL);
+	REQUIRE(valuep != NULL && *valuep == NULL);
+
+	*valuep = it->cur->value;
+}
+
+void
+isc_swisstable_iter_currentkey(isc_swisstable_iter_t *it,
+			       const unsigned char **key) {
+	REQUIRE(it != NULL);
+	REQUIRE(it->cur != NULL);
+	REQUIRE(key != NULL && *key == NULL);
+
+	*key = it->cur->key;
+}
+
+unsigned int
+isc_swisstable_count(isc_swisstable_t *table) {
+	REQUIRE(ISC_SWISSTABLE_VALID(table));
+
+	return table->count;
+}
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 
 #include <isc/atomic.h>
+#include <isc/errno.h>
 #include <isc/iterated_hash.h>
 #include <isc/strerr.h>
 #include <isc/thread.h>
@@ -156,6 +157,27 @@ isc_thread_setname(isc_thread_t thread, const char *name) {
 #endif /* if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__APPLE__) */
 }
 
+isc_result_t
+isc_thread_setaffinity(int cpu) {
+#if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(__linux__)
+	cpu_set_t cpus;
+	int ret;
+
+	REQUIRE(cpu >= 0 && cpu < CPU_SETSIZE);
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (ret != 0) {
+		return isc_errno_toresult(ret);
+	}
+	return ISC_R_SUCCESS;
+#else  /* if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(__linux__) */
+	UNUSED(cpu);
+	return ISC_R_NOTIMPLEMENTED;
+#endif /* if defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(__linux__) */
+}
+
 void
 isc_thread_yield(void) {
 #if defined(HAVE_SCHED_YIELD)
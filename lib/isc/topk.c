@@ -0,0 +1,648 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/atomic.h>
+#include <isc/hash.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/pause.h>
+#include <isc/random.h>
+#include <isc/tid.h>
+#include <isc/topk.h>
+#include <isc/util.h>
+
+#define TOPK_MAGIC	   ISC_MAGIC('T', 'o', 'p', 'K')
+#define TOPK_VALID(p)	   ISC_MAGIC_VALID(p, TOPK_MAGIC)
+#define TOPKMULTI_MAGIC	   ISC_MAGIC('T', 'k', 'M', 't')
+#define TOPKMULTI_VALID(p) ISC_MAGIC_VALID(p, TOPKMULTI_MAGIC)
+
+/*
+ * Each row of the count-min sketch is indexed by a different 16-bit
+ * slice of the 64-bit hash value, so four rows use the whole hash.
+ */
+#define ROWS	      4
+#define WIDTH	      1024
+#define INDEX(h, row) (((h) >> ((row) * 16)) & (WIDTH - 1))
+
+/*
+ * The slots of the table are found by hash value in an open-addressing
+ * index with twice as many buckets as slots, so it never fills up.
+ */
+#define BUCKETS	  (2 * ISC_TOPK_ENTRIES)
+#define BUCKET(h) ((h) % BUCKETS)
+
+STATIC_ASSERT(ISC_TOPK_ENTRIES < UINT8_MAX,
+	      "slot numbers must fit in the heap and the index");
+
+typedef struct slot {
+	uint64_t hashval;
+	atomic_uint_least32_t count;
+	unsigned int length;
+	unsigned char key[ISC_TOPK_KEYSIZE];
+} slot_t;
+
+typedef struct hitter {
+	uint64_t hashval;
+	isc_topk_entry_t entry;
+} hitter_t;
+
+/*
+ * A sketch is only updated by one thread, and is not locked.  The
+ * counters and counts are atomic, so that other threads can read them
+ * at any time.  The keys are not, so the owner makes 'generation' odd
+ * while it changes the keys in the table, and readers copy the table
+ * again until it has been even and unchanged for the whole copy.
+ */
+struct isc_topk {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	unsigned int halflife;
+	atomic_uint_least32_t decayed;
+	unsigned int skip; /* calls left until the next sample */
+	atomic_uint_fast32_t generation;
+	unsigned int used;
+	uint8_t heap[ISC_TOPK_ENTRIES];	    /* slots, lowest count first */
+	uint8_t position[ISC_TOPK_ENTRIES]; /* of each slot in 'heap' */
+	uint8_t index[BUCKETS];		    /* slot number + 1, or 0 */
+	atomic_uint_least32_t counters[ROWS][WIDTH];
+	slot_t slots[ISC_TOPK_ENTRIES];
+};
+
+struct isc_topkmulti {
+	unsigned int magic;
+	unsigned int size;
+	unsigned int rate;
+	isc_refcount_t references;
+	isc_topk_t *tk[];
+};
+
+static uint32_t
+estimate(isc_topk_t *tk, uint64_t hashval) {
+	uint32_t count = UINT32_MAX;
+
+	for (size_t row = 0; row < ROWS; row++) {
+		uint32_t counter = atomic_load_relaxed(
+			&tk->counters[row][INDEX(hashval, row)]);
+		count = ISC_MIN(count, counter);
+	}
+
+	return count;
+}
+
+static void
+change_begin(isc_topk_t *tk) {
+	atomic_store_relaxed(&tk->generation,
+			     atomic_load_relaxed(&tk->generation) + 1);
+	atomic_thread_fence(memory_order_release);
+}
+
+static void
+change_end(isc_topk_t *tk) {
+	atomic_store_release(&tk->generation,
+			     atomic_load_relaxed(&tk->generation) + 1);
+}
+
+/*
+ * Copy the keys in the table, which may be changing under us (see
+ * the comment above struct isc_topk), to 'hitters'.
+ */
+ISC_NO_SANITIZE_THREAD static unsigned int
+snapshot(isc_topk_t *tk, hitter_t *hitters) {
+	for (;;) {
+		uint_fast32_t generation = atomic_load_acquire(
+			&tk->generation);
+		unsigned int used;
+
+		if ((generation & 1) != 0) {
+			isc_pause();
+			continue;
+		}
+
+		used = ISC_MIN(tk->used, ISC_TOPK_ENTRIES);
+		for (unsigned int i = 0; i < used; i++) {
+			slot_t *slot = &tk->slots[i];
+			isc_topk_entry_t *entry = &hitters[i].entry;
+
+			hitters[i].hashval = slot->hashval;
+			entry->count = atomic_load_relaxed(&slot->count);
+			entry->length = ISC_MIN(slot->length,
+						ISC_TOPK_KEYSIZE);
+			memmove(entry->key, slot->key, entry->length);
+		}
+
+		atomic_thread_fence(memory_order_acquire);
+		if (atomic_load_relaxed(&tk->generation) == generation) {
+			return used;
+		}
+	}
+}
+
+/*
+ * The table keeps a binary min-heap of its slots, so that the slot with
+ * the lowest count is always heap[0].  Counts only go up between
+ * rebuilds, so an updated slot only ever moves down.
+ */
+static uint32_t
+heapcount(isc_topk_t *tk, unsigned int pos) {
+	return atomic_load_relaxed(&tk->slots[tk->heap[pos]].count);
+}
+
+static void
+heap_swap(isc_topk_t *tk, unsigned int a, unsigned int b) {
+	uint8_t slot = tk->heap[a];
+
+	tk->heap[a] = tk->heap[b];
+	tk->heap[b] = slot;
+	tk->position[tk->heap[a]] = a;
+	tk->position[tk->heap[b]] = b;
+}
+
+static void
+heap_up(isc_topk_t *tk, unsigned int pos) {
+	while (pos > 0) {
+		unsigned int parent = (pos - 1) / 2;
+
+		if (heapcount(tk, parent) <= heapcount(tk, pos)) {
+			break;
+		}
+		heap_swap(tk, parent, pos);
+		pos = parent;
+	}
+}
+
+static void
+heap_down(isc_topk_t *tk, unsigned int pos) {
+	for (;;) {
+		unsigned int child = 2 * pos + 1;
+
+		if (child >= tk->used) {
+			break;
+		}
+		if (child + 1 < tk->used &&
+		    heapcount(tk, child + 1) < heapcount(tk, child))
+		{
+			child++;
+		}
+		if (heapcount(tk, pos) <= heapcount(tk, child)) {
+			break;
+		}
+		heap_swap(tk, pos, child);
+		pos = child;
+	}
+}
+
+static void
+index_add(isc_topk_t *tk, unsigned int slot) {
+	unsigned int b = BUCKET(tk->slots[slot].hashval);
+
+	while (tk->index[b] != 0) {
+		b = (b + 1) % BUCKETS;
+	}
+	tk->index[b] = slot + 1;
+}
+
+/*
+ * Remove a slot from the index, and move back the slots after it that
+ * could not be found any more with a gap before them.
+ */
+static void
+index_del(isc_topk_t *tk, unsigned int slot) {
+	unsigned int b = BUCKET(tk->slots[slot].hashval);
+
+	while (tk->index[b] != slot + 1) {
+		b = (b + 1) % BUCKETS;
+	}
+	tk->index[b] = 0;
+
+	for (unsigned int n = (b + 1) % BUCKETS; tk->index[n] != 0;
+	     n = (n + 1) % BUCKETS)
+	{
+		unsigned int home = BUCKET(tk->slots[tk->index[n] - 1].hashval);
+		bool reachable = (b < n) ? (home > b && home <= n)
+					 : (home > b || home <= n);
+
+		if (!reachable) {
+			tk->index[b] = tk->index[n];
+			tk->index[n] = 0;
+			b = n;
+		}
+	}
+}
+
+static slot_t *
+lookup(isc_topk_t *tk, uint64_t hashval, const void *key, size_t length) {
+	for (unsigned int b = BUCKET(hashval); tk->index[b] != 0;
+	     b = (b + 1) % BUCKETS)
+	{
+		slot_t *slot = &tk->slots[tk->index[b] - 1];
+		if (slot->hashval == hashval && slot->length == length &&
+		    memcmp(slot->key, key, length) == 0)
+		{
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Rebuild the heap and the index after the counts or the slots have
+ * changed wholesale.
+ */
+static void
+rebuild(isc_topk_t *tk) {
+	memset(tk->index, 0, sizeof(tk->index));
+	for (unsigned int i = 0; i < tk->used; i++) {
+		tk->heap[i] = i;
+		tk->position[i] = i;
+		index_add(tk, i);
+	}
+	for (unsigned int i = tk->used / 2; i-- > 0;) {
+		heap_down(tk, i);
+	}
+}
+
+/*
+ * Give the key a place in the table if its count is high enough.
+ * A key that is already there has its count updated, otherwise it
+ * replaces the key with the lowest count.
+ */
+static void
+offer(isc_topk_t *tk, uint64_t hashval, const void *key, size_t length,
+      uint32_t count) {
+	slot_t *slot = NULL;
+	unsigned int i;
+
+	if (tk->used == ISC_TOPK_ENTRIES && count < heapcount(tk, 0)) {
+		return;
+	}
+
+	slot = lookup(tk, hashval, key, length);
+	if (slot != NULL) {
+		atomic_store_relaxed(&slot->count, count);
+		heap_down(tk, tk->position[slot - tk->slots]);
+		return;
+	}
+
+	change_begin(tk);
+
+	if (tk->used < ISC_TOPK_ENTRIES) {
+		i = tk->used++;
+		tk->heap[i] = i;
+		tk->position[i] = i;
+	} else {
+		i = tk->heap[0];
+		index_del(tk, i);
+	}
+
+	slot = &tk->slots[i];
+	slot->hashval = hashval;
+	atomic_store_relaxed(&slot->count, count);
+	slot->length = length;
+	memmove(slot->key, key, length);
+	index_add(tk, i);
+
+	change_end(tk);
+
+	heap_up(tk, tk->position[i]);
+	heap_down(tk, tk->position[i]);
+}
+
+/*
+ * How many times the counts recorded up to 'decayed' have to be halved
+ * by 'now'.
+ */
+static unsigned int
+decayshift(unsigned int halflife, isc_stdtime_t decayed, isc_stdtime_t now) {
+	if (halflife == 0 || decayed == 0 || now < decayed + halflife) {
+		return 0;
+	}
+	return (now - decayed) / halflife;
+}
+
+/*
+ * Halve all the counts once for every half-life that has passed since
+ * the last time we did.
+ */
+static void
+decay(isc_topk_t *tk, isc_stdtime_t now) {
+	isc_stdtime_t decayed = atomic_load_relaxed(&tk->decayed);
+	unsigned int shift, used = 0;
+
+	if (tk->halflife == 0) {
+		return;
+	}
+	if (decayed == 0) {
+		atomic_store_relaxed(&tk->decayed, now);
+		return;
+	}
+
+	shift = decayshift(tk->halflife, decayed, now);
+	if (shift == 0) {
+		return;
+	}
+	atomic_store_relaxed(&tk->decayed, decayed + shift * tk->halflife);
+
+	for (size_t row = 0; row < ROWS; row++) {
+		for (size_t col = 0; col < WIDTH; col++) {
+			atomic_uint_least32_t *counter =
+				&tk->counters[row][col];
+			uint32_t value = atomic_load_relaxed(counter);
+
+			value = (shift >= 32) ? 0 : value >> shift;
+			atomic_store_relaxed(counter, value);
+		}
+	}
+
+	change_begin(tk);
+	for (unsigned int i = 0; i < tk->used; i++) {
+		uint32_t count = atomic_load_relaxed(&tk->slots[i].count);
+
+		count = (shift >= 32) ? 0 : count >> shift;
+		if (count > 0) {
+			slot_t *slot = &tk->slots[used++];
+
+			if (slot != &tk->slots[i]) {
+				slot->hashval = tk->slots[i].hashval;
+				slot->length = tk->slots[i].length;
+				memmove(slot->key, tk->slots[i].key,
+					slot->length);
+			}
+			atomic_store_relaxed(&slot->count, count);
+		}
+	}
+	tk->used = used;
+	change_end(tk);
+
+	rebuild(tk);
+}
+
+void
+isc_topk_create(isc_mem_t *mctx, unsigned int halflife, isc_topk_t **tkp) {
+	REQUIRE(tkp != NULL && *tkp == NULL);
+
+	isc_topk_t *tk = isc_mem_cget(mctx, 1, sizeof(*tk));
+	tk->magic = TOPK_MAGIC;
+	tk->halflife = halflife;
+	isc_mem_attach(mctx, &tk->mctx);
+
+	*tkp = tk;
+}
+
+void
+isc_topk_destroy(isc_topk_t **tkp) {
+	REQUIRE(tkp != NULL && TOPK_VALID(*tkp));
+
+	isc_topk_t *tk = *tkp;
+	*tkp = NULL;
+
+	tk->magic = 0;
+	isc_mem_putanddetach(&tk->mctx, tk, sizeof(*tk));
+}
+
+void
+isc_topk_add(isc_topk_t *tk, const void *key, size_t length, uint32_t inc,
+	     isc_stdtime_t now) {
+	REQUIRE(TOPK_VALID(tk));
+	REQUIRE(key != NULL);
+	REQUIRE(length <= ISC_TOPK_KEYSIZE);
+
+	uint64_t hashval = isc_hash64(key, length, true);
+
+	decay(tk, now);
+
+	/*
+	 * Conservative update: only raise the counters that are below
+	 * the new estimate, which keeps the over-estimates smaller.
+	 */
+	uint32_t count = estimate(tk, hashval);
+	count = (count > UINT32_MAX - inc) ? UINT32_MAX : count + inc;
+	for (size_t row = 0; row < ROWS; row++) {
+		atomic_uint_least32_t *counter =
+			&tk->counters[row][INDEX(hashval, row)];
+		if (atomic_load_relaxed(counter) < count) {
+			atomic_store_relaxed(counter, count);
+		}
+	}
+
+	offer(tk, hashval, key, length, count);
+}
+
+uint32_t
+isc_topk_estimate(isc_topk_t *tk, const void *key, size_t length) {
+	REQUIRE(TOPK_VALID(tk));
+	REQUIRE(key != NULL);
+	REQUIRE(length <= ISC_TOPK_KEYSIZE);
+
+	return estimate(tk, isc_hash64(key, length, true));
+}
+
+void
+isc_topk_merge(isc_topk_t **targetp, isc_topk_t *source, isc_stdtime_t now) {
+	hitter_t hitters[ISC_TOPK_ENTRIES];
+	unsigned int shift, used;
+
+	REQUIRE(targetp != NULL);
+	REQUIRE(*targetp == NULL || TOPK_VALID(*targetp));
+	REQUIRE(TOPK_VALID(source));
+
+	if (*targetp == NULL) {
+		isc_topk_create(source->mctx, source->halflife, targetp);
+	}
+
+	isc_topk_t *target = *targetp;
+	INSIST(target != source);
+
+	/*
+	 * The source belongs to another thread, so instead of decaying
+	 * it, decay what we take from it.
+	 */
+	decay(target, now);
+	shift = decayshift(source->halflife,
+			   atomic_load_relaxed(&source->decayed), now);
+	if (shift >= 32) {
+		return;
+	}
+
+	for (size_t row = 0; row < ROWS; row++) {
+		for (size_t col = 0; col < WIDTH; col++) {
+			atomic_uint_least32_t *counter =
+				&target->counters[row][col];
+			uint32_t value = atomic_load_relaxed(counter);
+			uint32_t inc = atomic_load_relaxed(
+					       &source->counters[row][col]) >>
+				       shift;
+
+			value = (value > UINT32_MAX - inc) ? UINT32_MAX
+							   : value + inc;
+			atomic_store_relaxed(counter, value);
+		}
+	}
+
+	/*
+	 * The estimates of the keys already in the target may have gone
+	 * up, so refresh them before offering the source's keys.
+	 */
+	for (unsigned int i = 0; i < target->used; i++) {
+		slot_t *slot = &target->slots[i];
+		atomic_store_relaxed(&slot->count,
+				     estimate(target, slot->hashval));
+	}
+	rebuild(target);
+
+	used = snapshot(source, hitters);
+	for (unsigned int i = 0; i < used; i++) {
+		hitter_t *hitter = &hitters[i];
+		offer(target, hitter->hashval, hitter->entry.key,
+		      hitter->entry.length, estimate(target, hitter->hashval));
+	}
+}
+
+static int
+hittercmp(const void *a, const void *b) {
+	const hitter_t *ha = a;
+	const hitter_t *hb = b;
+
+	if (ha->entry.count != hb->entry.count) {
+		return ha->entry.count > hb->entry.count ? -1 : 1;
+	}
+	return 0;
+}
+
+size_t
+isc_topk_get(isc_topk_t *tk, isc_topk_entry_t *entries, size_t size) {
+	hitter_t hitters[ISC_TOPK_ENTRIES];
+	unsigned int used;
+	size_t count;
+
+	REQUIRE(TOPK_VALID(tk));
+	REQUIRE(entries != NULL || size == 0);
+
+	used = snapshot(tk, hitters);
+	qsort(hitters, used, sizeof(hitters[0]), hittercmp);
+
+	count = ISC_MIN(size, used);
+	for (size_t i = 0; i < count; i++) {
+		entries[i] = hitters[i].entry;
+	}
+
+	return count;
+}
+
+/**********************************************************************/
+
+void
+isc_topkmulti_create(isc_mem_t *mctx, unsigned int halflife,
+		     unsigned int rate, isc_topkmulti_t **tmp) {
+	REQUIRE(tmp != NULL && *tmp == NULL);
+	REQUIRE(rate > 0 && rate <= ISC_TOPK_MAXRATE);
+
+	unsigned int size = isc_tid_count();
+	INSIST(size > 0);
+
+	isc_topkmulti_t *tm = isc_mem_cget(mctx, 1,
+					   STRUCT_FLEX_SIZE(tm, tk, size));
+	*tm = (isc_topkmulti_t){
+		.magic = TOPKMULTI_MAGIC,
+		.size = size,
+		.rate = rate,
+	};
+
+	for (unsigned int i = 0; i < tm->size; i++) {
+		isc_topk_create(mctx, halflife, &tm->tk[i]);
+	}
+
+	isc_refcount_init(&tm->references, 1);
+
+	*tmp = tm;
+}
+
+static void
+isc__topkmulti_destroy(isc_topkmulti_t *tm) {
+	REQUIRE(TOPKMULTI_VALID(tm));
+
+	isc_mem_t *mctx = NULL;
+	isc_mem_attach(tm->tk[0]->mctx, &mctx);
+
+	for (unsigned int i = 0; i < tm->size; i++) {
+		isc_topk_destroy(&tm->tk[i]);
+	}
+
+	isc_refcount_destroy(&tm->references);
+	tm->magic = 0;
+
+	isc_mem_putanddetach(&mctx, tm, STRUCT_FLEX_SIZE(tm, tk, tm->size));
+}
+
+unsigned int
+isc_topkmulti_getrate(isc_topkmulti_t *tm) {
+	REQUIRE(TOPKMULTI_VALID(tm));
+
+	return tm->rate;
+}
+
+bool
+isc_topkmulti_sample(isc_topkmulti_t *tm) {
+	REQUIRE(TOPKMULTI_VALID(tm));
+
+	isc_tid_t tid = isc_tid();
+	if (tid == ISC_TID_UNKNOWN || (unsigned int)tid >= tm->size) {
+		return false;
+	}
+	if (tm->rate == 1) {
+		return true;
+	}
+
+	/*
+	 * Skip a random number of calls, 'rate' - 1 on average, so that
+	 * periodic traffic is not sampled in step with its period.
+	 */
+	isc_topk_t *tk = tm->tk[tid];
+	if (tk->skip > 0) {
+		tk->skip--;
+		return false;
+	}
+	tk->skip = isc_random_uniform(2 * tm->rate - 1);
+	return true;
+}
+
+void
+isc_topkmulti_add(isc_topkmulti_t *tm, const void *key, size_t length,
+		  isc_stdtime_t now) {
+	REQUIRE(TOPKMULTI_VALID(tm));
+
+	isc_tid_t tid = isc_tid();
+	if (tid == ISC_TID_UNKNOWN || (unsigned int)tid >= tm->size) {
+		return;
+	}
+
+	isc_topk_add(tm->tk[tid], key, length, tm->rate, now);
+}
+
+void
+isc_topkmulti_merge(isc_topk_t **targetp, isc_topkmulti_t *source,
+		    isc_stdtime_t now) {
+	REQUIRE(TOPKMULTI_VALID(source));
+
+	for (unsigned int i = 0; i < source->size; i++) {
+		isc_topk_merge(targetp, source->tk[i], now);
+	}
+}
+
+ISC_REFCOUNT_IMPL(isc_topkmulti, isc__topkmulti_destroy);
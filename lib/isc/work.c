@@ -73,6 +73,9 @@ typedef struct isc__workthread {
 			isc_thread_t thread;
 			struct __cds_wfcq_head qhead;
 			int32_t state; /* enum waitstate */
+			int32_t qlock; /* serializes dequeues */
+			isc_loop_t *peers; /* all the loops, for stealing */
+			uint32_t npeers;
 		};
 		uint8_t __padding0[ISC_OS_CACHELINE_SIZE];
 	};
@@ -82,6 +85,11 @@ typedef struct isc__workthread {
 	};
 } isc__workthread_t;
 
+/*
+ * Work stealing is off by default; see isc_work_setstealing().
+ */
+static bool work_stealing = false;
+
 STATIC_ASSERT(ISC_OS_CACHELINE_SIZE >= sizeof(struct cds_wfcq_tail),
 	      "ISC_OS_CACHELINE_SIZE smaller than sizeof(struct "
 	      "cds_wfcq_tail)");
@@ -104,6 +112,87 @@ workthread_wake(isc__workthread_t *thread) {
 	}
 }
 
+/*
+ * The queues are multi-producer, but __cds_wfcq_dequeue_blocking() needs a
+ * single consumer.  With work stealing a peer may dequeue from our queue as
+ * well, so every dequeue takes 'qlock'.  It is only ever held across a
+ * single dequeue, so the owner simply spins and the thieves just give up.
+ */
+static struct cds_wfcq_node *
+workthread_dequeue(isc__workthread_t *thread, bool trylock) {
+	struct cds_wfcq_node *node = NULL;
+
+	while (uatomic_cmpxchg(&thread->qlock, 0, 1) != 0) {
+		if (trylock) {
+			return NULL;
+		}
+		caa_cpu_relax();
+	}
+
+	node = __cds_wfcq_dequeue_blocking(&thread->qhead, &thread->qtail);
+
+	uatomic_set(&thread->qlock, 0);
+
+	return node;
+}
+
+static bool
+workthread_stealable(isc__workthread_t *thread) {
+	return thread->lane == ISC_WORKLANE_FAST &&
+	       uatomic_load(&work_stealing, CMM_RELAXED);
+}
+
+static isc__workthread_t *
+workthread_peer(isc__workthread_t *thread, uint32_t i) {
+	uint32_t tid = (thread->loop->tid + i) % thread->npeers;
+
+	return thread->peers[tid].workthreads[thread->lane];
+}
+
+/*
+ * Take one task from a peer that is busy running something else; the task
+ * still carries its origin loop, so the completion goes back there.
+ */
+static struct cds_wfcq_node *
+workthread_steal(isc__workthread_t *thread) {
+	for (uint32_t i = 1; i < thread->npeers; i++) {
+		isc__workthread_t *peer = workthread_peer(thread, i);
+
+		if ((uatomic_load(&peer->state, CMM_RELAXED) &
+		     THREAD_RUNNING) == 0 ||
+		    cds_wfcq_empty(&peer->qhead, &peer->qtail))
+		{
+			continue;
+		}
+
+		struct cds_wfcq_node *node = workthread_dequeue(peer, true);
+		if (node != NULL) {
+			return node;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * The worker we've queued to is busy; wake an idle peer, so it can steal the
+ * task if it is still queued by then.
+ */
+static void
+workthread_wake_peer(isc__workthread_t *thread) {
+	for (uint32_t i = 1; i < thread->npeers; i++) {
+		isc__workthread_t *peer = workthread_peer(thread, i);
+		int32_t state = uatomic_load(&peer->state, CMM_RELAXED);
+
+		if ((state & (THREAD_RUNNING | THREAD_WAKEUP | THREAD_STICKY)) ==
+		    0)
+		{
+			workthread_wake(peer);
+			return;
+		}
+	}
+}
+
 static void
 workthread_slumber(isc__workthread_t *thread) {
 	rcu_thread_offline();
@@ -247,9 +336,7 @@ workthread_thread(void *arg) {
 			continue;
 		}
 
-		struct cds_wfcq_node *node;
-		node = __cds_wfcq_dequeue_blocking(&thread->qhead,
-						   &thread->qtail);
+		struct cds_wfcq_node *node = workthread_dequeue(thread, false);
 
 		if (node == NULL) {
 			/*
@@ -267,8 +354,13 @@ workthread_thread(void *arg) {
 				break;
 			}
 
-			workthread_sleep(thread);
+			if (workthread_stealable(thread)) {
+				node = workthread_steal(thread);
+			}
+		}
 
+		if (node == NULL) {
+			workthread_sleep(thread);
 			continue;
 		}
 
@@ -320,12 +412,19 @@ isc_work_enqueue(isc_loop_t *loop, isc_worklane_t lane, isc_work_cb cb,
 		     THREAD_RUNNING) == 0)
 		{
 			workthread_wake(thread);
+		} else if (workthread_stealable(thread)) {
+			workthread_wake_peer(thread);
 		}
 	}
 
 	return work;
 }
 
+void
+isc_work_setstealing(bool enabled) {
+	uatomic_set(&work_stealing, enabled);
+}
+
 bool
 isc_work_cancel(isc_work_t *work) {
 	REQUIRE(VALID_WORK(work));
@@ -350,6 +449,8 @@ isc__workthread_create(isc_loop_t *loop, isc_worklane_t lane) {
 		.magic = WORKTHREAD_MAGIC,
 		.state = THREAD_WAITING,
 		.loop = loop,
+		.peers = isc_loop_get(0),
+		.npeers = isc_loopmgr_nloops(),
 	};
 
 	__cds_wfcq_init(&thread->qhead, &thread->qtail);
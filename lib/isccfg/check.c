@@ -40,6 +40,7 @@
 #include <isc/sockaddr.h>
 #include <isc/string.h>
 #include <isc/symtab.h>
+#include <isc/topk.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
@@ -1913,6 +1914,39 @@ check_options(const cfg_obj_t *options, const cfg_obj_t *config,
 		}
 	}
 
+	obj = NULL;
+	(void)cfg_map_get(options, "resolver-forwarder-spread", &obj);
+	if (obj != NULL && cfg_obj_aspercentage(obj) > 100) {
+		cfg_obj_log(obj, ISC_LOG_ERROR,
+			    "'resolver-forwarder-spread %u%%' exceeds 100%%",
+			    cfg_obj_aspercentage(obj));
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
+	obj = NULL;
+	(void)cfg_map_get(options, "resolver-hedge-percentile", &obj);
+	if (obj != NULL && cfg_obj_asuint32(obj) > 100) {
+		cfg_obj_log(obj, ISC_LOG_ERROR,
+			    "'resolver-hedge-percentile %u' exceeds 100",
+			    cfg_obj_asuint32(obj));
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
+	obj = NULL;
+	(void)cfg_map_get(options, "resolver-hedge-budget", &obj);
+	if (obj != NULL && cfg_obj_aspercentage(obj) > 100) {
+		cfg_obj_log(obj, ISC_LOG_ERROR,
+			    "'resolver-hedge-budget %u%%' exceeds 100%%",
+			    cfg_obj_aspercentage(obj));
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
 	obj = NULL;
 	(void)cfg_map_get(options, "check-names", &obj);
 	if (obj != NULL && !cfg_obj_islist(obj)) {
@@ -2069,9 +2103,15 @@ check_options(const cfg_obj_t *options, const cfg_obj_t *config,
 	}
 
 	check_range_uint32(options, &result, "edns-udp-size", 512, 4096);
+	check_range_uint32(options, &result, "hitters-sample-rate", 0,
+			   ISC_TOPK_MAXRATE);
 	check_range_uint32(options, &result, "max-udp-size", 512, 4096);
 	check_range_uint32(options, &result, "nocookie-udp-size", 128,
 			   UINT32_MAX);
+	check_range_uint32(options, &result,
+			   "recursive-clients-ipv4-prefix-length", 0, 32);
+	check_range_uint32(options, &result,
+			   "recursive-clients-ipv6-prefix-length", 0, 128);
 
 	if (aclctx != NULL) {
 		cfg_aclconfctx_detach(&aclctx);
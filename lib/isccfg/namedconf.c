@@ -1096,6 +1096,12 @@ static cfg_type_t cfg_type_cookiealg = { "cookiealg",	    cfg_parse_enum,
 					 cfg_print_ustring, cfg_doc_enum,
 					 &cfg_rep_string,   &cookiealg_enums };
 
+static const char *hugepages_enums[] = { "none", "transparent", "explicit",
+					 NULL };
+static cfg_type_t cfg_type_hugepages = { "hugepages",	    cfg_parse_enum,
+					 cfg_print_ustring, cfg_doc_enum,
+					 &cfg_rep_string,   &hugepages_enums };
+
 /*%
  * fetch-quota-params
  */
@@ -1525,15 +1531,18 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "geoip-use-ecs", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "has-old-clients", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "heartbeat-interval", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
+	{ "hitters-sample-rate", &cfg_type_uint32, 0, NULL },
 	{ "host-statistics", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "host-statistics-max", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "hostname", &cfg_type_qstringornone, 0, NULL },
+	{ "hugepages", &cfg_type_hugepages, 0, NULL },
 	{ "interface-interval", &cfg_type_duration, 0, NULL },
 	{ "keep-response-order", &cfg_type_bracketed_aml,
 	  CFG_CLAUSEFLAG_OBSOLETE, NULL },
 	{ "listen-on", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI, NULL },
 	{ "listen-on-v6", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI, NULL },
 	{ "lock-file", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
+	{ "loop-stall-threshold", &cfg_type_uint32, 0, NULL },
 	{ "managed-keys-directory", &cfg_type_qstring, 0, NULL },
 	{ "match-mapped-addresses", &cfg_type_boolean, 0, NULL },
 	{ "max-rsa-exponent-size", &cfg_type_uint32, 0, NULL },
@@ -1542,6 +1551,7 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "multiple-cnames", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "named-xfer", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "notify-rate", &cfg_type_uint32, 0, NULL },
+	{ "offload-work-stealing", &cfg_type_boolean, 0, NULL },
 	{ "pid-file", &cfg_type_qstringornone, 0, NULL },
 	{ "port", &cfg_type_uint32, 0, NULL },
 	{ "tls-port", &cfg_type_uint32, 0, NULL },
@@ -1564,7 +1574,12 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "random-device", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "recursing-file", &cfg_type_qstring, 0, NULL },
 	{ "recursive-clients", &cfg_type_uint32, 0, NULL },
+	{ "recursive-clients-fair-share", &cfg_type_boolean, 0, NULL },
+	{ "recursive-clients-ipv4-prefix-length", &cfg_type_uint32, 0, NULL },
+	{ "recursive-clients-ipv6-prefix-length", &cfg_type_uint32, 0, NULL },
+	{ "recursive-clients-min-share", &cfg_type_uint32, 0, NULL },
 	{ "reuseport", &cfg_type_boolean, 0, NULL },
+	{ "reuseport-cpu-affinity", &cfg_type_boolean, 0, NULL },
 	{ "reserved-sockets", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "responselog", &cfg_type_boolean, 0, NULL },
 	{ "secroots-file", &cfg_type_qstring, 0, NULL },
@@ -2440,6 +2455,9 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "request-sit", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "request-zoneversion", &cfg_type_boolean, 0, NULL },
 	{ "require-server-cookie", &cfg_type_boolean, 0, NULL },
+	{ "resolver-forwarder-spread", &cfg_type_percentage, 0, NULL },
+	{ "resolver-hedge-budget", &cfg_type_percentage, 0, NULL },
+	{ "resolver-hedge-percentile", &cfg_type_uint32, 0, NULL },
 	{ "resolver-nonbackoff-tries", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
 	{ "resolver-query-timeout", &cfg_type_uint32, 0, NULL },
 	{ "resolver-retry-interval", NULL, CFG_CLAUSEFLAG_ANCIENT, NULL },
@@ -2451,6 +2469,7 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "rrset-order", &cfg_type_rrsetorder, 0, NULL },
 	{ "send-cookie", &cfg_type_boolean, 0, NULL },
 	{ "servfail-ttl", &cfg_type_duration, 0, NULL },
+	{ "share-fetches", &cfg_type_boolean, 0, NULL },
 	{ "sig0key-checks-limit", &cfg_type_uint32, 0, NULL },
 	{ "sig0message-checks-limit", &cfg_type_uint32, 0, NULL },
 	{ "sortlist", &cfg_type_bracketed_aml, CFG_CLAUSEFLAG_ANCIENT, NULL },
@@ -191,11 +191,25 @@ ns_client_recursing(ns_client_t *client) {
 
 void
 ns_client_killoldestquery(ns_client_t *client) {
+	ns_server_t *sctx = NULL;
 	ns_client_t *oldest;
 	REQUIRE(NS_CLIENT_VALID(client));
 
+	sctx = client->manager->sctx;
+
 	LOCK(&client->manager->reclock);
 	oldest = ISC_LIST_HEAD(client->manager->recursing);
+	if (sctx->recursionfairshare) {
+		ISC_LIST_FOREACH(client->manager->recursing, rclient,
+				 inner.rlink) {
+			if (ns_server_recursionshare_over(
+				    sctx, rclient->inner.recursionshare))
+			{
+				oldest = rclient;
+				break;
+			}
+		}
+	}
 	if (oldest != NULL) {
 		ISC_LIST_UNLINK(client->manager->recursing, oldest,
 				inner.rlink);
@@ -2649,6 +2663,8 @@ clientmgr_destroy_cb(void *arg) {
 
 	manager->magic = 0;
 
+	ns_query_freeproofs(manager);
+
 	isc_loop_detach(&manager->loop);
 
 	dns_aclenv_detach(&manager->aclenv);
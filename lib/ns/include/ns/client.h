@@ -159,6 +159,8 @@ struct ns_clientmgr {
 	isc_mutex_t   reclock;
 	client_list_t recursing; /*%< Recursing clients */
 
+	ns_nsec3proofs_t *nsec3proofs; /*%< See query.c */
+
 	uint8_t tcp_buffer[NS_CLIENT_TCP_BUFFER_SIZE];
 };
 
@@ -256,12 +258,13 @@ struct ns_client {
 		void (*sendcb)(isc_buffer_t *buf);
 
 		ISC_LINK(ns_client_t) rlink;
-		unsigned char  cookie[8];
-		uint32_t       expire;
-		unsigned char *zoneversion;
-		uint32_t       zoneversionlength;
-		unsigned char *keytag;
-		uint16_t       keytag_len;
+		ns_recursionshare_t *recursionshare; /*%< see ns_server.h */
+		unsigned char	     cookie[8];
+		uint32_t	     expire;
+		unsigned char	    *zoneversion;
+		uint32_t	     zoneversionlength;
+		unsigned char	    *keytag;
+		uint16_t	     keytag_len;
 
 		/*%
 		 * Used to override the DNS response code in ns_client_error().
@@ -454,7 +457,9 @@ ns_client_recursing(ns_client_t *client);
 void
 ns_client_killoldestquery(ns_client_t *client);
 /*%<
- * Kill the oldest recursive query (recursing list head).
+ * Kill the oldest recursive query (recursing list head).  With fair
+ * sharing of the recursion quota, kill the oldest query from a client
+ * prefix that is over its share instead, if there is one.
  */
 
 void
@@ -314,6 +314,12 @@ ns_query_init(ns_client_t *client);
 void
 ns_query_free(ns_client_t *client);
 
+void
+ns_query_freeproofs(ns_clientmgr_t *manager);
+/*%<
+ * Free the NSEC3 proofs cached by 'manager'.
+ */
+
 void
 ns_query_start(ns_client_t *client, isc_nmhandle_t *handle);
 
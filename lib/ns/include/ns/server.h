@@ -18,14 +18,18 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/fuzz.h>
 #include <isc/histo.h>
 #include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/quota.h>
 #include <isc/random.h>
+#include <isc/rwlock.h>
 #include <isc/sockaddr.h>
 #include <isc/statsmulti.h>
+#include <isc/swisstable.h>
+#include <isc/topk.h>
 #include <isc/types.h>
 
 #include <dns/acl.h>
@@ -54,6 +58,12 @@
 #define NS_SERVER_COOKIEALWAYSVALID 0x00080000U /*%< -T cookiealwaysvalid */
 #define NS_SERVER_RPZSLOW	    0x00100000U /*%< -T rpzslow */
 
+/*%
+ * Half-life in seconds of the heavy-hitter counts, so that the lists of
+ * most frequent names and clients follow the recent traffic.
+ */
+#define NS_HITTERS_HALFLIFE 60
+
 /*%
  * Type for callback function to get hostname.
  */
@@ -74,6 +84,18 @@ typedef isc_result_t (*ns_matchview_t)(
 	void *cbarg, isc_result_t *sigresultp, isc_result_t *viewmatchresult,
 	dns_view_t **viewp);
 
+/*%
+ * The recursion shares are spread over a number of tables by the hash of
+ * their prefix, so that recursions from different prefixes rarely wait
+ * for the same lock.
+ */
+#define NS_RECURSIONSHARE_SHARDS 64
+
+typedef struct ns_recursionshard {
+	isc_rwlock_t	  lock;
+	isc_swisstable_t *table;
+} ns_recursionshard_t;
+
 /*%
  * Server context.
  */
@@ -99,6 +121,18 @@ struct ns_server {
 	ISC_LIST(isc_quota_t) http_quotas;
 	isc_mutex_t http_quotas_lock;
 
+	/*% Rendered AXFR streams shared by concurrent transfers */
+	ISC_LIST(ns_axfrcache_t) axfrcaches;
+	isc_mutex_t axfrcaches_lock;
+
+	/*% Fair sharing of the recursion quota between client prefixes */
+	bool		     recursionfairshare;
+	uint8_t		     recursionprefixlen4;
+	uint8_t		     recursionprefixlen6;
+	unsigned int	     recursionminshare;
+	atomic_uint_fast32_t recursionprefixes;
+	ns_recursionshard_t  recursionshards[NS_RECURSIONSHARE_SHARDS];
+
 	/*% Test options and other configurables */
 	uint32_t options;
 
@@ -136,6 +170,10 @@ struct ns_server {
 	isc_histomulti_t *tcpoutstats4;
 	isc_histomulti_t *tcpinstats6;
 	isc_histomulti_t *tcpoutstats6;
+
+	/*% Most frequent query names and client addresses, if counted */
+	isc_topkmulti_t *topqnames;
+	isc_topkmulti_t *topclients;
 };
 
 struct ns_altsecret {
@@ -199,6 +237,74 @@ ns_server_getoption(ns_server_t *sctx, unsigned int option);
  *\li	'sctx' is valid.
  */
 
+void
+ns_server_setrecursionshare(ns_server_t *sctx, bool enable,
+			    unsigned int prefixlen4, unsigned int prefixlen6,
+			    unsigned int minshare);
+/*%<
+ * Configure the fair sharing of the recursion quota.  When enabled, the
+ * recursing clients are accounted per client prefix ('prefixlen4' bits of
+ * IPv4 and 'prefixlen6' bits of IPv6 addresses).  Once the soft quota is
+ * reached, a prefix holding more than its share of the recursion quota
+ * (the soft quota divided by the number of prefixes recursing, but at
+ * least 'minshare') can no longer start new recursions, and its queries
+ * are the first to be dropped when other clients need room.
+ *
+ * Requires:
+ *\li	'sctx' is valid;
+ *\li	'prefixlen4' <= 32 and 'prefixlen6' <= 128.
+ */
+
+void
+ns_server_sethitters(ns_server_t *sctx, unsigned int rate);
+/*%<
+ * Count about one in 'rate' query names and client addresses in
+ * 'sctx->topqnames' and 'sctx->topclients', or none if 'rate' is zero.
+ * The sketches are replaced, and their counts lost, when 'rate' changes.
+ * This must be called while the loops are paused.
+ *
+ * Requires:
+ *\li	'sctx' is valid;
+ *\li	'rate' <= ISC_TOPK_MAXRATE.
+ */
+
+ns_recursionshare_t *
+ns_server_recursionshare_attach(ns_server_t *sctx, const isc_sockaddr_t *peer);
+/*%<
+ * Account a recursing client from 'peer' to its prefix.  Returns the
+ * share to pass to ns_server_recursionshare_over() and
+ * ns_server_recursionshare_detach(), or NULL if fair sharing is disabled.
+ * Each prefix has a share of its own, so the number of prefixes
+ * recursing is exact.
+ *
+ * Requires:
+ *\li	'sctx' is valid;
+ *\li	'peer' is not 'NULL'.
+ */
+
+void
+ns_server_recursionshare_detach(ns_server_t	     *sctx,
+				ns_recursionshare_t **sharep);
+/*%<
+ * Release a share returned by ns_server_recursionshare_attach() and set
+ * '*sharep' to NULL.  Does nothing if '*sharep' is already NULL.
+ *
+ * Requires:
+ *\li	'sctx' is valid;
+ *\li	'sharep' is not 'NULL'.
+ */
+
+bool
+ns_server_recursionshare_over(ns_server_t		*sctx,
+			      const ns_recursionshare_t *share);
+/*%<
+ * Return true if the prefix 'share' belongs to uses more than its fair
+ * share of the recursion quota.  Always false for a NULL share.
+ *
+ * Requires:
+ *\li	'sctx' is valid.
+ */
+
 void
 ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota);
 /*%<
@@ -208,3 +314,30 @@ ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota);
  *\li	'sctx' is valid;
  *\li	'http_quota' is not 'NULL'.
  */
+
+size_t
+ns_server_gethitters(isc_topkmulti_t *tm, isc_topk_entry_t *entries,
+		     size_t size);
+/*%<
+ * Merge the per-thread sketches of 'tm' (such as 'sctx->topqnames' or a
+ * resolver's fetch names) and copy up to 'size' of the most frequent keys
+ * to 'entries', highest count first.  Returns the number of entries
+ * copied, which is zero if 'tm' is NULL because nothing is counted.
+ *
+ * Requires:
+ *\li	'tm' is valid or NULL;
+ *\li	'entries' is not 'NULL'.
+ */
+
+void
+ns_server_formathitter(const isc_topk_entry_t *entry, bool address, char *buf,
+		       size_t size);
+/*%<
+ * Format the key of a heavy hitter: a client address as counted in
+ * 'sctx->topclients' (the address family followed by the address) if
+ * 'address' is true, or a DNS name in wire format otherwise.
+ *
+ * Requires:
+ *\li	'entry' is not 'NULL';
+ *\li	'buf' is not 'NULL' and 'size' is not zero.
+ */
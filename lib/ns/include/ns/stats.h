@@ -121,7 +121,9 @@ enum {
 	ns_statscounter_encryptedproxydot = 75,
 	ns_statscounter_encryptedproxydoh = 76,
 
-	ns_statscounter_max = 77,
+	ns_statscounter_reclimitfairshare = 77,
+
+	ns_statscounter_max = 78,
 };
 
 /*%
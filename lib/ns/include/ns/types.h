@@ -17,16 +17,19 @@
 
 typedef struct ns_altsecret ns_altsecret_t;
 typedef ISC_LIST(ns_altsecret_t) ns_altsecretlist_t;
+typedef struct ns_axfrcache ns_axfrcache_t;
 typedef struct ns_client    ns_client_t;
 typedef struct ns_clientmgr ns_clientmgr_t;
 typedef struct ns_plugin    ns_plugin_t;
 typedef ISC_LIST(ns_plugin_t) ns_plugins_t;
-typedef struct ns_interface    ns_interface_t;
-typedef struct ns_interfacemgr ns_interfacemgr_t;
-typedef struct ns_query	       ns_query_t;
-typedef struct ns_server       ns_server_t;
-typedef struct ns_stats	       ns_stats_t;
-typedef struct ns_hookasync    ns_hookasync_t;
+typedef struct ns_interface	 ns_interface_t;
+typedef struct ns_interfacemgr	 ns_interfacemgr_t;
+typedef struct ns_nsec3proofs	 ns_nsec3proofs_t;
+typedef struct ns_query		 ns_query_t;
+typedef struct ns_recursionshare ns_recursionshare_t;
+typedef struct ns_server	 ns_server_t;
+typedef struct ns_stats		 ns_stats_t;
+typedef struct ns_hookasync	 ns_hookasync_t;
 
 typedef enum { ns_cookiealg_siphash24 } ns_cookiealg_t;
 
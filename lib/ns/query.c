@@ -19,8 +19,10 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <isc/ascii.h>
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/base32.h>
 #include <isc/counter.h>
 #include <isc/hex.h>
 #include <isc/list.h>
@@ -34,6 +36,7 @@
 #include <isc/stats.h>
 #include <isc/string.h>
 #include <isc/thread.h>
+#include <isc/timer.h>
 #include <isc/util.h>
 
 #include <dns/adb.h>
@@ -5080,6 +5083,52 @@ qctx_setrad(query_ctx_t *qctx) {
 	}
 }
 
+/*%
+ * Count the query name and the client address in the heavy-hitter
+ * sketches, if they are enabled and this query is sampled.  The name
+ * is lower-cased so that randomized case doesn't split its count;
+ * names followed in a CNAME chain are not counted.
+ */
+static void
+query_hitters(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	ns_server_t *sctx = client->manager->sctx;
+	dns_name_t *qname = client->query.qname;
+	unsigned char key[ISC_TOPK_KEYSIZE];
+	isc_netaddr_t netaddr;
+	size_t length = 0;
+
+	if (sctx->topqnames == NULL || client->query.restarts > 0 ||
+	    !isc_topkmulti_sample(sctx->topqnames))
+	{
+		return;
+	}
+
+	isc_ascii_lowercopy(key, qname->ndata, qname->length);
+	isc_topkmulti_add(sctx->topqnames, key, qname->length,
+			  client->inner.now);
+
+	if (!client->inner.peeraddr_valid) {
+		return;
+	}
+
+	isc_netaddr_fromsockaddr(&netaddr, &client->inner.peeraddr);
+	key[length++] = netaddr.family;
+	switch (netaddr.family) {
+	case AF_INET:
+		memmove(key + length, &netaddr.type.in, 4);
+		length += 4;
+		break;
+	case AF_INET6:
+		memmove(key + length, &netaddr.type.in6, 16);
+		length += 16;
+		break;
+	default:
+		return;
+	}
+	isc_topkmulti_add(sctx->topclients, key, length, client->inner.now);
+}
+
 /*%
  * Starting point for a client query or a chaining query.
  *
@@ -5107,6 +5156,8 @@ ns__query_start(query_ctx_t *qctx) {
 	client->query.dboptions &= ~(DNS_DBFIND_STALETIMEOUT |
 				     DNS_DBFIND_STALEOK);
 
+	query_hitters(qctx);
+
 	CALL_HOOK(NS_QUERY_START_BEGIN, qctx);
 
 	/*
@@ -5907,18 +5958,42 @@ recursionquota_log(ns_client_t *client, atomic_uint_fast32_t *last_log_time,
 		      isc_quota_getsoft(quota), isc_quota_getmax(quota));
 }
 
-static atomic_uint_fast32_t last_soft, last_hard;
+static atomic_uint_fast32_t last_soft, last_hard, last_share;
 
 /*%
  * Acquire recursion quota before making the current client "recursing".
  */
 static isc_result_t
 acquire_recursionquota(ns_client_t *client) {
+	ns_server_t *sctx = client->manager->sctx;
 	isc_result_t result;
 
+	client->inner.recursionshare = ns_server_recursionshare_attach(
+		sctx, &client->inner.peeraddr);
+
 	result = recursionquotatype_attach_soft(client);
 	switch (result) {
 	case ISC_R_SOFTQUOTA:
+		if (ns_server_recursionshare_over(sctx,
+						  client->inner.recursionshare))
+		{
+			/*
+			 * This client's prefix already has more than its
+			 * share of the recursion quota; drop this query
+			 * rather than someone else's.
+			 */
+			recursionquota_log(client, &last_share,
+					   "recursive-clients fair share "
+					   "exceeded (%u/%u/%u), "
+					   "dropping query",
+					   &sctx->recursionquota);
+			recursionquotatype_detach(client);
+			ns_server_recursionshare_detach(
+				sctx, &client->inner.recursionshare);
+			ns_stats_increment(sctx->nsstats,
+					   ns_statscounter_reclimitfairshare);
+			return ISC_R_QUOTA;
+		}
 		recursionquota_log(client, &last_soft,
 				   "recursive-clients soft limit exceeded "
 				   "(%u/%u/%u), aborting oldest query",
@@ -5931,6 +6006,8 @@ acquire_recursionquota(ns_client_t *client) {
 		recursionquota_log(client, &last_hard,
 				   "no more recursive clients (%u/%u/%u)",
 				   &client->manager->sctx->recursionquota);
+		ns_server_recursionshare_detach(sctx,
+						&client->inner.recursionshare);
 		ns_client_killoldestquery(client);
 		return result;
 	default:
@@ -5956,6 +6033,13 @@ release_recursionquota(ns_client_t *client) {
 				inner.rlink);
 	}
 	UNLOCK(&client->manager->reclock);
+
+	/*
+	 * Only now that ns_client_killoldestquery() can't look at it any
+	 * more, as the last client of its prefix frees the share.
+	 */
+	ns_server_recursionshare_detach(client->manager->sctx,
+					&client->inner.recursionshare);
 }
 
 isc_result_t
@@ -7894,10 +7978,9 @@ query_dns64(query_ctx_t *qctx) {
 	}
 
 	CHECK(dns_dns64_apply(client->manager->mctx, view->dns64,
-			      view->dns64cnt, client->message,
-			      client->manager->aclenv, &client->inner.peeraddr,
-			      client->inner.signer, flags, qctx->rdataset,
-			      &dns64_rdataset));
+			      client->message, client->manager->aclenv,
+			      &client->inner.peeraddr, client->inner.signer,
+			      flags, qctx->rdataset, &dns64_rdataset));
 
 	dns_rdataset_setownercase(dns64_rdataset, mname);
 	client->query.noadditional = true;
@@ -10585,6 +10668,458 @@ cleanup:
 	}
 }
 
+/*%
+ * NSEC3 proof cache.
+ *
+ * An NXDOMAIN response from an NSEC3-signed zone needs the NSEC3
+ * records matching the closest encloser and covering the next closer
+ * name and the wildcard at the closest encloser.  Finding them costs
+ * a binary search for the closest encloser and three hashed lookups.
+ * When the query names are random labels below the same encloser, as
+ * in a random subdomain attack, only the next closer name differs, and
+ * the few NSEC3 records covering it repeat.
+ *
+ * So each client manager remembers the proofs it has assembled, per zone
+ * version and closest encloser, along with the spans of the NSEC3 records
+ * that covered next closer names.  If the next closer name of a query
+ * below a cached encloser hashes into one of those spans, the name does
+ * not exist, the encloser is the closest one and the whole proof comes
+ * from the cache without looking up any NSEC3 records.  (The NSEC
+ * lookup that finds the zone has no NSEC chain is still done.)
+ *
+ * An entry keeps its zone database and version open.  Once a query for
+ * the same zone comes with another database or version, because the
+ * zone has been reloaded or updated, the entries for the zone are stale
+ * and are dropped.  The zone pointer is only compared, never followed.
+ * So that a zone which is deleted, or no longer queried, does not keep
+ * old versions open, an entry is also dropped NSEC3PROOF_LIFETIME
+ * seconds after it was made, by a timer running while there are any.
+ */
+#define NSEC3PROOF_ENTRIES  16
+#define NSEC3PROOF_SPANS    8
+#define NSEC3PROOF_LIFETIME 10
+
+typedef struct nsec3record {
+	dns_fixedname_t fname;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+} nsec3record_t;
+
+typedef struct nsec3span {
+	unsigned char owner[NSEC3_MAX_HASH_LENGTH];
+	unsigned char next[NSEC3_MAX_HASH_LENGTH];
+	nsec3record_t record;
+} nsec3span_t;
+
+typedef struct nsec3proof {
+	const dns_zone_t *zone; /* Not attached */
+	dns_db_t *db;
+	dns_dbversion_t *version;
+	isc_stdtime_t expires;
+	dns_fixedname_t fencloser;
+	dns_hash_t hash;
+	uint16_t iterations;
+	unsigned char salt[256];
+	size_t salt_length;
+	size_t hash_length;
+	bool complete; /* 'wildcard' is set */
+	nsec3record_t encloser;
+	nsec3record_t wildcard;
+	unsigned int nspans, nextspan;
+	nsec3span_t spans[NSEC3PROOF_SPANS];
+} nsec3proof_t;
+
+struct ns_nsec3proofs {
+	isc_timer_t *timer;
+	unsigned int next;
+	nsec3proof_t entries[NSEC3PROOF_ENTRIES];
+};
+
+static void
+nsec3record_clear(nsec3record_t *record) {
+	dns_rdataset_cleanup(&record->rdataset);
+	dns_rdataset_cleanup(&record->sigrdataset);
+}
+
+static void
+nsec3record_set(nsec3record_t *record, dns_name_t *fname,
+		dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	nsec3record_clear(record);
+	dns_name_copy(fname, dns_fixedname_initname(&record->fname));
+	dns_rdataset_clone(rdataset, &record->rdataset);
+	if (sigrdataset != NULL && dns_rdataset_isassociated(sigrdataset)) {
+		dns_rdataset_clone(sigrdataset, &record->sigrdataset);
+	}
+}
+
+/*
+ * Add a copy of a cached NSEC3 record to the authority section.
+ */
+static void
+nsec3record_add(query_ctx_t *qctx, nsec3record_t *record) {
+	ns_client_t *client = qctx->client;
+	isc_buffer_t *dbuf = NULL, b;
+	dns_name_t *fname = NULL;
+	dns_rdataset_t *rdataset = NULL, *sigrdataset = NULL;
+
+	dbuf = ns_client_getnamebuf(client);
+	fname = ns_client_newname(client, dbuf, &b);
+	dns_name_copy(dns_fixedname_name(&record->fname), fname);
+	rdataset = ns_client_newrdataset(client);
+	dns_rdataset_clone(&record->rdataset, rdataset);
+	if (dns_rdataset_isassociated(&record->sigrdataset)) {
+		sigrdataset = ns_client_newrdataset(client);
+		dns_rdataset_clone(&record->sigrdataset, sigrdataset);
+	}
+
+	query_addrrset(qctx, &fname, &rdataset, &sigrdataset, dbuf,
+		       DNS_SECTION_AUTHORITY);
+
+	if (rdataset != NULL) {
+		ns_client_putrdataset(client, &rdataset);
+	}
+	if (sigrdataset != NULL) {
+		ns_client_putrdataset(client, &sigrdataset);
+	}
+	if (fname != NULL) {
+		ns_client_releasename(client, &fname);
+	}
+}
+
+static void
+nsec3proof_clear(nsec3proof_t *proof) {
+	for (unsigned int i = 0; i < proof->nspans; i++) {
+		nsec3record_clear(&proof->spans[i].record);
+	}
+	nsec3record_clear(&proof->encloser);
+	nsec3record_clear(&proof->wildcard);
+	if (proof->version != NULL) {
+		dns_db_closeversion(proof->db, &proof->version, false);
+	}
+	if (proof->db != NULL) {
+		dns_db_detach(&proof->db);
+	}
+	proof->zone = NULL;
+	proof->complete = false;
+	proof->nspans = 0;
+	proof->nextspan = 0;
+}
+
+void
+ns_query_freeproofs(ns_clientmgr_t *manager) {
+	ns_nsec3proofs_t *proofs = manager->nsec3proofs;
+
+	if (proofs == NULL) {
+		return;
+	}
+
+	manager->nsec3proofs = NULL;
+	isc_timer_destroy(&proofs->timer);
+	for (size_t i = 0; i < NSEC3PROOF_ENTRIES; i++) {
+		nsec3proof_clear(&proofs->entries[i]);
+	}
+	isc_mem_put(manager->mctx, proofs, sizeof(*proofs));
+}
+
+/*
+ * Drop the proofs that have outlived NSEC3PROOF_LIFETIME by 'now',
+ * and stop the timer once no proofs are left.
+ */
+static void
+nsec3proof_sweep(ns_nsec3proofs_t *proofs, isc_stdtime_t now) {
+	bool empty = true;
+
+	for (size_t i = 0; i < NSEC3PROOF_ENTRIES; i++) {
+		nsec3proof_t *proof = &proofs->entries[i];
+
+		if (proof->db == NULL) {
+			continue;
+		}
+		if (proof->expires <= now) {
+			nsec3proof_clear(proof);
+		} else {
+			empty = false;
+		}
+	}
+
+	if (empty) {
+		isc_timer_stop(proofs->timer);
+	}
+}
+
+static void
+nsec3proof_tick(void *arg) {
+	nsec3proof_sweep(arg, isc_stdtime_now());
+}
+
+/*
+ * Does the span of the NSEC3 record cover 'hash'?  The last record in
+ * the chain wraps around to the first.
+ */
+static bool
+nsec3span_covers(const nsec3span_t *span, const unsigned char *hash,
+		 size_t length) {
+	int lower = memcmp(span->owner, hash, length);
+	int upper = memcmp(hash, span->next, length);
+
+	if (memcmp(span->owner, span->next, length) < 0) {
+		return lower < 0 && upper < 0;
+	}
+	return lower < 0 || upper < 0;
+}
+
+/*
+ * Drop the proofs for older versions or databases of the zone being
+ * queried.
+ */
+static void
+nsec3proof_expire(query_ctx_t *qctx) {
+	ns_nsec3proofs_t *proofs = qctx->client->manager->nsec3proofs;
+
+	for (size_t i = 0; i < NSEC3PROOF_ENTRIES; i++) {
+		nsec3proof_t *proof = &proofs->entries[i];
+
+		if (proof->zone == qctx->zone &&
+		    (proof->db != qctx->db || proof->version != qctx->version))
+		{
+			nsec3proof_clear(proof);
+		}
+	}
+}
+
+/*
+ * Look for a cached proof that 'name' does not exist, and add it
+ * to the response.  Returns false if there is none.
+ */
+static bool
+nsec3proof_find(query_ctx_t *qctx, dns_name_t *name, bool ispositive) {
+	ns_nsec3proofs_t *proofs = qctx->client->manager->nsec3proofs;
+	unsigned int labels = dns_name_countlabels(name);
+
+	if (proofs == NULL || qctx->zone == NULL || qctx->version == NULL) {
+		return false;
+	}
+
+	nsec3proof_expire(qctx);
+
+	for (size_t i = 0; i < NSEC3PROOF_ENTRIES; i++) {
+		nsec3proof_t *proof = &proofs->entries[i];
+		dns_name_t *encloser = dns_fixedname_name(&proof->fencloser);
+		unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+		size_t hash_length;
+		dns_fixedname_t fixed;
+		dns_name_t nextcloser = DNS_NAME_INITEMPTY;
+		unsigned int elabels;
+		isc_result_t result;
+
+		if (!proof->complete || proof->zone != qctx->zone) {
+			continue;
+		}
+
+		elabels = dns_name_countlabels(encloser);
+		if (labels <= elabels || !dns_name_issubdomain(name, encloser))
+		{
+			continue;
+		}
+
+		dns_name_getlabelsequence(name, labels - elabels - 1,
+					  elabels + 1, &nextcloser);
+		result = dns_nsec3_hashname(
+			&fixed, hash, &hash_length, &nextcloser,
+			dns_db_origin(qctx->db), proof->hash, proof->iterations,
+			proof->salt, proof->salt_length);
+		if (result != ISC_R_SUCCESS ||
+		    hash_length != proof->hash_length)
+		{
+			continue;
+		}
+
+		for (size_t j = 0; j < proof->nspans; j++) {
+			nsec3span_t *span = &proof->spans[j];
+
+			if (!nsec3span_covers(span, hash, hash_length)) {
+				continue;
+			}
+
+			if (!ispositive) {
+				nsec3record_add(qctx, &proof->encloser);
+			}
+			nsec3record_add(qctx, &span->record);
+			if (!ispositive) {
+				nsec3record_add(qctx, &proof->wildcard);
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Get the entry for the proofs below 'encloser', clearing one if there
+ * is none, and remember the NSEC3 record matching the encloser.
+ */
+static nsec3proof_t *
+nsec3proof_start(query_ctx_t *qctx, dns_name_t *encloser, dns_name_t *fname,
+		 dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	ns_clientmgr_t *manager = qctx->client->manager;
+	ns_nsec3proofs_t *proofs = manager->nsec3proofs;
+	nsec3proof_t *proof = NULL;
+	isc_result_t result;
+
+	if (!dns_db_iszone(qctx->db) || qctx->zone == NULL ||
+	    qctx->version == NULL)
+	{
+		return NULL;
+	}
+
+	if (proofs == NULL) {
+		proofs = isc_mem_get(manager->mctx, sizeof(*proofs));
+		*proofs = (ns_nsec3proofs_t){ 0 };
+		for (size_t i = 0; i < NSEC3PROOF_ENTRIES; i++) {
+			nsec3proof_t *p = &proofs->entries[i];
+			dns_rdataset_init(&p->encloser.rdataset);
+			dns_rdataset_init(&p->encloser.sigrdataset);
+			dns_rdataset_init(&p->wildcard.rdataset);
+			dns_rdataset_init(&p->wildcard.sigrdataset);
+			for (size_t j = 0; j < NSEC3PROOF_SPANS; j++) {
+				nsec3record_t *r = &p->spans[j].record;
+				dns_rdataset_init(&r->rdataset);
+				dns_rdataset_init(&r->sigrdataset);
+			}
+		}
+		isc_timer_create(manager->loop, nsec3proof_tick, proofs,
+				 &proofs->timer);
+		manager->nsec3proofs = proofs;
+	}
+
+	/*
+	 * Use the entry for this encloser if there is one.  Otherwise
+	 * replace an unused entry, or failing that the entries in turn.
+	 */
+	nsec3proof_expire(qctx);
+	for (size_t i = 0; i < NSEC3PROOF_ENTRIES; i++) {
+		nsec3proof_t *p = &proofs->entries[i];
+		if (p->zone == qctx->zone &&
+		    dns_name_equal(dns_fixedname_name(&p->fencloser),
+				   encloser))
+		{
+			return p;
+		}
+		if (p->db == NULL && proof == NULL) {
+			proof = p;
+		}
+	}
+	if (proof == NULL) {
+		proof = &proofs->entries[proofs->next];
+		proofs->next = (proofs->next + 1) % NSEC3PROOF_ENTRIES;
+	}
+
+	nsec3proof_clear(proof);
+
+	proof->salt_length = sizeof(proof->salt);
+	result = dns_db_getnsec3parameters(qctx->db, qctx->version,
+					   &proof->hash, NULL,
+					   &proof->iterations, proof->salt,
+					   &proof->salt_length);
+	if (result != ISC_R_SUCCESS) {
+		return NULL;
+	}
+	if (proof->hash == DNS_NSEC3_UNKNOWNALG) {
+		proof->hash = 1;
+	}
+	proof->hash_length = dns_nsec3_hashlength(proof->hash);
+	if (proof->hash_length == 0) {
+		return NULL;
+	}
+
+	proof->zone = qctx->zone;
+	proof->expires = isc_stdtime_now() + NSEC3PROOF_LIFETIME;
+	dns_db_attach(qctx->db, &proof->db);
+	dns_db_attachversion(qctx->db, qctx->version, &proof->version);
+	if (!isc_timer_running(proofs->timer)) {
+		isc_interval_t interval;
+
+		isc_interval_set(&interval, NSEC3PROOF_LIFETIME, 0);
+		isc_timer_start(proofs->timer, isc_timertype_ticker,
+				&interval);
+	}
+	dns_name_copy(encloser, dns_fixedname_initname(&proof->fencloser));
+	nsec3record_set(&proof->encloser, fname, rdataset, sigrdataset);
+
+	return proof;
+}
+
+/*
+ * Remember the span of the NSEC3 record covering a next closer name.
+ */
+static void
+nsec3proof_addspan(nsec3proof_t *proof, dns_name_t *fname,
+		   dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	nsec3span_t *span = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t nsec3;
+	unsigned char owner[NSEC3_MAX_HASH_LENGTH];
+	dns_label_t hashlabel;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	if (dns_rdataset_count(rdataset) != 1) {
+		return;
+	}
+
+	result = dns_rdataset_first(rdataset);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_rdataset_current(rdataset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &nsec3, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	if (nsec3.next.length != proof->hash_length) {
+		return;
+	}
+
+	dns_name_getlabel(fname, 0, &hashlabel);
+	isc_region_consume(&hashlabel, 1);
+	isc_buffer_init(&buffer, owner, sizeof(owner));
+	result = isc_base32hexnp_decoderegion(&hashlabel, &buffer);
+	if (result != ISC_R_SUCCESS ||
+	    isc_buffer_usedlength(&buffer) != proof->hash_length)
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < proof->nspans; i++) {
+		if (memcmp(proof->spans[i].owner, owner, proof->hash_length) ==
+		    0)
+		{
+			return;
+		}
+	}
+
+	/*
+	 * Replace the spans round robin once they are all in use.
+	 */
+	span = &proof->spans[proof->nextspan];
+	proof->nextspan = (proof->nextspan + 1) % NSEC3PROOF_SPANS;
+	if (proof->nspans < NSEC3PROOF_SPANS) {
+		proof->nspans++;
+	}
+
+	memmove(span->owner, owner, proof->hash_length);
+	memmove(span->next, nsec3.next.base, proof->hash_length);
+	nsec3record_set(&span->record, fname, rdataset, sigrdataset);
+}
+
+/*
+ * Remember the NSEC3 record covering the wildcard at the encloser,
+ * which completes the proof.
+ */
+static void
+nsec3proof_setwildcard(nsec3proof_t *proof, dns_name_t *fname,
+		       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	nsec3record_set(&proof->wildcard, fname, rdataset, sigrdataset);
+	proof->complete = true;
+}
+
 static void
 query_addwildcardproof(query_ctx_t *qctx, bool ispositive, bool nodata) {
 	ns_client_t *client = qctx->client;
@@ -10606,6 +11141,7 @@ query_addwildcardproof(query_ctx_t *qctx, bool ispositive, bool nodata) {
 	dns_name_t *cname;
 	dns_clientinfomethods_t cm;
 	dns_clientinfo_t ci;
+	nsec3proof_t *proof = NULL;
 
 	CTRACE(ISC_LOG_DEBUG(3), "query_addwildcardproof");
 
@@ -10689,6 +11225,10 @@ again:
 		/*
 		 * No NSEC proof available, return NSEC3 proofs instead.
 		 */
+		if (nsec3proof_find(qctx, name, ispositive)) {
+			goto cleanup;
+		}
+
 		cname = dns_fixedname_initname(&cfixed);
 
 		/*
@@ -10728,6 +11268,8 @@ again:
 			goto cleanup;
 		}
 		if (!ispositive) {
+			proof = nsec3proof_start(qctx, cname, fname, rdataset,
+						 sigrdataset);
 			query_addrrset(qctx, &fname, &rdataset, &sigrdataset,
 				       dbuf, DNS_SECTION_AUTHORITY);
 		}
@@ -10776,6 +11318,10 @@ again:
 		if (!dns_rdataset_isassociated(rdataset)) {
 			goto cleanup;
 		}
+		if (proof != NULL) {
+			nsec3proof_addspan(proof, fname, rdataset,
+					   sigrdataset);
+		}
 		query_addrrset(qctx, &fname, &rdataset, &sigrdataset, dbuf,
 			       DNS_SECTION_AUTHORITY);
 
@@ -10814,6 +11360,10 @@ again:
 		if (!dns_rdataset_isassociated(rdataset)) {
 			goto cleanup;
 		}
+		if (proof != NULL) {
+			nsec3proof_setwildcard(proof, fname, rdataset,
+					       sigrdataset);
+		}
 		query_addrrset(qctx, &fname, &rdataset, &sigrdataset, dbuf,
 			       DNS_SECTION_AUTHORITY);
 
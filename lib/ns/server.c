@@ -14,11 +14,20 @@
 /*! \file */
 
 #include <stdbool.h>
+#include <string.h>
 
+#include <isc/atomic.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/rwlock.h>
 #include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/swisstable.h>
 #include <isc/util.h>
 
+#include <dns/name.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
 
@@ -51,6 +60,9 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 
 		.matchingview = matchingview,
 		.answercookie = true,
+
+		.recursionprefixlen4 = 24,
+		.recursionprefixlen6 = 56,
 	};
 
 	isc_mem_attach(mctx, &sctx->mctx);
@@ -69,6 +81,13 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	isc_quota_init(&sctx->sig0checksquota, 1);
 	ISC_LIST_INIT(sctx->http_quotas);
 	isc_mutex_init(&sctx->http_quotas_lock);
+	ISC_LIST_INIT(sctx->axfrcaches);
+	isc_mutex_init(&sctx->axfrcaches_lock);
+	for (size_t i = 0; i < NS_RECURSIONSHARE_SHARDS; i++) {
+		ns_recursionshard_t *shard = &sctx->recursionshards[i];
+		isc_swisstable_create(mctx, 4, &shard->table);
+		isc_rwlock_init(&shard->lock);
+	}
 
 	ns_stats_create(mctx, &sctx->nsstats, &sctx->nshighwaterstats);
 
@@ -150,6 +169,16 @@ ns_server_detach(ns_server_t **sctxp) {
 		}
 		isc_mutex_destroy(&sctx->http_quotas_lock);
 
+		INSIST(ISC_LIST_EMPTY(sctx->axfrcaches));
+		isc_mutex_destroy(&sctx->axfrcaches_lock);
+
+		INSIST(atomic_load(&sctx->recursionprefixes) == 0);
+		for (size_t i = 0; i < NS_RECURSIONSHARE_SHARDS; i++) {
+			ns_recursionshard_t *shard = &sctx->recursionshards[i];
+			isc_swisstable_destroy(&shard->table);
+			isc_rwlock_destroy(&shard->lock);
+		}
+
 		if (sctx->server_id != NULL) {
 			isc_mem_free(sctx->mctx, sctx->server_id);
 		}
@@ -205,6 +234,13 @@ ns_server_detach(ns_server_t **sctxp) {
 			isc_histomulti_detach(&sctx->tcpoutstats6);
 		}
 
+		if (sctx->topqnames != NULL) {
+			isc_topkmulti_detach(&sctx->topqnames);
+		}
+		if (sctx->topclients != NULL) {
+			isc_topkmulti_detach(&sctx->topclients);
+		}
+
 		sctx->magic = 0;
 
 		isc_mem_putanddetach(&sctx->mctx, sctx, sizeof(*sctx));
@@ -243,6 +279,213 @@ ns_server_getoption(ns_server_t *sctx, unsigned int option) {
 	return (sctx->options & option) != 0;
 }
 
+void
+ns_server_setrecursionshare(ns_server_t *sctx, bool enable,
+			    unsigned int prefixlen4, unsigned int prefixlen6,
+			    unsigned int minshare) {
+	REQUIRE(SCTX_VALID(sctx));
+	REQUIRE(prefixlen4 <= 32 && prefixlen6 <= 128);
+
+	sctx->recursionfairshare = enable;
+	sctx->recursionprefixlen4 = prefixlen4;
+	sctx->recursionprefixlen6 = prefixlen6;
+	sctx->recursionminshare = minshare;
+}
+
+void
+ns_server_sethitters(ns_server_t *sctx, unsigned int rate) {
+	REQUIRE(SCTX_VALID(sctx));
+	REQUIRE(rate <= ISC_TOPK_MAXRATE);
+
+	if (sctx->topqnames != NULL) {
+		if (isc_topkmulti_getrate(sctx->topqnames) == rate) {
+			return;
+		}
+		isc_topkmulti_detach(&sctx->topqnames);
+		isc_topkmulti_detach(&sctx->topclients);
+	}
+
+	if (rate > 0) {
+		isc_topkmulti_create(sctx->mctx, NS_HITTERS_HALFLIFE, rate,
+				     &sctx->topqnames);
+		isc_topkmulti_create(sctx->mctx, NS_HITTERS_HALFLIFE, rate,
+				     &sctx->topclients);
+	}
+}
+
+/*%
+ * The recursing clients of one prefix.  The key is the address family
+ * followed by the address masked to the configured prefix length.
+ */
+struct ns_recursionshare {
+	unsigned char key[17];
+	uint32_t hashval;
+	atomic_uint_fast32_t count;
+};
+
+static bool
+recursionshare_match(void *node, const void *key) {
+	ns_recursionshare_t *share = node;
+
+	return memcmp(share->key, key, sizeof(share->key)) == 0;
+}
+
+/*
+ * The lowest bits of the hash value are the swisstable's tag, and its
+ * probe sequence is derived from all of them; take the ones just above
+ * the tag.
+ */
+static ns_recursionshard_t *
+recursionshard(ns_server_t *sctx, uint32_t hashval) {
+	return &sctx->recursionshards[(hashval >> 7) %
+				      NS_RECURSIONSHARE_SHARDS];
+}
+
+ns_recursionshare_t *
+ns_server_recursionshare_attach(ns_server_t *sctx, const isc_sockaddr_t *peer) {
+	isc_netaddr_t netaddr;
+	unsigned char key[17] = { 0 };
+	unsigned int prefixlen, bits;
+	uint32_t hashval;
+	ns_recursionshard_t *shard = NULL;
+	ns_recursionshare_t *share = NULL;
+	isc_rwlocktype_t locktype = isc_rwlocktype_read;
+	isc_result_t result;
+
+	REQUIRE(SCTX_VALID(sctx));
+	REQUIRE(peer != NULL);
+
+	if (!sctx->recursionfairshare) {
+		return NULL;
+	}
+
+	isc_netaddr_fromsockaddr(&netaddr, peer);
+	switch (netaddr.family) {
+	case AF_INET:
+		memmove(key + 1, &netaddr.type.in, 4);
+		prefixlen = sctx->recursionprefixlen4;
+		bits = 32;
+		break;
+	case AF_INET6:
+		memmove(key + 1, &netaddr.type.in6, 16);
+		prefixlen = sctx->recursionprefixlen6;
+		bits = 128;
+		break;
+	default:
+		return NULL;
+	}
+	key[0] = netaddr.family;
+	for (unsigned int i = prefixlen; i < bits; i++) {
+		key[1 + i / 8] &= ~(0x80 >> (i % 8));
+	}
+	hashval = isc_hash32(key, 1 + bits / 8, true);
+	shard = recursionshard(sctx, hashval);
+
+	/*
+	 * A share only goes away under the write lock of its shard, once
+	 * its count has dropped to zero; see
+	 * ns_server_recursionshare_detach().
+	 */
+	RWLOCK(&shard->lock, locktype);
+	result = isc_swisstable_find(shard->table, hashval,
+				     recursionshare_match, key,
+				     (void **)&share);
+	if (result == ISC_R_NOTFOUND) {
+		UPGRADELOCK(&shard->lock, locktype);
+
+		share = isc_mem_get(sctx->mctx, sizeof(*share));
+		*share = (ns_recursionshare_t){ .hashval = hashval };
+		memmove(share->key, key, sizeof(share->key));
+
+		void *found = NULL;
+		result = isc_swisstable_add(shard->table, hashval,
+					    recursionshare_match, share->key,
+					    share, &found);
+		if (result == ISC_R_EXISTS) {
+			isc_mem_put(sctx->mctx, share, sizeof(*share));
+			share = found;
+		} else {
+			atomic_fetch_add_relaxed(&sctx->recursionprefixes, 1);
+		}
+	}
+	atomic_fetch_add_relaxed(&share->count, 1);
+	RWUNLOCK(&shard->lock, locktype);
+
+	return share;
+}
+
+void
+ns_server_recursionshare_detach(ns_server_t *sctx,
+				ns_recursionshare_t **sharep) {
+	ns_recursionshard_t *shard = NULL;
+	ns_recursionshare_t *share = NULL;
+	uint_fast32_t count;
+	isc_result_t result;
+
+	REQUIRE(SCTX_VALID(sctx));
+	REQUIRE(sharep != NULL);
+
+	share = *sharep;
+	if (share == NULL) {
+		return;
+	}
+	*sharep = NULL;
+	shard = recursionshard(sctx, share->hashval);
+
+	/*
+	 * Other clients of the prefix keep the share; the last one has
+	 * to remove it under the write lock, so that no one can find it
+	 * in the meantime.
+	 */
+	RWLOCK(&shard->lock, isc_rwlocktype_read);
+	count = atomic_load_relaxed(&share->count);
+	while (count > 1) {
+		if (atomic_compare_exchange_weak_relaxed(&share->count, &count,
+							 count - 1))
+		{
+			RWUNLOCK(&shard->lock, isc_rwlocktype_read);
+			return;
+		}
+	}
+	RWUNLOCK(&shard->lock, isc_rwlocktype_read);
+
+	RWLOCK(&shard->lock, isc_rwlocktype_write);
+	count = atomic_fetch_sub_relaxed(&share->count, 1);
+	INSIST(count > 0);
+	if (count == 1) {
+		result = isc_swisstable_delete(shard->table, share->hashval,
+					       recursionshare_match, share->key);
+		INSIST(result == ISC_R_SUCCESS);
+		count = atomic_fetch_sub_relaxed(&sctx->recursionprefixes, 1);
+		INSIST(count > 0);
+		isc_mem_put(sctx->mctx, share, sizeof(*share));
+	}
+	RWUNLOCK(&shard->lock, isc_rwlocktype_write);
+}
+
+bool
+ns_server_recursionshare_over(ns_server_t *sctx,
+			      const ns_recursionshare_t *share) {
+	uint32_t used, prefixes, limit;
+
+	REQUIRE(SCTX_VALID(sctx));
+
+	if (share == NULL) {
+		return false;
+	}
+
+	used = atomic_load_relaxed(&share->count);
+	prefixes = atomic_load_relaxed(&sctx->recursionprefixes);
+
+	limit = isc_quota_getsoft(&sctx->recursionquota);
+	if (limit == 0) {
+		limit = isc_quota_getmax(&sctx->recursionquota);
+	}
+	limit /= ISC_MAX(prefixes, 1);
+
+	return used > ISC_MAX(limit, sctx->recursionminshare);
+}
+
 void
 ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota) {
 	REQUIRE(SCTX_VALID(sctx));
@@ -253,3 +496,61 @@ ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota) {
 	ISC_LIST_APPEND(sctx->http_quotas, http_quota, link);
 	UNLOCK(&sctx->http_quotas_lock);
 }
+
+size_t
+ns_server_gethitters(isc_topkmulti_t *tm, isc_topk_entry_t *entries,
+		     size_t size) {
+	isc_topk_t *tk = NULL;
+	size_t count;
+
+	REQUIRE(entries != NULL);
+
+	if (tm == NULL) {
+		return 0;
+	}
+
+	isc_topkmulti_merge(&tk, tm, isc_stdtime_now());
+	count = isc_topk_get(tk, entries, size);
+	isc_topk_destroy(&tk);
+
+	return count;
+}
+
+void
+ns_server_formathitter(const isc_topk_entry_t *entry, bool address, char *buf,
+		       size_t size) {
+	REQUIRE(entry != NULL);
+	REQUIRE(buf != NULL && size > 0);
+
+	if (address) {
+		isc_netaddr_t netaddr;
+		struct in_addr ina;
+		struct in6_addr ina6;
+
+		if (entry->length == 1 + sizeof(ina) &&
+		    entry->key[0] == AF_INET)
+		{
+			memmove(&ina, entry->key + 1, sizeof(ina));
+			isc_netaddr_fromin(&netaddr, &ina);
+		} else if (entry->length == 1 + sizeof(ina6) &&
+			   entry->key[0] == AF_INET6)
+		{
+			memmove(&ina6, entry->key + 1, sizeof(ina6));
+			isc_netaddr_fromin6(&netaddr, &ina6);
+		} else {
+			strlcpy(buf, "?", size);
+			return;
+		}
+		isc_netaddr_format(&netaddr, buf, size);
+	} else {
+		dns_name_t name;
+		isc_region_t r = {
+			.base = UNCONST(entry->key),
+			.length = entry->length,
+		};
+
+		dns_name_init(&name);
+		dns_name_fromregion(&name, &r);
+		dns_name_format(&name, buf, size);
+	}
+}
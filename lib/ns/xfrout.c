@@ -13,11 +13,16 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
 
+#include <isc/async.h>
 #include <isc/formatcheck.h>
 #include <isc/list.h>
 #include <isc/log.h>
+#include <isc/loop.h>
+#include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/netmgr.h>
 #include <isc/result.h>
 #include <isc/stats.h>
@@ -624,11 +629,89 @@ struct xfr_stats {
 	isc_time_t end;	  /*%< End time of the transfer */
 };
 
+/*%
+ * Concurrent AXFRs over TCP of the same zone version share the rendered
+ * answer sections of their messages.  The first transfer creates an
+ * 'ns_axfrcache_t' with its own RR stream; whichever transfer gets ahead
+ * renders the next message and appends its answer section to the cache
+ * as an 'axfr_chunk_t', and the other transfers replay it, wrapping it in
+ * their own message ID, OPT record and TSIG.
+ *
+ * The compression pointers in a chunk refer to the question section of
+ * the first message, so a transfer only joins a cache whose question
+ * name matches its own exactly, case included.  A chunk is freed once
+ * every reader has sent it, but only after the cache has stopped taking
+ * new readers, which happens when it outgrows AXFRCACHE_MAXSIZE; until
+ * then a transfer starting late can still replay the stream from the
+ * beginning.
+ *
+ * Messages are rendered without holding the cache lock, one at a time;
+ * readers that need the message being rendered wait on the 'waiters'
+ * list and are resumed on their own loop when it is ready.  The renderer
+ * never gets more than AXFRCACHE_MAXSIZE ahead of the slowest reader:
+ * a reader that would render past that leaves the cache and carries on
+ * with an RR stream of its own (see axfrcache_leave()).
+ */
+#define AXFRCACHE_MAGIC	   ISC_MAGIC('X', 'f', 'r', 'C')
+#define VALID_AXFRCACHE(c) ISC_MAGIC_VALID(c, AXFRCACHE_MAGIC)
+
+/*%
+ * Space left in each cached message for the OPT record and TSIG that
+ * are added when the message is replayed.
+ */
+#define AXFRCACHE_RESERVE 1024
+
+/*%
+ * Size of the rendered data above which a cache stops taking readers,
+ * and how far the rendered data may run ahead of the slowest reader.
+ */
+#define AXFRCACHE_MAXSIZE (64 * 1024 * 1024)
+
+typedef struct xfrout_ctx xfrout_ctx_t;
+
+typedef struct axfr_chunk axfr_chunk_t;
+struct axfr_chunk {
+	ISC_LINK(axfr_chunk_t) link;
+	unsigned int count; /* Number of RRs */
+	bool first;	    /* Follows the question section */
+	bool last;	    /* Ends the stream */
+	unsigned int done;  /* Readers that have sent the chunk */
+	unsigned int length;
+	unsigned char data[];
+};
+
+struct ns_axfrcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	unsigned int references; /* Locked by sctx->axfrcaches_lock */
+	dns_db_t *db;
+	dns_dbversion_t *ver;
+	dns_fixedname_t fqname;
+	dns_name_t *qname;
+	dns_rdataclass_t qclass;
+	bool many_answers;
+	unsigned int msgsize; /* transfer-message-size */
+
+	isc_mutex_t lock;
+	rrstream_t *stream; /* NULL once the stream is rendered */
+	isc_result_t result;
+	ISC_LIST(axfr_chunk_t) chunks;
+	size_t size;
+	size_t maxsize;	      /* AXFRCACHE_MAXSIZE */
+	unsigned int nchunks; /* Chunks rendered */
+	bool trimmed;	      /* Chunks have been freed; no new readers */
+	bool rendering;	      /* A reader is rendering the next chunk */
+	unsigned int readers;
+	ISC_LIST(xfrout_ctx_t) waiters; /* Waiting for the next chunk */
+
+	ISC_LINK(ns_axfrcache_t) link;
+};
+
 /*%
  * An 'xfrout_ctx_t' contains the state of an outgoing AXFR or IXFR
  * in progress.
  */
-typedef struct {
+struct xfrout_ctx {
 	isc_mem_t *mctx;
 	ns_client_t *client;
 	unsigned int id;       /* ID of request */
@@ -658,6 +741,12 @@ typedef struct {
 	uint32_t end_serial;	/* Serial number after XFR is done */
 	struct xfr_stats stats; /*%< Transfer statistics */
 
+	/* Shared AXFR stream, used instead of 'stream' */
+	ns_axfrcache_t *cache;
+	axfr_chunk_t *chunk; /*%< Last chunk taken from 'cache' */
+	isc_loop_t *waitloop; /*%< Loop to resume on, when waiting */
+	ISC_LINK(xfrout_ctx_t) waitlink;
+
 	/* Timeouts */
 	uint64_t maxtime; /*%< Maximum XFR timeout (in ms) */
 	isc_nm_timer_t *maxtime_timer;
@@ -666,7 +755,7 @@ typedef struct {
 
 	/* Delayed send */
 	isc_nm_timer_t *delayed_send_timer;
-} xfrout_ctx_t;
+};
 
 static void
 xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
@@ -678,6 +767,18 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 		  unsigned int idletime, bool many_answers,
 		  xfrout_ctx_t **xfrp);
 
+static isc_result_t
+axfrcache_attach(ns_server_t *sctx, const dns_name_t *qname,
+		 dns_rdataclass_t qclass, dns_db_t *db, dns_dbversion_t *ver,
+		 bool many_answers, ns_axfrcache_t **cachep);
+
+static void
+axfrcache_detach(ns_server_t *sctx, ns_axfrcache_t **cachep,
+		 axfr_chunk_t *chunk);
+
+static void
+axfrcache_resume(void *arg);
+
 static void
 sendstream(xfrout_ctx_t *xfr);
 
@@ -720,6 +821,7 @@ ns_xfr_start(ns_client_t *client, dns_rdatatype_t reqtype) {
 	dns_rdataclass_t question_class;
 	rrstream_t *soa_stream = NULL;
 	rrstream_t *data_stream = NULL;
+	ns_axfrcache_t *cache = NULL;
 	rrstream_t *stream = NULL;
 	dns_difftuple_t *current_soa_tuple = NULL;
 	dns_rdata_t soa_rdata = DNS_RDATA_INIT;
@@ -1046,6 +1148,22 @@ got_soa:
 		is_ixfr = true;
 	} else {
 	axfr_fallback:
+		/*
+		 * Share the rendered messages with other AXFRs of the
+		 * same version.  Padded responses are left alone, as
+		 * the padding could need more than the space reserved
+		 * in the cached messages.
+		 */
+		if (reqtype == dns_rdatatype_axfr && client->inner.tcp &&
+		    !is_dlz && !client->inner.wantpad)
+		{
+			CHECK(axfrcache_attach(client->manager->sctx,
+					       question_name, question_class,
+					       db, ver,
+					       format == dns_many_answers,
+					       &cache));
+			goto have_stream;
+		}
 		CHECK(axfr_rrstream_create(mctx, db, ver, &data_stream));
 	}
 
@@ -1084,9 +1202,13 @@ have_stream:
 
 	xfr->end_serial = current_serial;
 	xfr->mnemonic = mnemonic;
+	xfr->cache = cache;
 	stream = NULL;
+	cache = NULL;
 
-	CHECK(xfr->stream->methods->first(xfr->stream));
+	if (xfr->stream != NULL) {
+		CHECK(xfr->stream->methods->first(xfr->stream));
+	}
 
 	if (xfr->tsigkey != NULL) {
 		dns_name_format(xfr->tsigkey->name, keyname, sizeof(keyname));
@@ -1168,6 +1290,9 @@ cleanup:
 	if (data_stream != NULL) {
 		data_stream->methods->destroy(&data_stream);
 	}
+	if (cache != NULL) {
+		axfrcache_detach(client->manager->sctx, &cache, NULL);
+	}
 	if (ver != NULL) {
 		dns_db_closeversion(db, &ver, false);
 	}
@@ -1222,6 +1347,7 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 		.lasttsig = lasttsig,
 		.verified_tsig = verified_tsig,
 		.many_answers = many_answers,
+		.waitlink = ISC_LINK_INITIALIZER,
 	};
 
 	isc_mem_attach(mctx, &xfr->mctx);
@@ -1341,131 +1467,98 @@ xfrout_enqueue_send(xfrout_ctx_t *xfr) {
 }
 
 /*
- * Arrange to send as much as we can of "stream" without blocking.
- *
- * Requires:
- *	The stream iterator is initialized and points at an RR,
- *      or possibly at the end of the stream (that is, the
- *      _first method of the iterator has been called).
+ * Set up 'msg' as the next TCP message of the transfer, and account for
+ * the space reserved for its OPT and TSIG records in xfr->buf.
  */
-static void
-sendstream(xfrout_ctx_t *xfr) {
-	dns_message_t *tcpmsg = NULL;
-	dns_message_t *msg = NULL; /* Client message if UDP, tcpmsg if TCP */
-	isc_result_t result;
-	dns_rdataset_t *qrdataset;
-	dns_name_t *msgname = NULL;
-	dns_rdata_t *msgrdata = NULL;
-	dns_rdatalist_t *msgrdl = NULL;
-	dns_rdataset_t *msgrds = NULL;
-	dns_compress_t cctx;
-	bool cleanup_cctx = false;
-	bool is_tcp;
-	int n_rrs;
-
-	isc_buffer_clear(&xfr->buf);
-	isc_buffer_clear(&xfr->txbuf);
+static isc_result_t
+inittcpmsg(xfrout_ctx_t *xfr, dns_message_t *msg) {
+	msg->id = xfr->id;
+	msg->rcode = dns_rcode_noerror;
+	msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+	if (xfr->client->inner.ra) {
+		msg->flags |= DNS_MESSAGEFLAG_RA;
+	}
+	RETERR(dns_message_settsigkey(msg, xfr->tsigkey));
+	dns_message_setquerytsig(msg, xfr->lasttsig);
+	if (xfr->lasttsig != NULL) {
+		isc_buffer_free(&xfr->lasttsig);
+	}
+	msg->verified_sig = xfr->verified_tsig;
 
-	is_tcp = xfr->client->inner.tcp;
-	if (!is_tcp) {
-		/*
-		 * In the UDP case, we put the response data directly into
-		 * the client message.
-		 */
-		msg = xfr->client->message;
-		CHECK(dns_message_reply(msg, true));
-	} else {
+	/*
+	 * Add a EDNS option to the message?
+	 */
+	if (xfr->client->inner.wantopt) {
+		RETERR(ns_client_addopt(xfr->client, msg));
 		/*
-		 * TCP. Build a response dns_message_t, temporarily storing
-		 * the raw, uncompressed owner names and RR data contiguously
-		 * in xfr->buf.  We know that if the uncompressed data fits
-		 * in xfr->buf, the compressed data will surely fit in a TCP
-		 * message.
+		 * Add to first message only.
 		 */
+		xfr->client->inner.wantnsid = false;
+		xfr->client->inner.haveexpire = false;
+	}
 
-		dns_message_create(xfr->mctx, NULL, NULL,
-				   DNS_MESSAGE_INTENTRENDER, &tcpmsg);
-		msg = tcpmsg;
+	/*
+	 * Account for reserved space.
+	 */
+	if (xfr->tsigkey != NULL) {
+		INSIST(msg->reserved != 0U);
+	}
+	isc_buffer_add(&xfr->buf, msg->reserved);
 
-		msg->id = xfr->id;
-		msg->rcode = dns_rcode_noerror;
-		msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
-		if (xfr->client->inner.ra) {
-			msg->flags |= DNS_MESSAGEFLAG_RA;
-		}
-		CHECK(dns_message_settsigkey(msg, xfr->tsigkey));
-		dns_message_setquerytsig(msg, xfr->lasttsig);
-		if (xfr->lasttsig != NULL) {
-			isc_buffer_free(&xfr->lasttsig);
-		}
-		msg->verified_sig = xfr->verified_tsig;
+	return ISC_R_SUCCESS;
+}
 
-		/*
-		 * Add a EDNS option to the message?
-		 */
-		if (xfr->client->inner.wantopt) {
-			CHECK(ns_client_addopt(xfr->client, msg));
-			/*
-			 * Add to first message only.
-			 */
-			xfr->client->inner.wantnsid = false;
-			xfr->client->inner.haveexpire = false;
-		}
+/*
+ * Include a question section in the first message only.
+ * BIND 8.2.1 will not recognize an IXFR if it does not
+ * have a question section.
+ */
+static void
+addquestion(xfrout_ctx_t *xfr, dns_message_t *msg) {
+	dns_rdataset_t *qrdataset = NULL;
+	dns_name_t *qname = NULL;
+	isc_region_t r;
 
-		/*
-		 * Account for reserved space.
-		 */
-		if (xfr->tsigkey != NULL) {
-			INSIST(msg->reserved != 0U);
-		}
-		isc_buffer_add(&xfr->buf, msg->reserved);
+	/*
+	 * Reserve space for the 12-byte message header
+	 * and 4 bytes of question.
+	 */
+	isc_buffer_add(&xfr->buf, 12 + 4);
+
+	dns_message_gettemprdataset(msg, &qrdataset);
+	dns_rdataset_makequestion(qrdataset, xfr->client->message->rdclass,
+				  xfr->qtype);
+
+	dns_message_gettempname(msg, &qname);
+	isc_buffer_availableregion(&xfr->buf, &r);
+	INSIST(r.length >= xfr->qname->length);
+	r.length = xfr->qname->length;
+	isc_buffer_putmem(&xfr->buf, xfr->qname->ndata, xfr->qname->length);
+	dns_name_fromregion(qname, &r);
+	ISC_LIST_INIT(qname->list);
+	ISC_LIST_APPEND(qname->list, qrdataset, link);
+
+	dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
+}
 
-		/*
-		 * Include a question section in the first message only.
-		 * BIND 8.2.1 will not recognize an IXFR if it does not
-		 * have a question section.
-		 */
-		if (!xfr->question_added) {
-			dns_name_t *qname = NULL;
-			isc_region_t r;
+/*
+ * Add RRs from 'stream' to the answer section of 'msg', temporarily
+ * storing their owner names and RR data in xfr->buf.  Try to fit in
+ * as many RRs as possible, unless "one-answer" format has been
+ * requested.  The number of RRs added is stored in '*countp'.
+ */
+static isc_result_t
+addrrs(xfrout_ctx_t *xfr, rrstream_t *stream, dns_message_t *msg,
+       bool is_tcp, unsigned int *countp, bool *eosp) {
+	isc_result_t result;
+	dns_name_t *msgname = NULL;
+	dns_rdata_t *msgrdata = NULL;
+	dns_rdatalist_t *msgrdl = NULL;
+	dns_rdataset_t *msgrds = NULL;
+	unsigned int n_rrs;
 
-			/*
-			 * Reserve space for the 12-byte message header
-			 * and 4 bytes of question.
-			 */
-			isc_buffer_add(&xfr->buf, 12 + 4);
-
-			qrdataset = NULL;
-			dns_message_gettemprdataset(msg, &qrdataset);
-			dns_rdataset_makequestion(qrdataset,
-						  xfr->client->message->rdclass,
-						  xfr->qtype);
-
-			dns_message_gettempname(msg, &qname);
-			isc_buffer_availableregion(&xfr->buf, &r);
-			INSIST(r.length >= xfr->qname->length);
-			r.length = xfr->qname->length;
-			isc_buffer_putmem(&xfr->buf, xfr->qname->ndata,
-					  xfr->qname->length);
-			dns_name_fromregion(qname, &r);
-			ISC_LIST_INIT(qname->list);
-			ISC_LIST_APPEND(qname->list, qrdataset, link);
-
-			dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
-			xfr->question_added = true;
-		} else {
-			/*
-			 * Reserve space for the 12-byte message header
-			 */
-			isc_buffer_add(&xfr->buf, 12);
-			msg->tcp_continuation = 1;
-		}
-	}
+	*countp = 0;
 
-	/*
-	 * Try to fit in as many RRs as possible, unless "one-answer"
-	 * format has been requested.
-	 */
 	for (n_rrs = 0;; n_rrs++) {
 		dns_name_t *name = NULL;
 		uint32_t ttl;
@@ -1479,7 +1572,7 @@ sendstream(xfrout_ctx_t *xfr) {
 		msgrdl = NULL;
 		msgrds = NULL;
 
-		xfr->stream->methods->current(xfr->stream, &name, &ttl, &rdata);
+		stream->methods->current(stream, &name, &ttl, &rdata);
 		size = name->length + 10 + rdata->length;
 		isc_buffer_availableregion(&xfr->buf, &r);
 		if (size >= r.length) {
@@ -1501,7 +1594,7 @@ sendstream(xfrout_ctx_t *xfr) {
 					   "(%d bytes)",
 					   size);
 				/* XXX DNS_R_RRTOOLARGE? */
-				CLEANUP(ISC_R_NOSPACE);
+				return ISC_R_NOSPACE;
 			}
 			break;
 		}
@@ -1545,14 +1638,14 @@ sendstream(xfrout_ctx_t *xfr) {
 		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
 		msgname = NULL;
 
-		xfr->stats.nrecs++;
+		(*countp)++;
 
-		result = xfr->stream->methods->next(xfr->stream);
+		result = stream->methods->next(stream);
 		if (result == ISC_R_NOMORE) {
-			xfr->end_of_stream = true;
+			*eosp = true;
 			break;
 		}
-		CHECK(result);
+		RETERR(result);
 
 		if (!xfr->many_answers) {
 			break;
@@ -1570,6 +1663,555 @@ sendstream(xfrout_ctx_t *xfr) {
 		}
 	}
 
+	return ISC_R_SUCCESS;
+}
+
+static isc_result_t
+axfrcache_attach(ns_server_t *sctx, const dns_name_t *qname,
+		 dns_rdataclass_t qclass, dns_db_t *db, dns_dbversion_t *ver,
+		 bool many_answers, ns_axfrcache_t **cachep) {
+	isc_result_t result;
+	ns_axfrcache_t *cache = NULL;
+	rrstream_t *data_stream = NULL, *soa_stream = NULL, *stream = NULL;
+
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	LOCK(&sctx->axfrcaches_lock);
+	ISC_LIST_FOREACH(sctx->axfrcaches, c, link) {
+		bool joined = false;
+
+		if (c->db != db || c->ver != ver || c->qclass != qclass ||
+		    c->many_answers != many_answers ||
+		    c->msgsize != sctx->transfer_tcp_message_size ||
+		    !dns_name_caseequal(c->qname, qname))
+		{
+			continue;
+		}
+
+		LOCK(&c->lock);
+		if (!c->trimmed && c->result == ISC_R_SUCCESS) {
+			c->readers++;
+			joined = true;
+		}
+		UNLOCK(&c->lock);
+
+		if (joined) {
+			c->references++;
+			UNLOCK(&sctx->axfrcaches_lock);
+			*cachep = c;
+			return ISC_R_SUCCESS;
+		}
+	}
+	UNLOCK(&sctx->axfrcaches_lock);
+
+	/*
+	 * Nothing to join; start a new stream.  Two transfers starting
+	 * at the same time may both get here, in which case each of them
+	 * renders its own stream.
+	 */
+	CHECK(axfr_rrstream_create(sctx->mctx, db, ver, &data_stream));
+	CHECK(soa_rrstream_create(sctx->mctx, db, ver, &soa_stream));
+	CHECK(compound_rrstream_create(sctx->mctx, &soa_stream, &data_stream,
+				       &stream));
+	CHECK(stream->methods->first(stream));
+
+	cache = isc_mem_get(sctx->mctx, sizeof(*cache));
+	*cache = (ns_axfrcache_t){
+		.magic = AXFRCACHE_MAGIC,
+		.references = 1,
+		.qclass = qclass,
+		.many_answers = many_answers,
+		.msgsize = sctx->transfer_tcp_message_size,
+		.stream = stream,
+		.result = ISC_R_SUCCESS,
+		.chunks = ISC_LIST_INITIALIZER,
+		.maxsize = AXFRCACHE_MAXSIZE,
+		.readers = 1,
+		.waiters = ISC_LIST_INITIALIZER,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	stream = NULL;
+
+	isc_mem_attach(sctx->mctx, &cache->mctx);
+	dns_db_attach(db, &cache->db);
+	dns_db_attachversion(db, ver, &cache->ver);
+	cache->qname = dns_fixedname_initname(&cache->fqname);
+	dns_name_copy(qname, cache->qname);
+	isc_mutex_init(&cache->lock);
+
+	LOCK(&sctx->axfrcaches_lock);
+	ISC_LIST_APPEND(sctx->axfrcaches, cache, link);
+	UNLOCK(&sctx->axfrcaches_lock);
+
+	*cachep = cache;
+
+cleanup:
+	if (stream != NULL) {
+		stream->methods->destroy(&stream);
+	}
+	if (soa_stream != NULL) {
+		soa_stream->methods->destroy(&soa_stream);
+	}
+	if (data_stream != NULL) {
+		data_stream->methods->destroy(&data_stream);
+	}
+	return result;
+}
+
+static void
+axfrcache_destroy(ns_axfrcache_t *cache) {
+	INSIST(cache->readers == 0);
+	INSIST(!cache->rendering && ISC_LIST_EMPTY(cache->waiters));
+
+	ISC_LIST_FOREACH(cache->chunks, chunk, link) {
+		ISC_LIST_UNLINK(cache->chunks, chunk, link);
+		isc_mem_put(cache->mctx, chunk, sizeof(*chunk) + chunk->length);
+	}
+	if (cache->stream != NULL) {
+		cache->stream->methods->destroy(&cache->stream);
+	}
+	dns_db_closeversion(cache->db, &cache->ver, false);
+	dns_db_detach(&cache->db);
+	isc_mutex_destroy(&cache->lock);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+/*
+ * Free the chunks at the head of the cache that every reader has sent,
+ * once the cache has grown too big to be replayed from the beginning.
+ * Requires the cache to be locked.
+ */
+static void
+axfrcache_trim(ns_axfrcache_t *cache) {
+	if (!cache->trimmed && cache->size <= cache->maxsize) {
+		return;
+	}
+
+	cache->trimmed = true;
+	ISC_LIST_FOREACH(cache->chunks, chunk, link) {
+		if (chunk->done < cache->readers) {
+			break;
+		}
+		ISC_LIST_UNLINK(cache->chunks, chunk, link);
+		cache->size -= chunk->length;
+		isc_mem_put(cache->mctx, chunk, sizeof(*chunk) + chunk->length);
+	}
+}
+
+/*
+ * Stop reading from the cache.  'chunk' is the last chunk the reader
+ * has taken, if any.
+ */
+static void
+axfrcache_detach(ns_server_t *sctx, ns_axfrcache_t **cachep,
+		 axfr_chunk_t *chunk) {
+	ns_axfrcache_t *cache = NULL;
+	bool destroy = false;
+
+	REQUIRE(cachep != NULL && VALID_AXFRCACHE(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	LOCK(&cache->lock);
+	/*
+	 * Forget that we sent the chunks before 'chunk', so that they
+	 * are not left waiting for us.
+	 */
+	if (chunk != NULL) {
+		ISC_LIST_FOREACH(cache->chunks, c, link) {
+			if (c == chunk) {
+				break;
+			}
+			INSIST(c->done > 0);
+			c->done--;
+		}
+	}
+	INSIST(cache->readers > 0);
+	cache->readers--;
+	axfrcache_trim(cache);
+	UNLOCK(&cache->lock);
+
+	LOCK(&sctx->axfrcaches_lock);
+	INSIST(cache->references > 0);
+	if (--cache->references == 0) {
+		ISC_LIST_UNLINK(sctx->axfrcaches, cache, link);
+		destroy = true;
+	}
+	UNLOCK(&sctx->axfrcaches_lock);
+
+	if (destroy) {
+		axfrcache_destroy(cache);
+	}
+}
+
+/*
+ * Render the next message of the cache's stream into a new chunk, using
+ * the buffers of 'xfr'.  Only the reader that has set cache->rendering
+ * may call this, without holding the cache lock.
+ */
+static isc_result_t
+axfrcache_render(ns_axfrcache_t *cache, xfrout_ctx_t *xfr,
+		 axfr_chunk_t **chunkp) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	bool cleanup_cctx = false;
+	bool first = (cache->nchunks == 0);
+	bool eos = false;
+	unsigned int count = 0, offset;
+	axfr_chunk_t *chunk = NULL;
+	isc_region_t r;
+
+	isc_buffer_clear(&xfr->buf);
+	isc_buffer_clear(&xfr->txbuf);
+
+	dns_message_create(xfr->mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &msg);
+
+	/*
+	 * Leave room for the OPT and TSIG records of the readers.
+	 */
+	isc_buffer_add(&xfr->buf, AXFRCACHE_RESERVE);
+	if (first) {
+		addquestion(xfr, msg);
+	} else {
+		isc_buffer_add(&xfr->buf, 12);
+		msg->tcp_continuation = 1;
+	}
+
+	CHECK(addrrs(xfr, cache->stream, msg, true, &count, &eos));
+
+	dns_compress_init(&cctx, xfr->mctx,
+			  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
+	cleanup_cctx = true;
+	CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
+	CHECK(dns_message_renderreserve(msg, AXFRCACHE_RESERVE));
+	CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
+	offset = isc_buffer_usedlength(&xfr->txbuf);
+	CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
+
+	isc_buffer_usedregion(&xfr->txbuf, &r);
+	isc_region_consume(&r, offset);
+
+	chunk = isc_mem_get(cache->mctx, sizeof(*chunk) + r.length);
+	*chunk = (axfr_chunk_t){
+		.link = ISC_LINK_INITIALIZER,
+		.count = count,
+		.first = first,
+		.last = eos,
+		.length = r.length,
+	};
+	memmove(chunk->data, r.base, r.length);
+	*chunkp = chunk;
+
+	xfrout_log(xfr, ISC_LOG_DEBUG(8), "rendered shared message of %u RRs",
+		   count);
+
+	if (!eos) {
+		/*
+		 * Release the database iterator locks until the next
+		 * message is needed.
+		 */
+		cache->stream->methods->pause(cache->stream);
+	}
+
+cleanup:
+	if (cleanup_cctx) {
+		dns_compress_invalidate(&cctx);
+	}
+	dns_message_detach(&msg);
+
+	return result;
+}
+
+/*
+ * Move 'xfr' on to the next chunk of its cache, rendering it if no
+ * other reader has done so yet.  Returns DNS_R_WAIT if another reader
+ * is rendering it: 'xfr' is then resumed with sendstream() on the
+ * current loop once it is ready.  Returns ISC_R_QUOTA if rendering it
+ * would get too far ahead of the slowest reader.
+ */
+static isc_result_t
+axfrcache_next(ns_axfrcache_t *cache, xfrout_ctx_t *xfr) {
+	isc_result_t result = ISC_R_SUCCESS;
+	axfr_chunk_t *chunk = NULL;
+	ISC_LIST(xfrout_ctx_t) waiters = ISC_LIST_INITIALIZER;
+
+	REQUIRE(VALID_AXFRCACHE(cache));
+
+	LOCK(&cache->lock);
+	if (xfr->chunk == NULL) {
+		chunk = ISC_LIST_HEAD(cache->chunks);
+	} else {
+		chunk = ISC_LIST_NEXT(xfr->chunk, link);
+	}
+	if (chunk != NULL) {
+		/* Already rendered */
+	} else if (cache->rendering) {
+		xfr->waitloop = isc_loop();
+		ISC_LIST_APPEND(cache->waiters, xfr, waitlink);
+		result = DNS_R_WAIT;
+	} else if (cache->stream == NULL) {
+		/* Readers stop at the last chunk. */
+		result = cache->result;
+		INSIST(result != ISC_R_SUCCESS);
+	} else if (cache->size > cache->maxsize) {
+		result = ISC_R_QUOTA;
+	} else {
+		cache->rendering = true;
+		UNLOCK(&cache->lock);
+
+		result = axfrcache_render(cache, xfr, &chunk);
+
+		LOCK(&cache->lock);
+		cache->rendering = false;
+		if (result == ISC_R_SUCCESS) {
+			ISC_LIST_APPEND(cache->chunks, chunk, link);
+			cache->size += chunk->length;
+			cache->nchunks++;
+		}
+		if (result != ISC_R_SUCCESS || chunk->last) {
+			cache->stream->methods->destroy(&cache->stream);
+			cache->stream = NULL;
+			cache->result = result;
+		}
+		ISC_LIST_MOVE(waiters, cache->waiters);
+	}
+	if (result == ISC_R_SUCCESS) {
+		if (xfr->chunk != NULL) {
+			xfr->chunk->done++;
+		}
+		xfr->chunk = chunk;
+		axfrcache_trim(cache);
+	}
+	UNLOCK(&cache->lock);
+
+	ISC_LIST_FOREACH(waiters, w, waitlink) {
+		ISC_LIST_UNLINK(waiters, w, waitlink);
+		isc_async_run(w->waitloop, axfrcache_resume, w);
+	}
+
+	return result;
+}
+
+/*
+ * Resume a reader that waited for the next chunk of its cache.
+ */
+static void
+axfrcache_resume(void *arg) {
+	xfrout_ctx_t *xfr = arg;
+
+	xfr->waitloop = NULL;
+	if (xfr->shuttingdown) {
+		xfrout_maybe_destroy(xfr);
+	} else {
+		sendstream(xfr);
+	}
+}
+
+/*
+ * Stop sharing the cache of 'xfr', and carry on from where it left off
+ * with an RR stream of its own.
+ */
+static isc_result_t
+axfrcache_leave(xfrout_ctx_t *xfr) {
+	isc_result_t result;
+	rrstream_t *data_stream = NULL, *soa_stream = NULL, *stream = NULL;
+
+	CHECK(axfr_rrstream_create(xfr->mctx, xfr->db, xfr->ver,
+				   &data_stream));
+	CHECK(soa_rrstream_create(xfr->mctx, xfr->db, xfr->ver, &soa_stream));
+	CHECK(compound_rrstream_create(xfr->mctx, &soa_stream, &data_stream,
+				       &stream));
+
+	/*
+	 * The stream is for the same version as the cache's, so it has
+	 * the same RRs in the same order.
+	 */
+	result = stream->methods->first(stream);
+	for (uint64_t i = 0; result == ISC_R_SUCCESS && i < xfr->stats.nrecs;
+	     i++)
+	{
+		result = stream->methods->next(stream);
+	}
+	CHECK(result);
+
+	xfrout_log(xfr, ISC_LOG_DEBUG(3),
+		   "leaving shared stream after %" PRIu64 " records",
+		   xfr->stats.nrecs);
+
+	axfrcache_detach(xfr->client->manager->sctx, &xfr->cache, xfr->chunk);
+	xfr->chunk = NULL;
+	xfr->question_added = true;
+	xfr->stream = stream;
+	stream = NULL;
+
+cleanup:
+	if (stream != NULL) {
+		stream->methods->destroy(&stream);
+	}
+	if (soa_stream != NULL) {
+		soa_stream->methods->destroy(&soa_stream);
+	}
+	if (data_stream != NULL) {
+		data_stream->methods->destroy(&data_stream);
+	}
+	return result;
+}
+
+/*
+ * Send the next message of a shared AXFR stream: the cached answer
+ * section, wrapped in our own header, question, OPT record and TSIG.
+ */
+static void
+sendcached(xfrout_ctx_t *xfr) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	bool cleanup_cctx = false;
+	axfr_chunk_t *chunk = NULL;
+	isc_region_t r;
+
+	REQUIRE(xfr->client->inner.tcp);
+
+	result = axfrcache_next(xfr->cache, xfr);
+	switch (result) {
+	case ISC_R_SUCCESS:
+		break;
+	case DNS_R_WAIT:
+		/* axfrcache_resume() carries on */
+		return;
+	case ISC_R_QUOTA:
+		CHECK(axfrcache_leave(xfr));
+		sendstream(xfr);
+		return;
+	default:
+		goto cleanup;
+	}
+	chunk = xfr->chunk;
+
+	isc_buffer_clear(&xfr->buf);
+	isc_buffer_clear(&xfr->txbuf);
+
+	dns_message_create(xfr->mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &msg);
+	CHECK(inittcpmsg(xfr, msg));
+
+	/*
+	 * The compression pointers in the first chunk refer to the
+	 * question name, which is the same as ours.
+	 */
+	if (chunk->first) {
+		addquestion(xfr, msg);
+	} else {
+		msg->tcp_continuation = 1;
+	}
+
+	dns_compress_init(&cctx, xfr->mctx,
+			  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
+	cleanup_cctx = true;
+	CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
+	CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
+	r = (isc_region_t){ .base = chunk->data, .length = chunk->length };
+	CHECK(dns_message_renderraw(msg, DNS_SECTION_ANSWER, &r,
+				    chunk->count));
+	CHECK(dns_message_renderend(msg));
+	dns_compress_invalidate(&cctx);
+	cleanup_cctx = false;
+
+	xfr->stats.nrecs += chunk->count;
+	xfr->end_of_stream = chunk->last;
+
+	xfrout_log(xfr, ISC_LOG_DEBUG(8),
+		   "sending shared TCP message of %d bytes",
+		   isc_buffer_usedlength(&xfr->txbuf));
+
+	xfrout_enqueue_send(xfr);
+
+	/* Advance lasttsig to be the last TSIG generated */
+	CHECK(dns_message_getquerytsig(msg, xfr->mctx, &xfr->lasttsig));
+
+cleanup:
+	if (cleanup_cctx) {
+		dns_compress_invalidate(&cctx);
+	}
+	if (msg != NULL) {
+		dns_message_detach(&msg);
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		xfrout_fail(xfr, result, "sending zone data");
+	}
+}
+
+/*
+ * Arrange to send as much as we can of "stream" without blocking.
+ *
+ * Requires:
+ *	The stream iterator is initialized and points at an RR,
+ *      or possibly at the end of the stream (that is, the
+ *      _first method of the iterator has been called).
+ */
+static void
+sendstream(xfrout_ctx_t *xfr) {
+	dns_message_t *tcpmsg = NULL;
+	dns_message_t *msg = NULL; /* Client message if UDP, tcpmsg if TCP */
+	isc_result_t result;
+	dns_compress_t cctx;
+	bool cleanup_cctx = false;
+	bool is_tcp;
+	unsigned int n_rrs = 0;
+
+	if (xfr->cache != NULL) {
+		sendcached(xfr);
+		return;
+	}
+
+	isc_buffer_clear(&xfr->buf);
+	isc_buffer_clear(&xfr->txbuf);
+
+	is_tcp = xfr->client->inner.tcp;
+	if (!is_tcp) {
+		/*
+		 * In the UDP case, we put the response data directly into
+		 * the client message.
+		 */
+		msg = xfr->client->message;
+		CHECK(dns_message_reply(msg, true));
+	} else {
+		/*
+		 * TCP. Build a response dns_message_t, temporarily storing
+		 * the raw, uncompressed owner names and RR data contiguously
+		 * in xfr->buf.  We know that if the uncompressed data fits
+		 * in xfr->buf, the compressed data will surely fit in a TCP
+		 * message.
+		 */
+
+		dns_message_create(xfr->mctx, NULL, NULL,
+				   DNS_MESSAGE_INTENTRENDER, &tcpmsg);
+		msg = tcpmsg;
+
+		CHECK(inittcpmsg(xfr, msg));
+
+		if (!xfr->question_added) {
+			addquestion(xfr, msg);
+			xfr->question_added = true;
+		} else {
+			/*
+			 * Reserve space for the 12-byte message header
+			 */
+			isc_buffer_add(&xfr->buf, 12);
+			msg->tcp_continuation = 1;
+		}
+	}
+
+	result = addrrs(xfr, xfr->stream, msg, is_tcp, &n_rrs,
+			&xfr->end_of_stream);
+	xfr->stats.nrecs += n_rrs;
+	CHECK(result);
+
 	if (is_tcp) {
 		dns_compress_init(&cctx, xfr->mctx,
 				  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
@@ -1623,6 +2265,7 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 	*xfrp = NULL;
 
 	INSIST(xfr->sends == 0);
+	INSIST(xfr->waitloop == NULL);
 
 	isc_nm_timer_stop(xfr->delayed_send_timer);
 	isc_nm_timer_detach(&xfr->delayed_send_timer);
@@ -1633,6 +2276,10 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 	if (xfr->stream != NULL) {
 		xfr->stream->methods->destroy(&xfr->stream);
 	}
+	if (xfr->cache != NULL) {
+		axfrcache_detach(xfr->client->manager->sctx, &xfr->cache,
+				 xfr->chunk);
+	}
 	if (xfr->buf.base != NULL) {
 		isc_mem_put(xfr->mctx, xfr->buf.base, xfr->buf.length);
 	}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare insert and lookup rates of isc_ht, isc_hashmap and
+ * isc_swisstable for a range of table sizes, with random 16 byte keys.
+ * Each lookup pass is run with keys that are present (hit) and with keys
+ * that are not (miss).
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/ht.h>
+#include <isc/lib.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/swisstable.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define KEYSIZE	 16
+#define MAXITEMS (1024 * 1024)
+#define ROUNDS	 4
+
+#define KILOOPS(count, us) ((us) == 0 ? 0.0 : ((count) * 1000.0 / (us)))
+
+struct item_s {
+	uint8_t key[KEYSIZE];
+	uint32_t hashval;
+};
+
+static struct item_s item[MAXITEMS];
+static struct item_s miss[MAXITEMS];
+
+struct fun {
+	const char *name;
+	void *(*new)(isc_mem_t *mem);
+	void (*destroy)(void *map);
+	isc_result_t (*add)(void *map, struct item_s *it);
+	isc_result_t (*get)(void *map, struct item_s *it, void **pval);
+};
+
+static bool
+item_match(void *node, const void *key) {
+	const struct item_s *it = node;
+	return memcmp(it->key, key, KEYSIZE) == 0;
+}
+
+/*
+ * ht
+ */
+
+static void *
+new_ht(isc_mem_t *mem) {
+	isc_ht_t *ht = NULL;
+	isc_ht_init(&ht, mem, 1, ISC_HT_CASE_SENSITIVE);
+	return ht;
+}
+
+static void
+destroy_ht(void *map) {
+	isc_ht_t *ht = map;
+	isc_ht_destroy(&ht);
+}
+
+static isc_result_t
+add_ht(void *map, struct item_s *it) {
+	return isc_ht_add(map, it->key, KEYSIZE, it);
+}
+
+static isc_result_t
+get_ht(void *map, struct item_s *it, void **pval) {
+	return isc_ht_find(map, it->key, KEYSIZE, pval);
+}
+
+/*
+ * hashmap
+ */
+
+static void *
+new_hashmap(isc_mem_t *mem) {
+	isc_hashmap_t *hashmap = NULL;
+	isc_hashmap_create(mem, 1, &hashmap);
+	return hashmap;
+}
+
+static void
+destroy_hashmap(void *map) {
+	isc_hashmap_t *hashmap = map;
+	isc_hashmap_destroy(&hashmap);
+}
+
+static isc_result_t
+add_hashmap(void *map, struct item_s *it) {
+	return isc_hashmap_add(map, it->hashval, item_match, it->key, it,
+			       NULL);
+}
+
+static isc_result_t
+get_hashmap(void *map, struct item_s *it, void **pval) {
+	return isc_hashmap_find(map, it->hashval, item_match, it->key, pval);
+}
+
+/*
+ * swisstable
+ */
+
+static void *
+new_swisstable(isc_mem_t *mem) {
+	isc_swisstable_t *table = NULL;
+	isc_swisstable_create(mem, 1, &table);
+	return table;
+}
+
+static void
+destroy_swisstable(void *map) {
+	isc_swisstable_t *table = map;
+	isc_swisstable_destroy(&table);
+}
+
+static isc_result_t
+add_swisstable(void *map, struct item_s *it) {
+	return isc_swisstable_add(map, it->hashval, item_match, it->key, it,
+				  NULL);
+}
+
+static isc_result_t
+get_swisstable(void *map, struct item_s *it, void **pval) {
+	return isc_swisstable_find(map, it->hashval, item_match, it->key,
+				   pval);
+}
+
+/*
+ * fun table
+ */
+static struct fun fun_list[] = {
+	{ "ht", new_ht, destroy_ht, add_ht, get_ht },
+	{ "hashmap", new_hashmap, destroy_hashmap, add_hashmap, get_hashmap },
+	{ "swisstable", new_swisstable, destroy_swisstable, add_swisstable,
+	  get_swisstable },
+	{ NULL, NULL, NULL, NULL, NULL },
+};
+
+static void
+init_items(struct item_s *items) {
+	isc_random_buf(items, MAXITEMS * sizeof(items[0]));
+	for (size_t i = 0; i < MAXITEMS; i++) {
+		items[i].hashval = isc_hash32(items[i].key, KEYSIZE, true);
+	}
+}
+
+int
+main(void) {
+	init_items(item);
+	init_items(miss);
+
+	printf("%10s | %10s | %10s | %10s | %10s |\n", "algorithm", "items",
+	       "add kops/s", "hit kops/s", "miss kops/s");
+
+	for (size_t nitems = 1024; nitems <= MAXITEMS; nitems *= 4) {
+		printf("---------- | ---------- | ---------- | ---------- | "
+		       "---------- |\n");
+
+		for (struct fun *fun = fun_list; fun->name != NULL; fun++) {
+			void *map = fun->new(isc_g_mctx);
+			size_t lookups = nitems * ROUNDS;
+
+			isc_time_t t0 = isc_time_now_hires();
+			for (size_t n = 0; n < nitems; n++) {
+				isc_result_t result = fun->add(map, &item[n]);
+				assert(result == ISC_R_SUCCESS);
+			}
+
+			isc_time_t t1 = isc_time_now_hires();
+			for (size_t r = 0; r < ROUNDS; r++) {
+				for (size_t n = 0; n < nitems; n++) {
+					void *pval = NULL;
+					isc_result_t result =
+						fun->get(map, &item[n], &pval);
+					assert(result == ISC_R_SUCCESS);
+					assert(pval == &item[n]);
+				}
+			}
+
+			isc_time_t t2 = isc_time_now_hires();
+			for (size_t r = 0; r < ROUNDS; r++) {
+				for (size_t n = 0; n < nitems; n++) {
+					void *pval = NULL;
+					isc_result_t result =
+						fun->get(map, &miss[n], &pval);
+					assert(result == ISC_R_NOTFOUND);
+				}
+			}
+
+			isc_time_t t3 = isc_time_now_hires();
+
+			printf("%10s | %10zu | %10.0f | %10.0f | %10.0f |\n",
+			       fun->name, nitems,
+			       KILOOPS(nitems, isc_time_microdiff(&t1, &t0)),
+			       KILOOPS(lookups, isc_time_microdiff(&t2, &t1)),
+			       KILOOPS(lookups, isc_time_microdiff(&t3, &t2)));
+
+			fun->destroy(map);
+		}
+	}
+
+	printf("---------- | ---------- | ---------- | ---------- | "
+	       "---------- |\n");
+}
@@ -231,7 +231,9 @@ main(int argc, char *argv[]) {
 				    names * sizeof(isc_refcount_t);
 		dns_qp_memusage_t memusage = dns_qp_memusage(qp);
 		uint64_t compaction_us, recovery_us, rollback_us;
-		dns_qp_gctime(&compaction_us, &recovery_us, &rollback_us);
+		isc_histo_t *pauses = NULL;
+		dns_qp_gctime(&compaction_us, &recovery_us, &rollback_us,
+			      &pauses);
 
 		printf("leaves %zu\n"
 		       " nodes %zu\n"
@@ -248,6 +250,18 @@ main(int argc, char *argv[]) {
 		printf("%f recovery\n", (double)recovery_us / 1000000);
 		printf("%f rollback\n", (double)rollback_us / 1000000);
 
+		const double frac[] = { 1.0, 0.99, 0.5 };
+		uint64_t pause[ARRAY_SIZE(frac)];
+		if (isc_histo_quantiles(pauses, ARRAY_SIZE(frac), frac,
+					pause) == ISC_R_SUCCESS)
+		{
+			printf("%f max / %f p99 / %f median compaction pause\n",
+			       (double)pause[0] / 1000000,
+			       (double)pause[1] / 1000000,
+			       (double)pause[2] / 1000000);
+		}
+		isc_histo_destroy(&pauses);
+
 		size_t bytes = memusage.bytes;
 		print_megabytes("file size", filesize);
 		print_megabytes("names", wirebytes);
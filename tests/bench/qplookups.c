@@ -17,6 +17,7 @@
 #include <isc/commandline.h>
 #include <isc/file.h>
 #include <isc/ht.h>
+#include <isc/hugepage.h>
 #include <isc/lib.h>
 #include <isc/rwlock.h>
 #include <isc/time.h>
@@ -112,7 +113,8 @@ const dns_qpmethods_t methods = {
 
 static void
 usage(void) {
-	fprintf(stderr, "usage: lookups <filename>\n");
+	fprintf(stderr, "usage: lookups [-H none|transparent|explicit] "
+			"<filename>\n");
 	exit(EXIT_FAILURE);
 }
 
@@ -192,15 +194,41 @@ main(int argc, char **argv) {
 	dns_name_t *name = NULL;
 	size_t i = 0, n = 0;
 	char buf[BUFSIZ];
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "H:")) != -1) {
+		switch (ch) {
+		case 'H':
+			if (strcmp(isc_commandline_argument, "none") == 0) {
+				isc_hugepage_setmode(isc_hugepage_none);
+			} else if (strcmp(isc_commandline_argument,
+					  "transparent") == 0)
+			{
+				isc_hugepage_setmode(isc_hugepage_transparent);
+			} else if (strcmp(isc_commandline_argument,
+					  "explicit") == 0)
+			{
+				isc_hugepage_setmode(isc_hugepage_explicit);
+			} else {
+				usage();
+			}
+			break;
+		default:
+			usage();
+		}
+	}
+
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
 
-	if (argc != 2) {
+	if (argc != 1) {
 		usage();
 	}
 
 	dns_qp_create(isc_g_mctx, &methods, NULL, &qp);
 
 	start = isc_time_monotonic();
-	n = load_qp(qp, argv[1]);
+	n = load_qp(qp, argv[0]);
 	dns_qp_compact(qp, DNS_QPGC_ALL);
 	stop = isc_time_monotonic();
 
@@ -0,0 +1,448 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+/*
+ * Mock isc_stdtime_now() so that the tests can move the clock past the
+ * address expiry times.
+ */
+static uint32_t stdtime_now = 1000;
+
+static uint32_t
+isc_stdtime_now(void) {
+	return stdtime_now;
+}
+
+#include <isc/buffer.h>
+#include <isc/lib.h>
+#include <isc/loop.h>
+#include <isc/net.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/tls.h>
+#include <isc/util.h>
+
+#include <dns/adb.h>
+#include <dns/dispatch.h>
+#include <dns/lib.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/resolver.h>
+#include <dns/stats.h>
+#include <dns/view.h>
+
+/*
+ * The fetches the ADB starts are recorded here instead of being sent,
+ * and completed by the tests.
+ */
+typedef struct {
+	dns_rdatatype_t type;
+	unsigned int options;
+	isc_job_cb cb;
+	void *arg;
+	dns_rdataset_t *rdataset;
+	bool canceled;
+	bool destroyed;
+} mockfetch_t;
+
+static mockfetch_t fetches[8];
+static size_t nfetches = 0;
+
+static isc_result_t
+mock_createfetch(dns_resolver_t *res ISC_ATTR_UNUSED,
+		 const dns_name_t *name ISC_ATTR_UNUSED, dns_rdatatype_t type,
+		 const dns_name_t *domain ISC_ATTR_UNUSED,
+		 dns_delegset_t *delegset ISC_ATTR_UNUSED,
+		 dns_forwarders_t *forwarders ISC_ATTR_UNUSED,
+		 const isc_sockaddr_t *client ISC_ATTR_UNUSED,
+		 dns_messageid_t id ISC_ATTR_UNUSED, unsigned int options,
+		 unsigned int depth ISC_ATTR_UNUSED,
+		 isc_counter_t *qc ISC_ATTR_UNUSED,
+		 isc_counter_t *gqc ISC_ATTR_UNUSED,
+		 fetchctx_t *parent ISC_ATTR_UNUSED,
+		 isc_loop_t *loop ISC_ATTR_UNUSED, isc_job_cb cb, void *arg,
+		 dns_edectx_t *edectx ISC_ATTR_UNUSED, dns_rdataset_t *rdataset,
+		 dns_rdataset_t *sigrdataset ISC_ATTR_UNUSED,
+		 dns_fetch_t **fetchp) {
+	INSIST(nfetches < ARRAY_SIZE(fetches));
+
+	fetches[nfetches] = (mockfetch_t){
+		.type = type,
+		.options = options,
+		.cb = cb,
+		.arg = arg,
+		.rdataset = rdataset,
+	};
+	*fetchp = (dns_fetch_t *)&fetches[nfetches++];
+
+	return ISC_R_SUCCESS;
+}
+
+static void
+mock_cancelfetch(dns_fetch_t *fetch) {
+	((mockfetch_t *)fetch)->canceled = true;
+}
+
+static void
+mock_destroyfetch(dns_fetch_t **fetchp) {
+	((mockfetch_t *)*fetchp)->destroyed = true;
+	*fetchp = NULL;
+}
+
+static void
+mock_freefresp(dns_fetchresponse_t **frespp) {
+	*frespp = NULL;
+}
+
+#define dns_resolver_createfetch  mock_createfetch
+#define dns_resolver_cancelfetch  mock_cancelfetch
+#define dns_resolver_destroyfetch mock_destroyfetch
+#define dns_resolver_freefresp	  mock_freefresp
+
+/*
+ * Because of the mocks above.
+ */
+#include "../dns/adb.c"
+
+#include <tests/dns.h>
+
+#define TTL 60
+
+static dns_view_t *view = NULL;
+static dns_dispatch_t *dispatch = NULL;
+static isc_tlsctx_cache_t *tlsctx_cache = NULL;
+static dns_adb_t *adb = NULL;
+static dns_fixedname_t fname;
+static dns_name_t *name = NULL;
+
+static unsigned char addr1[] = { 192, 0, 2, 1 };
+static unsigned char addr2[] = { 192, 0, 2, 2 };
+
+static void
+setup_adb(void) {
+	isc_result_t result;
+	isc_sockaddr_t local;
+	dns_dispatchmgr_t *dispatchmgr = NULL;
+	isc_mem_t *mctx = NULL;
+	isc_stats_t *stats = NULL;
+
+	result = dns_test_makeview("view", true, true, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dispatchmgr = dns_view_getdispatchmgr(view);
+	isc_sockaddr_any(&local);
+	result = dns_dispatch_createudp(dispatchmgr, &local, &dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_dispatchmgr_detach(&dispatchmgr);
+
+	isc_tlsctx_cache_create(isc_g_mctx, &tlsctx_cache);
+	result = dns_view_createresolver(view, 0, tlsctx_cache, dispatch,
+					 NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_stats_create(isc_g_mctx, &stats, dns_resstatscounter_max);
+	dns_resolver_setstats(view->resolver, stats);
+	isc_stats_detach(&stats);
+	dns_view_freeze(view);
+
+	isc_mem_create("ADB", &mctx);
+	dns_adb_create(mctx, view, &adb);
+	isc_mem_detach(&mctx);
+
+	name = dns_fixedname_initname(&fname);
+	result = dns_name_fromstring(name, "ns.example", dns_rootname, 0,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	stdtime_now = 1000;
+	nfetches = 0;
+}
+
+static void
+shutdown_adb(void) {
+	dns_adb_shutdown(adb);
+	dns_adb_detach(&adb);
+	dns_dispatch_detach(&dispatch);
+	dns_view_detach(&view);
+	isc_tlsctx_cache_detach(&tlsctx_cache);
+	isc_loopmgr_shutdown();
+}
+
+static void
+unexpected_event(void *arg ISC_ATTR_UNUSED) {
+	fail();
+}
+
+static dns_adbfind_t *
+createfind(unsigned int options, isc_job_cb cb) {
+	dns_adbfind_t *find = NULL;
+	size_t findlen = 1;
+	isc_result_t result;
+
+	result = dns_adb_createfind(adb, isc_loop(), cb, NULL, name,
+				    DNS_ADBFIND_INET | options, stdtime_now, 53,
+				    0, NULL, NULL, NULL, 1, &find, &findlen);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return find;
+}
+
+static bool
+has_address(dns_adbfind_t *find, const unsigned char *addr) {
+	ISC_LIST_FOREACH(find->list, ai, publink) {
+		if (memcmp(&ai->sockaddr.type.sin.sin_addr, addr, 4) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Answer the recorded fetch 'fetch' with an A record for 'addr'.
+ */
+static void
+complete_fetch(mockfetch_t *fetch, unsigned char *addr) {
+	dns_rdatalist_t rdatalist;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_fetchresponse_t resp = {
+		.fetch = (dns_fetch_t *)fetch,
+		.result = ISC_R_SUCCESS,
+		.rdataset = fetch->rdataset,
+		.arg = fetch->arg,
+	};
+
+	assert_false(fetch->destroyed);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = TTL;
+	rdata.data = addr;
+	rdata.length = 4;
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdatalist_tordataset(&rdatalist, fetch->rdataset);
+
+	fetch->cb(&resp);
+
+	assert_true(fetch->destroyed);
+}
+
+/*
+ * Look the name up, answer the fetch and look it up often enough for
+ * it to be refreshed once its addresses are close to expiring.
+ */
+static void
+populate(void) {
+	dns_adbfind_t *find = NULL;
+
+	find = createfind(0, unexpected_event);
+	assert_int_equal(nfetches, 1);
+	assert_int_equal(fetches[0].type, dns_rdatatype_a);
+	assert_int_equal(fetches[0].options & DNS_FETCHOPT_PREFETCH, 0);
+	dns_adb_destroyfind(&find);
+
+	complete_fetch(&fetches[0], addr1);
+
+	for (size_t i = 0; i < ADB_REFRESH_HITS; i++) {
+		find = createfind(0, unexpected_event);
+		assert_true(has_address(find, addr1));
+		dns_adb_destroyfind(&find);
+	}
+	assert_int_equal(nfetches, 1);
+}
+
+/* the refresh starts a prefetch when the addresses are about to expire */
+static void
+start_refresh(void) {
+	dns_adbfind_t *find = NULL;
+
+	stdtime_now += TTL - ADB_REFRESH_WINDOW + 1;
+	find = createfind(DNS_ADBFIND_WANTEVENT, unexpected_event);
+	assert_int_equal(nfetches, 2);
+	assert_int_equal(fetches[1].type, dns_rdatatype_a);
+	assert_int_not_equal(fetches[1].options & DNS_FETCHOPT_PREFETCH, 0);
+
+	/* the old addresses are still good, so the find doesn't wait */
+	assert_true(has_address(find, addr1));
+	assert_int_equal(find->query_pending, 0);
+	assert_int_equal(find->options & DNS_ADBFIND_WANTEVENT, 0);
+	dns_adb_destroyfind(&find);
+}
+
+/* a refresh replaces the addresses before they expire */
+ISC_LOOP_TEST_IMPL(refresh) {
+	dns_adbfind_t *find = NULL;
+
+	setup_adb();
+	populate();
+	start_refresh();
+
+	complete_fetch(&fetches[1], addr2);
+
+	stdtime_now += ADB_REFRESH_WINDOW;
+	find = createfind(0, unexpected_event);
+	assert_true(has_address(find, addr2));
+	assert_false(has_address(find, addr1));
+	dns_adb_destroyfind(&find);
+	assert_int_equal(nfetches, 2);
+
+	shutdown_adb();
+}
+
+static void
+refresh_expired_done(void *arg) {
+	dns_adbfind_t *find = arg;
+
+	assert_int_equal(dns_adb_findstatus(find), DNS_ADB_MOREADDRESSES);
+	dns_adb_destroyfind(&find);
+
+	find = createfind(0, unexpected_event);
+	assert_true(has_address(find, addr2));
+	dns_adb_destroyfind(&find);
+
+	shutdown_adb();
+}
+
+/*
+ * when the addresses expire while the refresh is still running, the
+ * finds wait for it like for any other fetch
+ */
+ISC_LOOP_TEST_IMPL(refresh_expired) {
+	dns_adbfind_t *find = NULL;
+
+	setup_adb();
+	populate();
+	start_refresh();
+
+	stdtime_now += ADB_REFRESH_WINDOW;
+	find = createfind(DNS_ADBFIND_WANTEVENT, refresh_expired_done);
+	assert_true(ISC_LIST_EMPTY(find->list));
+	assert_int_equal(find->query_pending, DNS_ADBFIND_INET);
+	assert_int_not_equal(find->options & DNS_ADBFIND_WANTEVENT, 0);
+
+	/* no second fetch was started */
+	assert_int_equal(nfetches, 2);
+
+	complete_fetch(&fetches[1], addr2);
+}
+
+/* unanswered queries make an address unresponsive until it answers */
+ISC_LOOP_TEST_IMPL(noresponse) {
+	dns_adbaddrinfo_t *ai = NULL;
+	isc_sockaddr_t sa;
+	struct in_addr in;
+	isc_result_t result;
+
+	setup_adb();
+
+	memmove(&in, addr1, sizeof(in));
+	isc_sockaddr_fromin(&sa, &in, 53);
+	result = dns_adb_findaddrinfo(adb, &sa, &ai, stdtime_now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (unsigned int i = 1; i < DNS_ADB_UNRESPONSIVE; i++) {
+		assert_int_equal(dns_adb_noresponse(adb, ai), i);
+		assert_false(dns_adb_unresponsive(adb, ai));
+	}
+	assert_int_equal(dns_adb_noresponse(adb, ai), DNS_ADB_UNRESPONSIVE);
+	assert_true(dns_adb_unresponsive(adb, ai));
+
+	/* aging the SRTT is no response */
+	dns_adb_adjustsrtt(adb, ai, 0, DNS_ADB_RTTADJAGE);
+	assert_true(dns_adb_unresponsive(adb, ai));
+
+	/* a measured round trip time is */
+	dns_adb_adjustsrtt(adb, ai, 1000, DNS_ADB_RTTADJDEFAULT);
+	assert_false(dns_adb_unresponsive(adb, ai));
+	assert_int_equal(dns_adb_noresponse(adb, ai), 1);
+
+	dns_adb_freeaddrinfo(adb, &ai);
+	shutdown_adb();
+}
+
+/* the RTT percentiles follow the measured round trip times */
+ISC_LOOP_TEST_IMPL(rttquantile) {
+	dns_adbaddrinfo_t *ai = NULL;
+	isc_sockaddr_t sa;
+	struct in_addr in;
+	isc_result_t result;
+	unsigned int us;
+
+	setup_adb();
+
+	memmove(&in, addr1, sizeof(in));
+	isc_sockaddr_fromin(&sa, &in, 53);
+	result = dns_adb_findaddrinfo(adb, &sa, &ai, stdtime_now);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* too few samples */
+	for (size_t i = 0; i < ADB_RTTMINSAMPLES - 1; i++) {
+		dns_adb_adjustsrtt(adb, ai, 3000, DNS_ADB_RTTADJDEFAULT);
+	}
+	assert_int_equal(dns_adb_rttquantile(adb, ai, 50), 0);
+
+	/* aging doesn't count as a sample */
+	dns_adb_adjustsrtt(adb, ai, 0, DNS_ADB_RTTADJAGE);
+	assert_int_equal(dns_adb_rttquantile(adb, ai, 50), 0);
+
+	/* 90 answers in 2-4ms, 10 in 64-128ms */
+	for (size_t i = ADB_RTTMINSAMPLES - 1; i < 90; i++) {
+		dns_adb_adjustsrtt(adb, ai, 3000, DNS_ADB_RTTADJDEFAULT);
+	}
+	for (size_t i = 0; i < 10; i++) {
+		dns_adb_adjustsrtt(adb, ai, 100000, DNS_ADB_RTTADJDEFAULT);
+	}
+
+	us = dns_adb_rttquantile(adb, ai, 50);
+	assert_in_range(us, 2000, 4000);
+	us = dns_adb_rttquantile(adb, ai, 90);
+	assert_in_range(us, 2000, 4000);
+	us = dns_adb_rttquantile(adb, ai, 95);
+	assert_in_range(us, 64000, 128000);
+	assert_int_equal(dns_adb_rttquantile(adb, ai, 100), 128000);
+
+	/* a full bucket halves them all, keeping the shape */
+	for (size_t i = 0; i < ADB_RTTBUCKET_MAX; i++) {
+		dns_adb_adjustsrtt(adb, ai, 3000, DNS_ADB_RTTADJDEFAULT);
+	}
+	us = dns_adb_rttquantile(adb, ai, 50);
+	assert_in_range(us, 2000, 4000);
+	us = dns_adb_rttquantile(adb, ai, 100);
+	assert_int_equal(us, 128000);
+
+	dns_adb_freeaddrinfo(adb, &ai);
+	shutdown_adb();
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(refresh, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(refresh_expired, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(noresponse, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(rttquantile, setup_managers, teardown_managers)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -28,6 +28,7 @@
 #include <isc/lib.h>
 #include <isc/managers.h>
 #include <isc/refcount.h>
+#include <isc/stats.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/tls.h>
@@ -37,6 +38,7 @@
 #include <dns/dispatch.h>
 #include <dns/lib.h>
 #include <dns/name.h>
+#include <dns/stats.h>
 #include <dns/view.h>
 
 #include <tests/dns.h>
@@ -1032,9 +1034,87 @@ ISC_LOOP_TEST_IMPL(dispatch_tcp_reuse_after_close) {
 	dns_dispatch_connect(test->dispentry);
 }
 
+/*
+ * The connection reuse statistics count the connections for queries, but
+ * not those of zone transfers, which are never shared.
+ */
+static isc_stats_t *tcpstats = NULL;
+
+static void
+connected_tcpstats(isc_result_t eresult, isc_region_t *region ISC_ATTR_UNUSED,
+		   void *arg) {
+	test_dispatch_t *test = arg;
+	dns_dispatch_t *reused = NULL, *xfrin = NULL;
+	isc_result_t result;
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+
+	result = dns_dispatch_createtcp(test->dispatchmgr, &tcp_connect_addr,
+					&tcp_server_addr, NULL,
+					DNS_DISPATCHTYPE_RESOLVER, 0, &reused);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(reused, test->dispatch);
+
+	result = dns_dispatch_createtcp(test->dispatchmgr, &tcp_connect_addr,
+					&tcp_server_addr, NULL,
+					DNS_DISPATCHTYPE_XFRIN, 0, &xfrin);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_not_equal(xfrin, test->dispatch);
+
+	assert_int_equal(isc_stats_get_counter(tcpstats,
+					       dns_resstatscounter_tcpconnnew),
+			 1);
+	assert_int_equal(
+		isc_stats_get_counter(tcpstats,
+				      dns_resstatscounter_tcpconnreused),
+		1);
+
+	dns_dispatch_detach(&xfrin);
+	dns_dispatch_detach(&reused);
+	isc_stats_detach(&tcpstats);
+	test_dispatch_shutdown(test);
+}
+
+ISC_LOOP_TEST_IMPL(dispatch_tcp_stats) {
+	isc_result_t result;
+	test_dispatch_t *test = isc_mem_get(isc_g_mctx, sizeof(*test));
+	*test = (test_dispatch_t){ 0 };
+
+	/* Server */
+	result = isc_nm_listenstreamdns(ISC_NM_LISTEN_ONE, &tcp_server_addr,
+					nameserver, NULL, accept_cb, NULL, 0,
+					NULL, NULL, ISC_NM_PROXY_NONE, &sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_loop_teardown(isc_loop_main(), stop_listening, sock);
+
+	/* Client */
+	result = dns_dispatchmgr_create(isc_g_mctx, &test->dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_stats_create(isc_g_mctx, &tcpstats, dns_resstatscounter_max);
+	dns_dispatchmgr_setstats(test->dispatchmgr, tcpstats);
+
+	result = dns_dispatch_createtcp(
+		test->dispatchmgr, &tcp_connect_addr, &tcp_server_addr, NULL,
+		DNS_DISPATCHTYPE_RESOLVER, 0, &test->dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_dispatch_add(test->dispatch, isc_loop_main(), 0,
+				  T_CLIENT_CONNECT, T_CLIENT_INIT,
+				  &tcp_server_addr, NULL, NULL,
+				  connected_tcpstats, client_senddone,
+				  response_noop, test, &test->id,
+				  &test->dispentry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dispatch_connect(test->dispentry);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(dispatch_sharedtcp, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_tcp_reuse_after_close, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dispatch_tcp_stats, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_udp_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatchset_create, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatchset_get, setup_test, teardown_test)
@@ -26,11 +26,14 @@
 #include <isc/lib.h>
 #include <isc/netaddr.h>
 #include <isc/result.h>
+#include <isc/sockaddr.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
+#include <dns/acl.h>
 #include <dns/dns64.h>
 #include <dns/lib.h>
+#include <dns/message.h>
 #include <dns/rdata.h>
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
@@ -229,8 +232,106 @@ ISC_RUN_TEST_IMPL(dns64_findprefix) {
 	multiple_prefixes();
 }
 
+ISC_RUN_TEST_IMPL(dns64_apply) {
+	unsigned char a[2][4] = { { 192, 0, 2, 1 }, { 198, 51, 100, 7 } };
+	unsigned char p1[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+	unsigned char p2[16] = { 0x00, 0x64, 0xff, 0x9b };
+	dns_rdata_t rdata[2] = { DNS_RDATA_INIT, DNS_RDATA_INIT };
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t *aaaa = NULL;
+	dns_dns64list_t dns64s;
+	dns_dns64_t *dns64 = NULL;
+	dns_acl_t *none = NULL;
+	dns_aclenv_t *env = NULL;
+	dns_message_t *message = NULL;
+	isc_netaddr_t prefix;
+	isc_sockaddr_t peer;
+	struct in6_addr in6;
+	isc_result_t result;
+	unsigned int i;
+
+	dns_rdatalist_init(&rdatalist);
+	for (i = 0; i < 2; i++) {
+		isc_region_t region = { .base = a[i], .length = 4 };
+		dns_rdata_fromregion(&rdata[i], dns_rdataclass_in,
+				     dns_rdatatype_a, &region);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata[i], link);
+	}
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.ttl = 300;
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	/*
+	 * The first prefix applies to no clients, the second to all of
+	 * them, so only the second prefix must be used for synthesis.
+	 */
+	ISC_LIST_INIT(dns64s);
+	dns_acl_none(isc_g_mctx, &none);
+	memmove(in6.s6_addr, p1, sizeof(in6.s6_addr));
+	isc_netaddr_fromin6(&prefix, &in6);
+	dns_dns64_create(isc_g_mctx, &prefix, 96, NULL, none, NULL, NULL, 0,
+			 &dns64);
+	dns_dns64_append(&dns64s, dns64);
+	dns64 = NULL;
+	memmove(in6.s6_addr, p2, sizeof(in6.s6_addr));
+	isc_netaddr_fromin6(&prefix, &in6);
+	dns_dns64_create(isc_g_mctx, &prefix, 96, NULL, NULL, NULL, NULL, 0,
+			 &dns64);
+	dns_dns64_append(&dns64s, dns64);
+	dns64 = NULL;
+
+	dns_aclenv_create(isc_g_mctx, &env);
+	dns_message_create(isc_g_mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &message);
+	memset(in6.s6_addr, 0, sizeof(in6.s6_addr));
+	in6.s6_addr[15] = 1;
+	isc_sockaddr_fromin6(&peer, &in6, 53);
+
+	result = dns_dns64_apply(isc_g_mctx, dns64s, message, env, &peer,
+				 NULL, 0, &rdataset, &aaaa);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(aaaa);
+	assert_int_equal(aaaa->type, dns_rdatatype_aaaa);
+	assert_int_equal(dns_rdataset_count(aaaa), 2);
+
+	i = 0;
+	DNS_RDATASET_FOREACH(aaaa) {
+		dns_rdata_t aaaa_rdata = DNS_RDATA_INIT;
+		dns_rdataset_current(aaaa, &aaaa_rdata);
+		assert_int_equal(aaaa_rdata.length, 16);
+		assert_memory_equal(aaaa_rdata.data, p2, 12);
+		assert_memory_equal(aaaa_rdata.data + 12, a[i], 4);
+		i++;
+	}
+	assert_int_equal(i, 2);
+
+	dns_rdataset_disassociate(aaaa);
+	dns_message_puttemprdataset(message, &aaaa);
+
+	/*
+	 * With only the "none" prefix left nothing is synthesized.
+	 */
+	dns64 = ISC_LIST_TAIL(dns64s);
+	dns_dns64_destroy(&dns64s, &dns64);
+	result = dns_dns64_apply(isc_g_mctx, dns64s, message, env, &peer,
+				 NULL, 0, &rdataset, &aaaa);
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_null(aaaa);
+
+	dns64 = ISC_LIST_HEAD(dns64s);
+	dns_dns64_destroy(&dns64s, &dns64);
+	dns_message_detach(&message);
+	dns_aclenv_detach(&env);
+	dns_acl_detach(&none);
+	dns_rdataset_disassociate(&rdataset);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(dns64_findprefix)
+ISC_TEST_ENTRY(dns64_apply)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
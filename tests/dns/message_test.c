@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/lib.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/lib.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+/*
+ * example.com/A response with two answers, an authority section and an
+ * additional section with glue and an OPT record.
+ */
+static unsigned char response[] = {
+	/* header */
+	0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00,
+	0x02,
+	/* question: example.com/A at offset 12 */
+	0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+	0x00, 0x01, 0x00, 0x01,
+	/* answer */
+	0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00,
+	0x04, 192, 0, 2, 1,
+	/* answer */
+	0xc0, 0x0c, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00,
+	0x04, 192, 0, 2, 2,
+	/* authority: NS ns.example.com, whose name is at offset 73 */
+	0xc0, 0x0c, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00,
+	0x05, 0x02, 'n', 's', 0xc0, 0x0c,
+	/* additional: glue */
+	0xc0, 0x49, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00,
+	0x04, 192, 0, 2, 53,
+	/* additional: OPT */
+	0x00, 0x00, 0x29, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* pre-rendered records can be spliced in after a matching question */
+ISC_RUN_TEST_IMPL(render_raw) {
+	dns_message_t *msg = NULL;
+	dns_rdataset_t *question = NULL;
+	dns_name_t *qname = NULL;
+	dns_compress_t cctx;
+	unsigned char data[512];
+	isc_buffer_t target;
+	isc_region_t answers = { .base = response + 29, .length = 32 };
+	isc_result_t result;
+
+	dns_message_create(isc_g_mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &msg);
+	msg->id = 0x1234;
+	msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_RD |
+		     DNS_MESSAGEFLAG_RA;
+
+	dns_message_gettempname(msg, &qname);
+	result = dns_name_fromstring(qname, "example.com", dns_rootname, 0,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_message_gettemprdataset(msg, &question);
+	dns_rdataset_makequestion(question, dns_rdataclass_in,
+				  dns_rdatatype_a);
+	ISC_LIST_APPEND(qname->list, question, link);
+	dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
+
+	isc_buffer_init(&target, data, sizeof(data));
+	dns_compress_init(&cctx, isc_g_mctx, 0);
+	result = dns_message_renderbegin(msg, &cctx, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderraw(msg, DNS_SECTION_ANSWER, &answers, 2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+
+	/* the same as the original message up to the authority section */
+	assert_int_equal(isc_buffer_usedlength(&target), 29 + 32);
+	assert_memory_equal(data, response, 8);
+	assert_memory_equal(data + 12, response + 12, 29 + 32 - 12);
+	assert_int_equal(data[8] << 8 | data[9], 0);
+	assert_int_equal(data[10] << 8 | data[11], 0);
+
+	/* no room for the records on top of the reserved space */
+	dns_message_reset(msg, DNS_MESSAGE_INTENTRENDER);
+	isc_buffer_init(&target, data, 12 + 40);
+	dns_compress_init(&cctx, isc_g_mctx, 0);
+	result = dns_message_renderbegin(msg, &cctx, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderreserve(msg, 10);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderraw(msg, DNS_SECTION_ANSWER, &answers, 2);
+	assert_int_equal(result, ISC_R_NOSPACE);
+	dns_message_renderrelease(msg, 10);
+	result = dns_message_renderraw(msg, DNS_SECTION_ANSWER, &answers, 2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+
+	dns_message_detach(&msg);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(render_raw)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
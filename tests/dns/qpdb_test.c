@@ -416,6 +416,116 @@ ISC_LOOP_TEST_IMPL(overmempurge_longname) {
 	isc_loopmgr_shutdown();
 }
 
+/*
+ * The node type map knows which types are at a node, and lookups of
+ * other types don't find anything.
+ */
+ISC_LOOP_TEST_IMPL(typemap) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	isc_mem_t *mctx = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+	dns_rdataset_t rdataset;
+
+	isc_mem_create("test", &mctx);
+	db = servestale_setup(mctx, &fname, &name);
+
+	servestale_addrdataset(db, name, now, dns_rdatatype_a, "10.53.0.1",
+			       3600, dns_trust_answer);
+	servestale_addrdataset(db, name, now, dns_rdatatype_txt, "\"text\"",
+			       3600, dns_trust_answer);
+
+	result = dns_db_findnode(db, name, false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	qpcnode_t *qpnode = (qpcnode_t *)node;
+	assert_true(typemap_has(&qpnode->typemap, DNS_TYPEPAIR(dns_rdatatype_a)));
+	assert_true(typemap_has(&qpnode->typemap,
+				DNS_SIGTYPEPAIR(dns_rdatatype_a)));
+	assert_true(
+		typemap_has(&qpnode->typemap, DNS_TYPEPAIR(dns_rdatatype_txt)));
+	assert_false(typemap_has(&qpnode->typemap,
+				 DNS_TYPEPAIR(dns_rdatatype_https)));
+	assert_false(
+		typemap_has(&qpnode->typemap, DNS_TYPEPAIR(dns_rdatatype_ns)));
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_https, 0,
+				     now, &rdataset, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = dns_db_findrdataset(db, node, NULL, dns_rdatatype_txt, 0, now,
+				     &rdataset, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+
+	dns_db_detachnode(&node);
+	dns_db_detach(&db);
+	isc_mem_detach(&mctx);
+	isc_loopmgr_shutdown();
+}
+
+/*
+ * A small RRset is stored in the node's slot, a large one is allocated
+ * separately, and the slot is released when the RRset goes.
+ */
+ISC_LOOP_TEST_IMPL(slot_rrset) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	isc_mem_t *mctx = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	dns_fixedname_t fname;
+	dns_name_t *name = NULL;
+
+	isc_mem_create("test", &mctx);
+	db = servestale_setup(mctx, &fname, &name);
+
+	servestale_addrdataset(db, name, now, dns_rdatatype_a, "10.53.0.1",
+			       3600, dns_trust_answer);
+	servestale_addrdataset(db, name, now, dns_rdatatype_txt,
+			       "\"a text record that is much too long to fit "
+			       "in the slot of a cache node\"",
+			       3600, dns_trust_answer);
+
+	result = dns_db_findnode(db, name, false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	qpcnode_t *qpnode = (qpcnode_t *)node;
+	dns_slabheader_t *slot = (dns_slabheader_t *)qpnode->slot.buf;
+	assert_true(atomic_load(&qpnode->slot.used));
+
+	DNS_SLABHEADER_FOREACH(header, &qpnode->headers) {
+		if (header->typepair == DNS_TYPEPAIR(dns_rdatatype_a)) {
+			assert_ptr_equal(header, slot);
+			assert_true(DNS_SLABHEADER_GETATTR(
+				header, DNS_SLABHEADERATTR_INSLOT));
+		} else {
+			assert_ptr_not_equal(header, slot);
+			assert_false(DNS_SLABHEADER_GETATTR(
+				header, DNS_SLABHEADERATTR_INSLOT));
+		}
+	}
+
+	result = dns_db_deleterdataset(db, node, NULL, dns_rdatatype_a, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_false(atomic_load(&qpnode->slot.used));
+
+	/* the next small RRset can use the slot again */
+	servestale_addrdataset(db, name, now, dns_rdatatype_aaaa, "fd92::1",
+			       3600, dns_trust_answer);
+	assert_true(atomic_load(&qpnode->slot.used));
+	assert_int_equal(slot->typepair, DNS_TYPEPAIR(dns_rdatatype_aaaa));
+
+	dns_db_detachnode(&node);
+	dns_db_detach(&db);
+	isc_mem_detach(&mctx);
+	isc_loopmgr_shutdown();
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(overmempurge_bigrdata, setup_managers, teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(overmempurge_longname, setup_managers, teardown_managers)
@@ -425,6 +535,8 @@ ISC_TEST_ENTRY_CUSTOM(servestale_fresh_over_stale_cname, setup_managers,
 		      teardown_managers)
 ISC_TEST_ENTRY_CUSTOM(servestale_fresh_cname_over_stale_type, setup_managers,
 		      teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(typemap, setup_managers, teardown_managers)
+ISC_TEST_ENTRY_CUSTOM(slot_rrset, setup_managers, teardown_managers)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -23,6 +23,7 @@
 #include <cmocka.h>
 
 #include <isc/assertions.h>
+#include <isc/histo.h>
 #include <isc/lib.h>
 #include <isc/log.h>
 #include <isc/loop.h>
@@ -376,6 +377,258 @@ ISC_RUN_TEST_IMPL(qpmulti) {
 	isc_loopmgr_run();
 	rcu_barrier();
 	isc_loopmgr_destroy();
+
+	/* every update commit compacts, so pauses must have been recorded */
+	isc_histo_t *pauses = NULL;
+	uint64_t compact_ns, recycle_ns, rollback_ns;
+	double population = 0.0;
+	dns_qp_gctime(&compact_ns, &recycle_ns, &rollback_ns, &pauses);
+	isc_histo_moments(pauses, &population, NULL, NULL);
+	assert_true(population > 0.0);
+	isc_histo_destroy(&pauses);
+}
+
+/*
+ * The incremental compaction test uses a trie that is bigger than one
+ * compaction step, with leaves identified only by their ival.
+ */
+#define COMPACT_COUNT (QP_COMPACT_BUDGET * 4)
+
+static void
+compact_ref(void *ctx, void *pval, uint32_t ival) {
+	UNUSED(ctx);
+	UNUSED(pval);
+	UNUSED(ival);
+}
+
+static size_t
+compact_makekey(dns_qpkey_t key, void *ctx, void *pval, uint32_t ival) {
+	UNUSED(ctx);
+	UNUSED(pval);
+	/*
+	 * One key byte per bit, so that there is a branch node per leaf.
+	 * A fixed length key is never a prefix of another key.
+	 */
+	size_t len = 0;
+	for (size_t bit = 32; bit-- > 0;) {
+		key[len++] = SHIFT_NOBYTE + 1 + ((ival >> bit) & 1);
+	}
+	return len;
+}
+
+static const dns_qpmethods_t compact_methods = {
+	compact_ref,
+	compact_ref,
+	compact_makekey,
+	testname,
+};
+
+static void
+compact_check(dns_qpmulti_t *qpm, uint32_t step) {
+	dns_qpread_t qpr = { 0 };
+	dns_qpmulti_query(qpm, &qpr);
+	for (uint32_t ival = 0; ival < COMPACT_COUNT; ival++) {
+		dns_qpkey_t key;
+		size_t len = compact_makekey(key, NULL, NULL, ival);
+		uint32_t found = ~0U;
+		isc_result_t result = dns_qp_getkey(&qpr, key, len, NULL,
+						    &found);
+		if (ival % step == 0) {
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_int_equal(found, ival);
+		} else {
+			assert_int_equal(result, ISC_R_NOTFOUND);
+		}
+	}
+	dns_qpread_destroy(qpm, &qpr);
+
+	dns_qp_memusage_t mu = dns_qpmulti_memusage(qpm);
+	assert_int_equal(mu.leaves, (COMPACT_COUNT + step - 1) / step);
+}
+
+/*
+ * Commit empty update transactions, each of which runs one compaction
+ * step, until the current pass is complete.
+ */
+static void
+compact_steps(dns_qpmulti_t *qpm) {
+	size_t steps = 0;
+	do {
+		dns_qp_t *qp = NULL;
+		dns_qpmulti_update(qpm, &qp);
+		dns_qpmulti_commit(qpm, &qp);
+		rcu_quiescent_state();
+		/* there is about one branch node per leaf */
+		assert_true(++steps <= COMPACT_COUNT / QP_COMPACT_BUDGET + 1);
+	} while (qpm->writer.compact_depth > 0);
+}
+
+/*
+ * After a complete pass, the live nodes outside the bump chunk should all
+ * be in chunks that did not need compacting.
+ */
+static void
+compact_complete(dns_qp_t *qp) {
+	for (dns_qpchunk_t chunk = 0; chunk < qp->chunk_max; chunk++) {
+		dns_qpcell_t live = qp->usage[chunk].used -
+				    qp->usage[chunk].free;
+		if (qp->usage[chunk].exists && chunk != qp->bump && live > 0) {
+			assert_true(live >= QP_MIN_USED);
+		}
+	}
+}
+
+static void
+incremental_compaction(void *arg) {
+	dns_qpmulti_t *qpm = NULL;
+	dns_qp_t *qp = NULL;
+
+	UNUSED(arg);
+
+	dns_qpmulti_create(isc_g_mctx, &compact_methods, NULL, &qpm);
+
+	dns_qpmulti_update(qpm, &qp);
+	for (uint32_t ival = 0; ival < COMPACT_COUNT; ival++) {
+		assert_int_equal(dns_qp_insert(qp, NULL, ival), ISC_R_SUCCESS);
+	}
+	dns_qpmulti_commit(qpm, &qp);
+	rcu_quiescent_state();
+	compact_steps(qpm);
+	compact_check(qpm, 1);
+
+	/* leave most chunks half empty */
+	dns_qpmulti_update(qpm, &qp);
+	for (uint32_t ival = 0; ival < COMPACT_COUNT; ival++) {
+		if (ival % 2 != 0) {
+			dns_qpkey_t key;
+			size_t len = compact_makekey(key, NULL, NULL, ival);
+			assert_int_equal(dns_qp_deletekey(qp, key, len, NULL,
+							  NULL),
+					 ISC_R_SUCCESS);
+		}
+	}
+	dns_qpmulti_commit(qpm, &qp);
+	rcu_quiescent_state();
+
+	/* the commit started a new pass, which stopped part way */
+	assert_int_not_equal(qpm->writer.compact_depth, 0);
+	compact_check(qpm, 2);
+
+	compact_steps(qpm);
+	compact_check(qpm, 2);
+	compact_complete(&qpm->writer);
+
+	dns_qpmulti_destroy(&qpm);
+	isc_loopmgr_shutdown();
+}
+
+/*
+ * Write transactions only compact when they have made enough garbage
+ * of their own for QP_AUTOGC(), more than half of the used cells, which
+ * include the free space left in the older chunks. This churn adds and
+ * removes enough temporary leaves to trigger one compaction step.
+ */
+#define COMPACT_CHURN (COMPACT_COUNT * 3 / 2)
+
+static void
+compact_churn(dns_qpmulti_t *qpm) {
+	dns_qp_t *qp = NULL;
+
+	dns_qpmulti_write(qpm, &qp);
+	for (uint32_t i = 0; i < COMPACT_CHURN; i++) {
+		assert_int_equal(dns_qp_insert(qp, NULL, COMPACT_COUNT + i),
+				 ISC_R_SUCCESS);
+	}
+	for (uint32_t i = 0; i < COMPACT_CHURN; i++) {
+		dns_qpkey_t key;
+		size_t len = compact_makekey(key, NULL, NULL,
+					     COMPACT_COUNT + i);
+		assert_int_equal(dns_qp_deletekey(qp, key, len, NULL, NULL),
+				 ISC_R_SUCCESS);
+	}
+	dns_qpmulti_commit(qpm, &qp);
+	rcu_quiescent_state();
+}
+
+static void
+write_compaction(void *arg) {
+	dns_qpmulti_t *qpm = NULL;
+	dns_qp_t *qp = NULL;
+	dns_qp_memusage_t mu;
+	size_t commits = 0, fragmented;
+
+	UNUSED(arg);
+
+	dns_qpmulti_create(isc_g_mctx, &compact_methods, NULL, &qpm);
+
+	dns_qpmulti_update(qpm, &qp);
+	for (uint32_t ival = 0; ival < COMPACT_COUNT; ival++) {
+		assert_int_equal(dns_qp_insert(qp, NULL, ival), ISC_R_SUCCESS);
+	}
+	dns_qpmulti_commit(qpm, &qp);
+	rcu_quiescent_state();
+	compact_steps(qpm);
+	compact_check(qpm, 1);
+
+	/* the twigs freed here are immutable, so this does not compact */
+	dns_qpmulti_write(qpm, &qp);
+	for (uint32_t ival = 1; ival < COMPACT_COUNT; ival += 2) {
+		dns_qpkey_t key;
+		size_t len = compact_makekey(key, NULL, NULL, ival);
+		assert_int_equal(dns_qp_deletekey(qp, key, len, NULL, NULL),
+				 ISC_R_SUCCESS);
+	}
+	dns_qpmulti_commit(qpm, &qp);
+	rcu_quiescent_state();
+	assert_int_equal(qpm->writer.compact_depth, 0);
+	compact_check(qpm, 2);
+
+	/*
+	 * Each commit runs one step of the pass through squash_twigs(),
+	 * which must recover some of the free space and leave a trie
+	 * that is still intact.
+	 */
+	mu = dns_qpmulti_memusage(qpm);
+	fragmented = mu.free;
+	do {
+		size_t before = mu.free;
+
+		compact_churn(qpm);
+		compact_check(qpm, 2);
+		mu = dns_qpmulti_memusage(qpm);
+		if (qpm->writer.compact_depth > 0) {
+			assert_true(mu.free < before);
+		}
+		assert_true(++commits <= COMPACT_COUNT / QP_COMPACT_BUDGET + 1);
+	} while (qpm->writer.compact_depth > 0);
+
+	/*
+	 * The pass was spread over several commits, and recovered most of
+	 * the space; what is left is the churn's own garbage.
+	 */
+	assert_true(commits > 1);
+	assert_true(mu.free < fragmented / 4);
+
+	dns_qpmulti_destroy(&qpm);
+	isc_loopmgr_shutdown();
+}
+
+ISC_RUN_TEST_IMPL(qpmulti_compact) {
+	setup_loopmgr(NULL);
+	setup_logging();
+	isc_loop_setup(isc_loop_main(), incremental_compaction, NULL);
+	isc_loopmgr_run();
+	rcu_barrier();
+	isc_loopmgr_destroy();
+}
+
+ISC_RUN_TEST_IMPL(qpmulti_write_compact) {
+	setup_loopmgr(NULL);
+	setup_logging();
+	isc_loop_setup(isc_loop_main(), write_compaction, NULL);
+	isc_loopmgr_run();
+	rcu_barrier();
+	isc_loopmgr_destroy();
 }
 
 ISC_RUN_TEST_IMPL(qpmulti_memusage) {
@@ -393,6 +646,8 @@ ISC_RUN_TEST_IMPL(qpmulti_memusage) {
 
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(qpmulti)
+ISC_TEST_ENTRY(qpmulti_compact)
+ISC_TEST_ENTRY(qpmulti_write_compact)
 ISC_TEST_ENTRY(qpmulti_memusage)
 ISC_TEST_LIST_END
 
@@ -25,16 +25,24 @@
 #include <isc/buffer.h>
 #include <isc/lib.h>
 #include <isc/net.h>
+#include <isc/stats.h>
 #include <isc/timer.h>
 #include <isc/tls.h>
 #include <isc/util.h>
 
+#include <dns/cache.h>
 #include <dns/dispatch.h>
+#include <dns/forward.h>
 #include <dns/lib.h>
 #include <dns/name.h>
 #include <dns/resolver.h>
 #include <dns/view.h>
 
+/*
+ * To test nextforwarder().
+ */
+#include "../dns/resolver.c"
+
 #include <tests/dns.h>
 
 static dns_dispatch_t *dispatch = NULL;
@@ -186,6 +194,349 @@ ISC_LOOP_TEST_IMPL(settimeout_overmax) {
 	isc_loopmgr_shutdown();
 }
 
+static dns_adbaddrinfo_t *
+mkforwarder(dns_adb_t *adb, uint8_t octet, unsigned int srtt) {
+	dns_adbaddrinfo_t *ai = NULL;
+	isc_sockaddr_t sa;
+	struct in_addr in = { .s_addr = htonl(0xc0000200 | octet) };
+	isc_result_t result;
+
+	isc_sockaddr_fromin(&sa, &in, 53);
+	result = dns_adb_findaddrinfo(adb, &sa, &ai, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	ai->srtt = srtt;
+
+	return ai;
+}
+
+/* Return the forwarders in the order nextforwarder() would try them */
+static void
+forwarder_order(fetchctx_t *fctx, dns_adbaddrinfo_t **order, size_t n) {
+	ISC_LIST_FOREACH(fctx->forwaddrs, ai, publink) {
+		ai->flags &= ~FCTX_ADDRINFO_MARK;
+	}
+	for (size_t i = 0; i < n; i++) {
+		order[i] = nextforwarder(fctx);
+		assert_non_null(order[i]);
+		order[i]->flags |= FCTX_ADDRINFO_MARK;
+	}
+	assert_null(nextforwarder(fctx));
+}
+
+/* nextforwarder() and dns_resolver_setforwarderspread() */
+ISC_LOOP_TEST_IMPL(forwarder_spread) {
+	dns_view_t *fwdview = NULL;
+	dns_resolver_t *resolver = NULL;
+	dns_adb_t *adb = NULL;
+	dns_adbaddrinfo_t *fast = NULL, *close = NULL, *slow = NULL;
+	dns_adbaddrinfo_t *order[3];
+	fetchctx_t fctx = { .forwaddrs = ISC_LIST_INITIALIZER };
+	bool closefirst = false;
+	isc_result_t result;
+
+	/* A view of its own, to shut its resolver and ADB down in the loop */
+	result = dns_test_makeview("forwarders", true, false, &fwdview);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_tlsctx_cache_create(isc_g_mctx, &tlsctx_cache);
+	result = dns_view_createresolver(fwdview, 0, tlsctx_cache, dispatch,
+					 NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_view_getresolver(fwdview, &resolver);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_view_getadb(fwdview, &adb);
+	assert_non_null(adb);
+
+	fast = mkforwarder(adb, 1, 1000);
+	close = mkforwarder(adb, 2, 1500);
+	slow = mkforwarder(adb, 3, 10000);
+	ISC_LIST_APPEND(fctx.forwaddrs, slow, publink);
+	ISC_LIST_APPEND(fctx.forwaddrs, close, publink);
+	ISC_LIST_APPEND(fctx.forwaddrs, fast, publink);
+
+	fctx.res = resolver;
+	fctx.adb = adb;
+	fctx.dispatchmgr = dns_view_getdispatchmgr(fwdview);
+
+	/* Without spread, the lowest SRTT always goes first */
+	dns_resolver_setforwarderspread(resolver, 0);
+	for (size_t i = 0; i < 100; i++) {
+		forwarder_order(&fctx, order, 3);
+		assert_ptr_equal(order[0], fast);
+		assert_ptr_equal(order[1], close);
+		assert_ptr_equal(order[2], slow);
+	}
+
+	/*
+	 * With the default spread, forwarders less than twice as slow as
+	 * the fastest share the load, but the slow one always comes last.
+	 */
+	dns_resolver_setforwarderspread(resolver, 100);
+	for (size_t i = 0; i < 1000; i++) {
+		forwarder_order(&fctx, order, 3);
+		closefirst = closefirst || order[0] == close;
+		assert_ptr_equal(order[2], slow);
+	}
+	assert_true(closefirst);
+
+	/* A forwarder that stopped responding comes last */
+	for (size_t i = 0; i < DNS_ADB_UNRESPONSIVE - 1; i++) {
+		dns_adb_noresponse(adb, fast);
+		forwarder_order(&fctx, order, 3);
+		assert_ptr_not_equal(order[2], fast);
+	}
+	dns_adb_noresponse(adb, fast);
+	for (size_t i = 0; i < 100; i++) {
+		forwarder_order(&fctx, order, 3);
+		assert_ptr_equal(order[2], fast);
+	}
+
+	/* ...until it responds again */
+	dns_adb_adjustsrtt(adb, fast, 1000, DNS_ADB_RTTADJDEFAULT);
+	dns_resolver_setforwarderspread(resolver, 0);
+	forwarder_order(&fctx, order, 3);
+	assert_ptr_equal(order[0], fast);
+
+	ISC_LIST_FOREACH(fctx.forwaddrs, ai, publink) {
+		ISC_LIST_UNLINK(fctx.forwaddrs, ai, publink);
+		dns_adb_freeaddrinfo(adb, &ai);
+	}
+	dns_dispatchmgr_detach(&fctx.dispatchmgr);
+	dns_adb_detach(&adb);
+	dns_resolver_detach(&resolver);
+	dns_view_detach(&fwdview);
+	isc_tlsctx_cache_detach(&tlsctx_cache);
+	isc_loopmgr_shutdown();
+}
+
+/* hedge_earn(), hedge_spend() and fctx_try() with a hedge outstanding */
+ISC_LOOP_TEST_IMPL(hedge) {
+	dns_resolver_t *resolver = NULL;
+	fetchctx_t fctx = {
+		.tid = isc_tid(),
+		.queries = ISC_LIST_INITIALIZER,
+	};
+	resquery_t query = {
+		.attributes = RESQUERY_ATTR_HEDGED,
+		.link = ISC_LINK_INITIALIZER,
+	};
+
+	mkres(&resolver);
+
+	/* A 5% budget pays for one hedge every twenty queries */
+	dns_resolver_sethedging(resolver, 95, 5);
+	assert_false(hedge_spend(resolver));
+	for (size_t i = 0; i < 19; i++) {
+		hedge_earn(resolver);
+	}
+	assert_false(hedge_spend(resolver));
+	hedge_earn(resolver);
+	assert_true(hedge_spend(resolver));
+	assert_false(hedge_spend(resolver));
+
+	/* Unused budget only piles up to a small burst */
+	for (size_t i = 0; i < 1000; i++) {
+		hedge_earn(resolver);
+	}
+	for (size_t i = 0; i < HEDGE_BURST; i++) {
+		assert_true(hedge_spend(resolver));
+	}
+	assert_false(hedge_spend(resolver));
+
+	/*
+	 * While the other query of a hedged pair is outstanding, a failed
+	 * one doesn't send another: fctx_try() returns before looking at
+	 * anything else in this fetch context, which has nothing else set.
+	 */
+	isc_mutex_init(&fctx.lock);
+	assert_false(fctx_hedgepending(&fctx));
+	ISC_LIST_APPEND(fctx.queries, &query, link);
+	assert_true(fctx_hedgepending(&fctx));
+	fctx_try(&fctx, true);
+
+	query.attributes |= RESQUERY_ATTR_CANCELED;
+	assert_false(fctx_hedgepending(&fctx));
+	ISC_LIST_UNLINK(fctx.queries, &query, link);
+	isc_mutex_destroy(&fctx.lock);
+
+	destroy_resolver(&resolver);
+	isc_loopmgr_shutdown();
+}
+
+/*
+ * Two views that share a cache and a fetch group, forwarding (to no
+ * forwarders at all, so that nothing is sent) in the same way.
+ */
+static dns_view_t *groupviews[2] = { NULL };
+static dns_fetchgroup_t *fetchgroup = NULL;
+static isc_stats_t *groupstats = NULL;
+
+typedef struct groupfetch {
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+} groupfetch_t;
+
+static groupfetch_t groupfetches[3];
+static size_t groupdone = 0;
+
+static void
+mkgroupviews(void) {
+	isc_sockaddrlist_t addrs = ISC_LIST_INITIALIZER;
+	dns_cache_t *cache = NULL;
+	isc_result_t result;
+
+	result = dns_cache_create(dns_rdataclass_in, "", isc_g_mctx, &cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_fetchgroup_create(isc_g_mctx, &fetchgroup);
+	isc_stats_create(isc_g_mctx, &groupstats, dns_resstatscounter_max);
+	isc_tlsctx_cache_create(isc_g_mctx, &tlsctx_cache);
+
+	for (size_t i = 0; i < ARRAY_SIZE(groupviews); i++) {
+		dns_view_t *v = NULL;
+
+		result = dns_test_makeview(i == 0 ? "a" : "b", true, false, &v);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_view_setcache(v, cache, true);
+		result = dns_fwdtable_add(v->fwdtable, dns_rootname, &addrs,
+					  dns_fwdpolicy_only);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_view_createresolver(v, 0, tlsctx_cache, dispatch,
+						 NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_resolver_setstats(v->resolver, groupstats);
+		dns_resolver_setfetchgroup(v->resolver, fetchgroup);
+		dns_view_freeze(v);
+		groupviews[i] = v;
+	}
+
+	dns_cache_detach(&cache);
+	groupdone = 0;
+}
+
+static void
+groupfetch_check(void) {
+	dns_view_t *v = groupviews[0] != NULL ? groupviews[0] : groupviews[1];
+
+	/* The canceled fetch of the other view gets its own result */
+	assert_int_equal(groupfetches[1].result, ISC_R_CANCELED);
+
+	/* The remaining fetches share the outcome of the fetch context */
+	assert_int_not_equal(groupfetches[0].result, ISC_R_SUCCESS);
+	assert_int_not_equal(groupfetches[0].result, ISC_R_UNSET);
+	assert_int_equal(groupfetches[2].result, groupfetches[0].result);
+
+	/* The fetch context has left the group */
+	assert_null(get_grouped_fctx(v->resolver, dns_rootname,
+				     dns_rdatatype_ns, 0));
+}
+
+static void
+groupfetch_done(void *arg) {
+	dns_fetchresponse_t *resp = arg;
+	groupfetch_t *gf = resp->arg;
+
+	assert_ptr_equal(resp->fetch, gf->fetch);
+	gf->result = resp->result;
+	if (dns_rdataset_isassociated(&gf->rdataset)) {
+		dns_rdataset_disassociate(&gf->rdataset);
+	}
+	dns_resolver_freefresp(&resp);
+	dns_resolver_destroyfetch(&gf->fetch);
+
+	if (++groupdone < ARRAY_SIZE(groupfetches)) {
+		return;
+	}
+
+	groupfetch_check();
+
+	for (size_t i = 0; i < ARRAY_SIZE(groupviews); i++) {
+		if (groupviews[i] != NULL) {
+			dns_view_detach(&groupviews[i]);
+		}
+	}
+	dns_fetchgroup_detach(&fetchgroup);
+	isc_stats_detach(&groupstats);
+	isc_tlsctx_cache_detach(&tlsctx_cache);
+	isc_loopmgr_shutdown();
+}
+
+static void
+groupfetch_start(size_t i, groupfetch_t *gf) {
+	isc_result_t result;
+
+	dns_rdataset_init(&gf->rdataset);
+	gf->result = ISC_R_UNSET;
+	result = dns_resolver_createfetch(
+		groupviews[i]->resolver, dns_rootname, dns_rdatatype_ns,
+		NULL, NULL, NULL, NULL, 0, 0, 0, NULL, NULL, NULL, isc_loop(),
+		groupfetch_done, gf, NULL, &gf->rdataset, NULL, &gf->fetch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static void
+groupfetch_join(void) {
+	fetchctx_t *fctx = NULL;
+
+	/* A fetch in view "b" joins the one started in view "a" */
+	groupfetch_start(0, &groupfetches[0]);
+	fctx = groupfetches[0].fetch->private;
+	assert_ptr_equal(fctx->res, groupviews[0]->resolver);
+	assert_true(fctx->grouped);
+
+	groupfetch_start(1, &groupfetches[1]);
+	assert_ptr_equal(groupfetches[1].fetch->private, fctx);
+	assert_int_equal(isc_stats_get_counter(groupstats,
+					       dns_resstatscounter_groupjoined),
+			 1);
+
+	/* Canceling it leaves the fetch of view "a" alone */
+	dns_resolver_cancelfetch(groupfetches[1].fetch);
+	assert_false(SHUTTINGDOWN(fctx));
+	assert_ptr_equal(ISC_LIST_HEAD(fctx->resps)->fetch,
+			 groupfetches[0].fetch);
+	assert_null(ISC_LIST_NEXT(ISC_LIST_HEAD(fctx->resps), link));
+
+	/* And another fetch in view "b" joins it again */
+	groupfetch_start(1, &groupfetches[2]);
+	assert_ptr_equal(groupfetches[2].fetch->private, fctx);
+	assert_int_equal(isc_stats_get_counter(groupstats,
+					       dns_resstatscounter_groupjoined),
+			 2);
+}
+
+/* dns_resolver_setfetchgroup(), shutting down the joining view */
+ISC_LOOP_TEST_IMPL(fetchgroup_joiner_shutdown) {
+	fetchctx_t *fctx = NULL;
+
+	mkgroupviews();
+	groupfetch_join();
+	fctx = groupfetches[0].fetch->private;
+
+	/*
+	 * Shutting down view "b" doesn't touch the fetch context of view
+	 * "a"; the fetch of view "b" that joined it still gets its result
+	 * from there.
+	 */
+	dns_view_detach(&groupviews[1]);
+	assert_false(SHUTTINGDOWN(fctx));
+	assert_ptr_equal(ISC_LIST_TAIL(fctx->resps)->fetch,
+			 groupfetches[2].fetch);
+}
+
+/* dns_resolver_setfetchgroup(), shutting down the view that fetches */
+ISC_LOOP_TEST_IMPL(fetchgroup_owner_shutdown) {
+	mkgroupviews();
+	groupfetch_join();
+
+	/*
+	 * Shutting down view "a" ends its fetch context, and with it the
+	 * fetch of view "b" that joined it.  Nothing joins it any more.
+	 */
+	dns_view_detach(&groupviews[0]);
+	assert_null(get_grouped_fctx(groupviews[1]->resolver, dns_rootname,
+				     dns_rdatatype_ns, 0));
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(create, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(gettimeout, setup_test, teardown_test)
@@ -193,6 +544,10 @@ ISC_TEST_ENTRY_CUSTOM(settimeout, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_default, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_belowmin, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_overmax, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(forwarder_spread, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(hedge, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(fetchgroup_joiner_shutdown, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(fetchgroup_owner_shutdown, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -31,6 +31,7 @@
 #include <isc/os.h>
 #include <isc/result.h>
 #include <isc/tid.h>
+#include <isc/timer.h>
 #include <isc/util.h>
 
 #include "async.c"
@@ -96,9 +97,139 @@ ISC_RUN_TEST_IMPL(isc_async_multiple) {
 	assert_string_equal(string, "12345");
 }
 
+static void
+async_low(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+
+	isc_async_run_low(loop, append, &n1);
+	isc_async_run(loop, append, &n2);
+	isc_async_run_low(loop, append, &n3);
+	isc_async_run(loop, append, &n4);
+	isc_loopmgr_shutdown();
+}
+
+ISC_RUN_TEST_IMPL(isc_async_low) {
+	string[0] = '\0';
+	isc_loop_setup(isc_loop_main(), async_low, NULL);
+	isc_loopmgr_run();
+	assert_string_equal(string, "2413");
+}
+
+#define LOW_JOBS (3 * ASYNC_LOW_BUDGET + 1)
+
+/*
+ * These are only touched from the main loop.
+ */
+static unsigned int lowjobs = 0;
+static unsigned int normaljobs = 0;
+static unsigned int inround = 0;
+static unsigned int maxround = 0;
+static unsigned int rounds = 0;
+static unsigned int lowdone = 0;
+static uv_check_t round_check;
+static isc_timer_t *budget_timer = NULL;
+
+static void
+budget_done(void) {
+	if (budget_timer == NULL) {
+		return;
+	}
+
+	lowdone = lowjobs;
+	uv_close((uv_handle_t *)&round_check, NULL);
+	isc_timer_destroy(&budget_timer);
+	isc_loopmgr_shutdown();
+}
+
+static void
+budget_timeout(void *arg ISC_ATTR_UNUSED) {
+	budget_done();
+}
+
+/*
+ * Called once per libuv loop iteration; closes the current round of low
+ * priority jobs.
+ */
+static void
+round_cb(uv_check_t *handle ISC_ATTR_UNUSED) {
+	if (inround > 0) {
+		rounds++;
+		inround = 0;
+	}
+}
+
+static void
+count_normal(void *arg ISC_ATTR_UNUSED) {
+	normaljobs++;
+
+	/* Normal jobs always get ahead of the rest of the low jobs */
+	assert_true(lowjobs <= ASYNC_LOW_BUDGET);
+}
+
+static void
+count_low(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+
+	/* The normal jobs queued before us have already run */
+	assert_true(normaljobs >= LOW_JOBS / ASYNC_LOW_BUDGET + 1);
+
+	lowjobs++;
+	inround++;
+	maxround = ISC_MAX(maxround, inround);
+
+	if (lowjobs == 1) {
+		isc_async_run(loop, count_normal, NULL);
+	}
+
+	if (lowjobs == LOW_JOBS) {
+		budget_done();
+	}
+}
+
+static void
+async_low_budget(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+	int r;
+
+	r = uv_check_init(&loop->loop, &round_check);
+	UV_RUNTIME_CHECK(uv_check_init, r);
+	r = uv_check_start(&round_check, round_cb);
+	UV_RUNTIME_CHECK(uv_check_start, r);
+
+	/*
+	 * Don't hang if the leftover low jobs never get scheduled again.
+	 */
+	isc_timer_create(loop, budget_timeout, NULL, &budget_timer);
+	isc_timer_start(budget_timer, isc_timertype_once,
+			&(isc_interval_t){ .seconds = 10 });
+
+	for (size_t i = 0; i < LOW_JOBS; i++) {
+		isc_async_run_low(loop, count_low, NULL);
+		if (i % ASYNC_LOW_BUDGET == 0) {
+			isc_async_run(loop, count_normal, NULL);
+		}
+	}
+}
+
+ISC_RUN_TEST_IMPL(isc_async_low_budget) {
+	isc_loop_setup(isc_loop_main(), async_low_budget, NULL);
+	isc_loopmgr_run();
+
+	/* Every low job ran before the shutdown, not in the final drain */
+	assert_int_equal(lowdone, LOW_JOBS);
+	assert_int_equal(normaljobs, LOW_JOBS / ASYNC_LOW_BUDGET + 2);
+
+	/* ... and never more than the budget in a single loop iteration */
+	assert_int_equal(maxround, ASYNC_LOW_BUDGET);
+	assert_int_equal(rounds + (inround > 0),
+			 (LOW_JOBS + ASYNC_LOW_BUDGET - 1) / ASYNC_LOW_BUDGET);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_async_run, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_async_multiple, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_low, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_low_budget, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -41,6 +41,7 @@
 #include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/sockaddr.h>
+#include <isc/string.h>
 #include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/uv.h>
@@ -691,6 +692,57 @@ ISC_LOOP_TEST_IMPL(doh_timeout_recovery_GET) {
 	doh_timeout_recovery(arg);
 }
 
+static void
+doh_POST_query_string_reply_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+			       isc_region_t *region, void *cbarg) {
+	UNUSED(handle);
+	UNUSED(region);
+	UNUSED(cbarg);
+
+	/* the server must reject the request instead of answering it */
+	assert_int_not_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&creads, 1);
+
+	isc_loopmgr_shutdown();
+}
+
+/*
+ * A POST request carries the DNS message in its body, so a "dns" query
+ * parameter is rejected even when it is not valid base64url.
+ */
+ISC_LOOP_TEST_IMPL(doh_POST_query_string) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_nmsocket_t *listen_sock = NULL;
+	char req_url[256];
+
+	result = isc_nm_http_endpoints_add(endpoints, ISC_NM_HTTP_DEFAULT_PATH,
+					   doh_receive_request_cb, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_nm_listenhttp(ISC_NM_LISTEN_ALL, &tcp_listen_addr, 0, NULL,
+				   NULL, endpoints, 0, get_proxy_type(),
+				   &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	sockaddr_to_url(&tcp_listen_addr, false, req_url, sizeof(req_url),
+			ISC_NM_HTTP_DEFAULT_PATH);
+	strlcat(req_url, "?dns=A", sizeof(req_url));
+	connect_send_request(req_url, true,
+			     &(isc_region_t){ .base = (uint8_t *)send_msg.base,
+					      .length = send_msg.len },
+			     doh_POST_query_string_reply_cb, NULL, false, 30000);
+
+	isc_loop_teardown(isc_loop_main(), listen_sock_close, listen_sock);
+}
+
+static int
+doh_POST_query_string_teardown(void **state) {
+	assert_int_equal(atomic_load(&creads), 1);
+	assert_int_equal(atomic_load(&sreads), 0);
+
+	return teardown_test(state);
+}
+
 static void
 doh_connect_thread(void *arg);
 
@@ -1348,141 +1400,124 @@ ISC_RUN_TEST_IMPL(doh_parse_GET_query_string) {
 	}
 }
 
-ISC_RUN_TEST_IMPL(doh_base64url_to_base64) {
-	char *res;
-	size_t res_len = 0;
+ISC_RUN_TEST_IMPL(doh_base64url_decode) {
+	unsigned char data[64];
+	isc_buffer_t buf;
+	isc_result_t result;
 	/* valid */
 	{
 		char test[] = "YW55IGNhcm5hbCBwbGVhc3VyZS4";
-		char res_test[] = "YW55IGNhcm5hbCBwbGVhc3VyZS4=";
+		char res_test[] = "any carnal pleasure.";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_non_null(res);
-		assert_true(res_len == strlen(res_test));
-		assert_true(strcmp(res, res_test) == 0);
-		isc_mem_free(isc_g_mctx, res);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(isc_buffer_usedlength(&buf),
+				 strlen(res_test));
+		assert_memory_equal(data, res_test, strlen(res_test));
 	}
 	/* valid */
 	{
 		char test[] = "YW55IGNhcm5hbCBwbGVhcw";
-		char res_test[] = "YW55IGNhcm5hbCBwbGVhcw==";
+		char res_test[] = "any carnal pleas";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_non_null(res);
-		assert_true(res_len == strlen(res_test));
-		assert_true(strcmp(res, res_test) == 0);
-		isc_mem_free(isc_g_mctx, res);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(isc_buffer_usedlength(&buf),
+				 strlen(res_test));
+		assert_memory_equal(data, res_test, strlen(res_test));
 	}
 	/* valid */
 	{
 		char test[] = "YW55IGNhcm5hbCBwbGVhc3Vy";
-		char res_test[] = "YW55IGNhcm5hbCBwbGVhc3Vy";
+		char res_test[] = "any carnal pleasur";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_non_null(res);
-		assert_true(res_len == strlen(res_test));
-		assert_true(strcmp(res, res_test) == 0);
-		isc_mem_free(isc_g_mctx, res);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(isc_buffer_usedlength(&buf),
+				 strlen(res_test));
+		assert_memory_equal(data, res_test, strlen(res_test));
 	}
 	/* valid */
 	{
-		char test[] = "YW55IGNhcm5hbCBwbGVhc3U";
-		char res_test[] = "YW55IGNhcm5hbCBwbGVhc3U=";
+		char test[] = "PDw_Pz8-Pg";
+		char res_test[] = "<<???>>";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_non_null(res);
-		assert_true(res_len == strlen(res_test));
-		assert_true(strcmp(res, res_test) == 0);
-		isc_mem_free(isc_g_mctx, res);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(isc_buffer_usedlength(&buf),
+				 strlen(res_test));
+		assert_memory_equal(data, res_test, strlen(res_test));
 	}
-	/* valid */
+	/* invalid: empty */
 	{
-		char test[] = "YW55IGNhcm5hbCBwbGVhcw";
-		char res_test[] = "YW55IGNhcm5hbCBwbGVhcw==";
+		char test[] = "";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_non_null(res);
-		assert_true(res_len == strlen(res_test));
-		assert_true(strcmp(res, res_test) == 0);
-		isc_mem_free(isc_g_mctx, res);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_BADBASE64);
 	}
-	/* valid */
+	/* invalid: padding is not allowed */
 	{
-		char test[] = "PDw_Pz8-Pg";
-		char res_test[] = "PDw/Pz8+Pg==";
+		char test[] = "PDw_Pz8-Pg==";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_non_null(res);
-		assert_true(res_len == strlen(res_test));
-		assert_true(strcmp(res, res_test) == 0);
-		isc_mem_free(isc_g_mctx, res);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_BADBASE64);
 	}
-	/* valid */
+	/* invalid: regular base64 alphabet */
 	{
-		char test[] = "PDw_Pz8-Pg";
-		char res_test[] = "PDw/Pz8+Pg==";
+		char test[] = "PDw/Pz8+Pg";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), NULL);
-		assert_non_null(res);
-		assert_true(strcmp(res, res_test) == 0);
-		isc_mem_free(isc_g_mctx, res);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_BADBASE64);
 	}
-	/* invalid */
+	/* invalid: length */
 	{
-		char test[] = "YW55IGNhcm5hbCBwbGVhcw";
-		res_len = 0;
+		char test[] = "YW55I";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test, 0,
-						  &res_len);
-		assert_null(res);
-		assert_true(res_len == 0);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_BADBASE64);
 	}
-	/* invalid */
+	/* invalid: non-zero trailing bits */
 	{
-		char test[] = "";
-		res_len = 0;
+		char test[] = "PDw_Pz8-Ph";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_null(res);
-		assert_true(res_len == 0);
+		isc_buffer_init(&buf, data, sizeof(data));
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_BADBASE64);
 	}
-	/* invalid */
+	/* invalid: no space */
 	{
-		char test[] = "PDw_Pz8-Pg==";
-		res_len = 0;
+		char test[] = "YW55IGNhcm5hbCBwbGVhc3VyZS4";
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_null(res);
-		assert_true(res_len == 0);
+		isc_buffer_init(&buf, data, 8);
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_NOSPACE);
 	}
-	/* invalid */
+	/* the decoded length is exact, partial groups included */
 	{
-		char test[] = "PDw_Pz8-Pg%3D%3D"; /* percent encoded "==" at the
-						     end */
-		res_len = 0;
+		char test[] = "YW55IGNhcm5hbCBwbGVhc3VyZS4";
+		const size_t len = strlen("any carnal pleasure.");
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, test,
-						  strlen(test), &res_len);
-		assert_null(res);
-		assert_true(res_len == 0);
-	}
-	/* invalid */
-	{
-		res_len = 0;
+		assert_int_equal(BASE64URL_DECODED_LEN(strlen(test)), len);
+		isc_buffer_init(&buf, data, len - 1);
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_NOSPACE);
+		isc_buffer_init(&buf, data, len);
+		result = isc__nm_base64url_decode(test, strlen(test), &buf);
+		assert_int_equal(result, ISC_R_SUCCESS);
 
-		res = isc__nm_base64url_to_base64(isc_g_mctx, NULL, 31231,
-						  &res_len);
-		assert_null(res);
-		assert_true(res_len == 0);
+		/* 87383 characters are 65537 octets, too large for DNS */
+		assert_int_equal(BASE64URL_DECODED_LEN(87380),
+				 MAX_DNS_MESSAGE_SIZE);
+		assert_int_equal(BASE64URL_DECODED_LEN(87383),
+				 MAX_DNS_MESSAGE_SIZE + 2);
 	}
 }
 
@@ -2073,7 +2108,7 @@ ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(mock_doh_uv_tcp_bind, setup_test, teardown_test)
 ISC_TEST_ENTRY(doh_parse_GET_query_string)
-ISC_TEST_ENTRY(doh_base64url_to_base64)
+ISC_TEST_ENTRY(doh_base64url_decode)
 ISC_TEST_ENTRY(doh_base64_to_base64url)
 ISC_TEST_ENTRY(doh_path_validation)
 ISC_TEST_ENTRY(doh_connect_makeuri)
@@ -2085,6 +2120,8 @@ ISC_TEST_ENTRY_CUSTOM(doh_timeout_recovery_POST, setup_test,
 		      doh_timeout_recovery_teardown)
 ISC_TEST_ENTRY_CUSTOM(doh_timeout_recovery_GET, setup_test,
 		      doh_timeout_recovery_teardown)
+ISC_TEST_ENTRY_CUSTOM(doh_POST_query_string, setup_test,
+		      doh_POST_query_string_teardown)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_one_POST, setup_test, doh_recv_one_teardown)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_one_GET, setup_test, doh_recv_one_teardown)
 ISC_TEST_ENTRY_CUSTOM(doh_recv_one_POST_TLS, setup_test, doh_recv_one_teardown)
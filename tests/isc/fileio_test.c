@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/fileio.h>
+#include <isc/lib.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+#define MANY 1000
+
+static int
+tempfile(char *name) {
+	int fd = mkstemp(name);
+	assert_int_not_equal(fd, -1);
+	return fd;
+}
+
+/* writes land where they were asked to, later ones on top */
+ISC_RUN_TEST_IMPL(isc_fileio_write) {
+	char name[] = "fileio_write.XXXXXX";
+	isc_fileio_t *fio = NULL;
+	char buf[32];
+	int fd = tempfile(name);
+
+	isc_fileio_create(isc_g_mctx, fd, &fio);
+
+	isc_fileio_write(fio, "0123456789", 10, 0);
+	isc_fileio_write(fio, "abc", 3, 20);
+	isc_fileio_sync(fio);
+	isc_fileio_write(fio, "XY", 2, 4);
+	isc_fileio_sync(fio);
+	assert_int_equal(isc_fileio_submit(fio), ISC_R_SUCCESS);
+
+	memset(buf, 0xff, sizeof(buf));
+	assert_int_equal(pread(fd, buf, sizeof(buf), 0), 23);
+	assert_memory_equal(buf, "0123XY6789", 10);
+	assert_memory_equal(buf + 10, "\0\0\0\0\0\0\0\0\0\0", 10);
+	assert_memory_equal(buf + 20, "abc", 3);
+
+	/* the batch can be reused once submitted */
+	isc_fileio_write(fio, "z", 1, 23);
+	assert_int_equal(isc_fileio_submit(fio), ISC_R_SUCCESS);
+	assert_int_equal(pread(fd, buf, sizeof(buf), 0), 24);
+	assert_int_equal(buf[23], 'z');
+
+	/* an empty batch is a no-op */
+	assert_int_equal(isc_fileio_submit(fio), ISC_R_SUCCESS);
+
+	isc_fileio_destroy(&fio);
+	assert_null(fio);
+
+	close(fd);
+	unlink(name);
+}
+
+/* batches larger than what is submitted at once keep their order */
+ISC_RUN_TEST_IMPL(isc_fileio_many) {
+	char name[] = "fileio_many.XXXXXX";
+	isc_fileio_t *fio = NULL;
+	unsigned char buf[MANY];
+	int fd = tempfile(name);
+
+	isc_fileio_create(isc_g_mctx, fd, &fio);
+
+	for (size_t i = 0; i < MANY; i++) {
+		unsigned char c = i % 251;
+
+		isc_fileio_write(fio, "?", 1, MANY - 1 - i);
+		isc_fileio_write(fio, &c, 1, MANY - 1 - i);
+		if (i % 100 == 0) {
+			isc_fileio_sync(fio);
+		}
+	}
+	assert_int_equal(isc_fileio_submit(fio), ISC_R_SUCCESS);
+
+	assert_int_equal(pread(fd, buf, sizeof(buf), 0), MANY);
+	for (size_t i = 0; i < MANY; i++) {
+		assert_int_equal(buf[MANY - 1 - i], i % 251);
+	}
+
+	isc_fileio_destroy(&fio);
+
+	close(fd);
+	unlink(name);
+}
+
+/* sequential writes are merged without losing any of the data */
+ISC_RUN_TEST_IMPL(isc_fileio_append) {
+	char name[] = "fileio_append.XXXXXX";
+	isc_fileio_t *fio = NULL;
+	unsigned char buf[MANY * 7];
+	int fd = tempfile(name);
+	off_t offset = 0;
+
+	isc_fileio_create(isc_g_mctx, fd, &fio);
+
+	for (size_t i = 0; i < MANY; i++) {
+		unsigned char piece[7];
+
+		memset(piece, i % 251, sizeof(piece));
+		isc_fileio_write(fio, piece, sizeof(piece), offset);
+		offset += sizeof(piece);
+		if (i == MANY / 2) {
+			isc_fileio_sync(fio);
+		}
+	}
+	assert_int_equal(isc_fileio_submit(fio), ISC_R_SUCCESS);
+
+	assert_int_equal(pread(fd, buf, sizeof(buf), 0), sizeof(buf));
+	for (size_t i = 0; i < sizeof(buf); i++) {
+		assert_int_equal(buf[i], (i / 7) % 251);
+	}
+
+	isc_fileio_destroy(&fio);
+
+	close(fd);
+	unlink(name);
+}
+
+/* failures are reported, and unsubmitted operations are discarded */
+ISC_RUN_TEST_IMPL(isc_fileio_error) {
+	char name[] = "fileio_error.XXXXXX";
+	isc_fileio_t *fio = NULL;
+	int fd = tempfile(name);
+
+	close(fd);
+	fd = open(name, O_RDONLY);
+	assert_int_not_equal(fd, -1);
+
+	isc_fileio_create(isc_g_mctx, fd, &fio);
+	isc_fileio_write(fio, "data", 4, 0);
+	isc_fileio_sync(fio);
+	assert_int_not_equal(isc_fileio_submit(fio), ISC_R_SUCCESS);
+
+	isc_fileio_write(fio, "data", 4, 0);
+	isc_fileio_destroy(&fio);
+
+	close(fd);
+	unlink(name);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_fileio_write)
+ISC_TEST_ENTRY(isc_fileio_many)
+ISC_TEST_ENTRY(isc_fileio_append)
+ISC_TEST_ENTRY(isc_fileio_error)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
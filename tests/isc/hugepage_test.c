@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/hugepage.h>
+#include <isc/lib.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+#define BLOCKSIZE (64 * 1024)
+#define NBLOCKS	  (ISC_HUGEPAGE_REGION_SIZE / BLOCKSIZE)
+
+/* without huge pages the arena hands out nothing */
+ISC_RUN_TEST_IMPL(isc_hugepage_none) {
+	isc_hugepage_arena_t *arena = NULL;
+	isc_hugepage_stats_t stats;
+
+	isc_hugepage_setmode(isc_hugepage_none);
+	isc_hugepage_arena_create(isc_g_mctx, BLOCKSIZE, &arena);
+
+	assert_null(isc_hugepage_get(arena, isc_g_mctx));
+
+	isc_hugepage_stats(arena, &stats);
+	assert_int_equal(stats.regions, 0);
+	assert_int_equal(stats.blocks, 0);
+
+	isc_hugepage_arena_destroy(&arena);
+	assert_null(arena);
+}
+
+/* blocks are aligned, distinct, charged to the memory context and reused */
+ISC_RUN_TEST_IMPL(isc_hugepage_blocks) {
+	isc_hugepage_arena_t *arena = NULL;
+	isc_hugepage_stats_t stats;
+	isc_mem_t *mctx = NULL;
+	uint8_t *blocks[3 * NBLOCKS];
+
+	isc_mem_create("hugepage", &mctx);
+	isc_hugepage_setmode(isc_hugepage_transparent);
+	isc_hugepage_arena_create(isc_g_mctx, BLOCKSIZE, &arena);
+
+	for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+		blocks[i] = isc_hugepage_get(arena, mctx);
+		if (blocks[i] == NULL) {
+			/* no memory to map; nothing more to test */
+			while (i-- > 0) {
+				isc_hugepage_put(arena, mctx, blocks[i]);
+			}
+			skip();
+		}
+		assert_int_equal((uintptr_t)blocks[i] % BLOCKSIZE, 0);
+		memset(blocks[i], (int)i, BLOCKSIZE);
+	}
+
+	assert_int_equal(isc_mem_inuse(mctx), ARRAY_SIZE(blocks) * BLOCKSIZE);
+
+	isc_hugepage_stats(arena, &stats);
+	assert_int_equal(stats.regions, 3);
+	assert_int_equal(stats.blocks, ARRAY_SIZE(blocks));
+
+	/* writes to one block must not have clobbered another */
+	for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+		assert_int_equal(blocks[i][0], (uint8_t)i);
+		assert_int_equal(blocks[i][BLOCKSIZE - 1], (uint8_t)i);
+	}
+
+	/* a block that is put back is the next one handed out */
+	isc_hugepage_put(arena, mctx, blocks[5]);
+	assert_ptr_equal(isc_hugepage_get(arena, mctx), blocks[5]);
+
+	/* emptied regions are unmapped, except for one spare */
+	for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+		isc_hugepage_put(arena, mctx, blocks[i]);
+	}
+
+	assert_int_equal(isc_mem_inuse(mctx), 0);
+
+	isc_hugepage_stats(arena, &stats);
+	assert_int_equal(stats.regions, 1);
+	assert_int_equal(stats.blocks, 0);
+
+	isc_hugepage_arena_destroy(&arena);
+	isc_hugepage_setmode(isc_hugepage_none);
+	isc_mem_detach(&mctx);
+}
+
+/* blocks need not be a power of two in size, e.g. qp-trie chunks */
+ISC_RUN_TEST_IMPL(isc_hugepage_oddsize) {
+	isc_hugepage_arena_t *arena = NULL;
+	isc_hugepage_stats_t stats;
+	const size_t blocksize = 48 * 1024;
+	const size_t nblocks = ISC_HUGEPAGE_REGION_SIZE / blocksize;
+	uint8_t *blocks[2 * (ISC_HUGEPAGE_REGION_SIZE / (48 * 1024))];
+
+	isc_hugepage_setmode(isc_hugepage_transparent);
+	isc_hugepage_arena_create(isc_g_mctx, blocksize, &arena);
+
+	for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+		blocks[i] = isc_hugepage_get(arena, isc_g_mctx);
+		if (blocks[i] == NULL) {
+			while (i-- > 0) {
+				isc_hugepage_put(arena, isc_g_mctx, blocks[i]);
+			}
+			skip();
+		}
+		memset(blocks[i], (int)i, blocksize);
+	}
+
+	/* the tail of a region that doesn't fit a block is left unused */
+	isc_hugepage_stats(arena, &stats);
+	assert_int_equal(stats.regions, 2);
+	assert_int_equal(stats.blocks, 2 * nblocks);
+
+	for (size_t i = 0; i < ARRAY_SIZE(blocks); i++) {
+		assert_int_equal(blocks[i][0], (uint8_t)i);
+		assert_int_equal(blocks[i][blocksize - 1], (uint8_t)i);
+		isc_hugepage_put(arena, isc_g_mctx, blocks[i]);
+	}
+
+	isc_hugepage_arena_destroy(&arena);
+	isc_hugepage_setmode(isc_hugepage_none);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_hugepage_none)
+ISC_TEST_ENTRY(isc_hugepage_blocks)
+ISC_TEST_ENTRY(isc_hugepage_oddsize)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -26,6 +26,7 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/lib.h>
 #include <isc/loop.h>
@@ -128,12 +129,56 @@ ISC_RUN_TEST_IMPL(isc_loopmgr_sigterm) {
 	isc_loopmgr_run();
 }
 
+static isc_loopstats_t stallstats;
+static uint64_t stallsuppressed;
+
+static void
+stall_teardown(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+
+	isc_loop_getstats(loop, &stallstats);
+	stallsuppressed = loop->stall_suppressed;
+}
+
+static void
+stall_again(void *arg ISC_ATTR_UNUSED) {
+	uv_sleep(20);
+	isc_loopmgr_shutdown();
+}
+
+static void
+stall(void *arg ISC_ATTR_UNUSED) {
+	isc_loop_t *loop = isc_loop();
+
+	isc_loop_teardown(loop, stall_teardown, NULL);
+
+	uv_sleep(20);
+	isc_async_run(loop, stall_again, NULL);
+}
+
+ISC_RUN_TEST_IMPL(isc_loop_stall) {
+	isc_loopmgr_setstallthreshold(10);
+	isc_loop_setup(isc_loop_main(), stall, NULL);
+
+	isc_loopmgr_run();
+
+	assert_true(stallstats.callbacks > 0);
+	assert_true(stallstats.runtime[2] >= 10 * US_PER_MS);
+	/* the second stall in a row is not logged */
+	assert_int_equal(stallsuppressed, 1);
+#if UV_VERSION_HEX >= UV_VERSION(1, 39, 0)
+	assert_true(stallstats.stalls > 0);
+	assert_true(stallstats.lag[2] >= 10 * US_PER_MS);
+#endif /* UV_VERSION_HEX >= UV_VERSION(1, 39, 0) */
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_pause, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_runjob, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigint, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigterm, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_loop_stall, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -18,6 +18,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define UNIT_TESTING
@@ -26,6 +27,7 @@
 #include <isc/atomic.h>
 #include <isc/file.h>
 #include <isc/lib.h>
+#include <isc/lockprof.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/os.h>
@@ -74,6 +76,51 @@ ISC_RUN_TEST_IMPL(isc_mutex) {
 	isc_mutex_destroy(&lock);
 }
 
+static isc_result_t
+lockprof_find(const isc_lockprof_stats_t *stats, void *arg) {
+	isc_lockprof_stats_t *found = arg;
+
+	if (strcmp(stats->file, __FILE__) == 0 &&
+	    stats->kind == isc_lockprof_mutex)
+	{
+		*found = *stats;
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+ISC_RUN_TEST_IMPL(isc_mutex_lockprof) {
+	isc_lockprof_stats_t found = { .acquired = 0 };
+	isc_mutex_t lock;
+
+	if (!isc_lockprof_supported()) {
+		skip();
+		return;
+	}
+
+	isc_lockprof_reset();
+
+	isc_mutex_init(&lock);
+
+	for (size_t i = 0; i < loops; i++) {
+		LOCK(&lock);
+		UNLOCK(&lock);
+	}
+
+	isc_mutex_destroy(&lock);
+
+	assert_int_equal(isc_lockprof_walk(lockprof_find, &found),
+			 ISC_R_SUCCESS);
+	assert_int_equal(found.acquired, loops);
+	assert_int_equal(found.contended, 0);
+
+	isc_lockprof_reset();
+	found.acquired = 0;
+	assert_int_equal(isc_lockprof_walk(lockprof_find, &found),
+			 ISC_R_SUCCESS);
+	assert_int_equal(found.acquired, 0);
+}
+
 #define ITERS 20
 
 #define DC	200
@@ -215,6 +262,7 @@ ISC_RUN_TEST_IMPL(isc_mutex_benchmark) {
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_mutex)
+ISC_TEST_ENTRY(isc_mutex_lockprof)
 #if !defined(__SANITIZE_THREAD__)
 ISC_TEST_ENTRY(isc_mutex_benchmark)
 #endif /* __SANITIZE_THREAD__ */
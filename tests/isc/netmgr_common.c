@@ -429,6 +429,9 @@ listen_send_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
 	isc_nmhandle_detach(&sendhandle);
 }
 
+static void
+request_reset(void *arg ISC_ATTR_UNUSED) {}
+
 void
 listen_read_cb(isc_nmhandle_t *handle, isc_result_t eresult,
 	       isc_region_t *region, void *cbarg) {
@@ -448,6 +451,15 @@ listen_read_cb(isc_nmhandle_t *handle, isc_result_t eresult,
 		memmove(&magic, region->base, sizeof(magic));
 		assert_true(magic == send_magic);
 
+		/* Attach per-request state like ns_client does */
+		if (isc_nmhandle_getdata(handle) == NULL) {
+			isc_nmhandle_setdata(handle, &sreads, request_reset,
+					     NULL);
+		}
+		isc_nm_loopload_t load;
+		isc_nm_getloopload(isc_tid(), &load);
+		assert_true(load.requests_active > 0);
+
 		if (have_expected_sreads(atomic_fetch_add(&sreads, 1) + 1)) {
 			do_sreads_shutdown();
 		}
@@ -1094,6 +1106,38 @@ stream_recv_one(void **state ISC_ATTR_UNUSED) {
 	stream_connect(connect_connect_cb, NULL, T_CONNECT);
 }
 
+/*
+ * Every request handle has been released by now.
+ */
+static void
+assert_no_requests(void) {
+	for (isc_tid_t tid = 0; tid < (isc_tid_t)isc_loopmgr_nloops(); tid++) {
+		isc_nm_loopload_t load;
+
+		isc_nm_getloopload(tid, &load);
+		assert_int_equal(load.requests_active, 0);
+	}
+}
+
+static void
+assert_loopload(uint64_t expected_accepted) {
+	uint64_t tcp_accepted = 0;
+
+	/*
+	 * Every accepted stream is accounted to exactly one loop, and
+	 * all of them are closed by now.
+	 */
+	for (isc_tid_t tid = 0; tid < (isc_tid_t)isc_loopmgr_nloops(); tid++) {
+		isc_nm_loopload_t load;
+
+		isc_nm_getloopload(tid, &load);
+		assert_int_equal(load.tcp_active, 0);
+		tcp_accepted += load.tcp_accepted;
+	}
+	assert_int_equal(tcp_accepted, expected_accepted);
+	assert_no_requests();
+}
+
 int
 stream_recv_one_teardown(void **state ISC_ATTR_UNUSED) {
 	atomic_assert_int_eq(cconnects, expected_cconnects);
@@ -1103,6 +1147,8 @@ stream_recv_one_teardown(void **state ISC_ATTR_UNUSED) {
 	atomic_assert_int_eq(ssends, expected_ssends);
 	atomic_assert_int_eq(creads, expected_creads);
 
+	assert_loopload(expected_saccepts);
+
 	return teardown_netmgr_test(state);
 }
 
@@ -1183,6 +1229,8 @@ stream_recv_two_teardown(void **state ISC_ATTR_UNUSED) {
 	atomic_assert_int_eq(ssends, expected_ssends);
 	atomic_assert_int_eq(creads, expected_creads);
 
+	assert_loopload(expected_saccepts);
+
 	return teardown_netmgr_test(state);
 }
 
@@ -2134,6 +2182,8 @@ udp_recv_one_teardown(void **state) {
 	atomic_assert_int_eq(ssends, expected_ssends);
 	atomic_assert_int_eq(creads, expected_creads);
 
+	assert_no_requests();
+
 	teardown_udp_test(state);
 
 	return 0;
@@ -2191,6 +2241,8 @@ udp_recv_two_teardown(void **state) {
 	atomic_assert_int_eq(ssends, expected_ssends);
 	atomic_assert_int_eq(creads, expected_creads);
 
+	assert_no_requests();
+
 	teardown_udp_test(state);
 	return 0;
 }
@@ -1259,6 +1259,96 @@ ISC_RUN_TEST_IMPL(proxyheader_tlv_data_test) {
 	assert_true(result == ISC_R_RANGE);
 }
 
+ISC_RUN_TEST_IMPL(proxyheader_addresses_only_test) {
+	isc_proxy2_handler_t *handler = (isc_proxy2_handler_t *)*state;
+	isc_result_t result;
+	isc_buffer_t databuf;
+	uint8_t data[ISC_PROXY2_MIN_AF_INET6_SIZE + 4];
+	const uint8_t extra[] = { 0xde, 0xad, 0xbe, 0xef };
+	isc_region_t region = { 0 };
+	dummy_handler_cbarg_t cbarg = { 0 };
+	struct in_addr in4 = { 0 };
+	struct in6_addr in6 = in6addr_loopback;
+	isc_sockaddr_t src_addrv4 = { 0 }, dst_addrv4 = { 0 },
+		       src_addrv6 = { 0 }, dst_addrv6 = { 0 };
+	isc_sockaddr_t src_addr = { 0 }, dst_addr = { 0 };
+	int socktype = 0;
+	size_t sz;
+
+	in4.s_addr = htonl(0xc0000201); /* 192.0.2.1 */
+	isc_sockaddr_fromin(&src_addrv4, &in4, 53001);
+	in4.s_addr = htonl(0xc0000235); /* 192.0.2.53 */
+	isc_sockaddr_fromin(&dst_addrv4, &in4, 53);
+	in6.s6_addr[0] = 0x20;
+	isc_sockaddr_fromin6(&src_addrv6, &in6, 53002);
+	in6.s6_addr[1] = 0x01;
+	isc_sockaddr_fromin6(&dst_addrv6, &in6, 853);
+
+	isc_proxy2_handler_setcb(handler, proxy2_handler_dummy, &cbarg);
+
+	/* AF_INET, SOCK_DGRAM, followed by a payload */
+	isc_buffer_init(&databuf, (void *)data, sizeof(data));
+	result = isc_proxy2_make_header(&databuf, ISC_PROXY2_CMD_PROXY,
+					SOCK_DGRAM, &src_addrv4, &dst_addrv4,
+					NULL);
+	assert_true(result == ISC_R_SUCCESS);
+	isc_buffer_putmem(&databuf, extra, sizeof(extra));
+	isc_buffer_usedregion(&databuf, &region);
+
+	result = isc_proxy2_header_handle_directly(
+		&region, proxy2_handler_dummy, &cbarg);
+	assert_true(result == ISC_R_SUCCESS);
+	assert_true(cbarg.cmd == ISC_PROXY2_CMD_PROXY);
+	assert_true(cbarg.socktype == SOCK_DGRAM);
+	assert_true(isc_sockaddr_equal(&cbarg.src_addr, &src_addrv4));
+	assert_true(isc_sockaddr_equal(&cbarg.dst_addr, &dst_addrv4));
+
+	cbarg = (dummy_handler_cbarg_t){ 0 };
+	result = isc_proxy2_handler_push(handler, &region);
+	assert_true(result == ISC_R_SUCCESS);
+	assert_true(isc_sockaddr_equal(&cbarg.src_addr, &src_addrv4));
+	assert_true(isc_sockaddr_equal(&cbarg.dst_addr, &dst_addrv4));
+
+	sz = isc_proxy2_handler_header(handler, NULL);
+	assert_true(sz == ISC_PROXY2_MIN_AF_INET_SIZE);
+	assert_true(isc_proxy2_handler_tlvs(handler, NULL) == 0);
+	region = (isc_region_t){ 0 };
+	sz = isc_proxy2_handler_extra(handler, &region);
+	assert_true(sz == sizeof(extra));
+	assert_true(memcmp(region.base, extra, sizeof(extra)) == 0);
+
+	result = isc_proxy2_handler_addresses(handler, &socktype, &src_addr,
+					      &dst_addr);
+	assert_true(result == ISC_R_SUCCESS);
+	assert_true(socktype == SOCK_DGRAM);
+	assert_true(isc_sockaddr_equal(&src_addr, &src_addrv4));
+	assert_true(isc_sockaddr_equal(&dst_addr, &dst_addrv4));
+
+	/* AF_INET6, SOCK_STREAM, without a payload */
+	cbarg = (dummy_handler_cbarg_t){ 0 };
+	isc_buffer_init(&databuf, (void *)data, sizeof(data));
+	result = isc_proxy2_make_header(&databuf, ISC_PROXY2_CMD_PROXY,
+					SOCK_STREAM, &src_addrv6, &dst_addrv6,
+					NULL);
+	assert_true(result == ISC_R_SUCCESS);
+	isc_buffer_usedregion(&databuf, &region);
+	assert_true(region.length == ISC_PROXY2_MIN_AF_INET6_SIZE);
+
+	result = isc_proxy2_handler_push(handler, &region);
+	assert_true(result == ISC_R_SUCCESS);
+	assert_true(cbarg.socktype == SOCK_STREAM);
+	assert_true(isc_sockaddr_equal(&cbarg.src_addr, &src_addrv6));
+	assert_true(isc_sockaddr_equal(&cbarg.dst_addr, &dst_addrv6));
+	assert_true(isc_proxy2_handler_extra(handler, NULL) == 0);
+
+	/* A truncated header must not be accepted */
+	cbarg = (dummy_handler_cbarg_t){ 0 };
+	region.length--;
+	result = isc_proxy2_header_handle_directly(
+		&region, proxy2_handler_dummy, &cbarg);
+	assert_true(result == ISC_R_NOMORE);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(proxyheader_generic_test, setup_test_proxy,
 		      teardown_test_proxy)
@@ -1288,6 +1378,8 @@ ISC_TEST_ENTRY_CUSTOM(proxyheader_bad_unexpected_not_enough_length_test,
 		      setup_test_proxy, teardown_test_proxy)
 ISC_TEST_ENTRY_CUSTOM(proxyheader_tlv_data_test, setup_test_proxy,
 		      teardown_test_proxy)
+ISC_TEST_ENTRY_CUSTOM(proxyheader_addresses_only_test, setup_test_proxy,
+		      teardown_test_proxy)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/ascii.h>
+#include <isc/hash.h>
+#include <isc/lib.h>
+#include <isc/mem.h>
+#include <isc/string.h>
+#include <isc/swisstable.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* INCLUDE LAST */
+
+#include "swisstable.c"
+
+typedef struct test_node {
+	uint32_t hashval;
+	char key[64];
+} test_node_t;
+
+static bool
+nodes_match(void *node0, const void *key) {
+	struct test_node *node = node0;
+
+	return memcmp(node->key, key, 16) == 0;
+}
+
+static bool
+upper_nodes_match(void *node0, const void *key) {
+	struct test_node *node = node0;
+
+	return isc_ascii_lowerequal((uint8_t *)node->key, key, 16);
+}
+
+static void
+test_swisstable_full(uint8_t init_bits, uintptr_t count) {
+	isc_swisstable_t *table = NULL;
+	isc_result_t result;
+	test_node_t *nodes, *upper_nodes;
+
+	nodes = isc_mem_cget(isc_g_mctx, count, sizeof(nodes[0]));
+	upper_nodes = isc_mem_cget(isc_g_mctx, count, sizeof(nodes[0]));
+
+	isc_swisstable_create(isc_g_mctx, init_bits, &table);
+	assert_non_null(table);
+
+	/*
+	 * Note: snprintf() is followed with strlcat()
+	 * to ensure we are always filling the 16 byte key.
+	 */
+	for (size_t i = 0; i < count; i++) {
+		snprintf((char *)nodes[i].key, 16, "%u", (unsigned int)i);
+		strlcat((char *)nodes[i].key, " key of a raw hashmap!!", 16);
+		nodes[i].hashval = isc_hash32(nodes[i].key, 16, true);
+
+		snprintf((char *)upper_nodes[i].key, 16, "%u", (unsigned int)i);
+		strlcat((char *)upper_nodes[i].key, " KEY of a raw hashmap!!",
+			16);
+		upper_nodes[i].hashval = isc_hash32(upper_nodes[i].key, 16,
+						    false);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_add(table, nodes[i].hashval,
+					    nodes_match, nodes[i].key,
+					    &nodes[i], &f);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(f, NULL);
+	}
+	assert_int_equal(isc_swisstable_count(table), count);
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_find(table, nodes[i].hashval,
+					     nodes_match, nodes[i].key, &f);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(&nodes[i], f);
+	}
+
+	/* check for double inserts */
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_add(table, nodes[i].hashval,
+					    nodes_match, nodes[i].key,
+					    &nodes[i], &f);
+		assert_int_equal(result, ISC_R_EXISTS);
+		assert_ptr_equal(f, &nodes[i]);
+	}
+
+	/* same hash values, but the keys differ in case */
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_find(table, upper_nodes[i].hashval,
+					     nodes_match, upper_nodes[i].key,
+					     &f);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		assert_null(f);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_delete(table, nodes[i].hashval,
+					       nodes_match, nodes[i].key);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = isc_swisstable_find(table, nodes[i].hashval,
+					     nodes_match, nodes[i].key, &f);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+		assert_null(f);
+	}
+	assert_int_equal(isc_swisstable_count(table), 0);
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_add(table, upper_nodes[i].hashval,
+					    upper_nodes_match,
+					    upper_nodes[i].key, &upper_nodes[i],
+					    &f);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(f, NULL);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_find(table, upper_nodes[i].hashval,
+					     upper_nodes_match,
+					     upper_nodes[i].key, &f);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(f, &upper_nodes[i]);
+	}
+
+	/* delete and re-add the same keys, leaving tombstones behind */
+	for (size_t n = 0; n < 4; n++) {
+		for (size_t i = 0; i < count; i++) {
+			result = isc_swisstable_delete(
+				table, upper_nodes[i].hashval,
+				upper_nodes_match, upper_nodes[i].key);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			result = isc_swisstable_add(
+				table, upper_nodes[i].hashval,
+				upper_nodes_match, upper_nodes[i].key,
+				&upper_nodes[i], NULL);
+			assert_int_equal(result, ISC_R_SUCCESS);
+		}
+	}
+	assert_int_equal(isc_swisstable_count(table), count);
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_swisstable_delete(table, upper_nodes[i].hashval,
+					       upper_nodes_match,
+					       upper_nodes[i].key);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(isc_swisstable_count(table), 0);
+
+	isc_swisstable_destroy(&table);
+	assert_null(table);
+
+	isc_mem_cput(isc_g_mctx, nodes, count, sizeof(nodes[0]));
+	isc_mem_cput(isc_g_mctx, upper_nodes, count, sizeof(nodes[0]));
+}
+
+ISC_RUN_TEST_IMPL(isc_swisstable_1_120) {
+	test_swisstable_full(1, 120);
+}
+
+ISC_RUN_TEST_IMPL(isc_swisstable_6_1000) {
+	test_swisstable_full(6, 1000);
+}
+
+ISC_RUN_TEST_IMPL(isc_swisstable_24_200000) {
+	test_swisstable_full(24, 200000);
+}
+
+ISC_RUN_TEST_IMPL(isc_swisstable_1_48000) {
+	test_swisstable_full(1, 48000);
+}
+
+ISC_RUN_TEST_IMPL(isc_swisstable_iterator) {
+	isc_swisstable_t *table = NULL;
+	isc_swisstable_iter_t *iter = NULL;
+	isc_result_t result;
+	size_t count = 7600;
+	test_node_t *nodes;
+	bool *seen;
+
+	nodes = isc_mem_cget(isc_g_mctx, count, sizeof(nodes[0]));
+	seen = isc_mem_cget(isc_g_mctx, count, sizeof(seen[0]));
+
+	isc_swisstable_create(isc_g_mctx, 1, &table);
+
+	for (size_t i = 0; i < count; i++) {
+		snprintf((char *)nodes[i].key, 16, "%u", (unsigned int)i);
+		strlcat((char *)nodes[i].key, " key of a raw hashmap!!", 16);
+		nodes[i].hashval = isc_hash32(nodes[i].key, 16, true);
+
+		result = isc_swisstable_add(table, nodes[i].hashval,
+					    nodes_match, nodes[i].key,
+					    &nodes[i], NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	/* We want to iterate while rehashing is in progress */
+	if (!rehashing_in_progress(table)) {
+		swisstable_rehash_start(table,
+					table->tables[table->hindex].bits + 1);
+		for (size_t i = 0; i < 4; i++) {
+			swisstable_rehash_one(table);
+		}
+	}
+	assert_true(rehashing_in_progress(table));
+
+	isc_swisstable_iter_create(table, &iter);
+
+	for (result = isc_swisstable_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_swisstable_iter_next(iter))
+	{
+		const uint8_t *tkey = NULL;
+		test_node_t *v = NULL;
+		ptrdiff_t i;
+
+		isc_swisstable_iter_current(iter, (void *)&v);
+		isc_swisstable_iter_currentkey(iter, &tkey);
+
+		i = v - &nodes[0];
+		assert_memory_equal(nodes[i].key, tkey, 16);
+
+		assert_false(seen[i]);
+		seen[i] = true;
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	for (size_t i = 0; i < count; i++) {
+		assert_true(seen[i]);
+	}
+
+	/* erase odd */
+	memset(seen, 0, count * sizeof(seen[0]));
+	result = isc_swisstable_iter_first(iter);
+	while (result == ISC_R_SUCCESS) {
+		test_node_t *v = NULL;
+		ptrdiff_t i;
+
+		isc_swisstable_iter_current(iter, (void *)&v);
+		i = v - nodes;
+
+		if (i % 2 == 1) {
+			result = isc_swisstable_iter_delcurrent_next(iter);
+		} else {
+			result = isc_swisstable_iter_next(iter);
+		}
+
+		assert_false(seen[i]);
+		seen[i] = true;
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	for (size_t i = 0; i < count; i++) {
+		assert_true(seen[i]);
+	}
+	assert_int_equal(isc_swisstable_count(table), count / 2);
+
+	/* erase the rest */
+	result = isc_swisstable_iter_first(iter);
+	while (result == ISC_R_SUCCESS) {
+		test_node_t *v = NULL;
+
+		isc_swisstable_iter_current(iter, (void *)&v);
+		assert_int_equal((v - nodes) % 2, 0);
+
+		result = isc_swisstable_iter_delcurrent_next(iter);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(isc_swisstable_count(table), 0);
+
+	/* Iterator doesn't progress rehashing */
+	assert_true(rehashing_in_progress(table));
+
+	isc_swisstable_iter_destroy(&iter);
+	assert_null(iter);
+
+	isc_swisstable_destroy(&table);
+
+	isc_mem_cput(isc_g_mctx, seen, count, sizeof(seen[0]));
+	isc_mem_cput(isc_g_mctx, nodes, count, sizeof(nodes[0]));
+}
+
+ISC_RUN_TEST_IMPL(isc_swisstable_collisions) {
+	isc_swisstable_t *table = NULL;
+	isc_result_t result;
+	size_t count = 1000;
+	test_node_t *nodes;
+
+	nodes = isc_mem_cget(isc_g_mctx, count, sizeof(nodes[0]));
+
+	isc_swisstable_create(isc_g_mctx, 1, &table);
+
+	/*
+	 * All the entries share one hash value, so every lookup has to
+	 * walk the whole probe sequence and fall back to the match function.
+	 */
+	for (size_t i = 0; i < count; i++) {
+		snprintf((char *)nodes[i].key, 16, "%u", (unsigned int)i);
+		strlcat((char *)nodes[i].key, " key of a raw hashmap!!", 16);
+		nodes[i].hashval = 0x5eed;
+
+		result = isc_swisstable_add(table, nodes[i].hashval,
+					    nodes_match, nodes[i].key,
+					    &nodes[i], NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		void *f = NULL;
+		result = isc_swisstable_find(table, nodes[i].hashval,
+					     nodes_match, nodes[i].key, &f);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(f, &nodes[i]);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		result = isc_swisstable_delete(table, nodes[i].hashval,
+					       nodes_match, nodes[i].key);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	assert_int_equal(isc_swisstable_count(table), 0);
+
+	isc_swisstable_destroy(&table);
+
+	isc_mem_cput(isc_g_mctx, nodes, count, sizeof(nodes[0]));
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(isc_swisstable_1_120)
+ISC_TEST_ENTRY(isc_swisstable_6_1000)
+ISC_TEST_ENTRY(isc_swisstable_24_200000)
+ISC_TEST_ENTRY(isc_swisstable_1_48000)
+ISC_TEST_ENTRY(isc_swisstable_iterator)
+ISC_TEST_ENTRY(isc_swisstable_collisions)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/lib.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/topk.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* INCLUDE LAST */
+
+#include "topk.c"
+
+#define HEAVY  10
+#define LIGHT  5000
+#define NOW    1000000
+#define REPEAT 200
+
+static void
+add(isc_topk_t *tk, const char *fmt, unsigned int n, uint32_t inc,
+    isc_stdtime_t now) {
+	char key[64];
+
+	snprintf(key, sizeof(key), fmt, n);
+	isc_topk_add(tk, key, strlen(key), inc, now);
+}
+
+static uint32_t
+get(isc_topk_t *tk, const char *fmt, unsigned int n) {
+	char key[64];
+
+	snprintf(key, sizeof(key), fmt, n);
+	return isc_topk_estimate(tk, key, strlen(key));
+}
+
+/* a few frequent keys stand out from a long tail of rare ones */
+ISC_RUN_TEST_IMPL(isc_topk_heavy) {
+	isc_topk_t *tk = NULL;
+	isc_topk_entry_t entries[ISC_TOPK_ENTRIES];
+	size_t count;
+
+	isc_topk_create(isc_g_mctx, 0, &tk);
+
+	for (unsigned int r = 0; r < REPEAT; r++) {
+		for (unsigned int i = 0; i < HEAVY; i++) {
+			add(tk, "heavy%u.example", i, i + 1, NOW);
+		}
+		for (unsigned int i = 0; i < LIGHT / REPEAT; i++) {
+			add(tk, "light%u.example", r * LIGHT / REPEAT + i, 1,
+			    NOW);
+		}
+	}
+
+	/* estimates never undercount */
+	for (unsigned int i = 0; i < HEAVY; i++) {
+		assert_true(get(tk, "heavy%u.example", i) >= REPEAT * (i + 1));
+	}
+	for (unsigned int i = 0; i < LIGHT; i++) {
+		assert_true(get(tk, "light%u.example", i) >= 1);
+	}
+
+	count = isc_topk_get(tk, entries, HEAVY);
+	assert_int_equal(count, HEAVY);
+	for (size_t i = 0; i < count; i++) {
+		char expected[64];
+
+		snprintf(expected, sizeof(expected), "heavy%zu.example",
+			 HEAVY - 1 - i);
+		assert_int_equal(entries[i].length, strlen(expected));
+		assert_memory_equal(entries[i].key, expected,
+				    entries[i].length);
+		assert_true(entries[i].count >= REPEAT * (HEAVY - i));
+		if (i > 0) {
+			assert_true(entries[i].count <= entries[i - 1].count);
+		}
+	}
+
+	count = isc_topk_get(tk, entries, ARRAY_SIZE(entries));
+	assert_int_equal(count, ISC_TOPK_ENTRIES);
+
+	isc_topk_destroy(&tk);
+	assert_null(tk);
+}
+
+/* counts are halved once per half-life */
+ISC_RUN_TEST_IMPL(isc_topk_decay) {
+	isc_topk_t *tk = NULL;
+	isc_topk_entry_t entries[ISC_TOPK_ENTRIES];
+
+	isc_topk_create(isc_g_mctx, 10, &tk);
+
+	add(tk, "key%u", 1, 64, NOW);
+	assert_int_equal(get(tk, "key%u", 1), 64);
+
+	add(tk, "key%u", 2, 1, NOW + 9);
+	assert_int_equal(get(tk, "key%u", 1), 64);
+
+	add(tk, "key%u", 2, 1, NOW + 25);
+	assert_int_equal(get(tk, "key%u", 1), 16);
+	assert_int_equal(isc_topk_get(tk, entries, ARRAY_SIZE(entries)), 2);
+
+	/* keys whose count drops to zero are forgotten */
+	add(tk, "key%u", 3, 1, NOW + 80);
+	assert_int_equal(get(tk, "key%u", 1), 0);
+	assert_int_equal(isc_topk_get(tk, entries, ARRAY_SIZE(entries)), 1);
+	assert_memory_equal(entries[0].key, "key3", 4);
+
+	/* a long idle time clears everything */
+	add(tk, "key%u", 4, 1, NOW + 1000);
+	assert_int_equal(get(tk, "key%u", 3), 0);
+	assert_int_equal(isc_topk_get(tk, entries, ARRAY_SIZE(entries)), 1);
+
+	isc_topk_destroy(&tk);
+}
+
+/*
+ * Every slot is in the heap, which has the lowest count at the top,
+ * and can be found through the index.
+ */
+static void
+check_table(isc_topk_t *tk) {
+	unsigned int indexed = 0;
+
+	for (unsigned int pos = 0; pos < tk->used; pos++) {
+		assert_int_equal(tk->position[tk->heap[pos]], pos);
+		if (pos > 0) {
+			assert_true(heapcount(tk, (pos - 1) / 2) <=
+				    heapcount(tk, pos));
+		}
+	}
+	for (unsigned int b = 0; b < BUCKETS; b++) {
+		indexed += (tk->index[b] != 0);
+	}
+	assert_int_equal(indexed, tk->used);
+	for (unsigned int i = 0; i < tk->used; i++) {
+		slot_t *slot = &tk->slots[i];
+		assert_ptr_equal(lookup(tk, slot->hashval, slot->key,
+					slot->length),
+				 slot);
+	}
+}
+
+/* the table stays consistent while a flood of new keys replaces its keys */
+ISC_RUN_TEST_IMPL(isc_topk_table) {
+	isc_topk_t *tk = NULL;
+	isc_topk_entry_t entries[ISC_TOPK_ENTRIES];
+	size_t count;
+
+	isc_topk_create(isc_g_mctx, 10, &tk);
+
+	for (unsigned int i = 0; i < LIGHT; i++) {
+		add(tk, "heavy%u.example", i % HEAVY, 4, NOW + i / 1000);
+		add(tk, "random%u.example", i, 1, NOW + i / 1000);
+		check_table(tk);
+	}
+	assert_int_equal(tk->used, ISC_TOPK_ENTRIES);
+
+	count = isc_topk_get(tk, entries, HEAVY);
+	assert_int_equal(count, HEAVY);
+	for (size_t i = 0; i < count; i++) {
+		assert_memory_equal(entries[i].key, "heavy", 5);
+	}
+
+	/* the heavy keys survive a decay, the rest are forgotten */
+	add(tk, "heavy%u.example", 0, 1, NOW + 100);
+	check_table(tk);
+	assert_int_equal(isc_topk_get(tk, entries, ARRAY_SIZE(entries)),
+			 HEAVY);
+
+	isc_topk_destroy(&tk);
+}
+
+/* a multithreaded sketch counts one in 'rate' keys, 'rate' times over */
+ISC_LOOP_TEST_IMPL(isc_topkmulti_sample) {
+	isc_topkmulti_t *tm = NULL;
+	isc_topk_t *merged = NULL;
+	unsigned int sampled = 0;
+
+	isc_topkmulti_create(isc_g_mctx, 0, 8, &tm);
+	assert_int_equal(isc_topkmulti_getrate(tm), 8);
+
+	for (unsigned int i = 0; i < 8 * LIGHT; i++) {
+		if (isc_topkmulti_sample(tm)) {
+			isc_topkmulti_add(tm, "key", 3, NOW);
+			sampled++;
+		}
+	}
+	assert_in_range(sampled, LIGHT * 9 / 10, LIGHT * 11 / 10);
+
+	isc_topkmulti_merge(&merged, tm, NOW);
+	assert_int_equal(isc_topk_estimate(merged, "key", 3), 8 * sampled);
+
+	isc_topk_destroy(&merged);
+	isc_topkmulti_detach(&tm);
+	isc_loopmgr_shutdown();
+}
+
+/* merging sketches adds up the counts */
+ISC_RUN_TEST_IMPL(isc_topk_merge) {
+	isc_topk_t *a = NULL, *b = NULL, *merged = NULL;
+	isc_topk_entry_t entries[ISC_TOPK_ENTRIES];
+
+	isc_topk_create(isc_g_mctx, 0, &a);
+	isc_topk_create(isc_g_mctx, 0, &b);
+
+	for (unsigned int i = 0; i < ISC_TOPK_ENTRIES - 1; i++) {
+		add(a, "a%u", i, 10, NOW);
+		add(b, "b%u", i, 10, NOW);
+	}
+	/* not the top key in either sketch, but the top key overall */
+	add(a, "both", 0, 8, NOW);
+	add(b, "both", 0, 8, NOW);
+
+	isc_topk_merge(&merged, a, NOW);
+	isc_topk_merge(&merged, b, NOW);
+	assert_non_null(merged);
+
+	assert_true(get(merged, "both", 0) >= 16);
+	assert_true(get(merged, "a%u", 0) >= 10);
+	assert_true(get(merged, "b%u", 0) >= 10);
+
+	assert_int_equal(isc_topk_get(merged, entries, 1), 1);
+	assert_int_equal(entries[0].length, 4);
+	assert_memory_equal(entries[0].key, "both", 4);
+
+	isc_topk_destroy(&merged);
+	isc_topk_destroy(&a);
+	isc_topk_destroy(&b);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_topk_heavy)
+ISC_TEST_ENTRY(isc_topk_decay)
+ISC_TEST_ENTRY(isc_topk_table)
+ISC_TEST_ENTRY(isc_topk_merge)
+ISC_TEST_ENTRY_CUSTOM(isc_topkmulti_sample, setup_loopmgr, teardown_loopmgr)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
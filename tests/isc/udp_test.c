@@ -12,6 +12,7 @@
  */
 
 #include <inttypes.h>
+#include <limits.h>
 #include <sched.h> /* IWYU pragma: keep */
 #include <setjmp.h>
 #include <signal.h>
@@ -195,6 +196,53 @@ ISC_LOOP_TEST_IMPL(udp_recv_send) { udp_recv_send(arg); }
 
 ISC_LOOP_TEST_IMPL(udp_double_read) { udp_double_read(arg); }
 
+ISC_LOOP_TEST_IMPL(udp_cpu_affinity) {
+	isc_result_t result = ISC_R_SUCCESS;
+	uint32_t nloops = isc_loopmgr_nloops();
+
+	/* The CPUs don't wrap around */
+	assert_int_equal(isc_os_cpu(UINT_MAX), -1);
+
+	result = isc_nm_setcpuaffinity(true);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		assert_false(isc_nm_getcpuaffinity());
+		isc_loopmgr_shutdown();
+		skip();
+		return;
+	}
+
+	/* More loops than CPUs is refused */
+	if (isc_os_cpu(nloops - 1) < 0) {
+		assert_int_equal(result, ISC_R_RANGE);
+		assert_false(isc_nm_getcpuaffinity());
+		isc_loopmgr_shutdown();
+		return;
+	}
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(isc_nm_getcpuaffinity());
+
+	result = isc_nm_listenudp(ISC_NM_LISTEN_ALL, &udp_listen_addr,
+				  mock_recv_cb, NULL, &listen_sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Every child joined the group in loop order */
+	assert_int_equal(listen_sock->njoined, nloops);
+
+	/* A child joining out of order detaches the program */
+	isc__nmsocket_joined(&listen_sock->children[nloops - 1]);
+#if defined(SO_DETACH_REUSEPORT_BPF)
+	result = isc__nm_socket_unsteer_cpu(listen_sock->children[0].fd);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+#endif /* defined(SO_DETACH_REUSEPORT_BPF) */
+
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+	assert_null(listen_sock);
+
+	isc_loopmgr_shutdown();
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY_CUSTOM(mock_listenudp_uv_udp_open, setup_udp_test,
@@ -227,6 +275,7 @@ ISC_TEST_ENTRY_CUSTOM(udp_shutdown_connect, udp_shutdown_connect_setup,
 		      udp_shutdown_connect_teardown)
 ISC_TEST_ENTRY_CUSTOM(udp_double_read, udp_double_read_setup,
 		      udp_double_read_teardown)
+ISC_TEST_ENTRY_CUSTOM(udp_cpu_affinity, setup_udp_test, teardown_udp_test)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_one, udp_recv_one_setup, udp_recv_one_teardown)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_two, udp_recv_two_setup, udp_recv_two_teardown)
 ISC_TEST_ENTRY_CUSTOM(udp_recv_send, udp_recv_send_setup,
@@ -29,6 +29,7 @@
 #include <isc/loop.h>
 #include <isc/os.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 #include <isc/tid.h>
 #include <isc/util.h>
 #include <isc/work.h>
@@ -39,6 +40,18 @@
 
 static atomic_uint scheduled = 0;
 
+/*
+ * isc_work_steal needs a peer to steal the work, and the number of loops
+ * can't change between tests, so every test runs with at least two.
+ */
+static int
+setup_loopmgr_peers(void **state) {
+	setup_workers(state);
+	isc_loopmgr_create(isc_g_mctx, ISC_MAX(workers, 2));
+
+	return 0;
+}
+
 static isc_result_t
 work_cb(void *arg ISC_ATTR_UNUSED) {
 	atomic_fetch_add(&scheduled, 1);
@@ -71,8 +84,84 @@ ISC_RUN_TEST_IMPL(isc_work_enqueue) {
 	assert_int_equal(atomic_load(&scheduled), 1);
 }
 
+#define STEAL_JOBS 64
+
+static atomic_uint completed = 0;
+static atomic_uint stolen = 0;
+static atomic_uint waited = 0;
+static uintptr_t owner = 0;
+
+static isc_result_t
+steal_work_cb(void *arg ISC_ATTR_UNUSED) {
+	atomic_fetch_add(&scheduled, 1);
+
+	assert_int_equal(isc_tid(), ISC_TID_UNKNOWN);
+
+	if (isc_thread_self() != owner) {
+		atomic_fetch_add(&stolen, 1);
+		return ISC_R_SUCCESS;
+	}
+
+	/*
+	 * Keep the owning worker busy until a peer has stolen a task, but
+	 * give up after about five seconds in total.
+	 */
+	while (atomic_load(&stolen) == 0 && atomic_fetch_add(&waited, 1) < 5000)
+	{
+		usleep(1000);
+	}
+
+	return ISC_R_SUCCESS;
+}
+
+static void
+steal_after_work_cb(void *arg ISC_ATTR_UNUSED, isc_result_t result) {
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Completions must always return to the originating loop */
+	assert_int_equal(isc_tid(), 0);
+
+	if (atomic_fetch_add(&completed, 1) + 1 == STEAL_JOBS) {
+		isc_loopmgr_shutdown();
+	}
+}
+
+static void
+work_steal_cb(void *arg ISC_ATTR_UNUSED) {
+	isc__workthread_t *thread =
+		isc__loopmgr_workthread(isc_loop(), ISC_WORKLANE_FAST);
+	owner = (uintptr_t)thread->thread;
+
+	for (size_t i = 0; i < STEAL_JOBS; i++) {
+		isc_work_enqueue(isc_loop(), ISC_WORKLANE_FAST, steal_work_cb,
+				 steal_after_work_cb, NULL);
+	}
+}
+
+ISC_RUN_TEST_IMPL(isc_work_steal) {
+	atomic_init(&scheduled, 0);
+	atomic_init(&completed, 0);
+	atomic_init(&stolen, 0);
+	atomic_init(&waited, 0);
+
+	isc_work_setstealing(true);
+
+	isc_loop_setup(isc_loop_main(), work_steal_cb, NULL);
+
+	isc_loopmgr_run();
+
+	isc_work_setstealing(false);
+
+	assert_int_equal(atomic_load(&scheduled), STEAL_JOBS);
+	assert_int_equal(atomic_load(&completed), STEAL_JOBS);
+	assert_int_not_equal(atomic_load(&stolen), 0);
+}
+
 ISC_TEST_LIST_START
-ISC_TEST_ENTRY_CUSTOM(isc_work_enqueue, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_work_enqueue, setup_loopmgr_peers,
+		      teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_work_steal, setup_loopmgr_peers,
+		      teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
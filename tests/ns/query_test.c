@@ -20,11 +20,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <arpa/inet.h>
+
 #define UNIT_TESTING
 #include <cmocka.h>
 
 #include <isc/lib.h>
 #include <isc/quota.h>
+#include <isc/sockaddr.h>
+#include <isc/swisstable.h>
+#include <isc/timer.h>
 #include <isc/util.h>
 
 #include <dns/badcache.h>
@@ -38,6 +43,8 @@
 #include <ns/server.h>
 #include <ns/stats.h>
 
+#include "../ns/query.c"
+
 #include <tests/ns.h>
 
 /* can be used for client->sendcb to avoid disruption on sending a response */
@@ -1714,12 +1721,395 @@ ISC_LOOP_TEST_IMPL(ns__query_hookchain) {
 	isc_loopmgr_shutdown();
 }
 
+/*****
+ ***** NSEC3 proof cache tests
+ *****/
+
+/*%
+ * Look for the NSEC3 proof that 'namestr' does not exist in the proof
+ * cache of the client manager.
+ */
+static bool
+nsec3proof_lookup(query_ctx_t *qctx, const char *namestr) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, namestr, dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return nsec3proof_find(qctx, name, false);
+}
+
+/*%
+ * Assemble the NSEC3 proof that 'namestr' does not exist, adding it
+ * to the proof cache.
+ */
+static void
+nsec3proof_assemble(query_ctx_t *qctx, const char *namestr) {
+	isc_result_t result;
+
+	qctx->need_wildcardproof = true;
+	result = dns_name_fromstring(
+		dns_fixedname_initname(&qctx->wildcardname), namestr,
+		dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	query_addwildcardproof(qctx, false, false);
+}
+
+/*%
+ * Is there an NSEC3 record owned by 'hash'.example in the authority
+ * section of the response?
+ */
+static bool
+nsec3proof_added(query_ctx_t *qctx, const char *hash) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, hash, dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_message_findname(qctx->client->message,
+				      DNS_SECTION_AUTHORITY, name,
+				      dns_rdatatype_nsec3, 0, NULL, NULL);
+	return result == ISC_R_SUCCESS;
+}
+
+/*%
+ * Get the cache entry for the zone being queried, if any.
+ */
+static nsec3proof_t *
+nsec3proof_entry(query_ctx_t *qctx) {
+	ns_nsec3proofs_t *proofs = qctx->client->manager->nsec3proofs;
+
+	if (proofs == NULL) {
+		return NULL;
+	}
+	for (size_t i = 0; i < NSEC3PROOF_ENTRIES; i++) {
+		if (proofs->entries[i].zone == qctx->zone) {
+			return &proofs->entries[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * In testdata/query/nsec3.db, the NSEC3 records of example are:
+ *
+ *   6cd52229... covering x1, x4 and *.example
+ *   b39f52k2... covering x2.example
+ *   q73gfqta... covering x0.example
+ *   v78tpb4j... covering x10 and x33.example, wrapping around to the
+ *               first record (2km8vfb1...)
+ */
+ISC_LOOP_TEST_IMPL(ns__query_nsec3proof) {
+	ns_hooktable_t *query_hooks = NULL;
+	query_ctx_t *qctx = NULL;
+	ns_nsec3proofs_t *proofs = NULL;
+	nsec3proof_t *proof = NULL;
+	dns_dbversion_t *oldversion = NULL, *newversion = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_db_t *db = NULL, *newdb = NULL;
+	isc_result_t result;
+	const ns_hook_t hook = {
+		.action = ns_test_hook_catch_call,
+	};
+	const ns_test_qctx_create_params_t qctx_params = {
+		.qname = "x1.example",
+		.qtype = dns_rdatatype_a,
+	};
+
+	/*
+	 * Stop once the query has found the zone database.
+	 */
+	ns_hooktable_create(isc_g_mctx, &query_hooks);
+	ns_hook_add(query_hooks, isc_g_mctx, NS_QUERY_LOOKUP_BEGIN, &hook);
+	ns__hook_table = query_hooks;
+
+	result = ns_test_qctx_create(&qctx_params, &qctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = ns_test_serve_zone("example",
+				    TESTS_DIR "/testdata/query/nsec3.db",
+				    qctx->client->inner.view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	ns__query_start(qctx);
+	assert_non_null(qctx->zone);
+	assert_non_null(qctx->db);
+	assert_non_null(qctx->version);
+
+	/* Nothing is cached yet */
+	assert_false(nsec3proof_lookup(qctx, "x1.example"));
+	assert_null(nsec3proof_entry(qctx));
+
+	/* Assembling a proof caches it, with the span covering x1 */
+	nsec3proof_assemble(qctx, "x1.example");
+	proof = nsec3proof_entry(qctx);
+	assert_non_null(proof);
+	assert_true(proof->complete);
+	assert_int_equal(proof->nspans, 1);
+	assert_ptr_equal(proof->db, qctx->db);
+	assert_ptr_equal(proof->version, qctx->version);
+	assert_true(nsec3proof_added(
+		qctx, "3msev9usmd4br9s97v51r2tdvmr9iqo1.example"));
+	assert_true(nsec3proof_added(
+		qctx, "6cd522290vma0nr8lqu1ivtcofj94rga.example"));
+
+	/* Names covered by the cached span are hits, others misses */
+	assert_true(nsec3proof_lookup(qctx, "x4.example"));
+	assert_true(nsec3proof_lookup(qctx, "y0.x4.example"));
+	assert_false(nsec3proof_lookup(qctx, "x2.example"));
+	assert_false(nsec3proof_lookup(qctx, "x10.example"));
+	assert_false(nsec3proof_lookup(qctx, "x33.example"));
+	assert_false(nsec3proof_lookup(qctx, "a.example"));
+	assert_false(nsec3proof_lookup(qctx, "x1.other"));
+
+	/*
+	 * The last NSEC3 record covers the hashes above its owner and
+	 * below the first owner.
+	 */
+	assert_false(nsec3proof_added(
+		qctx, "v78tpb4jfsvf164j324480ta0c5mk5oi.example"));
+	nsec3proof_assemble(qctx, "x10.example");
+	assert_ptr_equal(nsec3proof_entry(qctx), proof);
+	assert_int_equal(proof->nspans, 2);
+	assert_true(nsec3proof_added(
+		qctx, "v78tpb4jfsvf164j324480ta0c5mk5oi.example"));
+	assert_true(nsec3proof_lookup(qctx, "x10.example"));
+	assert_true(nsec3proof_lookup(qctx, "x33.example"));
+	assert_false(nsec3proof_lookup(qctx, "x0.example"));
+
+	/*
+	 * Once the zone is queried at a newer version, the proofs for
+	 * the old one are dropped.
+	 */
+	oldversion = qctx->version;
+	result = dns_db_newversion(qctx->db, &newversion);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(qctx->db, &newversion, true);
+	dns_db_currentversion(qctx->db, &newversion);
+	assert_ptr_not_equal(newversion, oldversion);
+
+	qctx->version = newversion;
+	assert_false(nsec3proof_lookup(qctx, "x4.example"));
+	assert_null(nsec3proof_entry(qctx));
+	assert_null(proof->db);
+	assert_null(proof->version);
+
+	nsec3proof_assemble(qctx, "x4.example");
+	proof = nsec3proof_entry(qctx);
+	assert_non_null(proof);
+	assert_ptr_equal(proof->version, newversion);
+	assert_true(nsec3proof_lookup(qctx, "x1.example"));
+
+	/* Likewise for a new database, when the zone is reloaded */
+	db = qctx->db;
+	result = ns_test_loaddb(&newdb, dns_dbtype_zone, "example",
+				TESTS_DIR "/testdata/query/nsec3.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(newdb, &version);
+	qctx->db = newdb;
+	qctx->version = version;
+	assert_false(nsec3proof_lookup(qctx, "x1.example"));
+	assert_null(nsec3proof_entry(qctx));
+
+	qctx->db = db;
+	qctx->version = oldversion;
+	dns_db_closeversion(newdb, &version, false);
+	dns_db_detach(&newdb);
+	dns_db_closeversion(db, &newversion, false);
+
+	/*
+	 * The proofs are dropped once their lifetime is over, whether
+	 * or not the zone is queried again, and the timer is stopped.
+	 */
+	nsec3proof_assemble(qctx, "x1.example");
+	proof = nsec3proof_entry(qctx);
+	assert_non_null(proof);
+	proofs = qctx->client->manager->nsec3proofs;
+	assert_true(isc_timer_running(proofs->timer));
+
+	nsec3proof_sweep(proofs, proof->expires - 1);
+	assert_ptr_equal(nsec3proof_entry(qctx), proof);
+	assert_true(isc_timer_running(proofs->timer));
+
+	nsec3proof_sweep(proofs, proof->expires);
+	assert_null(nsec3proof_entry(qctx));
+	assert_null(proof->db);
+	assert_null(proof->version);
+	assert_false(isc_timer_running(proofs->timer));
+
+	/*
+	 * Clean up.
+	 */
+	ns_test_cleanup_zone();
+	ns_test_qctx_destroy(&qctx);
+	ns_hooktable_free(isc_g_mctx, (void **)&query_hooks);
+
+	isc_loop_teardown(isc_loop_main(), shutdown_interfacemgr, NULL);
+	isc_loopmgr_shutdown();
+}
+
+/*****
+ ***** recursive-clients-fair-share tests
+ *****/
+
+static ns_recursionshare_t *
+share_attach(const char *address) {
+	isc_sockaddr_t sa;
+	struct in6_addr in6;
+	struct in_addr in;
+
+	if (inet_pton(AF_INET6, address, &in6) == 1) {
+		isc_sockaddr_fromin6(&sa, &in6, 53);
+	} else {
+		assert_int_equal(inet_pton(AF_INET, address, &in), 1);
+		isc_sockaddr_fromin(&sa, &in, 53);
+	}
+
+	return ns_server_recursionshare_attach(sctx, &sa);
+}
+
+/*%
+ * ns_server_recursionshare_attach(), ns_server_recursionshare_over() and
+ * ns_server_recursionshare_detach()
+ */
+ISC_LOOP_TEST_IMPL(ns__query_recursionshare) {
+	ns_recursionshare_t *shares[2000] = { NULL };
+	ns_recursionshare_t *a = NULL, *b = NULL, *c = NULL;
+	query_ctx_t *qctx = NULL;
+	struct in_addr in;
+	isc_result_t result;
+	char address[64];
+	const ns_test_qctx_create_params_t qctx_params = {
+		.qname = "foo.example.",
+		.qtype = dns_rdatatype_a,
+	};
+
+	/* Disabled, nothing is accounted */
+	a = share_attach("192.0.2.1");
+	assert_null(a);
+	assert_false(ns_server_recursionshare_over(sctx, a));
+	ns_server_recursionshare_detach(sctx, &a);
+
+	ns_server_setrecursionshare(sctx, true, 24, 56, 2);
+
+	/* Clients in the same prefix share, others don't */
+	a = share_attach("192.0.2.1");
+	b = share_attach("192.0.2.200");
+	c = share_attach("198.51.100.1");
+	assert_non_null(a);
+	assert_ptr_equal(a, b);
+	assert_ptr_not_equal(a, c);
+	assert_int_equal(atomic_load(&sctx->recursionprefixes), 2);
+	ns_server_recursionshare_detach(sctx, &b);
+	assert_null(b);
+	ns_server_recursionshare_detach(sctx, &c);
+	ns_server_recursionshare_detach(sctx, &a);
+	assert_int_equal(atomic_load(&sctx->recursionprefixes), 0);
+
+	a = share_attach("2001:db8::1");
+	b = share_attach("2001:db8:0:ff::1");
+	c = share_attach("2001:db8:0:100::1");
+	assert_ptr_equal(a, b);
+	assert_ptr_not_equal(a, c);
+	assert_int_equal(atomic_load(&sctx->recursionprefixes), 2);
+
+	/*
+	 * With a soft quota of 10 and two prefixes recursing, each is
+	 * entitled to 5 clients.
+	 */
+	isc_quota_soft(&sctx->recursionquota, 10);
+	for (size_t i = 0; i < 3; i++) {
+		shares[i] = share_attach("2001:db8::2");
+	}
+	assert_false(ns_server_recursionshare_over(sctx, a));
+	shares[3] = share_attach("2001:db8::2");
+	assert_true(ns_server_recursionshare_over(sctx, a));
+	assert_false(ns_server_recursionshare_over(sctx, c));
+	for (size_t i = 0; i < 4; i++) {
+		ns_server_recursionshare_detach(sctx, &shares[i]);
+	}
+	assert_false(ns_server_recursionshare_over(sctx, a));
+
+	/* The minimum share applies however many prefixes recurse */
+	ns_server_setrecursionshare(sctx, true, 24, 56, 3);
+	for (size_t i = 0; i < 10; i++) {
+		snprintf(address, sizeof(address), "10.0.%zu.1", i);
+		shares[i] = share_attach(address);
+	}
+	assert_int_equal(atomic_load(&sctx->recursionprefixes), 12);
+	shares[10] = share_attach("2001:db8::3");
+	assert_false(ns_server_recursionshare_over(sctx, a));
+	shares[11] = share_attach("2001:db8::3");
+	assert_true(ns_server_recursionshare_over(sctx, a));
+	for (size_t i = 0; i < 12; i++) {
+		ns_server_recursionshare_detach(sctx, &shares[i]);
+	}
+
+	/*
+	 * Every prefix is counted once, however many there are, and
+	 * clients hold on to their share when the prefix length changes.
+	 */
+	for (size_t i = 0; i < ARRAY_SIZE(shares); i++) {
+		snprintf(address, sizeof(address), "10.%zu.%zu.1", i / 256,
+			 i % 256);
+		shares[i] = share_attach(address);
+	}
+	assert_int_equal(atomic_load(&sctx->recursionprefixes),
+			 ARRAY_SIZE(shares) + 2);
+	size_t shards = 0;
+	for (size_t i = 0; i < NS_RECURSIONSHARE_SHARDS; i++) {
+		if (isc_swisstable_count(sctx->recursionshards[i].table) > 0) {
+			shards++;
+		}
+	}
+	assert_true(shards > NS_RECURSIONSHARE_SHARDS / 2);
+	ns_server_setrecursionshare(sctx, true, 8, 56, 2);
+	for (size_t i = 0; i < ARRAY_SIZE(shares); i++) {
+		ns_server_recursionshare_detach(sctx, &shares[i]);
+	}
+	ns_server_recursionshare_detach(sctx, &a);
+	ns_server_recursionshare_detach(sctx, &b);
+	ns_server_recursionshare_detach(sctx, &c);
+	assert_int_equal(atomic_load(&sctx->recursionprefixes), 0);
+	for (size_t i = 0; i < NS_RECURSIONSHARE_SHARDS; i++) {
+		assert_int_equal(
+			isc_swisstable_count(sctx->recursionshards[i].table),
+			0);
+	}
+
+	/* A recursing client holds a share until its quota is released */
+	result = ns_test_qctx_create(&qctx_params, &qctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	inet_pton(AF_INET, "192.0.2.1", &in);
+	isc_sockaddr_fromin(&qctx->client->inner.peeraddr, &in, 53);
+	qctx->client->inner.state = NS_CLIENTSTATE_WORKING;
+	result = acquire_recursionquota(qctx->client);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_non_null(qctx->client->inner.recursionshare);
+	assert_int_equal(atomic_load(&sctx->recursionprefixes), 1);
+	release_recursionquota(qctx->client);
+	assert_null(qctx->client->inner.recursionshare);
+	assert_int_equal(atomic_load(&sctx->recursionprefixes), 0);
+	ns_test_qctx_destroy(&qctx);
+
+	ns_server_setrecursionshare(sctx, false, 24, 56, 10);
+
+	isc_loop_teardown(isc_loop_main(), shutdown_interfacemgr, NULL);
+	isc_loopmgr_shutdown();
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(ns__query_sfcache, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_start, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_hookasync, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_hookasync_e2e, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_hookchain, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(ns__query_nsec3proof, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(ns__query_recursionshare, setup_server, teardown_server)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,615 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/hash.h>
+#include <isc/lib.h>
+#include <isc/loop.h>
+#include <isc/quota.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/lib.h>
+#include <dns/message.h>
+#include <dns/rdataset.h>
+#include <dns/tsig.h>
+
+#include <ns/client.h>
+#include <ns/server.h>
+
+/*
+ * To test the shared AXFR streams directly.
+ */
+#include "../ns/xfrout.c"
+
+#include <tests/ns.h>
+
+/*
+ * The transfers are driven by the mocks of isc_nm_send() and the netmgr
+ * timers below: every message sent is checked as a secondary would, and
+ * the send completes asynchronously on the loop of the transfer.
+ */
+typedef struct transfer {
+	ns_client_t *client;
+	xfrout_ctx_t *xfr;
+	ns_axfrcache_t *cache; /* The cache the transfer started with */
+	isc_loop_t *loop;
+	dns_tsigkey_t *key;
+	isc_buffer_t *lasttsig;
+	dst_context_t *tsigctx;
+	isc_nm_cb_t cb;
+	void *cbarg;
+	unsigned int nmsg;
+	unsigned int nrecs;
+	uint64_t hash;
+	unsigned int pauseafter; /* Hold the send of this message */
+	unsigned int dropafter;	 /* Fail the send of this message */
+	bool paused;
+	bool left; /* Left the shared stream */
+	bool done;
+	void (*onmsg)(struct transfer *);
+} transfer_t;
+
+#define NTRANSFERS 4
+
+static transfer_t transfers[NTRANSFERS];
+static atomic_uint ndone;
+static unsigned int nexpected;
+
+static dns_db_t *db = NULL;
+static dns_dbversion_t *ver = NULL;
+static dns_fixedname_t fqname;
+static dns_name_t *qname = NULL;
+static unsigned int zonerrs = 0;
+
+static int mock_timer;
+
+void
+isc_nm_timer_create(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+		    isc_nm_timer_cb cb ISC_ATTR_UNUSED,
+		    void *cbarg ISC_ATTR_UNUSED, isc_nm_timer_t **timerp) {
+	*timerp = (isc_nm_timer_t *)&mock_timer;
+}
+
+void
+isc_nm_timer_detach(isc_nm_timer_t **timerp) {
+	*timerp = NULL;
+}
+
+void
+isc_nm_timer_start(isc_nm_timer_t *timer ISC_ATTR_UNUSED,
+		   uint64_t timeout ISC_ATTR_UNUSED) {}
+
+void
+isc_nm_timer_stop(isc_nm_timer_t *timer ISC_ATTR_UNUSED) {}
+
+void
+isc_nmhandle_setwritetimeout(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+			     uint64_t timeout ISC_ATTR_UNUSED) {}
+
+static transfer_t *
+findtransfer(isc_nmhandle_t *handle) {
+	for (size_t i = 0; i < NTRANSFERS; i++) {
+		if (transfers[i].client == (ns_client_t *)handle) {
+			return &transfers[i];
+		}
+	}
+	UNREACHABLE();
+}
+
+/*
+ * Check a message the way a secondary would, TSIG included, and
+ * account for its RRs.
+ */
+static void
+checkmsg(transfer_t *t, isc_region_t *region) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	isc_buffer_t buffer;
+
+	dns_message_create(isc_g_mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE,
+			   &msg);
+	result = dns_message_settsigkey(msg, t->key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_message_setquerytsig(msg, t->lasttsig);
+	msg->tsigctx = t->tsigctx;
+	t->tsigctx = NULL;
+	msg->tcp_continuation = (t->nmsg > 0) ? 1 : 0;
+
+	isc_buffer_init(&buffer, region->base, region->length);
+	isc_buffer_add(&buffer, region->length);
+	result = dns_message_parse(msg, &buffer,
+				   DNS_MESSAGEPARSE_PRESERVEORDER);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(msg->rcode, dns_rcode_noerror);
+	assert_int_equal(msg->id, t->xfr->id);
+	assert_int_equal(msg->counts[DNS_SECTION_QUESTION],
+			 (t->nmsg == 0) ? 1 : 0);
+
+	result = dns_message_checksig(msg, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	if (t->key != NULL) {
+		assert_non_null(dns_message_gettsig(msg, NULL));
+		isc_buffer_free(&t->lasttsig);
+		result = dns_message_getquerytsig(msg, isc_g_mctx,
+						  &t->lasttsig);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+	t->tsigctx = msg->tsigctx;
+	msg->tsigctx = NULL;
+
+	MSG_SECTION_FOREACH(msg, DNS_SECTION_ANSWER, name) {
+		ISC_LIST_FOREACH(name->list, rds, link) {
+			DNS_RDATASET_FOREACH(rds) {
+				dns_rdata_t rdata = DNS_RDATA_INIT;
+				dns_rdataset_current(rds, &rdata);
+
+				/* The stream is bracketed by SOAs */
+				assert_int_equal(rdata.type == dns_rdatatype_soa,
+						 t->nrecs == 0 ||
+							 t->nrecs == zonerrs);
+
+				t->hash = t->hash * 31 +
+					  isc_hash64(name->ndata, name->length,
+						     false) +
+					  isc_hash64(rdata.data, rdata.length,
+						     true);
+				t->nrecs++;
+			}
+		}
+	}
+
+	dns_message_detach(&msg);
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED);
+
+static void
+senddone(void *arg) {
+	transfer_t *t = arg;
+	isc_result_t result = ISC_R_SUCCESS;
+	bool last = (t->nrecs == zonerrs + 1);
+
+	if (t->nmsg == t->dropafter) {
+		/* The secondary went away */
+		result = ISC_R_CONNECTIONRESET;
+		last = true;
+	}
+
+	t->cb((isc_nmhandle_t *)t->client, result, t->cbarg);
+
+	if (last) {
+		t->done = true;
+		if (atomic_fetch_add(&ndone, 1) + 1 == nexpected) {
+			isc_async_run(isc_loop_main(), finish, NULL);
+		}
+	}
+}
+
+void
+isc_nm_send(isc_nmhandle_t *handle, isc_region_t *region, isc_nm_cb_t cb,
+	    void *cbarg) {
+	transfer_t *t = findtransfer(handle);
+
+	assert_ptr_equal(isc_loop(), t->loop);
+	assert_false(t->done);
+
+	checkmsg(t, region);
+	t->nmsg++;
+	t->left = t->left || t->xfr->cache == NULL;
+	t->cb = cb;
+	t->cbarg = cbarg;
+
+	if (t->onmsg != NULL) {
+		t->onmsg(t);
+	}
+
+	if (t->nmsg == t->pauseafter) {
+		t->paused = true;
+		return;
+	}
+	isc_async_current(senddone, t);
+}
+
+static void
+resume(transfer_t *t) {
+	assert_true(t->paused);
+	t->paused = false;
+	isc_async_run(t->loop, senddone, t);
+}
+
+static void
+countrrs(void) {
+	dns_dbiterator_t *dbiter = NULL;
+	isc_result_t result;
+
+	zonerrs = 0;
+	result = dns_db_createiterator(db, 0, &dbiter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	DNS_DBITERATOR_FOREACH(dbiter) {
+		dns_dbnode_t *node = NULL;
+		dns_rdatasetiter_t *rdsiter = NULL;
+
+		result = dns_dbiterator_current(dbiter, &node, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_db_allrdatasets(db, node, ver, 0, 0, &rdsiter);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		DNS_RDATASETITER_FOREACH(rdsiter) {
+			dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+			dns_rdatasetiter_current(rdsiter, &rdataset);
+			zonerrs += dns_rdataset_count(&rdataset);
+			dns_rdataset_disassociate(&rdataset);
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(&node);
+	}
+	dns_dbiterator_destroy(&dbiter);
+}
+
+static void
+setup_transfers(unsigned int n) {
+	isc_result_t result;
+
+	result = ns_test_loaddb(&db, dns_dbtype_zone, "example",
+				TESTS_DIR "/testdata/xfrout/example.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db, &ver);
+	countrrs();
+
+	qname = dns_fixedname_initname(&fqname);
+	result = dns_name_fromstring(qname, "example", dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Small messages, so that the zone takes many of them */
+	sctx->transfer_tcp_message_size = AXFRCACHE_RESERVE + 256;
+
+	memset(transfers, 0, sizeof(transfers));
+	atomic_init(&ndone, 0);
+	nexpected = n;
+}
+
+static dns_tsigkey_t *
+mkkey(const char *name) {
+	isc_result_t result;
+	dns_fixedname_t fkeyname;
+	dns_name_t *keyname = dns_fixedname_initname(&fkeyname);
+	unsigned char secret[32];
+	dns_tsigkey_t *key = NULL;
+
+	memset(secret, name[0], sizeof(secret));
+	result = dns_name_fromstring(keyname, name, dns_rootname, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_tsigkey_create(keyname, DST_ALG_HMACSHA256, secret,
+				    sizeof(secret), isc_g_mctx, &key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return key;
+}
+
+/*
+ * Sign an AXFR request with 'key', and return the MAC the responses
+ * are chained to.
+ */
+static isc_buffer_t *
+signrequest(dns_tsigkey_t *key) {
+	isc_result_t result;
+	dns_message_t *msg = NULL;
+	dns_name_t *name = NULL;
+	dns_rdataset_t *question = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t buffer;
+	unsigned char data[512];
+	isc_buffer_t *querytsig = NULL;
+
+	dns_message_create(isc_g_mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &msg);
+	msg->opcode = dns_opcode_query;
+	msg->rdclass = dns_rdataclass_in;
+	dns_message_gettempname(msg, &name);
+	dns_name_copy(qname, name);
+	dns_message_gettemprdataset(msg, &question);
+	dns_rdataset_makequestion(question, dns_rdataclass_in,
+				  dns_rdatatype_axfr);
+	ISC_LIST_APPEND(name->list, question, link);
+	dns_message_addname(msg, name, DNS_SECTION_QUESTION);
+	result = dns_message_settsigkey(msg, key);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_buffer_init(&buffer, data, sizeof(data));
+	dns_compress_init(&cctx, isc_g_mctx, 0);
+	result = dns_message_renderbegin(msg, &cctx, &buffer);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_message_renderend(msg);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+
+	result = dns_message_getquerytsig(msg, isc_g_mctx, &querytsig);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_message_detach(&msg);
+
+	return querytsig;
+}
+
+/*
+ * Set up transfer 'i' on 'loop', sharing the AXFR stream with the
+ * transfers before it if they can be joined.
+ */
+static transfer_t *
+mktransfer(unsigned int i, isc_loop_t *loop, dns_tsigkey_t *key) {
+	isc_result_t result;
+	transfer_t *t = &transfers[i];
+	isc_buffer_t *lasttsig = NULL;
+
+	ns_test_getclient(NULL, true, &t->client);
+	t->client->inner.tcp = true;
+	t->client->inner.state = NS_CLIENTSTATE_WORKING;
+	t->client->message->rdclass = dns_rdataclass_in;
+	isc_nmhandle_attach(t->client->inner.handle,
+			    &t->client->inner.reqhandle);
+	t->loop = loop;
+
+	if (key != NULL) {
+		dns_tsigkey_attach(key, &t->key);
+		t->lasttsig = signrequest(key);
+		lasttsig = signrequest(key);
+	}
+
+	result = isc_quota_acquire(&sctx->xfroutquota);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	xfrout_ctx_create(isc_g_mctx, t->client, 1000 + i, qname,
+			  dns_rdatatype_axfr, dns_rdataclass_in, NULL, db, ver,
+			  NULL, t->key, lasttsig, key != NULL, 0, 0, true,
+			  &t->xfr);
+	t->xfr->mnemonic = "AXFR";
+	result = axfrcache_attach(sctx, qname, dns_rdataclass_in, db, ver,
+				  true, &t->xfr->cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	t->cache = t->xfr->cache;
+
+	return t;
+}
+
+static void
+start(void *arg) {
+	transfer_t *t = arg;
+
+	assert_ptr_equal(isc_loop(), t->loop);
+	sendstream(t->xfr);
+}
+
+static void
+finish(void *arg ISC_ATTR_UNUSED) {
+	for (size_t i = 0; i < nexpected; i++) {
+		transfer_t *t = &transfers[i];
+		isc_nmhandle_t *handle = t->client->inner.handle;
+
+		assert_true(t->done);
+		assert_null(t->client->inner.reqhandle);
+		if (t->dropafter == 0) {
+			/* Every transfer got the same complete zone */
+			assert_int_equal(t->nrecs, zonerrs + 1);
+			assert_true(t->hash == transfers[0].hash);
+		}
+
+		if (t->key != NULL) {
+			dns_tsigkey_detach(&t->key);
+		}
+		if (t->lasttsig != NULL) {
+			isc_buffer_free(&t->lasttsig);
+		}
+		if (t->tsigctx != NULL) {
+			dst_context_destroy(&t->tsigctx);
+		}
+		isc_nmhandle_detach(&t->client->inner.handle);
+		isc_nmhandle_detach(&handle);
+	}
+
+	/* The last reader to go destroyed the caches */
+	assert_true(ISC_LIST_EMPTY(sctx->axfrcaches));
+
+	dns_db_closeversion(db, &ver, false);
+	dns_db_detach(&db);
+
+	isc_loop_teardown(isc_loop_main(), shutdown_interfacemgr, NULL);
+	isc_loopmgr_shutdown();
+}
+
+/* transfers on different threads share one stream */
+ISC_LOOP_TEST_IMPL(concurrent) {
+	uint32_t nloops = isc_loopmgr_nloops();
+
+	setup_transfers(NTRANSFERS);
+
+	for (size_t i = 0; i < NTRANSFERS; i++) {
+		mktransfer(i, isc_loop_get(i % nloops), NULL);
+		assert_ptr_equal(transfers[i].cache, transfers[0].cache);
+	}
+	for (size_t i = 0; i < NTRANSFERS; i++) {
+		isc_async_run(transfers[i].loop, start, &transfers[i]);
+	}
+}
+
+/* a reader needing the chunk being rendered waits for it */
+ISC_LOOP_TEST_IMPL(wait) {
+	transfer_t *a = NULL, *b = NULL;
+
+	setup_transfers(2);
+
+	a = mktransfer(0, isc_loop(), NULL);
+	b = mktransfer(1, isc_loop(), NULL);
+	assert_ptr_equal(a->cache, b->cache);
+
+	/* Pretend that 'b' is rendering the first chunk */
+	a->cache->rendering = true;
+	sendstream(a->xfr);
+	assert_int_equal(a->nmsg, 0);
+	assert_ptr_equal(ISC_LIST_HEAD(a->cache->waiters), a->xfr);
+	assert_ptr_equal(a->xfr->waitloop, isc_loop());
+	a->cache->rendering = false;
+
+	/* Once it has, 'a' is resumed */
+	sendstream(b->xfr);
+	assert_int_equal(b->nmsg, 1);
+	assert_true(ISC_LIST_EMPTY(a->cache->waiters));
+	assert_int_equal(a->cache->nchunks, 1);
+}
+
+static void
+join_late(transfer_t *t) {
+	transfer_t *b = NULL;
+
+	if (t->nmsg != 10) {
+		return;
+	}
+
+	/* The first chunks are gone, so a new stream is started */
+	assert_true(t->cache->trimmed);
+	assert_false(ISC_LIST_HEAD(t->cache->chunks)->first);
+
+	b = mktransfer(1, isc_loop(), NULL);
+	assert_ptr_not_equal(b->cache, t->cache);
+	isc_async_current(start, b);
+}
+
+/* a transfer starting after the cache was trimmed doesn't join it */
+ISC_LOOP_TEST_IMPL(late) {
+	transfer_t *a = NULL;
+
+	setup_transfers(2);
+
+	a = mktransfer(0, isc_loop(), NULL);
+	a->cache->maxsize = 1024;
+	a->onmsg = join_late;
+	isc_async_current(start, a);
+}
+
+static void
+resume_slow(transfer_t *t) {
+	if (t->done || !t->left || !transfers[1].paused) {
+		return;
+	}
+
+	/* The renderer stayed within reach of the slow reader */
+	LOCK(&transfers[1].cache->lock);
+	assert_true(transfers[1].cache->size <=
+		    transfers[1].cache->maxsize + NS_CLIENT_TCP_BUFFER_SIZE);
+	assert_int_equal(transfers[1].cache->readers, 1);
+	UNLOCK(&transfers[1].cache->lock);
+
+	resume(&transfers[1]);
+}
+
+/* a reader too far ahead of the others leaves the shared stream */
+ISC_LOOP_TEST_IMPL(lag) {
+	transfer_t *a = NULL, *b = NULL;
+
+	setup_transfers(2);
+
+	a = mktransfer(0, isc_loop(), NULL);
+	b = mktransfer(1, isc_loop(), NULL);
+	assert_ptr_equal(a->cache, b->cache);
+	a->cache->maxsize = 4096;
+	b->pauseafter = 2;
+	a->onmsg = resume_slow;
+
+	isc_async_current(start, a);
+	isc_async_current(start, b);
+}
+
+static void
+resume_second(transfer_t *t) {
+	if (t->nmsg == 30 && transfers[1].paused) {
+		resume(&transfers[1]);
+	}
+}
+
+/* each reader signs the shared messages with its own TSIG key */
+ISC_LOOP_TEST_IMPL(tsig) {
+	dns_tsigkey_t *key1 = mkkey("key1"), *key2 = mkkey("key2");
+	transfer_t *a = NULL, *b = NULL, *c = NULL;
+
+	setup_transfers(3);
+
+	a = mktransfer(0, isc_loop(), key1);
+	b = mktransfer(1, isc_loop(), key2);
+	c = mktransfer(2, isc_loop(), NULL);
+	assert_ptr_equal(a->cache, b->cache);
+	assert_ptr_equal(a->cache, c->cache);
+	b->pauseafter = 5;
+	a->onmsg = resume_second;
+
+	isc_async_current(start, a);
+	isc_async_current(start, b);
+	isc_async_current(start, c);
+
+	dns_tsigkey_detach(&key1);
+	dns_tsigkey_detach(&key2);
+}
+
+static void
+check_dropped(transfer_t *t) {
+	if (t->nmsg != 10) {
+		return;
+	}
+
+	/* Only the chunk 'a' is sending is left */
+	assert_true(transfers[1].done);
+	assert_int_equal(t->cache->readers, 1);
+	assert_ptr_equal(ISC_LIST_HEAD(t->cache->chunks), t->xfr->chunk);
+	assert_ptr_equal(ISC_LIST_TAIL(t->cache->chunks), t->xfr->chunk);
+}
+
+/* a reader going away in the middle of the stream releases its chunks */
+ISC_LOOP_TEST_IMPL(drop) {
+	transfer_t *a = NULL, *b = NULL;
+
+	setup_transfers(2);
+
+	a = mktransfer(0, isc_loop(), NULL);
+	b = mktransfer(1, isc_loop(), NULL);
+	assert_ptr_equal(a->cache, b->cache);
+	a->cache->maxsize = 1024;
+	b->dropafter = 3;
+	a->onmsg = check_dropped;
+
+	isc_async_current(start, a);
+	isc_async_current(start, b);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(concurrent, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(wait, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(late, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(lag, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(tsig, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(drop, setup_server, teardown_server)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN